@@ -0,0 +1,125 @@
+#!/bin/bash
+
+# Runs the programs in programs/ on generated host graphs of increasing size
+# and writes one line per run to a CSV file. Called by "make bench", or
+# directly with the environment variables below.
+#
+# GP2            - The compiler (default: gp2 on the path).
+# LIBDIR         - The directory of the lib source files (default: ../lib),
+#                  compiled with each program instead of the installed lib.
+# CC             - The C compiler for the measuring helper (default: gcc).
+# BENCH_SIZES    - The approximate numbers of host nodes
+#                  (default: 1000 10000 100000 1000000 10000000).
+# BENCH_PROGRAMS - The programs to run (default: all in the table below).
+# BENCH_FLAGS    - Flags passed to the compiler, e.g. "-n -i" (default: none).
+# BENCH_TIMEOUT  - Seconds after which a run is killed (default: 300). Once a
+#                  program times out or crashes, its larger sizes are skipped.
+# BENCH_WORK     - The directory for generated hosts and compiled programs
+#                  (default: bench-work). Hosts are kept for later runs.
+# BENCH_CSV      - The output file (default: bench-results.csv).
+#
+# The CSV columns are:
+# program, family, size  - The run, with size the requested number of nodes.
+# nodes, edges           - The size of the generated host graph.
+# flags                  - BENCH_FLAGS.
+# status                 - ok, no_output (the program failed), timeout,
+#                          exit-<code>, signal-<number>, compile_error or
+#                          skipped.
+# wall_s, peak_rss_kb    - The wall-clock time and peak resident set size of
+#                          the whole run.
+# parse_s, run_s, print_s - The wall-clock time of building the host graph,
+#                          executing the program and writing the output
+#                          graph, from gp2.report.
+
+bench_dir=$(cd "$(dirname "$0")" && pwd)
+GP2=${GP2:-gp2}
+LIBDIR=${LIBDIR:-$bench_dir/../lib}
+CC=${CC:-gcc}
+BENCH_SIZES=${BENCH_SIZES:-"1000 10000 100000 1000000 10000000"}
+BENCH_FLAGS=${BENCH_FLAGS:-}
+BENCH_TIMEOUT=${BENCH_TIMEOUT:-300}
+BENCH_WORK=${BENCH_WORK:-bench-work}
+BENCH_CSV=${BENCH_CSV:-bench-results.csv}
+programs_dir=$bench_dir/../programs
+
+# <program> <host family> [host generator options]
+pairs="2colouring grid
+rooted-2colouring grid
+colouring tree
+acyclic dag
+topological-sort dag
+single-source-shortest-path grid -w -s
+mst-boruvka grid -w
+transitive-closure tree
+hoover grid
+series-parallel cycle
+eulerian-cycle cycle
+sierpinsky-triangle sierpinski"
+
+mkdir -p "$BENCH_WORK/hosts" || exit 1
+work=$(cd "$BENCH_WORK" && pwd)
+measure=$work/measure
+$CC -O2 -o "$measure" "$bench_dir/measure.c" || exit 1
+
+echo "program,family,size,nodes,edges,flags,status,wall_s,peak_rss_kb,parse_s,run_s,print_s" \
+   > "$BENCH_CSV"
+
+# Generates the host graph of the family and size unless it exists, and sets
+# host to its path and host_size to "<nodes>,<edges>".
+function generate-host {
+   local family=$1 size=$2; shift 2
+   local options=${*// /}
+   host=$work/hosts/$family$options-$size.host
+   if [ ! -f "$host" ] || [ ! -f "$host.size" ]; then
+      echo "Generating $family host with $size nodes"
+      "$bench_dir/genhost.sh" "$@" "$family" "$size" > "$host" 2> "$host.size" || exit 1
+   fi
+   host_size=$(tr ' ' ',' < "$host.size")
+}
+
+# Compiles the program into the directory build. Returns 1 on failure.
+function compile-program {
+   rm -rf "$build" && mkdir -p "$build" || exit 1
+   echo "Compiling $program"
+   "$GP2" $BENCH_FLAGS -l "$LIBDIR" -o "$build" "$programs_dir/$program.gp2" > "$build/compile.log" 2>&1 &&
+   cp "$LIBDIR"/*.c "$LIBDIR"/*.h "$build" &&
+   make -C "$build" -s > "$build/make.log" 2>&1
+}
+
+while read -r program family options; do
+   if [ -n "${BENCH_PROGRAMS:-}" ] && [[ " $BENCH_PROGRAMS " != *" $program "* ]]; then
+      continue
+   fi
+   build=$work/build/$program
+   compiled=true
+   compile-program || compiled=false
+   skip=false
+   for size in $BENCH_SIZES; do
+      generate-host $family $size $options
+      line="$program,$family,$size,$host_size,$BENCH_FLAGS"
+      if [ $compiled = false ]; then
+         echo "$line,compile_error,,,,," >> "$BENCH_CSV"
+         continue
+      fi
+      if [ $skip = true ]; then
+         echo "$line,skipped,,,,," >> "$BENCH_CSV"
+         continue
+      fi
+      echo "Running $program on $family host with $size nodes"
+      rm -f "$build/gp2.output" "$build/gp2.report"
+      (cd "$build" && "$measure" result "$BENCH_TIMEOUT" ./gp2run "$host" > run.log 2>&1)
+      read -r status wall rss < "$build/result"
+      if [ "$status" = ok ] && grep -q "^No output graph" "$build/gp2.output" 2> /dev/null; then
+         status=no_output
+      fi
+      [ "$status" = ok ] || [ "$status" = no_output ] || skip=true
+      phases=$(awk -F'\t' '$1 == "phase" { wall[$2] = $3 }
+                           END { if("execution" in wall)
+                                    printf "%s,%s,%s", wall["parsing"], wall["execution"], wall["output"] }' \
+               "$build/gp2.report" 2> /dev/null)
+      [ -n "$phases" ] || phases=",,"
+      echo "$line,$status,$wall,$rss,$phases" >> "$BENCH_CSV"
+   done
+done <<< "$pairs"
+
+echo "Results saved to $BENCH_CSV"
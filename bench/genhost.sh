@@ -0,0 +1,87 @@
+#!/bin/bash
+
+# Writes a GP 2 host graph of the given family with about the given number of
+# nodes to stdout, and its node and edge counts to stderr as "<nodes> <edges>".
+#
+# Usage: genhost.sh [-w] [-s] <family> <nodes>
+#
+# Families:
+# grid       - A square grid with edges pointing right and down. It is acyclic.
+# tree       - A random tree with edges from each node to its children.
+# cycle      - A directed cycle.
+# dag        - A random connected DAG with about two edges per node.
+# sierpinski - The input of sierpinsky-triangle.gp2: a root node labelled
+#              with the first generation with at least the given number of
+#              nodes.
+#
+# -w labels the edges with random integer weights from 1 to 100 instead of
+#    empty.
+# -s marks node 0 grey, the source of single-source-shortest-path.gp2.
+#
+# Random graphs are generated from a fixed seed, so each call with the same
+# arguments writes the same graph.
+
+weights=0
+source=0
+while getopts "ws" option; do
+   case $option in
+      w) weights=1 ;;
+      s) source=1 ;;
+      *) echo "Usage: genhost.sh [-w] [-s] <family> <nodes>" >&2; exit 1 ;;
+   esac
+done
+shift $((OPTIND - 1))
+if [ $# -ne 2 ]; then
+   echo "Usage: genhost.sh [-w] [-s] <family> <nodes>" >&2
+   exit 1
+fi
+
+awk -v family="$1" -v n="$2" -v weights=$weights -v source=$source '
+function node(id) {
+   if(id == 0 && source) print "  (" id ", empty # grey)"
+   else print "  (" id ", empty)"
+   nodes++
+}
+function edge(from, to) {
+   print "  (" edges ", " from ", " to ", " (weights ? 1 + int(rand() * 100) : "empty") ")"
+   edges++
+}
+BEGIN {
+   srand(1)
+   nodes = 0
+   edges = 0
+   if(family == "sierpinski") {
+      # Generation k has 3 * (3^k + 1) / 2 nodes.
+      for(k = 0; 3 * (3 ^ k + 1) / 2 < n; k++);
+      print "[ (0(R), " k ") | ]"
+      nodes = 1
+   }
+   else if(family == "grid") {
+      side = int(sqrt(n) + 0.5)
+      print "["
+      for(i = 0; i < side * side; i++) node(i)
+      print "|"
+      for(i = 0; i < side * side; i++) {
+         if(i % side < side - 1) edge(i, i + 1)
+         if(i + side < side * side) edge(i, i + side)
+      }
+      print "]"
+   }
+   else if(family == "tree" || family == "cycle" || family == "dag") {
+      print "["
+      for(i = 0; i < n; i++) node(i)
+      print "|"
+      for(i = 1; i < n; i++) {
+         if(family == "cycle") edge(i - 1, i)
+         else edge(int(rand() * i), i)
+         if(family == "dag" && i > 1) edge(int(rand() * i), i)
+      }
+      if(family == "cycle" && n > 1) edge(n - 1, 0)
+      print "]"
+   }
+   else {
+      print "Error: unknown graph family " family "." > "/dev/stderr"
+      exit 1
+   }
+   print nodes " " edges > "/dev/stderr"
+}'
@@ -0,0 +1,95 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+/* Runs a command and writes its status, wall-clock time in seconds and peak
+ * resident set size in kilobytes to the result file, separated by spaces.
+ * The status is "ok", "exit-<code>", "signal-<number>" or "timeout". The
+ * command is killed after the timeout unless it is 0.
+ *
+ * Usage: measure <result-file> <timeout-seconds> <command> [args...] */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+static pid_t child = 0;
+static volatile sig_atomic_t timed_out = 0;
+
+static void timeout(int signal_number)
+{
+   (void) signal_number;
+   timed_out = 1;
+   if(child > 0) kill(child, SIGKILL);
+}
+
+int main(int argc, char **argv)
+{
+   if(argc < 4)
+   {
+      fprintf(stderr, "Usage: measure <result-file> <timeout-seconds> <command> [args...]\n");
+      return 2;
+   }
+   FILE *result = fopen(argv[1], "w");
+   if(result == NULL)
+   {
+      perror(argv[1]);
+      return 2;
+   }
+   int seconds = atoi(argv[2]);
+   signal(SIGALRM, timeout);
+
+   struct timespec start, end;
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   child = fork();
+   if(child < 0)
+   {
+      perror("fork");
+      return 2;
+   }
+   if(child == 0)
+   {
+      execvp(argv[3], argv + 3);
+      perror(argv[3]);
+      _exit(127);
+   }
+   if(seconds > 0) alarm(seconds);
+
+   int status;
+   struct rusage usage;
+   while(wait4(child, &status, 0, &usage) < 0)
+   {
+      if(errno == EINTR) continue;
+      perror("wait4");
+      return 2;
+   }
+   alarm(0);
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   double wall = (double) (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+   if(timed_out) fprintf(result, "timeout");
+   else if(WIFSIGNALED(status)) fprintf(result, "signal-%d", WTERMSIG(status));
+   else if(WEXITSTATUS(status) != 0) fprintf(result, "exit-%d", WEXITSTATUS(status));
+   else fprintf(result, "ok");
+   /* ru_maxrss is in kilobytes on Linux. */
+   fprintf(result, " %.3f %ld\n", wall, usage.ru_maxrss);
+   fclose(result);
+   return 0;
+}
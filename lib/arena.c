@@ -0,0 +1,80 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "arena.h"
+
+void initialiseArena(Arena *arena, size_t initial_size)
+{
+   assert(initial_size > 0 && initial_size % ARENA_ALIGNMENT == 0);
+   arena->top = 0;
+   arena->initial_size = initial_size;
+   arena->chunks = 0;
+   for(int chunk = 0; chunk < ARENA_MAX_CHUNKS; chunk++) arena->chunk[chunk] = NULL;
+}
+
+void *arenaAllocate(Arena *arena, size_t size)
+{
+   size = arenaSize(size);
+   int chunk = arenaChunk(arena, arena->top);
+   size_t end = arenaChunkStart(arena, chunk + 1);
+   /* An allocation never straddles two chunks. The rest of the chunk is
+    * skipped instead. */
+   while(arena->top + size > end)
+   {
+      arena->top = end;
+      chunk++;
+      end = arenaChunkStart(arena, chunk + 1);
+   }
+   if(chunk >= ARENA_MAX_CHUNKS)
+   {
+      print_to_log("Error (arenaAllocate): arena exhausted.\n");
+      exit(1);
+   }
+   while(arena->chunks <= chunk)
+   {
+      arena->chunk[arena->chunks] = mallocSafe(arena->initial_size << arena->chunks,
+                                               "arenaAllocate");
+      arena->chunks++;
+   }
+   void *address = arena->chunk[chunk] + (arena->top - arenaChunkStart(arena, chunk));
+   arena->top += size;
+   return address;
+}
+
+/* The chunk following the top is kept so that a stack moving back and forth
+ * across a chunk boundary does not allocate and free it each time. */
+void arenaRelease(Arena *arena, size_t checkpoint)
+{
+   assert(checkpoint <= arena->top);
+   arena->top = checkpoint;
+   int keep = arenaChunk(arena, checkpoint) + 2;
+   while(arena->chunks > keep)
+   {
+      arena->chunks--;
+      free(arena->chunk[arena->chunks]);
+      arena->chunk[arena->chunks] = NULL;
+   }
+}
+
+void freeArena(Arena *arena)
+{
+   while(arena->chunks > 0)
+   {
+      arena->chunks--;
+      free(arena->chunk[arena->chunks]);
+      arena->chunk[arena->chunks] = NULL;
+   }
+   arena->top = 0;
+}
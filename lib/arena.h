@@ -0,0 +1,95 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ============
+  Arena Module
+  ============
+
+  A region allocator for data that is freed in last-in first-out order, such
+  as the records of the graph change stack. Allocations are bumped off the
+  top of the arena, and everything allocated after a checkpoint is released
+  at once by resetting the top to it. A checkpoint is the value of the top,
+  so it nests like the restore points of the change stack.
+
+  The arena is a sequence of chunks that double in size and are never moved,
+  so allocations keep their addresses and the address of an offset can be
+  computed directly. When the top is reset, chunks beyond the one following
+  the top are freed.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_ARENA_H
+#define INC_ARENA_H
+
+#define ARENA_ALIGNMENT 8
+#define ARENA_MAX_CHUNKS 40
+
+#include "common.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct Arena {
+   /* The offset of the next allocation, and the size of the first chunk. */
+   size_t top;
+   size_t initial_size;
+   /* Chunk i holds initial_size << i bytes and starts at offset
+    * initial_size * (2^i - 1). The chunks above the last one allocated are
+    * NULL. */
+   int chunks;
+   char *chunk[ARENA_MAX_CHUNKS];
+} Arena;
+
+/* Allocation sizes are rounded up to a multiple of the alignment. */
+#define arenaSize(size) \
+   (((size) + ARENA_ALIGNMENT - 1) & ~((size_t) ARENA_ALIGNMENT - 1))
+
+/* The initial size must be a multiple of the alignment. An arena that only
+ * holds records of one size is contiguous if the initial size is a multiple
+ * of the rounded record size: the record at position p then has the offset
+ * p * arenaSize(record size). */
+void initialiseArena(Arena *arena, size_t initial_size);
+void *arenaAllocate(Arena *arena, size_t size);
+void arenaRelease(Arena *arena, size_t checkpoint);
+void freeArena(Arena *arena);
+
+static inline size_t arenaCheckpoint(Arena *arena)
+{
+   return arena->top;
+}
+
+static inline int arenaChunk(Arena *arena, size_t offset)
+{
+   size_t blocks = offset / arena->initial_size + 1;
+   return (int) (sizeof(unsigned long long) * 8 - 1) - __builtin_clzll(blocks);
+}
+
+static inline size_t arenaChunkStart(Arena *arena, int chunk)
+{
+   return arena->initial_size * (((size_t) 1 << chunk) - 1);
+}
+
+/* Returns the address of an allocated offset. */
+static inline void *arenaAt(Arena *arena, size_t offset)
+{
+   assert(offset < arena->top);
+   int chunk = arenaChunk(arena, offset);
+   return arena->chunk[chunk] + (offset - arenaChunkStart(arena, chunk));
+}
+
+#endif /* INC_ARENA_H */
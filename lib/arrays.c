@@ -17,8 +17,8 @@
 #include <stddef.h>
 #include "arrays.h"
 
-// Find leading bit in an int.
-#define fls(x) (int) ((sizeof(int)<<3) - __builtin_clz(x) - 1)
+// Find leading bit in a long.
+#define fls(x) (int) ((sizeof(long)<<3) - __builtin_clzl(x) - 1)
 
 BigArray makeBigArray(size_t elem_sz)
 {
@@ -65,7 +65,13 @@ void doubleBigArray(BigArray *array)
   array->capacity += array_size;
 }
 
-int genFreeBigArrayPos(BigArray *array)
+void reserveBigArray(BigArray *array, long capacity)
+{
+  while(array->capacity < capacity)
+    doubleBigArray(array);
+}
+
+long genFreeBigArrayPos(BigArray *array)
 {
   assert(array->size <= array->capacity);
   #ifndef MINIMAL_GC
@@ -92,7 +98,7 @@ int genFreeBigArrayPos(BigArray *array)
   #endif
 }
 
-void *getBigArrayValue(BigArray *array, int index)
+void *getBigArrayValue(BigArray *array, long index)
 {
   assert(index >= 0);
   assert(index < array->size);
@@ -101,13 +107,13 @@ void *getBigArrayValue(BigArray *array, int index)
     return (void *) &(array->firstelems[index * array->elem_sz]);
 
   index -= BIGAR_INIT_SZ / array->elem_sz;
-  ptrdiff_t inarray_index = (ptrdiff_t) index - (1 << fls(index+2)) + 2;
+  ptrdiff_t inarray_index = (ptrdiff_t) index - (1L << fls(index+2)) + 2;
 
   return (void *) array->elems[fls(index+2)-1].items + inarray_index*array->elem_sz;
 }
 
 #ifndef MINIMAL_GC
-void removeFromBigArray(BigArray *array, int index)
+void removeFromBigArray(BigArray *array, long index)
 {
   assert(index >= 0);
   assert(index < array->size);
@@ -42,7 +42,7 @@ typedef struct BigArrayElem {
 typedef struct BigArrayHole {
   struct BigArrayHole *prev;
   struct BigArrayHole *next;
-  int index; // TODO: UNSIGNED
+  long index;
 } BigArrayHole;
 
 // Dynamic data struct of arbitrary size, which never moves elements.
@@ -51,12 +51,14 @@ typedef struct BigArrayHole {
 // and an IntArray of available holes in said array.
 // Useful for minimizing the number of malloc's while keeping pointers valid.
 
-// 24/32 bytes + BIGAR_INIT_SZ
-// currently, 216/224 bytes
+// 32/40 bytes + BIGAR_INIT_SZ
+// currently, 224/232 bytes
+// Positions and sizes are longs, so an array can hold as many elements as fit
+// in memory. The subarrays double in size, so there are at most 64 of them.
 typedef struct BigArray {
-  int capacity; // TODO: UNSIGNED
-  int size; // TODO: UNSIGNED
-  int elem_sz; // TODO: UNSIGNED
+  long capacity;
+  long size;
+  int elem_sz;
   unsigned short max_array;
   unsigned short num_arrays;
 #define BIGAR_INIT_SZ 192
@@ -68,10 +70,12 @@ typedef struct BigArray {
 } BigArray;
 
 BigArray makeBigArray(size_t elem_sz);
-int genFreeBigArrayPos(BigArray *array);
-void *getBigArrayValue(BigArray *array, int index);
+// Allocate space for at least capacity elements up front.
+void reserveBigArray(BigArray *array, long capacity);
+long genFreeBigArrayPos(BigArray *array);
+void *getBigArrayValue(BigArray *array, long index);
 
 #ifndef MINIMAL_GC
-void removeFromBigArray(BigArray *array, int index);
+void removeFromBigArray(BigArray *array, long index);
 void emptyBigArray(BigArray *array);
 #endif
@@ -0,0 +1,194 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "batch.h"
+#include "debug.h"
+#include "graphWriter.h"
+#include "hostLoader.h"
+#include "report.h"
+#include "snapshot.h"
+
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Shared by the workers through an anonymous shared mapping. */
+typedef struct BatchState {
+   /* The index of the next unprocessed host file. */
+   atomic_int next;
+   atomic_int outputs, failures, errors;
+} BatchState;
+
+string *readManifest(string file_name, int *count)
+{
+   FILE *manifest = fopen(file_name, "r");
+   if(manifest == NULL)
+   {
+      perror(file_name);
+      return NULL;
+   }
+   int capacity = 64;
+   string *host_files = mallocSafe(capacity * sizeof(string), "readManifest");
+   *count = 0;
+   char *line = NULL;
+   size_t line_size = 0;
+   ssize_t length;
+   while((length = getline(&line, &line_size, manifest)) != -1)
+   {
+      while(length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r'))
+         line[--length] = '\0';
+      if(length == 0 || line[0] == '#') continue;
+      if(*count == capacity)
+      {
+         capacity *= 2;
+         host_files = reallocSafe(host_files, capacity * sizeof(string), "readManifest");
+      }
+      host_files[(*count)++] = strdup(line);
+   }
+   free(line);
+   fclose(manifest);
+   return host_files;
+}
+
+/* Writes the output of one run to <host file>.output. Returns false if the
+ * file cannot be written. */
+static bool writeOutput(GP2Context *context, string host_file, bool succeeded,
+                        BatchOptions options)
+{
+   char output_name[strlen(host_file) + 8];
+   sprintf(output_name, "%s.output", host_file);
+   FILE *output_file = fopen(output_name, "w");
+   if(output_file == NULL)
+   {
+      perror(output_name);
+      return false;
+   }
+   startPhase(OUTPUT_PHASE);
+   bool written = true;
+   if(!succeeded) fprintf(output_file, "No output graph: %s\n", context->failure);
+   else if(options.snapshot_output) printGraphSnapshot(context->host, output_file);
+   else written = printGraphBuffered(context->host, output_file, options.dense_ids);
+   if(fclose(output_file) != 0) written = false;
+   return written;
+}
+
+/* Processes host files until there are none left. The log, the profile and
+ * the report are named after the worker. The log of the batch is restored at
+ * the end. */
+static void runWorker(int worker, GP2Context *context, ProgramFunction program,
+                      string *host_files, int count, BatchOptions options,
+                      BatchState *state)
+{
+   FILE *batch_log = log_file;
+   char file_name[32];
+   sprintf(file_name, "gp2.%d.log", worker);
+   openLogFile(file_name);
+   int index;
+   while((index = atomic_fetch_add(&(state->next), 1)) < count)
+   {
+      string host_file = host_files[index];
+      startPhase(PARSING_PHASE);
+      Graph *graph = isGraphSnapshot(host_file) ? loadGraphSnapshot(host_file)
+                                                : loadHostGraph(host_file);
+      if(graph == NULL)
+      {
+         fprintf(stderr, "Error parsing host graph file %s.\n", host_file);
+         atomic_fetch_add(&(state->errors), 1);
+         continue;
+      }
+      startPhase(EXECUTION_PHASE);
+      bool succeeded = program(context, graph);
+      if(!writeOutput(context, host_file, succeeded, options))
+         atomic_fetch_add(&(state->errors), 1);
+      else if(succeeded) atomic_fetch_add(&(state->outputs), 1);
+      else atomic_fetch_add(&(state->failures), 1);
+   }
+   if(options.profiles != NULL)
+   {
+      sprintf(file_name, "gp2.%d.profile", worker);
+      writeProfile(file_name, options.profiles);
+   }
+   recordMemory(context->host);
+   startPhase(TEARDOWN_PHASE);
+   sprintf(file_name, "gp2.%d.report", worker);
+   writeReport(file_name);
+   closeLogFile();
+   log_file = batch_log;
+}
+
+bool runBatch(ProgramFunction program, string *host_files, int count,
+              BatchOptions options)
+{
+   int workers = options.workers;
+   if(workers <= 0) workers = (int) sysconf(_SC_NPROCESSORS_ONLN);
+   if(workers > count) workers = count;
+   if(workers < 1) workers = 1;
+
+   BatchState *state = mmap(NULL, sizeof(BatchState), PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if(state == MAP_FAILED)
+   {
+      perror("runBatch");
+      return false;
+   }
+   atomic_init(&(state->next), 0);
+   atomic_init(&(state->outputs), 0);
+   atomic_init(&(state->failures), 0);
+   atomic_init(&(state->errors), 0);
+
+   startPhase(STARTUP_PHASE);
+   GP2Context *context = makeContext();
+   stopPhase();
+   bool crashed = false;
+   if(workers == 1) runWorker(0, context, program, host_files, count, options, state);
+   else
+   {
+      /* Buffered output would be written again by each worker. */
+      fflush(stdout);
+      fflush(stderr);
+      if(log_file != NULL) fflush(log_file);
+      int worker;
+      for(worker = 0; worker < workers; worker++)
+      {
+         pid_t pid = fork();
+         if(pid == 0)
+         {
+            runWorker(worker, context, program, host_files, count, options, state);
+            _exit(0);
+         }
+         if(pid < 0)
+         {
+            perror("fork");
+            crashed = true;
+            break;
+         }
+      }
+      int status;
+      while(wait(&status) > 0)
+         if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) crashed = true;
+   }
+   int outputs = atomic_load(&(state->outputs)), failures = atomic_load(&(state->failures)),
+       errors = atomic_load(&(state->errors));
+   printf("Processed %d host graphs on %d worker%s: %d output graphs, %d failures, "
+          "%d errors.\n", count, workers, workers == 1 ? "" : "s", outputs, failures, errors);
+   if(outputs + failures + errors < count)
+      fprintf(stderr, "Error: %d host graphs were not processed.\n",
+              count - outputs - failures - errors);
+   freeContext(context);
+   munmap(state, sizeof(BatchState));
+   return !crashed && outputs + failures == count;
+}
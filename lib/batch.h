@@ -0,0 +1,70 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ============
+  Batch Module
+  ============
+
+  Runs a compiled program on many host graphs, for gp2run called with several
+  host files or a manifest. The inputs are shared by a pool of worker
+  processes. Each worker takes the next unprocessed input when it finishes
+  one, so a few large graphs do not hold up the rest.
+
+  The context, and with it the string table and the list store, is made
+  before the workers are forked. Each worker starts with a copy of them and
+  reuses its context, change stack and morphisms for all of its inputs. The
+  output graph of <host file> is written to <host file>.output. Worker n
+  writes its log, run report and profile to gp2.<n>.log, gp2.<n>.report and
+  gp2.<n>.profile. Its report adds up the phases of all of its runs, and it
+  records memory for its last graph.
+
+  A manifest lists one host file per line. Blank lines and lines starting
+  with '#' are skipped.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_BATCH_H
+#define INC_BATCH_H
+
+#include "common.h"
+#include "context.h"
+#include "graph.h"
+#include "profile.h"
+
+#include <stdbool.h>
+
+typedef bool (*ProgramFunction)(GP2Context *context, Graph *graph);
+
+typedef struct BatchOptions {
+   /* The number of worker processes, or 0 for one per online processor. */
+   int workers;
+   bool snapshot_output, dense_ids;
+   /* The rule profiles written by each worker, or NULL. */
+   RuleProfile **profiles;
+} BatchOptions;
+
+/* Returns the host files listed in the manifest as an array of count strings,
+ * or NULL if the manifest cannot be read. */
+string *readManifest(string file_name, int *count);
+
+/* Runs the program on each host file. Returns false if a host file could not
+ * be loaded, an output file could not be written or a worker crashed. The
+ * failure of the program on a graph is reported in its output file. */
+bool runBatch(ProgramFunction program, string *host_files, int count,
+              BatchOptions options);
+
+#endif /* INC_BATCH_H */
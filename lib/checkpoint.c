@@ -0,0 +1,112 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "checkpoint.h"
+#include "graphStacks.h"
+#include "snapshot.h"
+
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+volatile sig_atomic_t checkpoint_requested = 0;
+
+static string checkpoint_file = NULL, temporary_file = NULL;
+
+static void requestCheckpoint(int signal_number)
+{
+   (void) signal_number;
+   checkpoint_requested = 1;
+}
+
+void enableCheckpoints(string file_name, int interval)
+{
+   checkpoint_file = file_name;
+   temporary_file = mallocSafe(strlen(file_name) + 5, "enableCheckpoints");
+   strcpy(temporary_file, file_name);
+   strcat(temporary_file, ".tmp");
+
+   struct sigaction action;
+   memset(&action, 0, sizeof(struct sigaction));
+   action.sa_handler = requestCheckpoint;
+   sigemptyset(&action.sa_mask);
+   /* Interrupted reads and writes of the host and output files restart. */
+   action.sa_flags = SA_RESTART;
+   sigaction(SIGUSR1, &action, NULL);
+   if(interval > 0)
+   {
+      sigaction(SIGALRM, &action, NULL);
+      struct itimerval timer = {{interval, 0}, {interval, 0}};
+      setitimer(ITIMER_REAL, &timer, NULL);
+   }
+}
+
+void writeCheckpoint(Graph *graph, uint32_t program, int site)
+{
+   if(checkpoint_file == NULL || graphChangeStackSize() > 0) return;
+   checkpoint_requested = 0;
+   FILE *file = fopen(temporary_file, "wb");
+   if(file == NULL)
+   {
+      perror(temporary_file);
+      return;
+   }
+   CheckpointHeader header;
+   memset(&header, 0, sizeof(CheckpointHeader));
+   memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+   header.version = CHECKPOINT_VERSION;
+   header.program = program;
+   header.site = (uint32_t) site;
+   fwrite(&header, sizeof(CheckpointHeader), 1, file);
+   printGraphSnapshot(graph, file);
+   /* The data must be on disk before the rename replaces the last
+    * checkpoint. */
+   bool written = fflush(file) == 0 && fsync(fileno(file)) == 0;
+   if(fclose(file) != 0) written = false;
+   if(!written || rename(temporary_file, checkpoint_file) != 0)
+   {
+      perror(checkpoint_file);
+      remove(temporary_file);
+      return;
+   }
+   print_to_log("Checkpoint written at site %d.\n", site);
+}
+
+Graph *loadCheckpoint(string file_name, uint32_t program, int *site)
+{
+   FILE *file = fopen(file_name, "rb");
+   if(file == NULL)
+   {
+      perror(file_name);
+      return NULL;
+   }
+   CheckpointHeader header;
+   bool valid = fread(&header, sizeof(CheckpointHeader), 1, file) == 1;
+   fclose(file);
+   if(!valid || memcmp(header.magic, CHECKPOINT_MAGIC, 8) != 0 ||
+      header.version != CHECKPOINT_VERSION)
+   {
+      print_to_log("Error (loadCheckpoint): %s is not a checkpoint file.\n", file_name);
+      return NULL;
+   }
+   if(header.program != program)
+   {
+      print_to_log("Error (loadCheckpoint): %s is the checkpoint of another "
+                   "program.\n", file_name);
+      return NULL;
+   }
+   *site = (int) header.site;
+   return loadGraphSnapshotAt(file_name, sizeof(CheckpointHeader));
+}
@@ -0,0 +1,81 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  =================
+  Checkpoint Module
+  =================
+
+  Checkpoints of long runs. A checkpoint file holds the position the run has
+  reached and the host graph at that point in the snapshot format, so that a
+  run that crashes or is stopped can be continued from it with
+  gp2run --resume.
+
+  The positions are the checkpoint sites of the program: the commands of the
+  main body outside branch conditions, loop bodies and the functions of
+  procedures, to which the generated gp2_run can jump. A loop in the main body
+  is also passed through its site at the start of each iteration, so a resumed
+  run enters the loop again, which is equivalent to continuing it.
+
+  A checkpoint is requested by SIGUSR1 or by a timer, and written at the next
+  site reached with an empty graph change stack. The file is first written
+  under a temporary name and then renamed, so an earlier checkpoint survives a
+  crash while the next one is written.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_CHECKPOINT_H
+#define INC_CHECKPOINT_H
+
+#include "common.h"
+#include "graph.h"
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CHECKPOINT_MAGIC "GP2CKPT"
+#define CHECKPOINT_VERSION 2
+
+/* The header of a checkpoint file, followed by the graph snapshot. program
+ * identifies the compiled program, so that the checkpoint of another program
+ * is not resumed. */
+typedef struct CheckpointHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t program;
+   uint32_t site;
+   uint32_t reserved;
+} CheckpointHeader;
+
+/* Set when a checkpoint is due. The program code tests it at each site. */
+extern volatile sig_atomic_t checkpoint_requested;
+
+/* Makes SIGUSR1 request a checkpoint to the file, and the timer request one
+ * every interval seconds if interval is positive. */
+void enableCheckpoints(string file_name, int interval);
+
+/* Called at a checkpoint site while a checkpoint is requested. Writes the
+ * checkpoint and clears the request, unless the graph change stack holds
+ * changes, in which case the request is kept for the next site. */
+void writeCheckpoint(Graph *graph, uint32_t program, int site);
+
+/* Builds the graph of the checkpoint file and sets site to its position.
+ * Returns NULL and writes the reason to the log file if the file is not a
+ * checkpoint of the program. */
+Graph *loadCheckpoint(string file_name, uint32_t program, int *site);
+
+#endif /* INC_CHECKPOINT_H */
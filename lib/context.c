@@ -0,0 +1,76 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "context.h"
+#include "graphStacks.h"
+#include "label.h"
+#include "stringTable.h"
+
+/* The number of contexts sharing the tables. */
+static int context_count = 0;
+
+GP2Context *makeContext(void)
+{
+   if(context_count == 0)
+   {
+      initialiseStringTable();
+      initialiseHostListStore();
+   }
+   context_count++;
+   GP2Context *context = mallocSafe(sizeof(GP2Context), "makeContext");
+   context->host = NULL;
+   context->failure = NULL;
+   context->runs = 0;
+   context->resume_site = 0;
+   return context;
+}
+
+void beginRun(GP2Context *context, Graph *graph)
+{
+   #ifndef MINIMAL_GC
+   if(context->host != graph) freeGraph(context->host);
+   #endif
+   context->host = graph;
+   context->failure = NULL;
+   context->runs++;
+   setStackGraph(graph);
+}
+
+void endRun(GP2Context *context, Graph *graph, string failure)
+{
+   /* Changes left on the stack refer to the graph of this run. Later runs
+    * number their restore points from an empty stack. */
+   discardChanges(0);
+   context->host = graph;
+   context->failure = failure;
+}
+
+void freeContext(GP2Context *context)
+{
+   if(context == NULL) return;
+   #ifndef MINIMAL_GC
+   freeGraph(context->host);
+   #endif
+   free(context);
+   context_count--;
+   #ifndef MINIMAL_GC
+   if(context_count == 0)
+   {
+      freeGraphChangeStack();
+      freeHostListStore();
+      freeStringTable();
+   }
+   #endif
+}
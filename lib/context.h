@@ -0,0 +1,72 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ==============
+  Context Module
+  ==============
+
+  The state of runs of a compiled program. A compiled program is the function
+  gp2_run(context, graph) of the generated program.c, which can be called any
+  number of times on one context. The context owns the host graph: the input
+  of a run is freed by the next run or by freeContext, unless the next run is
+  on the same graph.
+
+  The string table, the list store and the graph change stack are shared by
+  all contexts. They are set up by the first context and freed with the last
+  one, so a run starts with tables that are already allocated, and only the
+  changes left by the last run are discarded. The runs of different contexts
+  must not overlap, since the program code works on the global host graph of
+  the active run.
+
+  With minimal garbage collection (MINIMAL_GC), graphs and the shared tables
+  are never freed.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_CONTEXT_H
+#define INC_CONTEXT_H
+
+#include "common.h"
+#include "graph.h"
+
+#include <stdbool.h>
+
+typedef struct GP2Context {
+   /* The graph of the last run: its output if the run succeeded. NULL before
+    * the first run. */
+   Graph *host;
+   /* Why the last run produced no output graph, or NULL. */
+   string failure;
+   /* The number of runs started on the context. */
+   int runs;
+   /* The checkpoint site the next run starts from (see checkpoint.h), or 0
+    * to start it from the beginning of the program. Cleared by the run. */
+   int resume_site;
+} GP2Context;
+
+GP2Context *makeContext(void);
+
+/* Called by gp2_run. beginRun makes the graph the host graph of the context,
+ * freeing the previous one. endRun records the graph at the end of the run,
+ * which may differ from the one passed to beginRun if the program compacts the
+ * host graph, and the failure of the run, if any. */
+void beginRun(GP2Context *context, Graph *graph);
+void endRun(GP2Context *context, Graph *graph, string failure);
+
+void freeContext(GP2Context *context);
+
+#endif /* INC_CONTEXT_H */
@@ -14,37 +14,430 @@
   along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
 
 #include "graph.h"
+#ifdef NODE_FILTER
+#include "nodeFilter.h"
+#endif
+
+#include <stdint.h>
+
+/* Edge lists and their storage are reached through these macros, which hide
+ * where COMPACT_NODES keeps them. */
+#ifdef COMPACT_NODES
+#define nodeEdges(node) ((node)->adjacency->edges)
+#ifndef ARRAY_ADJACENCY
+#define edgeListArray(graph, node) (&((graph)->_edgelistarray))
+#endif
+#ifndef NO_NODE_LIST
+#define nodeListEntry(node) ((node)->adjacency->nodeListAddress)
+#endif
+#define nodeRootEntry(node) ((node)->adjacency->rootListAddress)
+#else
+#define nodeEdges(node) ((node)->edges)
+#ifndef ARRAY_ADJACENCY
+#define edgeListArray(graph, node) (&((node)->_edgelistarray))
+#endif
+#ifndef NO_NODE_LIST
+#define nodeListEntry(node) ((node)->nodeListAddress)
+#endif
+#define nodeRootEntry(node) ((node)->rootListAddress)
+#endif
 
 /* ===============
  * Static Graph Functions
  * =============== */
 
+static void linkRootEntry(Graph *graph, RootNodes *entry, int mark)
+{
+   entry->prev = NULL;
+   entry->next = graph->root_nodes[mark];
+   if(entry->next != NULL) entry->next->prev = entry;
+   graph->root_nodes[mark] = entry;
+}
+
+static void unlinkRootEntry(Graph *graph, RootNodes *entry, int mark)
+{
+   if(entry->prev != NULL) entry->prev->next = entry->next;
+   else graph->root_nodes[mark] = entry->next;
+   if(entry->next != NULL) entry->next->prev = entry->prev;
+}
+
 static void addRootNode(Graph *graph, Node *node)
 {
-   RootNodes *root_node = mallocSafe(sizeof(RootNodes), "addRootNode");
-   root_node->node = node;
-   root_node->next = graph->root_nodes;
-   graph->root_nodes = root_node;
+   RootNodes *entry = graph->free_roots;
+   if(entry != NULL) graph->free_roots = entry->next;
+   else entry = mallocSafe(sizeof(RootNodes), "addRootNode");
+   entry->node = node;
+   nodeRootEntry(node) = entry;
+   linkRootEntry(graph, entry, node->label.mark);
 }
 
+/* The root flag is left to the caller, so that a removed node that is
+ * recovered becomes a root again. */
 static void removeRootNode(Graph *graph, Node *node)
 {
-   RootNodes *current = graph->root_nodes, *previous = NULL;
-   while(current != NULL)
+   RootNodes *entry = nodeRootEntry(node);
+   unlinkRootEntry(graph, entry, node->label.mark);
+   entry->next = graph->free_roots;
+   graph->free_roots = entry;
+}
+
+
+#ifdef ARRAY_ADJACENCY
+/* Adds the edge at the end of the array and stores its position there. */
+static void appendEdge(EdgeArray *array, Edge *edge, long *position)
+{
+   if(array->size == array->capacity)
+   {
+      array->capacity = array->capacity == 0 ? EDGE_ARRAY_INITIAL_SIZE : 2 * array->capacity;
+      array->edges = reallocSafe(array->edges, array->capacity * sizeof(Edge *),
+                                 "appendEdge");
+   }
+   *position = array->size;
+   array->edges[array->size++] = edge;
+}
+
+/* Removes the edge at the passed position by moving the last edge of the array
+ * into it. The orientation of the array says which position of the moved edge
+ * to update. Storage is halved once the array is a quarter full. */
+static void swapRemoveEdge(EdgeArray *array, long position, int orientation)
+{
+   assert(position >= 0 && position < array->size);
+   Edge *last = array->edges[--array->size];
+   if(position != array->size)
+   {
+      array->edges[position] = last;
+      if(orientation == 0) last->source_position = position;
+      else last->target_position = position;
+   }
+   if(array->capacity > EDGE_ARRAY_INITIAL_SIZE && array->size * 4 <= array->capacity)
    {
-      if(current->node == node)
+      array->capacity /= 2;
+      array->edges = reallocSafe(array->edges, array->capacity * sizeof(Edge *),
+                                 "swapRemoveEdge");
+   }
+}
+
+/* Adds the edge to the arrays of its mark at its source and target. */
+static void listEdge(Edge *edge)
+{
+   bool loop = edge->source == edge->target;
+   appendEdge(&(nodeEdges(edge->source)[edge->label.mark][0][loop]), edge,
+              &(edge->source_position));
+   setEdgeInSrcLst(edge);
+   appendEdge(&(nodeEdges(edge->target)[edge->label.mark][1][loop]), edge,
+              &(edge->target_position));
+   setEdgeInTrgLst(edge);
+}
+
+/* Takes the edge out of the arrays of the passed mark at its source and target. */
+static void unlistEdge(Edge *edge, int mark)
+{
+   bool loop = edge->source == edge->target;
+   if(edgeInSrcLst(edge))
+   {
+      swapRemoveEdge(&(nodeEdges(edge->source)[mark][0][loop]), edge->source_position, 0);
+      clearEdgeInSrcLst(edge);
+   }
+   if(edgeInTrgLst(edge))
+   {
+      swapRemoveEdge(&(nodeEdges(edge->target)[mark][1][loop]), edge->target_position, 1);
+      clearEdgeInTrgLst(edge);
+   }
+}
+#endif
+
+#ifdef LABEL_INDEX
+static unsigned labelClassHash(MarkType mark, HostList *list)
+{
+   uintptr_t key = (uintptr_t) list >> 4;
+   return (unsigned) (key ^ (key >> 16)) * 31u + (unsigned) mark;
+}
+
+static LabelClass **labelClassBucket(Graph *graph, MarkType mark, HostList *list)
+{
+   unsigned hash = labelClassHash(mark, list);
+   return &(graph->label_classes[hash & (unsigned) (graph->label_class_buckets - 1)]);
+}
+
+static void growLabelIndex(Graph *graph)
+{
+   LabelClass **old_classes = graph->label_classes;
+   long old_buckets = graph->label_class_buckets;
+   graph->label_class_buckets *= 2;
+   graph->label_classes = callocSafe(graph->label_class_buckets, sizeof(LabelClass *),
+                                     "growLabelIndex");
+   for(long i = 0; i < old_buckets; i++)
+   {
+      LabelClass *class = old_classes[i];
+      while(class != NULL)
       {
-         clearNodeRoot(node);
-         if(previous == NULL) graph->root_nodes = current->next;
-         else previous->next = current->next;
-         free(current);
-         break;
+         LabelClass *next = class->next;
+         LabelClass **bucket = labelClassBucket(graph, class->mark, class->list);
+         class->next = *bucket;
+         *bucket = class;
+         class = next;
       }
-      previous = current;
-      current = current->next;
    }
+   free(old_classes);
 }
 
+static void indexNode(Graph *graph, Node *node)
+{
+   LabelClass **bucket = labelClassBucket(graph, node->label.mark, node->label.list);
+   LabelClass *class = *bucket;
+   while(class != NULL && (class->mark != node->label.mark || class->list != node->label.list))
+      class = class->next;
+   if(class == NULL)
+   {
+      class = mallocSafe(sizeof(LabelClass), "indexNode");
+      class->list = node->label.list;
+      class->mark = node->label.mark;
+      class->first = NULL;
+      class->next = *bucket;
+      *bucket = class;
+      graph->label_class_count++;
+      if(graph->label_class_count > 2 * graph->label_class_buckets) growLabelIndex(graph);
+   }
+   node->label_class = class;
+   node->class_prev = NULL;
+   node->class_next = class->first;
+   if(class->first != NULL) class->first->class_prev = node;
+   class->first = node;
+}
+
+/* Classes are freed when their last node leaves, so that the table does not
+ * accumulate the classes of host lists that no longer exist. */
+static void unindexNode(Graph *graph, Node *node)
+{
+   LabelClass *class = node->label_class;
+   if(node->class_prev != NULL) node->class_prev->class_next = node->class_next;
+   else class->first = node->class_next;
+   if(node->class_next != NULL) node->class_next->class_prev = node->class_prev;
+   node->label_class = NULL;
+   if(class->first != NULL) return;
+
+   LabelClass **bucket = labelClassBucket(graph, class->mark, class->list);
+   while(*bucket != class) bucket = &((*bucket)->next);
+   *bucket = class->next;
+   free(class);
+   graph->label_class_count--;
+}
+
+void reindexNode(Graph *graph, Node *node, HostLabel new_label)
+{
+   if(node->label_class != NULL) unindexNode(graph, node);
+   node->label = new_label;
+   if(!nodeDeleted(node)) indexNode(graph, node);
+}
+
+Node *firstNodeWithLabel(Graph *graph, MarkType mark, HostList *list)
+{
+   LabelClass *class = *labelClassBucket(graph, mark, list);
+   while(class != NULL)
+   {
+      if(class->mark == mark && class->list == list) return class->first;
+      class = class->next;
+   }
+   return NULL;
+}
+#endif
+
+#ifdef DEGREE_INDEX
+#define nodeDegree(node) (nodeOutDegree(node) + nodeInDegree(node))
+
+/* A node is in the degree list of its mark and degree exactly when it is live
+ * and its degree is below DEGREE_INDEX_BUCKETS. The degree changes only while
+ * the node is out of its list, so the mark of the list it leaves is passed. */
+static void unlistNodeDegree(Graph *graph, Node *node, int mark)
+{
+   long degree = nodeDegree(node);
+   if(nodeDeleted(node) || degree >= DEGREE_INDEX_BUCKETS) return;
+   if(node->degree_prev != NULL) node->degree_prev->degree_next = node->degree_next;
+   else graph->degree_nodes[mark][degree] = node->degree_next;
+   if(node->degree_next != NULL) node->degree_next->degree_prev = node->degree_prev;
+}
+
+static void listNodeDegree(Graph *graph, Node *node)
+{
+   long degree = nodeDegree(node);
+   if(nodeDeleted(node) || degree >= DEGREE_INDEX_BUCKETS) return;
+   Node **head = &(graph->degree_nodes[node->label.mark][degree]);
+   node->degree_prev = NULL;
+   node->degree_next = *head;
+   if(*head != NULL) (*head)->degree_prev = node;
+   *head = node;
+}
+
+/* Called before and after the degrees of the endpoints of an edge change. */
+static void unlistEndpointDegrees(Graph *graph, Node *source, Node *target)
+{
+   unlistNodeDegree(graph, source, source->label.mark);
+   if(target != source) unlistNodeDegree(graph, target, target->label.mark);
+}
+
+static void listEndpointDegrees(Graph *graph, Node *source, Node *target)
+{
+   listNodeDegree(graph, source);
+   if(target != source) listNodeDegree(graph, target);
+}
+#endif
+
+#ifdef EDGE_LISTS
+/* An edge is in the list of its mark exactly when it is live. The mark
+ * changes only while the edge is out of its list, so the mark of the list it
+ * leaves is passed. */
+static void unlistMarkEdge(Graph *graph, Edge *edge, int mark)
+{
+   if(edgeDeleted(edge)) return;
+   if(edge->mark_prev != NULL) edge->mark_prev->mark_next = edge->mark_next;
+   else graph->mark_edges[mark] = edge->mark_next;
+   if(edge->mark_next != NULL) edge->mark_next->mark_prev = edge->mark_prev;
+}
+
+static void listMarkEdge(Graph *graph, Edge *edge)
+{
+   if(edgeDeleted(edge)) return;
+   Edge **head = &(graph->mark_edges[edge->label.mark]);
+   edge->mark_prev = NULL;
+   edge->mark_next = *head;
+   if(*head != NULL) (*head)->mark_prev = edge;
+   *head = edge;
+}
+#endif
+
+#ifdef EDGE_INDEX
+static unsigned edgeIndexHash(Node *source, Node *target, int mark)
+{
+   unsigned hash = (unsigned) source->index * 0x9E3779B1u;
+   hash = (hash ^ (unsigned) target->index) * 0x85EBCA6Bu;
+   hash ^= hash >> 13;
+   return (hash ^ (unsigned) mark) * 0xC2B2AE35u;
+}
+
+static Edge **edgeIndexBucket(Graph *graph, Node *source, Node *target, int mark)
+{
+   unsigned hash = edgeIndexHash(source, target, mark);
+   return &(graph->edge_index[(hash >> 8) & (unsigned) (graph->edge_index_buckets - 1)]);
+}
+
+static void linkIndexedEdge(Edge **bucket, Edge *edge)
+{
+   edge->index_next = *bucket;
+   if(*bucket != NULL) (*bucket)->index_pprev = &(edge->index_next);
+   edge->index_pprev = bucket;
+   *bucket = edge;
+}
+
+static void growEdgeIndex(Graph *graph)
+{
+   Edge **old_index = graph->edge_index;
+   long old_buckets = graph->edge_index_buckets;
+   graph->edge_index_buckets *= 2;
+   graph->edge_index = callocSafe(graph->edge_index_buckets, sizeof(Edge *),
+                                  "growEdgeIndex");
+   for(long i = 0; i < old_buckets; i++)
+   {
+      Edge *edge = old_index[i];
+      while(edge != NULL)
+      {
+         Edge *next = edge->index_next;
+         linkIndexedEdge(edgeIndexBucket(graph, edge->source, edge->target,
+                                         edge->label.mark), edge);
+         edge = next;
+      }
+   }
+   free(old_index);
+}
+
+static void indexEdge(Graph *graph, Edge *edge)
+{
+   linkIndexedEdge(edgeIndexBucket(graph, edge->source, edge->target, edge->label.mark),
+                   edge);
+   setEdgeIndexed(edge);
+   graph->edge_index_count++;
+   if(graph->edge_index_count > 2 * graph->edge_index_buckets) growEdgeIndex(graph);
+}
+
+static void unindexEdge(Graph *graph, Edge *edge)
+{
+   *(edge->index_pprev) = edge->index_next;
+   if(edge->index_next != NULL) edge->index_next->index_pprev = edge->index_pprev;
+   clearEdgeIndexed(edge);
+   graph->edge_index_count--;
+}
+
+/* Adds the node to the index with all of its live edges that are not already
+ * there through their other endpoint. */
+static void indexIncidentEdges(Graph *graph, Node *node)
+{
+   node->flags |= NFLAG_EDGEINDEX;
+   for(int i = 0; i < 6; i++){
+      for(int j = 0; j < 2; j++){
+         for(int k = 0; k < 2; k++){
+            #ifdef ARRAY_ADJACENCY
+            EdgeArray *array = &(nodeEdges(node)[i][j][k]);
+            for(long position = 0; position < array->size; position++)
+            {
+               Edge *edge = array->edges[position];
+            #else
+            for(EdgeList *curr = nodeEdges(node)[i][j][k]; curr != NULL; curr = curr->next)
+            {
+               Edge *edge = curr->edge;
+            #endif
+               if(!edgeDeleted(edge) && !edgeIndexed(edge)) indexEdge(graph, edge);
+            }
+         }
+      }
+   }
+}
+
+/* Called once a live edge is in the edge lists of its endpoints and their
+ * degrees count it. */
+static void updateEdgeIndex(Graph *graph, Edge *edge)
+{
+   if(edgesIndexed(edge->source, edge->target)) indexEdge(graph, edge);
+   Node *ends[2] = {edge->source, edge->target};
+   for(int i = 0; i < 2; i++)
+   {
+      if(nodeEdgeIndexed(ends[i])) continue;
+      if(ends[i]->outdegree + ends[i]->indegree >= EDGE_INDEX_THRESHOLD)
+         indexIncidentEdges(graph, ends[i]);
+   }
+}
+
+Edge *firstEdgeBetween(Graph *graph, Node *source, Node *target, int mark)
+{
+   Edge *edge = *edgeIndexBucket(graph, source, target, mark);
+   while(edge != NULL && (edge->source != source || edge->target != target ||
+                          edge->label.mark != mark))
+      edge = edge->index_next;
+   return edge;
+}
+
+Edge *nextEdgeBetween(Edge *edge)
+{
+   Node *source = edge->source, *target = edge->target;
+   int mark = edge->label.mark;
+   edge = edge->index_next;
+   while(edge != NULL && (edge->source != source || edge->target != target ||
+                          edge->label.mark != mark))
+      edge = edge->index_next;
+   return edge;
+}
+#endif
+
+#ifdef CHANGE_STAMPS
+long change_clock = 0;
+long change_stamps[CHANGE_KINDS];
+
+bool changedSince(long time, unsigned kinds)
+{
+   for(int kind = 0; kind < CHANGE_KINDS; kind++)
+      if((kinds & (1u << kind)) && change_stamps[kind] > time) return true;
+   return false;
+}
+#endif
+
 /* ===============
  * Graph Functions
  * =============== */
@@ -54,6 +447,7 @@ Graph *newGraph()
    Graph *graph = mallocSafe(sizeof(Graph), "newGraph");
    graph->number_of_nodes = 0;
    graph->number_of_edges = 0;
+   for(int i = 0; i < 6; i++) graph->nodes_by_mark[i] = 0;
    #ifndef NO_NODE_LIST
    for(int i = 0; i < 5; i++) graph->nodes[i] = NULL;
    #endif
@@ -62,35 +456,89 @@ Graph *newGraph()
    #ifndef NO_NODE_LIST
    graph->_nodelistarray = makeBigArray(sizeof(NodeList));
    #endif
-   graph->root_nodes = NULL;
+   #ifdef COMPACT_NODES
+   graph->_adjacencyarray = makeBigArray(sizeof(NodeAdjacency));
+   #ifndef ARRAY_ADJACENCY
+   graph->_edgelistarray = makeBigArray(sizeof(EdgeList));
+   #endif
+   #endif
+   for(int i = 0; i < 6; i++) graph->root_nodes[i] = NULL;
+   graph->free_roots = NULL;
+   #ifdef LABEL_INDEX
+   graph->label_class_buckets = LABEL_INDEX_INITIAL_SIZE;
+   graph->label_class_count = 0;
+   graph->label_classes = callocSafe(LABEL_INDEX_INITIAL_SIZE, sizeof(LabelClass *),
+                                     "newGraph");
+   #endif
+   #ifdef DEGREE_INDEX
+   for(int mark = 0; mark < 6; mark++)
+      for(int degree = 0; degree < DEGREE_INDEX_BUCKETS; degree++)
+         graph->degree_nodes[mark][degree] = NULL;
+   #endif
+   #ifdef EDGE_LISTS
+   for(int mark = 0; mark < 6; mark++) graph->mark_edges[mark] = NULL;
+   #endif
+   #ifdef EDGE_INDEX
+   graph->edge_index_buckets = EDGE_INDEX_INITIAL_SIZE;
+   graph->edge_index_count = 0;
+   graph->edge_index = callocSafe(EDGE_INDEX_INITIAL_SIZE, sizeof(Edge *), "newGraph");
+   #endif
+   #ifdef NODE_FILTER
+   graph->filter_marks = NULL;
+   graph->filter_indegrees = NULL;
+   graph->filter_outdegrees = NULL;
+   graph->filter_size = 0;
+   #endif
+   #ifdef CHANGE_STAMPS
+   change_clock++;
+   for(int kind = 0; kind < CHANGE_KINDS; kind++) change_stamps[kind] = change_clock;
+   #endif
    return graph;
 }
 
 Node *addNode(Graph *graph, bool root, HostLabel label)
 {
    #ifndef NO_NODE_LIST
-   int nlistind = genFreeBigArrayPos(&(graph->_nodelistarray));
+   long nlistind = genFreeBigArrayPos(&(graph->_nodelistarray));
    NodeList *nlist = (NodeList *) getBigArrayValue(
        &(graph->_nodelistarray), nlistind);
    nlist->index = nlistind;
    #endif
 
-   int nodeind = genFreeBigArrayPos(&(graph->_nodearray));
+   long nodeind = genFreeBigArrayPos(&(graph->_nodearray));
    Node *node = (Node *) getBigArrayValue(&(graph->_nodearray), nodeind);
    node->index = nodeind;
    if(root) initializeRootNodeInGraph(node);
    else initializeNodeInGraph(node);
 
    node->label = label;
+   #ifdef COMPACT_NODES
+   // Adjacency records are allocated and freed together with their nodes, so
+   // both arrays hand out the same positions.
+   long adjacencyind = genFreeBigArrayPos(&(graph->_adjacencyarray));
+   assert(adjacencyind == nodeind);
+   node->adjacency = (NodeAdjacency *) getBigArrayValue(&(graph->_adjacencyarray),
+                                                        adjacencyind);
+   #endif
    for(int marks = 0; marks < 6; marks++){
       for(int orientations = 0; orientations < 2; orientations++){
-         node->edges[marks][orientations][0] = NULL;
-         node->edges[marks][orientations][1] = NULL;
+         for(int loops = 0; loops < 2; loops++){
+            #ifdef ARRAY_ADJACENCY
+            EdgeArray *array = &(nodeEdges(node)[marks][orientations][loops]);
+            array->edges = NULL;
+            array->size = 0;
+            array->capacity = 0;
+            #else
+            nodeEdges(node)[marks][orientations][loops] = NULL;
+            #endif
+         }
       }
    }
    node->outdegree = 0;
    node->indegree = 0;
+   #if !defined(COMPACT_NODES) && !defined(ARRAY_ADJACENCY)
    node->_edgelistarray = makeBigArray(sizeof(EdgeList));
+   #endif
 
    #ifndef NO_NODE_LIST
    nlist->node = node;
@@ -98,59 +546,95 @@ Node *addNode(Graph *graph, bool root, HostLabel label)
    nlist->prev = NULL;
    if(graph->nodes[label.mark] != NULL) graph->nodes[label.mark]->prev = nlist;
    graph->nodes[label.mark] = nlist;
-   node->nodeListAddress = nlist;
+   nodeListEntry(node) = nlist;
+   #endif
+
+   #ifdef LABEL_INDEX
+   indexNode(graph, node);
+   #endif
+   #ifdef DEGREE_INDEX
+   listNodeDegree(graph, node);
+   #endif
+   #ifdef NODE_FILTER
+   updateNodeFilter(graph, node);
    #endif
 
    if(root) addRootNode(graph, node);
    graph->number_of_nodes++;
+   graph->nodes_by_mark[label.mark]++;
+   noteNodeChange(node);
    return node;
 }
 
 Edge *addEdge(Graph *graph, HostLabel label, Node *source, Node *target)
 {
-   int edgeind = genFreeBigArrayPos(&(graph->_edgearray));
+   long edgeind = genFreeBigArrayPos(&(graph->_edgearray));
    Edge *edge = (Edge *) getBigArrayValue(&(graph->_edgearray), edgeind);
    edge->index = edgeind;
    edge->label = label;
    edge->source = source;
    edge->target = target;
    edge->flags = (char) 0;
+   #ifdef DEGREE_INDEX
+   unlistEndpointDegrees(graph, source, target);
+   #endif
 
-   int srclstind = genFreeBigArrayPos(&(source->_edgelistarray));
+   #ifdef ARRAY_ADJACENCY
+   listEdge(edge);
+   incrementOutDegree(source);
+   incrementInDegree(target);
+   #else
+   long srclstind = genFreeBigArrayPos(edgeListArray(graph, source));
    EdgeList *srclist = (EdgeList *) getBigArrayValue(
-       &(source->_edgelistarray), srclstind);
+       edgeListArray(graph, source), srclstind);
    srclist->index = srclstind;
    srclist->edge = edge;
 
-   srclist->next = source->edges[label.mark][0][edge->source == edge->target];
+   srclist->next = nodeEdges(source)[label.mark][0][edge->source == edge->target];
    srclist->prev = NULL;
-   if(source->edges[label.mark][0][edge->source == edge->target] != NULL){
-      source->edges[label.mark][0][edge->source == edge->target]->prev = srclist;
+   if(nodeEdges(source)[label.mark][0][edge->source == edge->target] != NULL){
+      nodeEdges(source)[label.mark][0][edge->source == edge->target]->prev = srclist;
    }
-   source->edges[label.mark][0][edge->source == edge->target] = srclist;
+   nodeEdges(source)[label.mark][0][edge->source == edge->target] = srclist;
    edge->edgeSrcListAddress = srclist;
 
    setEdgeInSrcLst(edge);
    incrementOutDegree(source);
 
-   int trglstind = genFreeBigArrayPos(&(target->_edgelistarray));
+   long trglstind = genFreeBigArrayPos(edgeListArray(graph, target));
    EdgeList *trglist = (EdgeList *) getBigArrayValue(
-       &(target->_edgelistarray), trglstind);
+       edgeListArray(graph, target), trglstind);
    trglist->index = trglstind;
    trglist->edge = edge;
 
-   trglist->next = target->edges[label.mark][1][edge->source == edge->target];
+   trglist->next = nodeEdges(target)[label.mark][1][edge->source == edge->target];
    trglist->prev = NULL;
-   if(target->edges[label.mark][1][edge->source == edge->target] != NULL){
-      target->edges[label.mark][1][edge->source == edge->target]->prev = trglist;
+   if(nodeEdges(target)[label.mark][1][edge->source == edge->target] != NULL){
+      nodeEdges(target)[label.mark][1][edge->source == edge->target]->prev = trglist;
    }
-   target->edges[label.mark][1][edge->source == edge->target] = trglist;
+   nodeEdges(target)[label.mark][1][edge->source == edge->target] = trglist;
    edge->edgeTrgListAddress = trglist;
 
    setEdgeInTrgLst(edge);
    incrementInDegree(target);
+   #endif
 
+   #ifdef DEGREE_INDEX
+   listEndpointDegrees(graph, source, target);
+   #endif
+   #ifdef NODE_FILTER
+   updateNodeFilter(graph, source);
+   updateNodeFilter(graph, target);
+   #endif
+   #ifdef EDGE_INDEX
+   updateEdgeIndex(graph, edge);
+   #endif
+   #ifdef EDGE_LISTS
+   listMarkEdge(graph, edge);
+   #endif
    graph->number_of_edges++;
+   noteEdgeChange(edge);
+   noteChange(DEGREE_CHANGE);
    return edge;
 }
 
@@ -158,74 +642,144 @@ Edge *addEdge(Graph *graph, HostLabel label, Node *source, Node *target)
 void recoverNode(Graph *graph, Node *node)
 {
    #ifndef NO_NODE_LIST
-   int nlistind = genFreeBigArrayPos(&(graph->_nodelistarray));
-   NodeList *nlist = (NodeList *) getBigArrayValue(
-       &(graph->_nodelistarray), nlistind);
-   nlist->index = nlistind;
-   nlist->node = node;
-   nlist->next = graph->nodes[node->label.mark];
-   graph->nodes[node->label.mark] = nlist;
+   /* A node that has not been passed by a scan since its removal is still in
+    * the list of its mark. */
+   if(!nodeInGraph(node))
+   {
+      long nlistind = genFreeBigArrayPos(&(graph->_nodelistarray));
+      NodeList *nlist = (NodeList *) getBigArrayValue(
+          &(graph->_nodelistarray), nlistind);
+      nlist->index = nlistind;
+      nlist->node = node;
+      nlist->next = graph->nodes[node->label.mark];
+      nlist->prev = NULL;
+      if(graph->nodes[node->label.mark] != NULL) graph->nodes[node->label.mark]->prev = nlist;
+      graph->nodes[node->label.mark] = nlist;
+      nodeListEntry(node) = nlist;
+   }
    #endif
 
    setNodeInGraph(node);
+   #ifdef LABEL_INDEX
+   indexNode(graph, node);
+   #endif
+   #ifdef DEGREE_INDEX
+   listNodeDegree(graph, node);
+   #endif
+   #ifdef NODE_FILTER
+   updateNodeFilter(graph, node);
+   #endif
    if(nodeRoot(node)) addRootNode(graph, node);
    graph->number_of_nodes++;
+   graph->nodes_by_mark[node->label.mark]++;
+   noteNodeChange(node);
 }
 
 void recoverEdge(Graph *graph, Edge *edge)
 {
+   #ifdef DEGREE_INDEX
+   unlistEndpointDegrees(graph, edge->source, edge->target);
+   #endif
+   #ifdef ARRAY_ADJACENCY
+   // Removed edges are always out of both arrays.
+   assert(!edgeInSrcLst(edge) && !edgeInTrgLst(edge));
+   listEdge(edge);
+   incrementOutDegree(edge->source);
+   incrementInDegree(edge->target);
+   #else
    if(!edgeInSrcLst(edge)){
       Node *source = edge->source;
-      int srclstind = genFreeBigArrayPos(&(source->_edgelistarray));
+      long srclstind = genFreeBigArrayPos(edgeListArray(graph, source));
       EdgeList *srclist = (EdgeList *) getBigArrayValue(
-         &(source->_edgelistarray), srclstind);
+         edgeListArray(graph, source), srclstind);
       srclist->index = srclstind;
       srclist->edge = edge;
 
-      srclist->next = source->edges[edge->label.mark][0][edge->source == edge->target];
+      srclist->next = nodeEdges(source)[edge->label.mark][0][edge->source == edge->target];
       srclist->prev = NULL;
-      if(source->edges[edge->label.mark][0][edge->source == edge->target] != NULL){
-         source->edges[edge->label.mark][0][edge->source == edge->target]->prev = srclist;
+      if(nodeEdges(source)[edge->label.mark][0][edge->source == edge->target] != NULL){
+         nodeEdges(source)[edge->label.mark][0][edge->source == edge->target]->prev = srclist;
       }
-      source->edges[edge->label.mark][0][edge->source == edge->target] = srclist;
+      nodeEdges(source)[edge->label.mark][0][edge->source == edge->target] = srclist;
       edge->edgeSrcListAddress = srclist;
-      incrementOutDegree(source);
       setEdgeInSrcLst(edge);
    }
    if(!edgeInTrgLst(edge)){
       Node *target = edge->target;
-      int trglstind = genFreeBigArrayPos(&(target->_edgelistarray));
+      long trglstind = genFreeBigArrayPos(edgeListArray(graph, target));
       EdgeList *trglist = (EdgeList *) getBigArrayValue(
-         &(target->_edgelistarray), trglstind);
+         edgeListArray(graph, target), trglstind);
       trglist->index = trglstind;
       trglist->edge = edge;
 
-      trglist->next = target->edges[edge->label.mark][1][edge->source == edge->target];
+      trglist->next = nodeEdges(target)[edge->label.mark][1][edge->source == edge->target];
       trglist->prev = NULL;
-      if(target->edges[edge->label.mark][1][edge->source == edge->target] != NULL){
-         target->edges[edge->label.mark][1][edge->source == edge->target]->prev = trglist;
+      if(nodeEdges(target)[edge->label.mark][1][edge->source == edge->target] != NULL){
+         nodeEdges(target)[edge->label.mark][1][edge->source == edge->target]->prev = trglist;
       }
-      target->edges[edge->label.mark][1][edge->source == edge->target] = trglist;
+      nodeEdges(target)[edge->label.mark][1][edge->source == edge->target] = trglist;
       edge->edgeTrgListAddress = trglist;
       setEdgeInTrgLst(edge);
-      incrementInDegree(target);
    }
+   // removeEdge decremented the degrees even if the edge is still listed.
+   incrementOutDegree(edge->source);
+   incrementInDegree(edge->target);
+   #endif
+   #ifdef DEGREE_INDEX
+   listEndpointDegrees(graph, edge->source, edge->target);
+   #endif
+   #ifdef NODE_FILTER
+   updateNodeFilter(graph, edge->source);
+   updateNodeFilter(graph, edge->target);
+   #endif
+   #ifdef EDGE_INDEX
+   updateEdgeIndex(graph, edge);
+   #endif
+   #ifdef EDGE_LISTS
+   listMarkEdge(graph, edge);
+   #endif
    graph->number_of_edges++;
+   noteEdgeChange(edge);
+   noteChange(DEGREE_CHANGE);
 }
 
 void removeNode(Graph *graph, Node *node)
 {
+   #ifdef DEGREE_INDEX
+   unlistNodeDegree(graph, node, node->label.mark);
+   #endif
    setNodeDeleted(node);
+   #ifdef NODE_FILTER
+   updateNodeFilter(graph, node);
+   #endif
+   #ifdef LABEL_INDEX
+   unindexNode(graph, node);
+   #endif
    if(nodeRoot(node)) removeRootNode(graph, node);
    graph->number_of_nodes--;
+   graph->nodes_by_mark[node->label.mark]--;
 }
 
 void relistNode(Graph *graph, Node *node, int old_mark)
 {
    //setNodeRemarked(node);
+   graph->nodes_by_mark[old_mark]--;
+   graph->nodes_by_mark[node->label.mark]++;
+   if(nodeRoot(node) && !nodeDeleted(node))
+   {
+      unlinkRootEntry(graph, nodeRootEntry(node), old_mark);
+      linkRootEntry(graph, nodeRootEntry(node), node->label.mark);
+   }
+   #ifdef DEGREE_INDEX
+   unlistNodeDegree(graph, node, old_mark);
+   listNodeDegree(graph, node);
+   #endif
+   #ifdef NODE_FILTER
+   updateNodeFilter(graph, node);
+   #endif
    #ifndef NO_NODE_LIST
    int mark = node->label.mark;
-   NodeList *nlist = node->nodeListAddress;
+   NodeList *nlist = nodeListEntry(node);
    if(nlist->prev != NULL) nlist->prev->next = nlist->next;
    if(nlist->next != NULL) nlist->next->prev = nlist->prev;
    if(nlist->prev == NULL) graph->nodes[old_mark] = nlist->next;
@@ -237,6 +791,21 @@ void relistNode(Graph *graph, Node *node, int old_mark)
 }
 
 void relistEdge(Graph *graph, Edge *edge, int old_mark){
+   #ifdef EDGE_INDEX
+   if(edgeIndexed(edge))
+   {
+      unindexEdge(graph, edge);
+      indexEdge(graph, edge);
+   }
+   #endif
+   #ifdef EDGE_LISTS
+   unlistMarkEdge(graph, edge, old_mark);
+   listMarkEdge(graph, edge);
+   #endif
+   #ifdef ARRAY_ADJACENCY
+   unlistEdge(edge, old_mark);
+   listEdge(edge);
+   #else
    int mark = edge->label.mark;
    EdgeList *eTrgList = edge->edgeTrgListAddress;
    EdgeList *eSrcList = edge->edgeSrcListAddress;
@@ -245,27 +814,58 @@ void relistEdge(Graph *graph, Edge *edge, int old_mark){
    // Source node:
    if(eSrcList->prev != NULL) eSrcList->prev->next = eSrcList->next;
    if(eSrcList->next != NULL) eSrcList->next->prev = eSrcList->prev;
-   if(eSrcList->prev == NULL) src->edges[old_mark][0][trg == src] = eSrcList->next;
+   if(eSrcList->prev == NULL) nodeEdges(src)[old_mark][0][trg == src] = eSrcList->next;
    eSrcList->prev = NULL;
-   eSrcList->next = src->edges[mark][0][trg == src];
-   if(src->edges[mark][0][trg == src] != NULL) src->edges[mark][0][trg == src]->prev = eSrcList;
-   src->edges[mark][0][trg == src] = eSrcList;
+   eSrcList->next = nodeEdges(src)[mark][0][trg == src];
+   if(nodeEdges(src)[mark][0][trg == src] != NULL) nodeEdges(src)[mark][0][trg == src]->prev = eSrcList;
+   nodeEdges(src)[mark][0][trg == src] = eSrcList;
    // Target node:
    if(eTrgList->prev != NULL) eTrgList->prev->next = eTrgList->next;
    if(eTrgList->next != NULL) eTrgList->next->prev = eTrgList->prev;
-   if(eTrgList->prev == NULL) trg->edges[old_mark][1][trg == src] = eTrgList->next;
+   if(eTrgList->prev == NULL) nodeEdges(trg)[old_mark][1][trg == src] = eTrgList->next;
    eTrgList->prev = NULL;
-   eTrgList->next = trg->edges[mark][1][trg == src];
-   if(trg->edges[mark][1][trg == src] != NULL) trg->edges[mark][1][trg == src]->prev = eTrgList;
-   trg->edges[mark][1][trg == src] = eTrgList;
+   eTrgList->next = nodeEdges(trg)[mark][1][trg == src];
+   if(nodeEdges(trg)[mark][1][trg == src] != NULL) nodeEdges(trg)[mark][1][trg == src]->prev = eTrgList;
+   nodeEdges(trg)[mark][1][trg == src] = eTrgList;
+   #endif
 }
 
 void removeEdge(Graph *graph, Edge *edge)
 {
+   #ifdef EDGE_LISTS
+   unlistMarkEdge(graph, edge, edge->label.mark);
+   #endif
    setEdgeDeleted(edge);
+   #ifdef DEGREE_INDEX
+   unlistEndpointDegrees(graph, edgeSource(edge), edgeTarget(edge));
+   #endif
    decrementOutDegree(edgeSource(edge));
    decrementInDegree(edgeTarget(edge));
+   #ifdef DEGREE_INDEX
+   listEndpointDegrees(graph, edgeSource(edge), edgeTarget(edge));
+   #endif
+   #ifdef NODE_FILTER
+   updateNodeFilter(graph, edgeSource(edge));
+   updateNodeFilter(graph, edgeTarget(edge));
+   #endif
    graph->number_of_edges--;
+   noteChange(DEGREE_CHANGE);
+   #ifdef EDGE_INDEX
+   if(edgeIndexed(edge)) unindexEdge(graph, edge);
+   #endif
+   #ifdef ARRAY_ADJACENCY
+   /* Nothing else holds the edge once it is out of the arrays, unless it is
+    * on the graph change stack. Generated code clears the matched flags of a
+    * rule's match before applying it, so the edge is not touched again. */
+   unlistEdge(edge, edge->label.mark);
+   #ifndef MINIMAL_GC
+   if(edgeFree(edge))
+   {
+      removeHostList(edge->label.list);
+      removeFromBigArray(&(graph->_edgearray), edge->index);
+   }
+   #endif
+   #endif
 }
 
 void changeRoot(Graph *graph, Node *node)
@@ -280,6 +880,7 @@ void changeRoot(Graph *graph, Node *node)
      addRootNode(graph, node);
      setNodeRoot(node);
    }
+   noteNodeChange(node);
 }
 
 #ifndef MINIMAL_GC
@@ -292,19 +893,45 @@ void tryGarbageCollectNode(Graph *graph, Node *node)
       for(int i = 0; i < 6; i++){
          for(int j = 0; j < 2; j++){
             for(int k = 0; k < 2; k++){
-               for(EdgeList *curr = node->edges[i][j][k]; curr != NULL; curr = curr->next)
+               #ifdef ARRAY_ADJACENCY
+               EdgeArray *array = &(nodeEdges(node)[i][j][k]);
+               for(long position = 0; position < array->size; position++)
+               {
+                  Edge *edge = array->edges[position];
+                  if(j == 0) clearEdgeInSrcLst(edge);
+                  else clearEdgeInTrgLst(edge);
+                  if(edgeFree(edge))
+                  {
+                     removeHostList(edge->label.list);
+                     removeFromBigArray(&(graph->_edgearray), edge->index);
+                  }
+               }
+               if(array->edges != NULL) free(array->edges);
+               #else
+               EdgeList *next;
+               for(EdgeList *curr = nodeEdges(node)[i][j][k]; curr != NULL; curr = next)
                {
-                  clearEdgeInSrcLst(curr->edge);
+                  next = curr->next;
+                  if(j == 0) clearEdgeInSrcLst(curr->edge);
+                  else clearEdgeInTrgLst(curr->edge);
                   if(edgeFree(curr->edge))
                   {
                      removeHostList(curr->edge->label.list);
                      removeFromBigArray(&(graph->_edgearray), curr->edge->index);
                   }
+                  #ifdef COMPACT_NODES
+                  removeFromBigArray(&(graph->_edgelistarray), curr->index);
+                  #endif
                }
+               #endif
             }
          }
       }
+      #ifdef COMPACT_NODES
+      removeFromBigArray(&(graph->_adjacencyarray), node->index);
+      #elif !defined(ARRAY_ADJACENCY)
       emptyBigArray(&(node->_edgelistarray));
+      #endif
       removeFromBigArray(&(graph->_nodearray), node->index);
    }
 }
@@ -314,6 +941,23 @@ void tryGarbageCollectNode(Graph *graph, Node *node)
  * Graph Querying Functions 
  * ======================== */
 
+#if defined(COMPACT_NODES) && !defined(ARRAY_ADJACENCY)
+/* Returns an entry that has just been unlinked from an edge list to the pool.
+ * The hole written into the entry overwrites its links, so the caller passes
+ * the entry that followed it, and a position still referring to the entry is
+ * moved on to that one. */
+static void releaseEdgeListEntry(Graph *graph, EdgeList **current_prev, EdgeList *entry,
+                                 EdgeList *next)
+{
+   if(*current_prev == entry) *current_prev = next;
+   #ifndef MINIMAL_GC
+   removeFromBigArray(&(graph->_edgelistarray), entry->index);
+   #else
+   UNUSED(graph);
+   #endif
+}
+#endif
+
 #ifndef NO_NODE_LIST
 Node *yieldNextNode(Graph *graph, NodeList **current_prev, int mark)
 {
@@ -333,13 +977,13 @@ Node *yieldNextNode(Graph *graph, NodeList **current_prev, int mark)
      if(deleted_node)
      {
        #ifndef MINIMAL_GC
-       int index = current->index;
+       long index = current->index;
        #endif
-       if((*current_prev) != current)
-         (*current_prev)->next = current->next;
-       if (initial){
-         graph->nodes[mark] = current->next;
-       }
+       /* The entries before current have all been unlinked in the initial
+        * case, so the next entry becomes the head of the list. */
+       if(initial) graph->nodes[mark] = current->next;
+       else (*current_prev)->next = current->next;
+       if(current->next != NULL) current->next->prev = initial ? NULL : *current_prev;
        current = current->next;
        clearNodeInGraph(node);
        #ifndef MINIMAL_GC
@@ -369,13 +1013,20 @@ Node *yieldNextNodeFast(Graph *graph, NodeList **current_prev, int mark)
    *current_prev = current;
    return current->node;
 }
+
+NodeList *nodeListPosition(Node *node)
+{
+   assert(!nodeDeleted(node));
+   return nodeListEntry(node);
+}
 #endif
 
+#ifndef ARRAY_ADJACENCY
 Edge *yieldNextOutEdge(Graph *graph, Node *node, EdgeList **current_prev, int mark, bool loop)
 {
    EdgeList *current;
    bool initial = *current_prev == NULL;
-   if(initial) *current_prev = current = node->edges[mark][0][loop];
+   if(initial) *current_prev = current = nodeEdges(node)[mark][0][loop];
    else current = (*current_prev)->next;
 
    bool deleted_edge = true;
@@ -388,13 +1039,17 @@ Edge *yieldNextOutEdge(Graph *graph, Node *node, EdgeList **current_prev, int ma
      deleted_edge = edgeDeleted(edge);
      if(deleted_edge)
      {
-       if((*current_prev) != current)
-         (*current_prev)->next = current->next;
-       if(initial){
-         node->edges[mark][0][loop] = current->next;
-       }
+       if(initial) nodeEdges(node)[mark][0][loop] = current->next;
+       else (*current_prev)->next = current->next;
+       if(current->next != NULL) current->next->prev = initial ? NULL : *current_prev;
+       #ifdef COMPACT_NODES
+       EdgeList *unlinked = current;
+       #endif
        current = current->next;
        clearEdgeInSrcLst(edge);
+       #ifdef COMPACT_NODES
+       releaseEdgeListEntry(graph, current_prev, unlinked, current);
+       #endif
        #ifndef MINIMAL_GC
        if(edgeFree(edge))
        {
@@ -412,7 +1067,24 @@ Edge *yieldNextOutEdge(Graph *graph, Node *node, EdgeList **current_prev, int ma
 Edge *yieldNextOutEdgeFast(Graph *graph, Node *node, EdgeList **current_prev, int mark, bool loop)
 {
    EdgeList *current;
-   if(*current_prev == NULL) *current_prev = current = node->edges[mark][0][loop];
+   if(*current_prev == NULL) *current_prev = current = nodeEdges(node)[mark][0][loop];
+   else current = (*current_prev)->next;
+
+   bool deleted_edge = true;
+   while(deleted_edge) {
+     if(current == NULL) return NULL;
+     deleted_edge = edgeDeleted(current->edge);
+     if(deleted_edge) current = current->next;
+   }
+
+   *current_prev = current;
+   return current->edge;
+}
+
+Edge *yieldNextInEdgeFast(Graph *graph, Node *node, EdgeList **current_prev, int mark, bool loop)
+{
+   EdgeList *current;
+   if(*current_prev == NULL) *current_prev = current = nodeEdges(node)[mark][1][loop];
    else current = (*current_prev)->next;
 
    bool deleted_edge = true;
@@ -430,7 +1102,7 @@ Edge *yieldNextInEdge(Graph *graph, Node *node, EdgeList **current_prev, int mar
 {
    EdgeList *current;
    bool initial = *current_prev == NULL;
-   if(initial) *current_prev = current = node->edges[mark][1][loop];
+   if(initial) *current_prev = current = nodeEdges(node)[mark][1][loop];
    else current = (*current_prev)->next;
 
    bool deleted_edge = true;
@@ -442,13 +1114,17 @@ Edge *yieldNextInEdge(Graph *graph, Node *node, EdgeList **current_prev, int mar
      deleted_edge = edgeDeleted(edge);
      if(deleted_edge)
      {
-       if((*current_prev) != current)
-         (*current_prev)->next = current->next;
-       if(initial){
-         node->edges[mark][1][loop] = current->next;
-       }
+       if(initial) nodeEdges(node)[mark][1][loop] = current->next;
+       else (*current_prev)->next = current->next;
+       if(current->next != NULL) current->next->prev = initial ? NULL : *current_prev;
+       #ifdef COMPACT_NODES
+       EdgeList *unlinked = current;
+       #endif
        current = current->next;
-       clearEdgeInSrcLst(edge);
+       clearEdgeInTrgLst(edge);
+       #ifdef COMPACT_NODES
+       releaseEdgeListEntry(graph, current_prev, unlinked, current);
+       #endif
        #ifndef MINIMAL_GC
        if(edgeFree(edge))
        {
@@ -462,10 +1138,11 @@ Edge *yieldNextInEdge(Graph *graph, Node *node, EdgeList **current_prev, int mar
    *current_prev = current;
    return current->edge;
 }
+#endif
 
-RootNodes *getRootNodeList(Graph *graph)
+RootNodes *getRootNodeList(Graph *graph, int mark)
 {
-   return graph->root_nodes;
+   return graph->root_nodes[mark];
 }
 
 void printGraph(Graph *graph, FILE *file) 
@@ -474,7 +1151,7 @@ void printGraph(Graph *graph, FILE *file)
     * index in the graph is not suitable for this purpose because there may be holes
     * in the graph's node array. The counts are also used to control the number of
     * nodes and edges printed per line. */
-   int node_count = 0, edge_count = 0;
+   long node_count = 0, edge_count = 0;
    if(graph == NULL || graph->number_of_nodes == 0) 
    {
       PTF("[ | ]\n\n");
@@ -489,7 +1166,7 @@ void printGraph(Graph *graph, FILE *file)
       for(Node *node; (node = yieldNextNode(graph, &nlistpos, i)) != NULL;){
       #else
       Node *node;
-      for (int i = 0; i < graph->_nodearray.size; i++)
+      for (long i = 0; i < graph->_nodearray.size; i++)
       {
          node = (Node *) getBigArrayValue(&(graph->_nodearray), i);
          if(nodeDeleted(node))
@@ -501,8 +1178,8 @@ void printGraph(Graph *graph, FILE *file)
          /* Five nodes per line */
          if(node_count != 0 && node_count % 5 == 0) PTF("\n  ");
          node_count++;
-         if(nodeRoot(node)) PTF("(%d(R), ", node->index);
-         else PTF("(%d, ", node->index);
+         if(nodeRoot(node)) PTF("(%ld(R), ", node->index);
+         else PTF("(%ld, ", node->index);
          printHostLabel(node->label, file);
          PTF(") ");
       #ifndef NO_NODE_LIST
@@ -515,7 +1192,9 @@ void printGraph(Graph *graph, FILE *file)
       return;
    }
    PTF("|\n  ");
+   #ifndef ARRAY_ADJACENCY
    EdgeList *elistpos = NULL;
+   #endif
    #ifndef NO_NODE_LIST
    for(int n = 0; n < 6; n++){
       if(n == DASHED) continue;
@@ -523,20 +1202,27 @@ void printGraph(Graph *graph, FILE *file)
       for(Node *node; (node = yieldNextNode(graph, &nlistpos, n)) != NULL;)
       {
       #else
-      for (int i = 0; i < graph->_nodearray.size; i++)
+      for (long i = 0; i < graph->_nodearray.size; i++)
       {
          node = (Node *) getBigArrayValue(&(graph->_nodearray), i);
          if(nodeDeleted(node)) continue;
       #endif
          for(int k = 0; k < 6; k++){
             for(int j = 0; j < 2; j++){
+               #ifdef ARRAY_ADJACENCY
+               EdgeArray *array = outEdgeArray(node, k, j);
+               for(long position = array->size - 1; position >= 0; position--)
+               {
+                  Edge *edge = array->edges[position];
+               #else
                elistpos = NULL;
                for(Edge *edge; (edge = yieldNextOutEdge(graph, node, &elistpos, k, j)) != NULL;)
                {
+               #endif
                   /* Three edges per line */
                   if(edge_count != 0 && edge_count % 3 == 0) PTF("\n  ");
                   edge_count++;
-                  PTF("(%d, %d, %d, ", edge->index, edgeSource(edge)->index, edgeTarget(edge)->index);
+                  PTF("(%ld, %ld, %ld, ", edge->index, edgeSource(edge)->index, edgeTarget(edge)->index);
                   printHostLabel(edge->label, file);
                   PTF(") ");
                }
@@ -564,20 +1250,20 @@ void printGraphFast(Graph *graph, FILE *file)
       nlistpos = NULL;
       for(Node *node; (node = yieldNextNodeFast(graph, &nlistpos, n)) != NULL;)
       {
-         if(nodeRoot(node)) PTF("(%d(R), ", node->index);
-         else PTF("(%d, ", node->index);
+         if(nodeRoot(node)) PTF("(%ld(R), ", node->index);
+         else PTF("(%ld, ", node->index);
          printHostLabel(node->label, file);
          PTF(") ");
       }
    }
    #else
    Node *node;
-   for (int i = 0; i < graph->_nodearray.size; i++)
+   for (long i = 0; i < graph->_nodearray.size; i++)
    {
       node = (Node *) getBigArrayValue(&(graph->_nodearray), i);
       if(nodeDeleted(node)) continue;
-      if(nodeRoot(node)) PTF("(%d(R), ", node->index);
-      else PTF("(%d, ", node->index);
+      if(nodeRoot(node)) PTF("(%ld(R), ", node->index);
+      else PTF("(%ld, ", node->index);
       printHostLabel(node->label, file);
       PTF(") ");
    }
@@ -588,24 +1274,33 @@ void printGraphFast(Graph *graph, FILE *file)
       return;
    }
    PTF("|\n  ");
+   #ifndef ARRAY_ADJACENCY
    EdgeList *elistpos = NULL;
+   #endif
    #ifndef NO_NODE_LIST
    for(int n = 0; n < 6; n++){
       if(n == DASHED) continue;
       nlistpos = NULL;
       for(Node *node; (node = yieldNextNodeFast(graph, &nlistpos, n)) != NULL;){
    #else
-   for (int i = 0; i < graph->_nodearray.size; i++)
+   for (long i = 0; i < graph->_nodearray.size; i++)
    {
       node = (Node *) getBigArrayValue(&(graph->_nodearray), i);
       if(nodeDeleted(node)) continue;
    #endif
          for(int i = 0; i < 6; i++){
             for(int j = 0; j < 2; j++){
+               #ifdef ARRAY_ADJACENCY
+               EdgeArray *array = outEdgeArray(node, i, j);
+               for(long position = array->size - 1; position >= 0; position--)
+               {
+                  Edge *edge = array->edges[position];
+               #else
                elistpos = NULL;
                for(Edge *edge; (edge = yieldNextOutEdgeFast(graph, node, &elistpos, i, j)) != NULL;)
                {
-                  PTF("(%d, %d, %d, ", edge->index, edgeSource(edge)->index, edgeTarget(edge)->index);
+               #endif
+                  PTF("(%ld, %ld, %ld, ", edge->index, edgeSource(edge)->index, edgeTarget(edge)->index);
                   printHostLabel(edge->label, file);
                   PTF(") ");
                }
@@ -619,6 +1314,230 @@ void printGraphFast(Graph *graph, FILE *file)
 }
 
 #ifndef MINIMAL_GC
+static Node *copyNode(Graph *graph, Node *node)
+{
+   addHostList(node->label.list);
+   return addNode(graph, false, node->label);
+}
+
+static Edge *copyEdge(Graph *graph, Edge *edge, Node **nodes)
+{
+   addHostList(edge->label.list);
+   return addEdge(graph, edge->label, nodes[edge->source->index],
+                  nodes[edge->target->index]);
+}
+
+#ifndef NO_NODE_LIST
+static void reverseNodeList(Graph *graph, int mark)
+{
+   NodeList *entry = graph->nodes[mark], *previous = NULL;
+   while(entry != NULL)
+   {
+      NodeList *next = entry->next;
+      entry->next = previous;
+      entry->prev = next;
+      previous = entry;
+      entry = next;
+   }
+   graph->nodes[mark] = previous;
+}
+#endif
+
+/* Gives the edge lists of the copy of a node the order of the node's lists.
+ * The copies of the edges are looked up by the index of the original. */
+static void orderEdgeLists(Node *node, Node *copy, Edge **edges)
+{
+   for(int mark = 0; mark < 6; mark++){
+      for(int orientation = 0; orientation < 2; orientation++){
+         for(int loop = 0; loop < 2; loop++){
+            #ifdef ARRAY_ADJACENCY
+            EdgeArray *array = nodeEdgeArray(node, mark, orientation, loop);
+            EdgeArray *copy_array = nodeEdgeArray(copy, mark, orientation, loop);
+            assert(array->size == copy_array->size);
+            for(long position = 0; position < array->size; position++)
+            {
+               Edge *edge = edges[array->edges[position]->index];
+               copy_array->edges[position] = edge;
+               if(orientation == 0) edge->source_position = position;
+               else edge->target_position = position;
+            }
+            #else
+            EdgeList *previous = NULL;
+            for(EdgeList *entry = nodeEdges(node)[mark][orientation][loop]; entry != NULL;
+                entry = entry->next)
+            {
+               if(edgeDeleted(entry->edge)) continue;
+               Edge *edge = edges[entry->edge->index];
+               EdgeList *copy_entry = orientation == 0 ? edge->edgeSrcListAddress
+                                                       : edge->edgeTrgListAddress;
+               copy_entry->prev = previous;
+               if(previous == NULL) nodeEdges(copy)[mark][orientation][loop] = copy_entry;
+               else previous->next = copy_entry;
+               previous = copy_entry;
+            }
+            if(previous == NULL) nodeEdges(copy)[mark][orientation][loop] = NULL;
+            else previous->next = NULL;
+            #endif
+         }
+      }
+   }
+}
+
+/* Copies the out-edges of a node in the order of its lists. */
+static void copyOutEdges(Graph *graph, Graph *compact, Node *node, Node **nodes, Edge **edges)
+{
+   #ifndef ARRAY_ADJACENCY
+   EdgeList *elistpos = NULL;
+   #endif
+   for(int mark = 0; mark < 6; mark++){
+      for(int loop = 0; loop < 2; loop++){
+         #ifdef ARRAY_ADJACENCY
+         UNUSED(graph);
+         EdgeArray *array = outEdgeArray(node, mark, loop);
+         for(long position = array->size - 1; position >= 0; position--)
+         {
+            Edge *edge = array->edges[position];
+         #else
+         elistpos = NULL;
+         for(Edge *edge; (edge = yieldNextOutEdgeFast(graph, node, &elistpos, mark, loop)) != NULL;)
+         {
+         #endif
+            edges[edge->index] = copyEdge(compact, edge, nodes);
+         }
+      }
+   }
+}
+
+Graph *compactGraph(Graph *graph)
+{
+   Graph *compact = newGraph();
+   reserveBigArray(&(compact->_nodearray), graph->number_of_nodes);
+   reserveBigArray(&(compact->_edgearray), graph->number_of_edges);
+   /* The copies of the nodes and edges, indexed by the originals. */
+   Node **nodes = mallocSafe((graph->_nodearray.size + 1) * sizeof(Node *), "compactGraph");
+   Edge **edges = mallocSafe((graph->_edgearray.size + 1) * sizeof(Edge *), "compactGraph");
+
+   /* The nodes are copied in the order in which matchers visit them. Adding a
+    * node puts it at the head of its list, so each list is reversed after. */
+   #ifndef NO_NODE_LIST
+   NodeList *nlistpos = NULL;
+   for(int mark = 0; mark < 6; mark++)
+   {
+      if(mark == DASHED) continue;
+      nlistpos = NULL;
+      for(Node *node; (node = yieldNextNodeFast(graph, &nlistpos, mark)) != NULL;)
+         nodes[node->index] = copyNode(compact, node);
+      reverseNodeList(compact, mark);
+   }
+   #else
+   for(long index = 0; index < graph->_nodearray.size; index++)
+   {
+      Node *node = (Node *) getBigArrayValue(&(graph->_nodearray), index);
+      if(!nodeDeleted(node)) nodes[index] = copyNode(compact, node);
+   }
+   #endif
+
+   /* The root lists are rebuilt back to front, as roots are added at their
+    * heads. */
+   for(int mark = 0; mark < 6; mark++)
+   {
+      RootNodes *last = graph->root_nodes[mark];
+      while(last != NULL && last->next != NULL) last = last->next;
+      for(RootNodes *root = last; root != NULL; root = root->prev)
+      {
+         Node *copy = nodes[root->node->index];
+         setNodeRoot(copy);
+         addRootNode(compact, copy);
+      }
+   }
+
+   /* The edges are copied in the order of their sources, then the edge lists
+    * of every node are given their old order. */
+   #ifndef NO_NODE_LIST
+   for(int mark = 0; mark < 6; mark++)
+   {
+      if(mark == DASHED) continue;
+      nlistpos = NULL;
+      for(Node *node; (node = yieldNextNodeFast(graph, &nlistpos, mark)) != NULL;)
+         copyOutEdges(graph, compact, node, nodes, edges);
+   }
+   for(int mark = 0; mark < 6; mark++)
+   {
+      if(mark == DASHED) continue;
+      nlistpos = NULL;
+      for(Node *node; (node = yieldNextNodeFast(graph, &nlistpos, mark)) != NULL;)
+         orderEdgeLists(node, nodes[node->index], edges);
+   }
+   #else
+   for(long index = 0; index < graph->_nodearray.size; index++)
+   {
+      Node *node = (Node *) getBigArrayValue(&(graph->_nodearray), index);
+      if(!nodeDeleted(node)) copyOutEdges(graph, compact, node, nodes, edges);
+   }
+   for(long index = 0; index < graph->_nodearray.size; index++)
+   {
+      Node *node = (Node *) getBigArrayValue(&(graph->_nodearray), index);
+      if(!nodeDeleted(node)) orderEdgeLists(node, nodes[index], edges);
+   }
+   #endif
+
+   #ifdef LABEL_INDEX
+   /* The classes hold the same nodes, which are put in their old order. */
+   for(long index = 0; index < graph->_nodearray.size; index++)
+   {
+      Node *node = (Node *) getBigArrayValue(&(graph->_nodearray), index);
+      if(nodeDeleted(node)) continue;
+      Node *copy = nodes[index];
+      copy->class_next = node->class_next == NULL ? NULL : nodes[node->class_next->index];
+      copy->class_prev = node->class_prev == NULL ? NULL : nodes[node->class_prev->index];
+      if(node->label_class->first == node) copy->label_class->first = copy;
+   }
+   #endif
+
+   #ifdef DEGREE_INDEX
+   /* The degree lists hold the same nodes, which are put in their old order. */
+   for(int mark = 0; mark < 6; mark++)
+      for(int degree = 0; degree < DEGREE_INDEX_BUCKETS; degree++)
+      {
+         Node *previous = NULL;
+         for(Node *node = graph->degree_nodes[mark][degree]; node != NULL;
+             node = node->degree_next)
+         {
+            Node *copy = nodes[node->index];
+            copy->degree_prev = previous;
+            if(previous == NULL) compact->degree_nodes[mark][degree] = copy;
+            else previous->degree_next = copy;
+            previous = copy;
+         }
+         if(previous == NULL) compact->degree_nodes[mark][degree] = NULL;
+         else previous->degree_next = NULL;
+      }
+   #endif
+
+   #ifdef EDGE_LISTS
+   /* The mark lists hold the same edges, which are put in their old order. */
+   for(int mark = 0; mark < 6; mark++)
+   {
+      Edge *previous = NULL;
+      for(Edge *edge = graph->mark_edges[mark]; edge != NULL; edge = edge->mark_next)
+      {
+         Edge *copy = edges[edge->index];
+         copy->mark_prev = previous;
+         if(previous == NULL) compact->mark_edges[mark] = copy;
+         else previous->mark_next = copy;
+         previous = copy;
+      }
+      if(previous == NULL) compact->mark_edges[mark] = NULL;
+      else previous->mark_next = NULL;
+   }
+   #endif
+
+   free(nodes);
+   free(edges);
+   freeGraph(graph);
+   return compact;
+}
+
 void freeGraph(Graph *graph){
    if(graph == NULL) return;
 
@@ -639,7 +1558,7 @@ void freeGraph(Graph *graph){
    }
    #else
    Node *node;
-   for (int i = 0; i < graph->_nodearray.size; i++)
+   for (long i = 0; i < graph->_nodearray.size; i++)
    {
       node = (Node *) getBigArrayValue(&(graph->_nodearray), i);
       if(nodeDeleted(node))
@@ -653,21 +1572,36 @@ void freeGraph(Graph *graph){
    }
    #endif
 
-   if(graph->root_nodes != NULL)
+   /* Removing the nodes has moved every root list entry to the free list. */
+   RootNodes *iterator = graph->free_roots;
+   while(iterator != NULL)
    {
-      RootNodes *iterator = graph->root_nodes;
-      while(iterator != NULL)
-      {
-         RootNodes *temp = iterator;
-         iterator = iterator->next;
-         free(temp);
-      }
+      RootNodes *temp = iterator;
+      iterator = iterator->next;
+      free(temp);
    }
    emptyBigArray(&(graph->_nodearray));
    emptyBigArray(&(graph->_edgearray));
    #ifndef NO_NODE_LIST
    emptyBigArray(&(graph->_nodelistarray));
    #endif
+   #ifdef COMPACT_NODES
+   emptyBigArray(&(graph->_adjacencyarray));
+   #ifndef ARRAY_ADJACENCY
+   emptyBigArray(&(graph->_edgelistarray));
+   #endif
+   #endif
+   #ifdef LABEL_INDEX
+   free(graph->label_classes);
+   #endif
+   #ifdef EDGE_INDEX
+   free(graph->edge_index);
+   #endif
+   #ifdef NODE_FILTER
+   free(graph->filter_marks);
+   free(graph->filter_indegrees);
+   free(graph->filter_outdegrees);
+   #endif
    free(graph);
 }
 #endif
@@ -22,6 +22,58 @@
   An API for GP2 graphs. Defines structures for graphs, nodes, edges, label
   class tables and functions that operate on these structures.
 
+  With COMPACT_NODES defined, a node keeps only the fields read by the
+  matcher (label, flags, index and degrees). Its edge list heads and node
+  list address move to a separate NodeAdjacency record, and the entries of
+  all edge lists come from one pool in the graph rather than a BigArray
+  embedded in every node.
+
+  With ARRAY_ADJACENCY defined, the edge lists of a node are replaced by
+  growable arrays of edge pointers, indexed in the same way. Each edge records
+  its position in the arrays of its source and target, so that removeEdge takes
+  it out of both at once by moving the last entry of each array into its place.
+  The arrays therefore never hold deleted edges and are scanned with plain
+  indexed loops. An array gives back half of its storage once it is a quarter
+  full.
+
+  With DEGREE_INDEX defined, the live nodes of each mark whose degree (the
+  sum of the indegree and the outdegree) is below DEGREE_INDEX_BUCKETS are
+  kept in a doubly-linked list for each degree. The lists are updated
+  whenever an edge is added, removed or recovered, so nodes with an exact
+  small degree, such as the leaves deleted by pruning rules, are found
+  without scanning the node list.
+
+  The root nodes are kept in a doubly-linked list for each mark, and every
+  root node points at its entry, so a node is added to or removed from the
+  roots in constant time. Root matchers only visit the roots of the marks
+  they can match. Removed entries are kept for reuse by the graph.
+
+  With EDGE_INDEX defined, the graph also holds a hash table of edges keyed on
+  source, target and mark. Only the edges incident to high-degree nodes are
+  in it: a node joins the index, together with all of its edges, once its
+  degree reaches EDGE_INDEX_THRESHOLD, and stays there until it is freed. An
+  edge is indexed exactly when it is live and one of its endpoints is, so the
+  edges between two nodes can be found without scanning the edge lists of
+  either whenever edgesIndexed holds for them.
+
+  With EDGE_LISTS defined, the live edges of each mark are also kept in a
+  doubly-linked list, updated whenever an edge is added, removed, recovered
+  or remarked. A rule edge matched in isolation takes its candidates from the
+  lists of the marks it can match, so a searchplan can start at a rare marked
+  edge instead of scanning nodes for one.
+
+  With CHANGE_STAMPS defined, every change to a graph that can give a rule a
+  match it did not have is stamped with the time of a global change clock:
+  a node or an edge getting a mark, by being added, recovered, relabelled or
+  remarked, a node being made or unmade a root, and an edge being added or
+  removed, which changes the degrees of its endpoints. Rule set calls record
+  the time at which a rule last failed, and skip it until a change of a kind
+  that concerns it has a later stamp.
+
+  With NODE_FILTER defined, the marks and degrees of the nodes are also kept
+  in byte arrays indexed by node position, which the node array scans of
+  programs compiled without node lists filter (see the nodeFilter module).
+
 /////////////////////////////////////////////////////////////////////////// */
 
 #ifndef INC_GRAPH_H
@@ -33,6 +85,7 @@
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h> 
 #include <stdio.h> 
 
@@ -42,31 +95,69 @@ typedef struct NodeList {
   struct Node *node;
   struct NodeList *next;
   struct NodeList *prev;
-  int index; // TODO: UNSIGNED
+  long index;
 } NodeList;
 #endif
 
+#ifdef ARRAY_ADJACENCY
+// 24 bytes
+typedef struct EdgeArray {
+  struct Edge **edges;
+  long size, capacity;
+} EdgeArray;
+
+#define EDGE_ARRAY_INITIAL_SIZE 4
+#else
 // 24 bytes
 typedef struct EdgeList {
   struct Edge *edge;
   struct EdgeList *next;
   struct EdgeList *prev;
-  int index; // TODO: UNSIGNED
+  long index;
 } EdgeList;
+#endif
+
+#ifdef LABEL_INDEX
+// The live nodes with a given mark and host list. Nodes in a class are linked
+// through their class_next and class_prev fields. Since host lists are
+// hash-consed, the list pointer identifies the list.
+typedef struct LabelClass {
+  HostList *list;
+  MarkType mark;
+  struct Node *first;
+  struct LabelClass *next;
+} LabelClass;
+
+#define LABEL_INDEX_INITIAL_SIZE 256
+#endif
+
+#ifdef DEGREE_INDEX
+#define DEGREE_INDEX_BUCKETS 4
+#endif
+
+#ifdef EDGE_INDEX
+#define EDGE_INDEX_INITIAL_SIZE 256
+#define EDGE_INDEX_THRESHOLD 64
+#endif
 
 /* ================================
  * Graph Data Structure + Functions
  * ================================ */
 
-// 96/120 + BIGAR_INIT_SZ * 3 bytes
-// currently, 672/696 bytes
+// 120/144 + BIGAR_INIT_SZ * 3 bytes
+// currently, 696/720 bytes
+// With COMPACT_NODES, two more BigArrays: 1128/1168 bytes
 typedef struct Graph
 {
    #ifndef NO_NODE_LIST
    NodeList* nodes[6];
    #endif
-   struct RootNodes *root_nodes;
-   int number_of_nodes, number_of_edges; // TODO: UNSIGNED
+   // The root nodes of each mark, and the unused root list entries.
+   struct RootNodes *root_nodes[6];
+   struct RootNodes *free_roots;
+   long number_of_nodes, number_of_edges;
+   // Number of live nodes of each mark, read by adaptive matchers.
+   long nodes_by_mark[6];
 
    // Internally keep arrays to reduce malloc/free's to O(log n).
    BigArray _nodearray;
@@ -74,6 +165,42 @@ typedef struct Graph
    #ifndef NO_NODE_LIST
    BigArray _nodelistarray;
    #endif
+   #ifdef COMPACT_NODES
+   // The adjacency records of the nodes, and the entries of every edge list.
+   BigArray _adjacencyarray;
+   #ifndef ARRAY_ADJACENCY
+   BigArray _edgelistarray;
+   #endif
+   #endif
+   #ifdef LABEL_INDEX
+   // Hash table of label classes with separate chaining. The number of
+   // buckets is a power of two, doubled when there are more classes.
+   LabelClass **label_classes;
+   long label_class_buckets, label_class_count;
+   #endif
+   #ifdef DEGREE_INDEX
+   // The heads of the lists of live nodes by mark and degree, linked through
+   // their degree_next and degree_prev fields.
+   struct Node *degree_nodes[6][DEGREE_INDEX_BUCKETS];
+   #endif
+   #ifdef EDGE_LISTS
+   // The heads of the lists of live edges by mark, linked through their
+   // mark_next and mark_prev fields.
+   struct Edge *mark_edges[6];
+   #endif
+   #ifdef EDGE_INDEX
+   // Hash table of indexed edges, chained through their index_next fields.
+   // The number of buckets is a power of two, doubled when there are more
+   // than twice as many edges.
+   struct Edge **edge_index;
+   long edge_index_buckets, edge_index_count;
+   #endif
+   #ifdef NODE_FILTER
+   // The mark bits and saturated degrees of the nodes by position in the node
+   // array, read by nextNodeCandidate (see the lib's nodeFilter module).
+   uint8_t *filter_marks, *filter_indegrees, *filter_outdegrees;
+   long filter_size;
+   #endif
 } Graph;
 
 /* The arguments nodes and edges are the initial sizes of the node array and the
@@ -84,8 +211,25 @@ Graph *newGraph();
  * Node and Edge Definitions
  * ========================= */
 
+#ifdef COMPACT_NODES
+// 192/200 bytes, or 576/584 bytes with ARRAY_ADJACENCY
+typedef struct NodeAdjacency {
+   // The edge lists of the node, indexed as Node.edges below.
+   #ifdef ARRAY_ADJACENCY
+   EdgeArray edges[6][2][2];
+   #else
+   EdgeList* edges[6][2][2];
+   #endif
+   #ifndef NO_NODE_LIST
+   NodeList* nodeListAddress;
+   #endif
+   struct RootNodes *rootListAddress;
+} NodeAdjacency;
+#endif
+
 // 64/72 bytes + BIGAR_INIT_SZ
 // currently, 256/264 bytes
+// With COMPACT_NODES, 48 bytes
 typedef struct Node {
    HostLabel label;
 #define NFLAG_ROOT 0b1
@@ -94,38 +238,73 @@ typedef struct Node {
 #define NFLAG_INGRAPH 0b1000
 #define NFLAG_INSTACK 0b10000
 #define NFLAG_REMARKED 0b100000
+#define NFLAG_EDGEINDEX 0b1000000
    char flags; // All flags stored here.
-   int index; // TODO: UNSIGNED
+   long index;
+   #ifdef COMPACT_NODES
+   long outdegree, indegree;
+   NodeAdjacency *adjacency;
+   #else
    // A 3D array containing all edge linked lists:
    // - the first dimension denotes the mark,
    // - the second dimension denotes the orientation, and
    // - the third dimension denotes whether the edge in question is a loop.
+   #ifdef ARRAY_ADJACENCY
+   EdgeArray edges[6][2][2];
+   long outdegree, indegree;
+   #else
    EdgeList* edges[6][2][2];
-   int outdegree, indegree; // TODO: UNSIGNED
+   long outdegree, indegree;
    BigArray _edgelistarray;
+   #endif
    #ifndef NO_NODE_LIST
    NodeList* nodeListAddress;
    #endif
+   struct RootNodes *rootListAddress;
+   #endif
+   // The label index links are followed by indexed matchers, so they stay
+   // with the hot fields.
+   #ifdef LABEL_INDEX
+   LabelClass *label_class;
+   struct Node *class_next, *class_prev;
+   #endif
+   #ifdef DEGREE_INDEX
+   struct Node *degree_next, *degree_prev;
+   #endif
 } Node;
 
-// 16 bytes
+// 24 bytes
 typedef struct RootNodes {
    Node *node;
-   struct RootNodes *next;
+   struct RootNodes *next, *prev;
 } RootNodes;
 
-// 32 bytes
+// 56 bytes
 typedef struct Edge {
    HostLabel label;
 #define EFLAG_MATCHED 0b10
+#define EFLAG_INDEXED 0b1000
 #define EFLAG_DELETED 0b100
 #define EFLAG_INSTACK 0b10000
 #define EFLAG_INSRCLST 0b100000
 #define EFLAG_INTRGLST 0b1000000
    char flags;
-   int index; // TODO: UNSIGNED
+   long index;
    Node *source, *target;
+   #ifdef ARRAY_ADJACENCY
+   // Positions in the edge arrays of the source and the target.
+   long source_position, target_position;
+   #else
    EdgeList* edgeTrgListAddress, *edgeSrcListAddress;
+   #endif
+   #ifdef EDGE_INDEX
+   // index_pprev points at the field that points at the edge, so that the
+   // edge can be unlinked without rehashing its old key.
+   struct Edge *index_next, **index_pprev;
+   #endif
+   #ifdef EDGE_LISTS
+   struct Edge *mark_next, *mark_prev;
+   #endif
 } Edge;
 
 /* Nodes and edges are created and added to the graph with the addNode and addEdge
@@ -148,10 +327,44 @@ void relistNode(Graph *graph, Node *node, int old_mark);
 void relistEdge(Graph *graph, Edge *edge, int old_mark);
 
 
-#define relabelNode(node, new_label) (node)->label = new_label
-#define changeNodeMark(node, new_mark) (node)->label.mark = new_mark
-#define relabelEdge(edge, new_label) (edge)->label = new_label
-#define changeEdgeMark(edge, new_mark) (edge)->label.mark = new_mark
+#ifdef CHANGE_STAMPS
+// The kinds of change: a node or an edge getting the given mark, and the
+// degrees of nodes changing.
+#define NODE_CHANGE(mark) (mark)
+#define EDGE_CHANGE(mark) (6 + (mark))
+#define DEGREE_CHANGE 12
+#define CHANGE_KINDS 13
+
+// The time of the last change, and of the last change of each kind. Every
+// new graph counts as a change of all kinds.
+extern long change_clock;
+extern long change_stamps[CHANGE_KINDS];
+
+#define noteChange(kind) (change_stamps[kind] = ++change_clock)
+// Returns true if a change of one of the kinds, bit k of the mask standing
+// for kind k, has happened after the given time.
+bool changedSince(long time, unsigned kinds);
+#else
+#define noteChange(kind) ((void) 0)
+#endif
+#define noteNodeChange(node) noteChange(NODE_CHANGE((node)->label.mark))
+#define noteEdgeChange(edge) noteChange(EDGE_CHANGE((edge)->label.mark))
+
+#ifdef LABEL_INDEX
+// Moves the node to the label class of its new label.
+void reindexNode(Graph *graph, Node *node, HostLabel new_label);
+#define relabelNode(graph, node, new_label) \
+   (reindexNode(graph, node, new_label), noteNodeChange(node))
+#define changeNodeMark(graph, node, new_mark) \
+   (reindexNode(graph, node, makeHostLabel(new_mark, (node)->label.length, (node)->label.list)), \
+    noteNodeChange(node))
+#else
+#define relabelNode(graph, node, new_label) ((node)->label = new_label, noteNodeChange(node))
+#define changeNodeMark(graph, node, new_mark) \
+   ((node)->label.mark = new_mark, noteNodeChange(node))
+#endif
+#define relabelEdge(edge, new_label) ((edge)->label = new_label, noteEdgeChange(edge))
+#define changeEdgeMark(edge, new_mark) ((edge)->label.mark = new_mark, noteEdgeChange(edge))
 
 #define nodeRoot(node) ((node)->flags & NFLAG_ROOT)
 #define nodeMatched(node) ((node)->flags & NFLAG_MATCHED)
@@ -187,16 +400,19 @@ void relistEdge(Graph *graph, Edge *edge, int old_mark);
 #define edgeInStack(edge) ((edge)->flags & EFLAG_INSTACK)
 #define edgeInSrcLst(edge) ((edge)->flags & EFLAG_INSRCLST)
 #define edgeInTrgLst(edge) ((edge)->flags & EFLAG_INTRGLST)
+#define edgeIndexed(edge) ((edge)->flags & EFLAG_INDEXED)
 #define setEdgeMatched(edge) (edge)->flags |= EFLAG_MATCHED
 #define setEdgeDeleted(edge) (edge)->flags |= EFLAG_DELETED
 #define setEdgeInStack(edge) (edge)->flags |= EFLAG_INSTACK
 #define setEdgeInSrcLst(edge) (edge)->flags |= EFLAG_INSRCLST
 #define setEdgeInTrgLst(edge) (edge)->flags |= EFLAG_INTRGLST
+#define setEdgeIndexed(edge) (edge)->flags |= EFLAG_INDEXED
 #define clearEdgeMatched(edge) (edge)->flags &= ~EFLAG_MATCHED
 #define clearEdgeDeleted(edge) (edge)->flags &= ~EFLAG_DELETED
 #define clearEdgeInStack(edge) (edge)->flags &= ~EFLAG_INSTACK
 #define clearEdgeInSrcLst(edge) (edge)->flags &= ~EFLAG_INSRCLST
 #define clearEdgeInTrgLst(edge) (edge)->flags &= ~EFLAG_INTRGLST
+#define clearEdgeIndexed(edge) (edge)->flags &= ~EFLAG_INDEXED
 
 #define edgeSource(edge) (edge)->source
 #define edgeTarget(edge) (edge)->target
@@ -215,6 +431,21 @@ void tryGarbageCollectNode(Graph *graph, Node *node);
  * Graph Querying Functions
  * ======================== */
 
+#ifdef ARRAY_ADJACENCY
+// The arrays of edges leaving and entering a node with the given mark. The
+// edges are added at the end, so scanning an array from its last position
+// visits the newest edge first, as the linked lists do.
+#ifdef COMPACT_NODES
+#define nodeEdgeArray(node, mark, orientation, loop) \
+   (&((node)->adjacency->edges[mark][orientation][loop]))
+#else
+#define nodeEdgeArray(node, mark, orientation, loop) \
+   (&((node)->edges[mark][orientation][loop]))
+#endif
+#define outEdgeArray(node, mark, loop) nodeEdgeArray(node, mark, 0, loop)
+#define inEdgeArray(node, mark, loop) nodeEdgeArray(node, mark, 1, loop)
+#endif
+
 // Given the current position in the list of nodes/edges,
 // yield the next element in the list.
 // Done this way so deleted nodes/edges are garbage
@@ -222,16 +453,84 @@ void tryGarbageCollectNode(Graph *graph, Node *node);
 #ifndef NO_NODE_LIST
 Node *yieldNextNode(Graph *graph, NodeList **current, int mark);
 #endif
+#ifndef ARRAY_ADJACENCY
 Edge *yieldNextOutEdge(Graph *graph, Node *node, EdgeList **current, int mark, bool loop);
 Edge *yieldNextInEdge(Graph *graph, Node *node, EdgeList **current, int mark, bool loop);
+#endif
 
-RootNodes *getRootNodeList(Graph *graph);
+// As above, but deleted nodes/edges are skipped without being collected.
+#ifndef NO_NODE_LIST
+Node *yieldNextNodeFast(Graph *graph, NodeList **current, int mark);
+#endif
+
+// The position of a live node in the list of its mark. Passed to
+// yieldNextNode, the iteration continues with the node after it.
+#ifndef NO_NODE_LIST
+NodeList *nodeListPosition(Node *node);
+#endif
+#ifndef ARRAY_ADJACENCY
+Edge *yieldNextOutEdgeFast(Graph *graph, Node *node, EdgeList **current, int mark, bool loop);
+Edge *yieldNextInEdgeFast(Graph *graph, Node *node, EdgeList **current, int mark, bool loop);
+#endif
+
+// The root nodes with the given mark.
+RootNodes *getRootNodeList(Graph *graph, int mark);
+
+#ifdef LABEL_INDEX
+// Returns the first live node with the given mark and host list, or NULL.
+// The other nodes of the class are reached with nextNodeWithLabel.
+Node *firstNodeWithLabel(Graph *graph, MarkType mark, HostList *list);
+#define nextNodeWithLabel(node) (node)->class_next
+#endif
+
+#ifdef DEGREE_INDEX
+// The first live node with the given mark and a degree below
+// DEGREE_INDEX_BUCKETS, or NULL. The other nodes are reached with
+// nextNodeWithDegree.
+#define firstNodeWithDegree(graph, mark, degree) (graph)->degree_nodes[mark][degree]
+#define nextNodeWithDegree(node) (node)->degree_next
+#endif
+
+#ifdef EDGE_LISTS
+// The most recently added live edge with the given mark, or NULL. The other
+// edges of the mark are reached with nextEdgeWithMark.
+#define firstEdgeWithMark(graph, mark) (graph)->mark_edges[mark]
+#define nextEdgeWithMark(edge) (edge)->mark_next
+#endif
+
+#ifdef EDGE_INDEX
+#define nodeEdgeIndexed(node) ((node)->flags & NFLAG_EDGEINDEX)
+// True if the edges from source to target can be looked up in the index.
+#define edgesIndexed(source, target) (nodeEdgeIndexed(source) || nodeEdgeIndexed(target))
+// Return the first and the next edge from source to target with the given
+// mark, or NULL. Only to be called when edgesIndexed(source, target) holds.
+Edge *firstEdgeBetween(Graph *graph, Node *source, Node *target, int mark);
+Edge *nextEdgeBetween(Edge *edge);
+#endif
 
 void printGraph(Graph *graph, FILE *file);
 void printGraphFast(Graph *graph, FILE *file);
 
 #ifndef MINIMAL_GC
 void freeGraph(Graph *graph);
+
+/* Deleted nodes and edges leave holes in the node and edge arrays, which are
+ * only reused by later additions. A graph is sparse if its node array or its
+ * edge array is at least COMPACTION_MIN_SIZE long and less than a quarter of
+ * it is live. */
+#define COMPACTION_MIN_SIZE 1024
+#define graphSparse(graph) \
+   (((graph)->_nodearray.size >= COMPACTION_MIN_SIZE && \
+     (graph)->number_of_nodes * 4 < (graph)->_nodearray.size) || \
+    ((graph)->_edgearray.size >= COMPACTION_MIN_SIZE && \
+     (graph)->number_of_edges * 4 < (graph)->_edgearray.size))
+
+/* Returns a copy of the graph whose nodes and edges are packed into the front
+ * of its arrays in the order in which they are traversed, and frees the graph.
+ * The node, edge and root lists, and the label classes, keep their order.
+ * Nodes and edges get new indices, so no pointers into the graph may be held,
+ * and the graph must not be referenced by the graph change stack. */
+Graph *compactGraph(Graph *graph);
 #endif
 
 #endif /* INC_GRAPH_H */
\ No newline at end of file
@@ -15,47 +15,249 @@
 
 #include "graphStacks.h"
 
+#include <stdint.h>
+#include <string.h>
+
+/* The changes are stored contiguously in an arena, so that growing the stack
+ * never copies it and undoing or discarding changes releases their memory in
+ * one step. */
+#define CHANGE_SIZE arenaSize(sizeof(GraphChange))
+
 typedef struct GraphChangeStack {
-   int size;
-   int capacity;
-   GraphChange *stack;
+   long size;
+   /* The size of the stack when the innermost restore point was taken. Changes
+    * above it are coalesced per item. */
+   long segment;
+   /* The number of coalesced changes above segment. */
+   long coalesced;
+   /* The largest size the stack has had. */
+   long high_water;
+   Arena changes;
    Graph *graph;
 } GraphChangeStack;
 
 static GraphChangeStack *graph_change_stack = NULL;
 
+/* Maps each item changed in the current segment to the stack positions of the
+ * changes recorded for it, or -1. A slot is live only if its generation is the
+ * current one, so the index is emptied in constant time at each new segment. */
+typedef struct ChangeIndexSlot {
+   void *item;
+   unsigned generation;
+   long added, label, root;
+} ChangeIndexSlot;
+
+static struct ChangeIndex {
+   ChangeIndexSlot *slots;
+   unsigned capacity, count, generation;
+} change_index = {NULL, 0, 0, 1};
+
 static void makeGraphChangeStack(int initial_capacity)
 {
    GraphChangeStack *stack = mallocSafe(sizeof(GraphChangeStack), "makeGraphChangeStack");
    stack->size = 0;
-   stack->capacity = initial_capacity;
-   stack->stack = mallocSafe(initial_capacity * sizeof(GraphChange), "makeGraphChangeStack"); 
+   stack->segment = 0;
+   stack->coalesced = 0;
+   stack->high_water = 0;
+   initialiseArena(&(stack->changes), initial_capacity * CHANGE_SIZE);
    stack->graph = NULL;
    graph_change_stack = stack;
 }
 
-static void growGraphChangeStack(void)
+static inline GraphChange *changeAt(long position)
 {
-   graph_change_stack->capacity *= 2;
-   graph_change_stack->stack = reallocSafe(
-     graph_change_stack->stack,
-     graph_change_stack->capacity * sizeof(GraphChange),
-     "growGraphChangeStack"
-   );
+   return (GraphChange *) arenaAt(&(graph_change_stack->changes),
+                                  (size_t) position * CHANGE_SIZE);
 }
 
-static void pushGraphChange(GraphChange change)
+/* Returns the position of the pushed change. */
+static long pushGraphChange(GraphChange change)
 {
    if(graph_change_stack == NULL) makeGraphChangeStack(128);
-   else if(graph_change_stack->size >= graph_change_stack->capacity) growGraphChangeStack();
-   graph_change_stack->stack[graph_change_stack->size++] = change;
+   GraphChange *top = arenaAllocate(&(graph_change_stack->changes), sizeof(GraphChange));
+   *top = change;
+   assert(top == changeAt(graph_change_stack->size));
+   if(graph_change_stack->size >= graph_change_stack->high_water)
+      graph_change_stack->high_water = graph_change_stack->size + 1;
+   return graph_change_stack->size++;
 }
 
 static GraphChange pullGraphChange(void)
 {
    assert(graph_change_stack != NULL);
    assert(graph_change_stack->size > 0);
-   return graph_change_stack->stack[--graph_change_stack->size];
+   return *changeAt(--graph_change_stack->size);
+}
+
+/* Releases the memory of the changes above the current size. */
+static void releaseGraphChanges(void)
+{
+   arenaRelease(&(graph_change_stack->changes),
+                (size_t) graph_change_stack->size * CHANGE_SIZE);
+}
+
+static unsigned hashItem(void *item)
+{
+   uintptr_t key = (uintptr_t) item;
+   key ^= key >> 33;
+   key *= 0xFF51AFD7ED558CCDu;
+   key ^= key >> 33;
+   return (unsigned) key;
+}
+
+static inline bool slotLive(ChangeIndexSlot *slot)
+{
+   return slot->generation == change_index.generation;
+}
+
+/* Returns the live slot of the passed item, or the slot where it belongs. */
+static ChangeIndexSlot *findChangeSlot(void *item)
+{
+   unsigned mask = change_index.capacity - 1;
+   unsigned index = hashItem(item) & mask;
+   while(slotLive(&(change_index.slots[index])))
+   {
+      if(change_index.slots[index].item == item) return &(change_index.slots[index]);
+      index = (index + 1) & mask;
+   }
+   return &(change_index.slots[index]);
+}
+
+static ChangeIndexSlot *lookupChanges(void *item)
+{
+   if(change_index.count == 0) return NULL;
+   ChangeIndexSlot *slot = findChangeSlot(item);
+   return slotLive(slot) ? slot : NULL;
+}
+
+static void growChangeIndex(void)
+{
+   ChangeIndexSlot *old_slots = change_index.slots;
+   unsigned old_capacity = change_index.capacity;
+   change_index.capacity = old_capacity == 0 ? 64 : old_capacity * 2;
+   change_index.slots = callocSafe(change_index.capacity, sizeof(ChangeIndexSlot),
+                                   "growChangeIndex");
+   /* Slots from calloc carry generation 0, which is never current. */
+   for(unsigned index = 0; index < old_capacity; index++)
+   {
+      if(!slotLive(&(old_slots[index]))) continue;
+      *findChangeSlot(old_slots[index].item) = old_slots[index];
+   }
+   if(old_slots != NULL) free(old_slots);
+}
+
+/* Returns the slot of the passed item, adding one without changes if the item
+ * has none in the current segment. */
+static ChangeIndexSlot *recordChanges(void *item)
+{
+   if((change_index.count + 1) * 4 > change_index.capacity * 3) growChangeIndex();
+   ChangeIndexSlot *slot = findChangeSlot(item);
+   if(!slotLive(slot))
+   {
+      slot->item = item;
+      slot->generation = change_index.generation;
+      slot->added = slot->label = slot->root = -1;
+      change_index.count++;
+   }
+   return slot;
+}
+
+/* Empties the slot of an item that is about to be freed, since its memory may
+ * be reused by an item added later in the segment. */
+static void forgetChanges(ChangeIndexSlot *slot)
+{
+   unsigned mask = change_index.capacity - 1;
+   unsigned hole = (unsigned) (slot - change_index.slots);
+   unsigned index = (hole + 1) & mask;
+   while(slotLive(&(change_index.slots[index])))
+   {
+      unsigned home = hashItem(change_index.slots[index].item) & mask;
+      if(((index - home) & mask) >= ((index - hole) & mask))
+      {
+         change_index.slots[hole] = change_index.slots[index];
+         hole = index;
+      }
+      index = (index + 1) & mask;
+   }
+   change_index.slots[hole].generation = 0;
+   change_index.count--;
+}
+
+/* Called whenever a restore point is taken or reached, since changes below it
+ * must stay separate from the changes made after it. */
+static void startSegment(void)
+{
+   graph_change_stack->segment = graph_change_stack->size;
+   graph_change_stack->coalesced = 0;
+   if(change_index.count == 0) return;
+   change_index.count = 0;
+   if(++change_index.generation == 0)
+   {
+      memset(change_index.slots, 0, change_index.capacity * sizeof(ChangeIndexSlot));
+      change_index.generation = 1;
+   }
+}
+
+static void *changedItem(GraphChange *change)
+{
+   switch(change->type)
+   {
+      case ADDED_NODE: return change->added_node;
+      case ADDED_EDGE: return change->added_edge;
+      case REMOVED_NODE: return change->removed_node;
+      case REMOVED_EDGE: return change->removed_edge;
+      case RELABELLED_NODE: return change->relabelled_node.node;
+      case RELABELLED_EDGE: return change->relabelled_edge.edge;
+      case REMARKED_NODE: return change->remarked_node.node;
+      case REMARKED_EDGE: return change->remarked_edge.edge;
+      case CHANGED_ROOT_NODE: return change->changed_root;
+      default: return NULL;
+   }
+}
+
+/* Removes the coalesced changes from the segment, moving the remaining ones
+ * down and updating their positions in the index. */
+static void compactSegment(void)
+{
+   long kept = graph_change_stack->segment;
+   for(long position = kept; position < graph_change_stack->size; position++)
+   {
+      GraphChange *change = changeAt(position);
+      if(change->type == COALESCED_CHANGE) continue;
+      *changeAt(kept) = *change;
+      ChangeIndexSlot *slot = lookupChanges(changedItem(change));
+      assert(slot != NULL);
+      switch(change->type)
+      {
+         case ADDED_NODE: case ADDED_EDGE: slot->added = kept; break;
+         case CHANGED_ROOT_NODE: slot->root = kept; break;
+         case REMOVED_NODE: case REMOVED_EDGE: break;
+         default: slot->label = kept; break;
+      }
+      kept++;
+   }
+   graph_change_stack->size = kept;
+   graph_change_stack->coalesced = 0;
+   releaseGraphChanges();
+}
+
+/* Turns the change at the passed position into a no-op. Trailing no-ops are
+ * popped, and the segment is compacted once they make up most of it. */
+static void coalesceChange(long position)
+{
+   assert(position >= graph_change_stack->segment);
+   changeAt(position)->type = COALESCED_CHANGE;
+   graph_change_stack->coalesced++;
+   while(graph_change_stack->size > graph_change_stack->segment &&
+         changeAt(graph_change_stack->size - 1)->type == COALESCED_CHANGE)
+   {
+      graph_change_stack->size--;
+      graph_change_stack->coalesced--;
+   }
+   releaseGraphChanges();
+   if(graph_change_stack->coalesced >= 64 &&
+      graph_change_stack->coalesced * 2 > graph_change_stack->size - graph_change_stack->segment)
+      compactSegment();
 }
 
 void setStackGraph(Graph *graph)
@@ -64,9 +266,23 @@ void setStackGraph(Graph *graph)
    graph_change_stack->graph = graph;
 }
 
-int topOfGraphChangeStack(void)
+long topOfGraphChangeStack(void)
+{
+   if(graph_change_stack == NULL) return 0;
+   startSegment();
+   return graph_change_stack->size;
+}
+
+long graphChangeStackSize(void)
 {
-   return graph_change_stack == NULL ? 0 : graph_change_stack->size;
+   if(graph_change_stack == NULL) return 0;
+   return graph_change_stack->size;
+}
+
+long graphChangeStackHighWater(void)
+{
+   if(graph_change_stack == NULL) return 0;
+   return graph_change_stack->high_water;
 }
 
 void pushAddedNode(Node *node)
@@ -76,7 +292,7 @@ void pushAddedNode(Node *node)
    change.added_node = node;
    change.first_occurrence = !nodeInStack(node);
    setNodeInStack(node);
-   pushGraphChange(change);
+   recordChanges(node)->added = pushGraphChange(change);
 }
 
 void pushAddedEdge(Edge *edge)
@@ -86,11 +302,23 @@ void pushAddedEdge(Edge *edge)
    change.added_edge = edge;
    change.first_occurrence = !edgeInStack(edge);
    setEdgeInStack(edge);
-   pushGraphChange(change);
+   recordChanges(edge)->added = pushGraphChange(change);
 }
 
+/* An item added in the current segment has no other changes recorded for it
+ * there. Removing it cancels the addition, leaving the item to be collected
+ * as if the changes had never been recorded. */
 void pushRemovedNode(Node *node)
 {
+   ChangeIndexSlot *slot = lookupChanges(node);
+   if(slot != NULL && slot->added >= 0)
+   {
+      assert(changeAt(slot->added)->first_occurrence);
+      clearNodeInStack(node);
+      coalesceChange(slot->added);
+      forgetChanges(slot);
+      return;
+   }
    GraphChange change;
    change.type = REMOVED_NODE;
    change.removed_node = node;
@@ -101,6 +329,15 @@ void pushRemovedNode(Node *node)
 
 void pushRemovedEdge(Edge *edge)
 {
+   ChangeIndexSlot *slot = lookupChanges(edge);
+   if(slot != NULL && slot->added >= 0)
+   {
+      assert(changeAt(slot->added)->first_occurrence);
+      clearEdgeInStack(edge);
+      coalesceChange(slot->added);
+      forgetChanges(slot);
+      return;
+   }
    GraphChange change;
    change.type = REMOVED_EDGE;
    change.removed_edge = edge;
@@ -109,8 +346,26 @@ void pushRemovedEdge(Edge *edge)
    pushGraphChange(change);
 }
 
+/* Only the oldest label of an item in a segment is needed to undo it, and no
+ * label of an item added in the segment. A recorded remark becomes a
+ * relabelling with the mark it recorded. */
 void pushRelabelledNode(Node *node, HostLabel old_label)
 {
+   ChangeIndexSlot *slot = lookupChanges(node);
+   if(slot != NULL && slot->added >= 0) return;
+   if(slot != NULL && slot->label >= 0)
+   {
+      GraphChange *change = changeAt(slot->label);
+      if(change->type == RELABELLED_NODE) return;
+      old_label.mark = change->remarked_node.old_mark;
+      change->type = RELABELLED_NODE;
+      change->relabelled_node.node = node;
+      change->relabelled_node.old_label = old_label;
+      #ifndef MINIMAL_GC
+      addHostList(old_label.list);
+      #endif
+      return;
+   }
    GraphChange change;
    change.type = RELABELLED_NODE;
    change.relabelled_node.node = node;
@@ -122,11 +377,26 @@ void pushRelabelledNode(Node *node, HostLabel old_label)
    #ifndef MINIMAL_GC
    addHostList(old_label.list);
    #endif
-   pushGraphChange(change);
+   recordChanges(node)->label = pushGraphChange(change);
 }
 
 void pushRelabelledEdge(Edge *edge, HostLabel old_label)
 {
+   ChangeIndexSlot *slot = lookupChanges(edge);
+   if(slot != NULL && slot->added >= 0) return;
+   if(slot != NULL && slot->label >= 0)
+   {
+      GraphChange *change = changeAt(slot->label);
+      if(change->type == RELABELLED_EDGE) return;
+      old_label.mark = change->remarked_edge.old_mark;
+      change->type = RELABELLED_EDGE;
+      change->relabelled_edge.edge = edge;
+      change->relabelled_edge.old_label = old_label;
+      #ifndef MINIMAL_GC
+      addHostList(old_label.list);
+      #endif
+      return;
+   }
    GraphChange change;
    change.type = RELABELLED_EDGE;
    change.relabelled_edge.edge = edge;
@@ -138,42 +408,62 @@ void pushRelabelledEdge(Edge *edge, HostLabel old_label)
    #ifndef MINIMAL_GC
    addHostList(old_label.list);
    #endif
-   pushGraphChange(change);
+   recordChanges(edge)->label = pushGraphChange(change);
 }
 
 void pushRemarkedNode(Node *node, MarkType old_mark)
 {
+   ChangeIndexSlot *slot = lookupChanges(node);
+   if(slot != NULL && (slot->added >= 0 || slot->label >= 0)) return;
    GraphChange change;
    change.type = REMARKED_NODE;
    change.remarked_node.node = node;
    change.first_occurrence = !nodeInStack(node);
    setNodeInStack(node);
    change.remarked_node.old_mark = old_mark;
-   pushGraphChange(change);
+   recordChanges(node)->label = pushGraphChange(change);
 }
 
 void pushRemarkedEdge(Edge *edge, MarkType old_mark)
 {
+   ChangeIndexSlot *slot = lookupChanges(edge);
+   if(slot != NULL && (slot->added >= 0 || slot->label >= 0)) return;
    GraphChange change;
    change.type = REMARKED_EDGE;
    change.remarked_edge.edge = edge;
    change.first_occurrence = !edgeInStack(edge);
    setEdgeInStack(edge);
    change.remarked_edge.old_mark = old_mark;
-   pushGraphChange(change);
+   recordChanges(edge)->label = pushGraphChange(change);
 }
 
+/* A second root change of a node in a segment cancels the first. The first
+ * change is kept if dropping it would clear the in-stack flag of a node with
+ * a recorded label. */
 void pushChangedRootNode(Node *node)
 {
+   ChangeIndexSlot *slot = lookupChanges(node);
+   if(slot != NULL && slot->added >= 0) return;
+   if(slot != NULL && slot->root >= 0)
+   {
+      GraphChange *change = changeAt(slot->root);
+      if(!change->first_occurrence || slot->label < 0)
+      {
+         if(change->first_occurrence) clearNodeInStack(node);
+         coalesceChange(slot->root);
+         slot->root = -1;
+         return;
+      }
+   }
    GraphChange change;
    change.type = CHANGED_ROOT_NODE;
    change.changed_root = node;
    change.first_occurrence = !nodeInStack(node);
    setNodeInStack(node);
-   pushGraphChange(change);
+   recordChanges(node)->root = pushGraphChange(change);
 }
 
-void undoChanges(int restore_point)
+void undoChanges(long restore_point)
 {
    if(graph_change_stack == NULL) return;
    assert(restore_point >= 0);
@@ -200,8 +490,7 @@ void undoChanges(int restore_point)
               if(change.first_occurrence)
                 clearNodeInStack(change.removed_node);
               clearNodeDeleted(change.removed_node);
-              if(!nodeInGraph(change.removed_node))
-                recoverNode(graph, change.removed_node);
+              recoverNode(graph, change.removed_node);
               break;
 
          case REMOVED_EDGE:
@@ -218,7 +507,7 @@ void undoChanges(int restore_point)
               removeHostList((change.relabelled_node.node)->label.list);
               #endif
               current_mark = change.relabelled_node.node->label.mark;
-              relabelNode(change.relabelled_node.node, change.relabelled_node.old_label);
+              relabelNode(graph, change.relabelled_node.node, change.relabelled_node.old_label);
               if(current_mark != change.relabelled_node.old_label.mark){
                relistNode(graph, change.relabelled_node.node, current_mark);
               }
@@ -230,14 +519,17 @@ void undoChanges(int restore_point)
               #ifndef MINIMAL_GC
               removeHostList((change.relabelled_edge.edge)->label.list);
               #endif
+              current_mark = change.relabelled_edge.edge->label.mark;
               relabelEdge(change.relabelled_edge.edge, change.relabelled_edge.old_label);
+              if(current_mark != change.relabelled_edge.old_label.mark)
+                relistEdge(graph, change.relabelled_edge.edge, current_mark);
               break;
 
          case REMARKED_NODE:
               if(change.first_occurrence)
                 clearNodeInStack(change.remarked_node.node);
               current_mark = change.remarked_node.node->label.mark;
-              changeNodeMark(change.remarked_node.node, change.remarked_node.old_mark);
+              changeNodeMark(graph, change.remarked_node.node, change.remarked_node.old_mark);
               relistNode(graph, change.remarked_node.node, current_mark);
               break;
 
@@ -255,14 +547,33 @@ void undoChanges(int restore_point)
               changeRoot(graph, change.changed_root);
               break;
 
+         case COALESCED_CHANGE:
+              break;
+
          default:
               print_to_log("Error (restoreGraph): Unexepected change type %d.\n",
                            change.type);
               break;
       }
    }
+   releaseGraphChanges();
+   startSegment();
 }
 
+#ifndef MINIMAL_GC
+/* Frees an edge that is no longer referenced by the host graph or the stack.
+ * Deleted edges are out of the edge lists once these have been walked past
+ * them, and always with ARRAY_ADJACENCY. */
+static void collectEdge(Graph *graph, Edge *edge)
+{
+   if(edgeFree(edge))
+   {
+     removeHostList(edge->label.list);
+     removeFromBigArray(&(graph->_edgearray), edge->index);
+   }
+}
+#endif
+
 static void freeGraphChange(GraphChange change)
 {
    #ifndef MINIMAL_GC
@@ -279,11 +590,7 @@ static void freeGraphChange(GraphChange change)
            if(change.first_occurrence)
              clearEdgeInStack(change.added_edge);
            #ifndef MINIMAL_GC
-           if(edgeFree(change.added_edge))
-           {
-             removeHostList(change.added_edge->label.list);
-             removeFromBigArray(&(graph->_edgearray), change.added_edge->index);
-           }
+           collectEdge(graph, change.added_edge);
            #endif
            break;
 
@@ -295,6 +602,9 @@ static void freeGraphChange(GraphChange change)
       case REMOVED_EDGE:
            if(change.first_occurrence)
              clearEdgeInStack(change.removed_edge);
+           #ifndef MINIMAL_GC
+           collectEdge(graph, change.removed_edge);
+           #endif
            break;
 
       case RELABELLED_NODE:
@@ -305,6 +615,9 @@ static void freeGraphChange(GraphChange change)
       case RELABELLED_EDGE:
            if(change.first_occurrence)
              clearEdgeInStack(change.relabelled_edge.edge);
+           #ifndef MINIMAL_GC
+           collectEdge(graph, change.relabelled_edge.edge);
+           #endif
            break;
 
       case REMARKED_NODE:
@@ -315,6 +628,9 @@ static void freeGraphChange(GraphChange change)
       case REMARKED_EDGE:
            if(change.first_occurrence)
              clearEdgeInStack(change.remarked_edge.edge);
+           #ifndef MINIMAL_GC
+           collectEdge(graph, change.remarked_edge.edge);
+           #endif
            break;
 
       case CHANGED_ROOT_NODE:
@@ -322,6 +638,9 @@ static void freeGraphChange(GraphChange change)
              clearNodeInStack(change.changed_root);
            break;
 
+      case COALESCED_CHANGE:
+           break;
+
       default:
            print_to_log("Error (freeGraphChange): Unexepected graph change "
                         "type %d.\n",change.type);
@@ -329,7 +648,7 @@ static void freeGraphChange(GraphChange change)
    }
 }
 
-void discardChanges(int restore_point)
+void discardChanges(long restore_point)
 {
    if(graph_change_stack == NULL) return;
    while(graph_change_stack->size > restore_point)
@@ -337,6 +656,8 @@ void discardChanges(int restore_point)
       GraphChange change = pullGraphChange();
       freeGraphChange(change);
    }
+   releaseGraphChanges();
+   startSegment();
 } 
 
 #ifndef MINIMAL_GC
@@ -344,7 +665,25 @@ void freeGraphChangeStack(void)
 {
    if(graph_change_stack == NULL) return;
    discardChanges(0);
-   free(graph_change_stack->stack);
+   freeArena(&(graph_change_stack->changes));
    free(graph_change_stack);
+   graph_change_stack = NULL;
+   if(change_index.slots != NULL) free(change_index.slots);
+   change_index.slots = NULL;
+   change_index.capacity = change_index.count = 0;
+}
+
+Graph *compactGraphIfSparse(Graph *graph)
+{
+   if(!graphSparse(graph)) return graph;
+   if(graph_change_stack != NULL)
+   {
+      if(graph_change_stack->size > 0) return graph;
+      /* The change index may still hold the addresses of coalesced items. */
+      startSegment();
+   }
+   graph = compactGraph(graph);
+   setStackGraph(graph);
+   return graph;
 }
 #endif
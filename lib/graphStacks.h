@@ -25,6 +25,15 @@
   (2) A stack of graph changes maintained so that the graph can be rolled back
       if necessary.
 
+  The changes pushed since the last restore point was taken or reached form a
+  segment, in which changes are coalesced per item: only the oldest label,
+  mark and root status of an item are recorded, nothing is recorded for an
+  item after its addition, and removing an item added in the segment cancels
+  its addition. The stack therefore grows with the number of items changed
+  between restore points rather than the number of changes. Undoing a segment
+  restores the same graph, though nodes may end up at other positions in
+  their node lists.
+
 /////////////////////////////////////////////////////////////////////////// */
 
 #ifndef INC_GRAPH_STACKS_H
@@ -32,6 +41,7 @@
 
 #define GRAPH_STACK_SIZE 4
 
+#include "arena.h"
 #include "common.h"
 #include "graph.h"
 #include "label.h"
@@ -54,7 +64,9 @@ typedef enum {
    RELABELLED_EDGE,
    REMARKED_NODE,
    REMARKED_EDGE,
-   CHANGED_ROOT_NODE
+   CHANGED_ROOT_NODE,
+   /* A change cancelled by a later change in its segment. */
+   COALESCED_CHANGE
 } __attribute__ ((__packed__)) GraphChangeType;
 
 typedef struct GraphChange
@@ -92,7 +104,12 @@ typedef struct GraphChange
 
 void setStackGraph(Graph *graph);
 
-int topOfGraphChangeStack(void);
+long topOfGraphChangeStack(void);
+/* The number of records on the stack. Unlike topOfGraphChangeStack, this does
+ * not start a new segment. */
+long graphChangeStackSize(void);
+/* The largest number of records the stack has held. */
+long graphChangeStackHighWater(void);
 void pushAddedNode(Node *node);
 void pushAddedEdge(Edge *edge);
 void pushRemovedNode(Node *node);
@@ -102,11 +119,16 @@ void pushRelabelledEdge(Edge *edge, HostLabel old_label);
 void pushRemarkedNode(Node *node, MarkType old_mark);
 void pushRemarkedEdge(Edge *edge, MarkType old_mark);
 void pushChangedRootNode(Node *node);
-void undoChanges(int restore_point);
+void undoChanges(long restore_point);
 // Need to pass graph here in case node/edges need to be collected
-void discardChanges(int restore_point);
+void discardChanges(long restore_point);
 #ifndef MINIMAL_GC
 void freeGraphChangeStack(void);
+
+/* Compacts the graph if it is sparse and the stack holds no changes, since the
+ * changes refer to nodes and edges by address. Returns the graph to use from
+ * then on, which is also the graph of the stack. */
+Graph *compactGraphIfSparse(Graph *graph);
 #endif
 
 #endif /* INC_GRAPH_STACKS_H */
@@ -0,0 +1,237 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "graphWriter.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct GraphWriter {
+   int fd;
+   bool failed;
+   size_t used;
+   char buffer[GRAPH_WRITER_BUFFER_SIZE];
+} GraphWriter;
+
+/* Static so that writing a graph never allocates the buffer. */
+static GraphWriter writer;
+
+static void flushWriter(void)
+{
+   char *data = writer.buffer;
+   size_t remaining = writer.used;
+   while(remaining > 0 && !writer.failed)
+   {
+      ssize_t written = write(writer.fd, data, remaining);
+      if(written < 0)
+      {
+         if(errno == EINTR) continue;
+         print_to_log("Error (printGraphBuffered): write failure.\n");
+         writer.failed = true;
+         break;
+      }
+      data += written;
+      remaining -= (size_t) written;
+   }
+   writer.used = 0;
+}
+
+static inline void writeBytes(const char *bytes, size_t length)
+{
+   while(writer.used + length > GRAPH_WRITER_BUFFER_SIZE)
+   {
+      size_t space = GRAPH_WRITER_BUFFER_SIZE - writer.used;
+      memcpy(writer.buffer + writer.used, bytes, space);
+      writer.used += space;
+      bytes += space;
+      length -= space;
+      flushWriter();
+   }
+   memcpy(writer.buffer + writer.used, bytes, length);
+   writer.used += length;
+}
+
+#define writeLiteral(literal) writeBytes(literal, sizeof(literal) - 1)
+
+static inline void writeInt(long value)
+{
+   /* Digits are generated backwards into a scratch buffer. The magnitude is
+    * computed unsigned so that LONG_MIN is handled. */
+   char digits[21];
+   int position = 21;
+   unsigned long magnitude = value < 0 ? 0ul - (unsigned long) value : (unsigned long) value;
+   do {
+      digits[--position] = (char) ('0' + magnitude % 10);
+      magnitude /= 10;
+   } while(magnitude > 0);
+   if(value < 0) digits[--position] = '-';
+   writeBytes(digits + position, (size_t) (21 - position));
+}
+
+static void writeLabel(HostLabel label)
+{
+   if(label.length == 0) writeLiteral("empty");
+   else
+   {
+      HostAtom *atoms = label.list->atoms;
+      for(unsigned index = 0; index < label.list->length; index++)
+      {
+         if(index > 0) writeLiteral(" : ");
+         if(atoms[index].type == 'i') writeInt(atoms[index].num);
+         else
+         {
+            writeLiteral("\"");
+            writeBytes(atoms[index].str, stringLength(atoms[index].str));
+            writeLiteral("\"");
+         }
+      }
+   }
+   switch(label.mark)
+   {
+      case RED: writeLiteral(" # red"); break;
+      case GREEN: writeLiteral(" # green"); break;
+      case BLUE: writeLiteral(" # blue"); break;
+      case GREY: writeLiteral(" # grey"); break;
+      case DASHED: writeLiteral(" # dashed"); break;
+      default: break;
+   }
+}
+
+/* The counts control the line breaks exactly as in printGraph. With dense
+ * IDs they are also the printed IDs. */
+static void writeNode(Node *node, long *node_count, long *node_ids)
+{
+   if(*node_count != 0 && *node_count % 5 == 0) writeLiteral("\n  ");
+   writeLiteral("(");
+   if(node_ids != NULL)
+   {
+      node_ids[node->index] = *node_count;
+      writeInt(*node_count);
+   }
+   else writeInt(node->index);
+   if(nodeRoot(node)) writeLiteral("(R), ");
+   else writeLiteral(", ");
+   writeLabel(node->label);
+   writeLiteral(") ");
+   (*node_count)++;
+}
+
+static void writeOutEdges(Graph *graph, Node *node, long *edge_count, long *node_ids)
+{
+   #ifndef ARRAY_ADJACENCY
+   EdgeList *elistpos = NULL;
+   #endif
+   for(int k = 0; k < 6; k++){
+      for(int j = 0; j < 2; j++){
+         #ifdef ARRAY_ADJACENCY
+         EdgeArray *array = outEdgeArray(node, k, j);
+         for(long position = array->size - 1; position >= 0; position--)
+         {
+            Edge *edge = array->edges[position];
+         #else
+         elistpos = NULL;
+         for(Edge *edge; (edge = yieldNextOutEdgeFast(graph, node, &elistpos, k, j)) != NULL;)
+         {
+         #endif
+            if(*edge_count != 0 && *edge_count % 3 == 0) writeLiteral("\n  ");
+            writeLiteral("(");
+            if(node_ids != NULL)
+            {
+               writeInt(*edge_count);
+               writeLiteral(", ");
+               writeInt(node_ids[edgeSource(edge)->index]);
+               writeLiteral(", ");
+               writeInt(node_ids[edgeTarget(edge)->index]);
+            }
+            else
+            {
+               writeInt(edge->index);
+               writeLiteral(", ");
+               writeInt(edgeSource(edge)->index);
+               writeLiteral(", ");
+               writeInt(edgeTarget(edge)->index);
+            }
+            writeLiteral(", ");
+            writeLabel(edge->label);
+            writeLiteral(") ");
+            (*edge_count)++;
+         }
+      }
+   }
+}
+
+bool printGraphBuffered(Graph *graph, FILE *file, bool dense_ids)
+{
+   fflush(file);
+   writer.fd = fileno(file);
+   writer.failed = false;
+   writer.used = 0;
+
+   if(graph == NULL || graph->number_of_nodes == 0)
+   {
+      writeLiteral("[ | ]\n\n");
+      flushWriter();
+      return !writer.failed;
+   }
+   /* Indexed by the node's position in the node array. */
+   long *node_ids = NULL;
+   if(dense_ids) node_ids = mallocSafe((graph->_nodearray.size + 1) * sizeof(long),
+                                       "printGraphBuffered");
+   long node_count = 0, edge_count = 0;
+
+   writeLiteral("[ ");
+   #ifndef NO_NODE_LIST
+   NodeList *nlistpos = NULL;
+   for(int n = 0; n < 6; n++){
+      if(n == DASHED) continue;
+      nlistpos = NULL;
+      for(Node *node; (node = yieldNextNodeFast(graph, &nlistpos, n)) != NULL;)
+         writeNode(node, &node_count, node_ids);
+   }
+   #else
+   Node *node;
+   for(long i = 0; i < graph->_nodearray.size; i++)
+   {
+      node = (Node *) getBigArrayValue(&(graph->_nodearray), i);
+      if(nodeDeleted(node)) continue;
+      writeNode(node, &node_count, node_ids);
+   }
+   #endif
+   if(graph->number_of_edges == 0) writeLiteral("| ]\n\n");
+   else
+   {
+      writeLiteral("|\n  ");
+      #ifndef NO_NODE_LIST
+      for(int n = 0; n < 6; n++){
+         if(n == DASHED) continue;
+         nlistpos = NULL;
+         for(Node *node; (node = yieldNextNodeFast(graph, &nlistpos, n)) != NULL;)
+            writeOutEdges(graph, node, &edge_count, node_ids);
+      }
+      #else
+      for(long i = 0; i < graph->_nodearray.size; i++)
+      {
+         node = (Node *) getBigArrayValue(&(graph->_nodearray), i);
+         if(nodeDeleted(node)) continue;
+         writeOutEdges(graph, node, &edge_count, node_ids);
+      }
+      #endif
+      writeLiteral("]\n\n");
+   }
+   flushWriter();
+   if(node_ids != NULL) free(node_ids);
+   return !writer.failed;
+}
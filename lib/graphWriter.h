@@ -0,0 +1,47 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ===================
+  Graph Writer Module
+  ===================
+
+  A fast writer for the text format produced by printGraph. The output is
+  formatted by hand into a large buffer which is passed to write() whenever
+  it fills, so no stdio call or allocation is made per node or edge. Unlike
+  printGraph, the writer does not garbage collect the graph.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_GRAPH_WRITER_H
+#define INC_GRAPH_WRITER_H
+
+#include "common.h"
+#include "graph.h"
+#include "label.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#define GRAPH_WRITER_BUFFER_SIZE (1 << 20)
+
+/* Writes the graph to the passed file in the same format as printGraph. Any
+ * data already buffered in the FILE is flushed first. If dense_ids is set,
+ * nodes and edges are numbered 0, 1, 2, ... in the order they are written
+ * instead of by their index in the graph. Returns false if a write failed. */
+bool printGraphBuffered(Graph *graph, FILE *file, bool dense_ids);
+
+#endif /* INC_GRAPH_WRITER_H */
@@ -0,0 +1,523 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "hostLoader.h"
+
+#include <limits.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* ==============
+ * Node ID Table
+ * ============== */
+
+/* IDs below dense_limit live in the dense vector, which grows on demand.
+ * Larger (or negative) IDs go to an open addressing hash table. */
+typedef struct NodeTable {
+   Node **dense;
+   long dense_size, dense_limit;
+   long *keys;
+   Node **values;
+   size_t capacity, count;
+} NodeTable;
+
+static void initialiseNodeTable(NodeTable *table, long expected_nodes)
+{
+   table->dense_limit = expected_nodes > LONG_MAX / 4 ? LONG_MAX : expected_nodes * 4 + 1024;
+   table->dense_size = expected_nodes + 1;
+   table->dense = callocSafe(table->dense_size, sizeof(Node *), "initialiseNodeTable");
+   table->keys = NULL;
+   table->values = NULL;
+   table->capacity = 0;
+   table->count = 0;
+}
+
+static void freeNodeTable(NodeTable *table)
+{
+   free(table->dense);
+   if(table->keys != NULL) free(table->keys);
+   if(table->values != NULL) free(table->values);
+}
+
+static size_t findSlot(NodeTable *table, long id)
+{
+   size_t slot = ((unsigned long) id * 0x9E3779B97F4A7C15ul) & (table->capacity - 1);
+   while(table->values[slot] != NULL && table->keys[slot] != id)
+      slot = (slot + 1) & (table->capacity - 1);
+   return slot;
+}
+
+static Node *lookupNode(NodeTable *table, long id)
+{
+   if(id >= 0 && id < table->dense_size) return table->dense[id];
+   if(table->capacity == 0) return NULL;
+   return table->values[findSlot(table, id)];
+}
+
+/* Returns false if the ID is already taken. */
+static bool insertNode(NodeTable *table, long id, Node *node)
+{
+   if(id >= 0 && id < table->dense_limit)
+   {
+      if(id >= table->dense_size)
+      {
+         long size = table->dense_size;
+         while(size <= id) size = size > table->dense_limit / 2 ? table->dense_limit : size * 2;
+         table->dense = reallocSafe(table->dense, size * sizeof(Node *), "insertNode");
+         memset(table->dense + table->dense_size, 0, (size - table->dense_size) * sizeof(Node *));
+         table->dense_size = size;
+      }
+      if(table->dense[id] != NULL) return false;
+      table->dense[id] = node;
+      return true;
+   }
+   if(2 * (table->count + 1) > table->capacity)
+   {
+      long *keys = table->keys;
+      Node **values = table->values;
+      size_t capacity = table->capacity;
+      table->capacity = capacity == 0 ? 64 : capacity * 2;
+      table->keys = mallocSafe(table->capacity * sizeof(long), "insertNode");
+      table->values = callocSafe(table->capacity, sizeof(Node *), "insertNode");
+      for(size_t index = 0; index < capacity; index++)
+      {
+         if(values[index] == NULL) continue;
+         size_t slot = findSlot(table, keys[index]);
+         table->keys[slot] = keys[index];
+         table->values[slot] = values[index];
+      }
+      if(keys != NULL) free(keys);
+      if(values != NULL) free(values);
+   }
+   size_t slot = findSlot(table, id);
+   if(table->values[slot] != NULL) return false;
+   table->keys[slot] = id;
+   table->values[slot] = node;
+   table->count++;
+   return true;
+}
+
+/* ==========
+ * The Loader
+ * ========== */
+
+typedef struct HostLoader {
+   char *position, *end;
+   long line;
+   bool error;
+   Graph *graph;
+   NodeTable nodes;
+   /* Atoms of the list being parsed. */
+   HostAtom *atoms;
+   unsigned long atom_capacity;
+} HostLoader;
+
+static void loaderError(HostLoader *loader, const char *message)
+{
+   if(loader->error) return;
+   fprintf(stderr, "Error at line %ld: %s\n", loader->line, message);
+   loader->error = true;
+}
+
+/* Skips white space and comments. */
+static void skipSpace(HostLoader *loader)
+{
+   while(loader->position < loader->end)
+   {
+      char c = *loader->position;
+      if(c == '\n') loader->line++;
+      else if(c == '/' && loader->position + 1 < loader->end && loader->position[1] == '/')
+      {
+         while(loader->position < loader->end && *loader->position != '\n') loader->position++;
+         continue;
+      }
+      else if(c != ' ' && c != '\t' && c != '\r') return;
+      loader->position++;
+   }
+}
+
+/* Returns the next significant character without consuming it, or '\0' at the
+ * end of the input. */
+static char peek(HostLoader *loader)
+{
+   skipSpace(loader);
+   return loader->position < loader->end ? *loader->position : '\0';
+}
+
+static bool expect(HostLoader *loader, char c, const char *message)
+{
+   if(peek(loader) != c)
+   {
+      loaderError(loader, message);
+      return false;
+   }
+   loader->position++;
+   return true;
+}
+
+static bool isDigit(char c)
+{
+   return c >= '0' && c <= '9';
+}
+
+static bool parseNumber(HostLoader *loader, long *result)
+{
+   if(!isDigit(peek(loader)))
+   {
+      loaderError(loader, "expected a number");
+      return false;
+   }
+   long value = 0;
+   while(loader->position < loader->end && isDigit(*loader->position))
+   {
+      int digit = *loader->position - '0';
+      if(value > (LONG_MAX - digit) / 10)
+      {
+         loaderError(loader, "number out of range");
+         return false;
+      }
+      value = value * 10 + digit;
+      loader->position++;
+   }
+   *result = value;
+   return true;
+}
+
+/* Compares the next word with a keyword. Consumes it on a match. */
+static bool matchWord(HostLoader *loader, const char *word)
+{
+   size_t length = strlen(word);
+   if((size_t) (loader->end - loader->position) < length) return false;
+   if(strncmp(loader->position, word, length) != 0) return false;
+   char next = loader->position + length < loader->end ? loader->position[length] : '\0';
+   if((next >= 'a' && next <= 'z') || (next >= 'A' && next <= 'Z') || isDigit(next))
+      return false;
+   loader->position += length;
+   return true;
+}
+
+/* Layout information for the editor: '<' x ',' y '>' where x and y are
+ * integers or decimals. It is ignored. */
+static bool parsePosition(HostLoader *loader)
+{
+   loader->position++;
+   for(int coordinate = 0; coordinate < 2; coordinate++)
+   {
+      char c = peek(loader);
+      if(c == '-' || c == '+') loader->position++;
+      char *start = loader->position;
+      while(loader->position < loader->end &&
+            (isDigit(*loader->position) || *loader->position == '.'))
+         loader->position++;
+      if(loader->position == start)
+      {
+         loaderError(loader, "expected a coordinate");
+         return false;
+      }
+      if(loader->position < loader->end &&
+         (*loader->position == 'e' || *loader->position == 'E'))
+      {
+         loader->position++;
+         if(loader->position < loader->end &&
+            (*loader->position == '-' || *loader->position == '+'))
+            loader->position++;
+         while(loader->position < loader->end && isDigit(*loader->position))
+            loader->position++;
+      }
+      if(!expect(loader, coordinate == 0 ? ',' : '>', "malformed position")) return false;
+   }
+   return true;
+}
+
+/* Parses a string literal, terminates it in place and interns it. The caller
+ * receives a reference to the interned string. */
+static bool parseString(HostLoader *loader, string *result)
+{
+   char *start = ++loader->position;
+   while(loader->position < loader->end && *loader->position != '"')
+   {
+      char c = *loader->position;
+      if(c == '\n')
+      {
+         loaderError(loader, "string continues on new line");
+         return false;
+      }
+      if(c < ' ' || c > '~')
+      {
+         loaderError(loader, "invalid character in string");
+         return false;
+      }
+      loader->position++;
+   }
+   if(loader->position == loader->end)
+   {
+      loaderError(loader, "unterminated string");
+      return false;
+   }
+   *loader->position++ = '\0';
+   *result = makeString(start);
+   return true;
+}
+
+static bool parseLabel(HostLoader *loader, HostLabel *label)
+{
+   unsigned length = 0;
+   while(true)
+   {
+      char c = peek(loader);
+      if(c == 'e' && matchWord(loader, "empty"))
+         ; /* The empty list contributes no atoms. */
+      else
+      {
+         if(length == loader->atom_capacity)
+         {
+            loader->atom_capacity *= 2;
+            loader->atoms = reallocSafe(loader->atoms, loader->atom_capacity * sizeof(HostAtom),
+                                        "parseLabel");
+         }
+         HostAtom *atom = &(loader->atoms[length]);
+         if(c == '"')
+         {
+            atom->type = 's';
+            if(!parseString(loader, &(atom->str))) return false;
+         }
+         else
+         {
+            bool negative = c == '-';
+            if(negative) loader->position++;
+            atom->type = 'i';
+            if(!parseNumber(loader, &(atom->num))) return false;
+            if(negative) atom->num = -atom->num;
+         }
+         length++;
+         if(length == UINT_MAX)
+         {
+            loaderError(loader, "list too long");
+            return false;
+         }
+      }
+      if(peek(loader) != ':') break;
+      loader->position++;
+   }
+   MarkType mark = NONE;
+   if(peek(loader) == '#')
+   {
+      loader->position++;
+      peek(loader);
+      if(matchWord(loader, "red")) mark = RED;
+      else if(matchWord(loader, "green")) mark = GREEN;
+      else if(matchWord(loader, "blue")) mark = BLUE;
+      else if(matchWord(loader, "grey")) mark = GREY;
+      else if(matchWord(loader, "dashed")) mark = DASHED;
+      else
+      {
+         loaderError(loader, "expected a mark");
+         return false;
+      }
+   }
+   if(length == 0) *label = makeEmptyLabel(mark);
+   else
+   {
+      HostList *list = makeHostList(loader->atoms, length, true);
+      *label = makeHostLabel(mark, length, list);
+   }
+   return true;
+}
+
+/* The list of a parsed label is in the list store, so if a later syntax
+ * error prevents it from being attached to the graph, its reference must be
+ * dropped. */
+static void releaseLabel(HostLabel label)
+{
+   #ifndef MINIMAL_GC
+   removeHostList(label.list);
+   #else
+   UNUSED(label);
+   #endif
+}
+
+/* '(' ID ["(R)"] ',' Label [Position] ')' */
+static void parseNode(HostLoader *loader)
+{
+   loader->position++;
+   long id;
+   if(!parseNumber(loader, &id)) return;
+   bool root = false;
+   if(peek(loader) == '(')
+   {
+      loader->position++;
+      if(!expect(loader, 'R', "expected (R)")) return;
+      if(!expect(loader, ')', "expected (R)")) return;
+      root = true;
+   }
+   if(!expect(loader, ',', "expected ','")) return;
+   HostLabel label;
+   if(!parseLabel(loader, &label)) return;
+   if(peek(loader) == '<' && !parsePosition(loader))
+   {
+      releaseLabel(label);
+      return;
+   }
+   if(!expect(loader, ')', "expected ')'"))
+   {
+      releaseLabel(label);
+      return;
+   }
+   Node *node = addNode(loader->graph, root, label);
+   if(!insertNode(&(loader->nodes), id, node)) loaderError(loader, "duplicate node ID");
+}
+
+/* '(' ID ',' Source ',' Target ',' Label ')' */
+static void parseEdge(HostLoader *loader)
+{
+   loader->position++;
+   long id, source_id, target_id;
+   if(!parseNumber(loader, &id)) return;
+   if(!expect(loader, ',', "expected ','")) return;
+   if(!parseNumber(loader, &source_id)) return;
+   if(!expect(loader, ',', "expected ','")) return;
+   if(!parseNumber(loader, &target_id)) return;
+   if(!expect(loader, ',', "expected ','")) return;
+   Node *source = lookupNode(&(loader->nodes), source_id);
+   Node *target = lookupNode(&(loader->nodes), target_id);
+   if(source == NULL || target == NULL)
+   {
+      loaderError(loader, "edge refers to an undefined node");
+      return;
+   }
+   HostLabel label;
+   if(!parseLabel(loader, &label)) return;
+   if(!expect(loader, ')', "expected ')'"))
+   {
+      releaseLabel(label);
+      return;
+   }
+   addEdge(loader->graph, label, source, target);
+}
+
+/* The first pass. Counts the parenthesised items on either side of the last
+ * '|' outside strings and comments; "(R)" is not an item. */
+static void countItems(char *position, char *end, long *nodes, long *edges)
+{
+   long before = 0, after = 0;
+   while(position < end)
+   {
+      char c = *position++;
+      if(c == '"')
+      {
+         while(position < end && *position != '"' && *position != '\n') position++;
+         position++;
+      }
+      else if(c == '/' && position < end && *position == '/')
+      {
+         while(position < end && *position != '\n') position++;
+      }
+      else if(c == '|')
+      {
+         before += after;
+         after = 0;
+      }
+      else if(c == '(' && !(position < end && *position == 'R')) after++;
+   }
+   *nodes = before;
+   *edges = after;
+}
+
+static bool readHostFile(string file_name, char **data, size_t *size)
+{
+   FILE *file = fopen(file_name, "rb");
+   if(file == NULL)
+   {
+      perror(file_name);
+      return false;
+   }
+   struct stat file_stat;
+   if(fstat(fileno(file), &file_stat) != 0)
+   {
+      perror(file_name);
+      fclose(file);
+      return false;
+   }
+   *size = (size_t) file_stat.st_size;
+   *data = mallocSafe(*size + 1, "readHostFile");
+   if(fread(*data, 1, *size, file) != *size)
+   {
+      perror(file_name);
+      free(*data);
+      fclose(file);
+      return false;
+   }
+   (*data)[*size] = '\0';
+   fclose(file);
+   return true;
+}
+
+Graph *loadHostGraph(string file_name)
+{
+   char *data;
+   size_t size;
+   if(!readHostFile(file_name, &data, &size)) return NULL;
+
+   long node_count, edge_count;
+   countItems(data, data + size, &node_count, &edge_count);
+
+   HostLoader loader;
+   loader.position = data;
+   loader.end = data + size;
+   loader.line = 1;
+   loader.error = false;
+   loader.graph = newGraph();
+   reserveBigArray(&(loader.graph->_nodearray), node_count);
+   reserveBigArray(&(loader.graph->_edgearray), edge_count);
+   #ifndef NO_NODE_LIST
+   reserveBigArray(&(loader.graph->_nodelistarray), node_count);
+   #endif
+   #ifdef COMPACT_NODES
+   reserveBigArray(&(loader.graph->_adjacencyarray), node_count);
+   #ifndef ARRAY_ADJACENCY
+   /* Every edge has an entry in the lists of its source and its target. */
+   reserveBigArray(&(loader.graph->_edgelistarray), 2 * edge_count);
+   #endif
+   #endif
+   initialiseNodeTable(&(loader.nodes), node_count);
+   loader.atom_capacity = 64;
+   loader.atoms = mallocSafe(loader.atom_capacity * sizeof(HostAtom), "loadHostGraph");
+
+   /* '[' [Position '|'] Node* '|' Edge* ']' */
+   if(expect(&loader, '[', "expected '['"))
+   {
+      if(peek(&loader) == '<' && parsePosition(&loader))
+         expect(&loader, '|', "expected '|'");
+      while(!loader.error && peek(&loader) == '(') parseNode(&loader);
+      if(!loader.error && expect(&loader, '|', "expected '|'"))
+      {
+         while(!loader.error && peek(&loader) == '(') parseEdge(&loader);
+         if(!loader.error && expect(&loader, ']', "expected ']'") && peek(&loader) != '\0')
+            loaderError(&loader, "unexpected input after the graph");
+      }
+   }
+
+   free(loader.atoms);
+   freeNodeTable(&(loader.nodes));
+   free(data);
+   if(loader.error)
+   {
+      #ifndef MINIMAL_GC
+      freeGraph(loader.graph);
+      #endif
+      return NULL;
+   }
+   return loader.graph;
+}
@@ -0,0 +1,58 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ==================
+  Host Loader Module
+  ==================
+
+  A hand-written loader for the textual host graph format, replacing the
+  Flex/Bison host graph parser in the runtime.
+
+  The file is read into memory in one piece. A quick first pass counts the
+  nodes and edges so the graph's arrays can be sized up front; the second
+  pass parses the graph and builds it. Node IDs are resolved through a flat
+  vector when they are small enough (the usual case: editors number nodes
+  from 0), falling back to a hash table for large or sparse IDs. String
+  atoms are terminated in place in the file buffer and interned straight
+  from there, so each distinct string is copied only once.
+
+  =============
+  Update Policy
+  =============
+  Changes to the GP 2 host graph syntax accepted by this loader must be
+  mirrored in the host graph parser of the graphical editor.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_HOST_LOADER_H
+#define INC_HOST_LOADER_H
+
+#include "common.h"
+#include "graph.h"
+#include "label.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* The host graph, defined in the generated main.c. */
+extern struct Graph *host;
+
+/* Builds a new graph from the host graph file. Syntax errors are reported to
+ * stderr with their line number, and NULL is returned. */
+Graph *loadHostGraph(string file_name);
+
+#endif /* INC_HOST_LOADER_H */
@@ -15,210 +15,303 @@
 
 #include "label.h"
 
+#include <limits.h>
+
 HostLabel blank_label = {NULL, 0, NONE};
 
-Bucket **list_store = NULL;
-
-/* The list hash table has 400 buckets. It is structured as follows:
- * Lists of length 1 occupy buckets 0 - 99.
- * Lists of length 2 occupy buckets 100 - 199.
- * Lists of length 3 occupy buckets 200 - 299.
- * Lists of length > 3 occupy buckets 300 - 399.
- * The first unit in the first atom (an integer or the first character of a string)
- * gives the index to add to the 'base' (the appropriate multiple of 100) as defined
- * in the function. */
-static unsigned hashHostList(HostAtom *list, unsigned short length)
+ListStore list_store = {NULL, 0, 0, NULL};
+
+/* FNV-1a over the list's length, the type of each atom, and each atom's value,
+ * followed by a final avalanche so that the low bits used to index the table
+ * depend on the whole list. Strings are interned, so a string atom contributes
+ * its stored hash and its characters are never read. */
+#define FNV_OFFSET 2166136261u
+#define FNV_PRIME 16777619u
+
+static inline unsigned mixWord(unsigned hash, unsigned value)
 {
-   unsigned hash = 0;
-   unsigned short index;
-   for(index = 0; index < length; index++)
+   int byte;
+   for(byte = 0; byte < 4; byte++)
    {
-      HostAtom atom = list[index];
-      int value = atom.type == 'i' ? atom.num : atom.str[0];
-      hash = ((hash << 5) + hash) + value; /* hash = hash * 33 + value */
+      hash = (hash ^ (value & 0xFF)) * FNV_PRIME;
+      value >>= 8;
    }
-   return hash % LIST_TABLE_SIZE;
+   return hash;
 }
 
-static HostList *appendHostAtom(HostList *list, HostAtom atom, bool free_strings)
+static unsigned hashHostList(HostAtom *list, unsigned length)
 {
-   HostListItem *new_item = mallocSafe(sizeof(HostListItem), "appendAtom");
-   new_item->atom = atom;
-   if(atom.type == 's') 
+   unsigned hash = (FNV_OFFSET ^ length) * FNV_PRIME;
+   unsigned index;
+   for(index = 0; index < length; index++)
    {
-      if(free_strings) new_item->atom.str = atom.str;
-      else new_item->atom.str = strdup(atom.str);
+      HostAtom atom = list[index];
+      hash = (hash ^ (unsigned char) atom.type) * FNV_PRIME;
+      if(atom.type == 'i')
+         hash = mixWord(mixWord(hash, (unsigned) atom.num), (unsigned) (atom.num >> 32));
+      else hash = mixWord(hash, stringHash(atom.str));
    }
-   new_item->next = NULL;
+   hash ^= hash >> 16;
+   hash *= 0x85EBCA6Bu;
+   hash ^= hash >> 13;
+   hash *= 0xC2B2AE35u;
+   hash ^= hash >> 16;
+   return hash;
+}
 
-   if(list == NULL)
+/* Allocates a list holding a copy of the passed array. The list takes a
+ * reference to each of its strings unless the caller hands over its own
+ * (free_strings). */
+static HostList *allocateHostList(HostAtom *array, unsigned length, bool free_strings)
+{
+   HostList *list = mallocSafe(sizeof(HostList) + length * sizeof(HostAtom),
+                               "allocateHostList");
+   list->hash = 0;
+   list->length = length;
+   unsigned index;
+   for(index = 0; index < length; index++)
    {
-      new_item->prev = NULL;
-      HostList *new_list = mallocSafe(sizeof(HostList), "appendAtom");
-      new_list->hash = -1;
-      new_list->first = new_item;
-      new_list->last = new_item;
-      return new_list;
+      list->atoms[index] = array[index];
+      #ifndef MINIMAL_GC
+      if(array[index].type == 's' && !free_strings) addString(array[index].str);
+      #else
+      UNUSED(free_strings);
+      #endif
    }
-   else
+   return list;
+}
+
+/* Returns true if the list is equal to the list represented by the passed array.
+ * Both sides hold interned strings, which are equal only if they are the same
+ * pointer. */
+static bool listEqualsArray(HostList *list, HostAtom *array, unsigned length)
+{
+   if(list->length != length) return false;
+   unsigned index;
+   for(index = 0; index < length; index++)
    {
-      list->last->next = new_item;
-      new_item->prev = list->last;
-      list->last = new_item;
-      return list;
+      if(list->atoms[index].type != array[index].type) return false;
+      if(array[index].type == 'i')
+      {
+         if(list->atoms[index].num != array[index].num) return false;
+      }
+      else if(list->atoms[index].str != array[index].str) return false;
    }
+   return true;
 }
 
-/* Create a new bucket, allocate a list defined by the function arguments, and
- * point the bucket to that list. */
-static Bucket *makeBucket(HostAtom *array, unsigned short length, bool free_strings)
+void initialiseHostListStore(void)
 {
-   Bucket *bucket = mallocSafe(sizeof(Bucket), "makeBucket");
-   HostList *list = NULL;
-   int index;
-   for(index = 0; index < length; index++) 
-      list = appendHostAtom(list, array[index], free_strings);
-   bucket->list = list;
-   #ifndef MINIMAL_GC
-   bucket->reference_count = 1;
-   #endif
-   bucket->next = NULL;
-   bucket->prev = NULL;
-   return bucket;
+   list_store.capacity = LIST_STORE_INITIAL_SIZE;
+   list_store.count = 0;
+   list_store.slots = callocSafe(list_store.capacity, sizeof(ListStoreSlot),
+                                 "initialiseHostListStore");
+   list_store.small_integers = callocSafe(SMALL_INTEGER_MAX - SMALL_INTEGER_MIN + 1,
+                                          SMALL_INTEGER_LIST_SIZE, "initialiseHostListStore");
 }
 
-void initialiseHostListStore(void)
+static inline bool isSmallIntegerArray(HostAtom *array, unsigned length)
+{
+   return length == 1 && array[0].type == 'i' &&
+          array[0].num >= SMALL_INTEGER_MIN && array[0].num <= SMALL_INTEGER_MAX;
+}
+
+static inline HostList *smallIntegerList(long value)
+{
+   return (HostList *) (list_store.small_integers +
+                        (size_t) (value - SMALL_INTEGER_MIN) * SMALL_INTEGER_LIST_SIZE);
+}
+
+#ifndef MINIMAL_GC
+static inline bool isSmallIntegerList(HostList *list)
 {
-   list_store = callocSafe(LIST_TABLE_SIZE, sizeof(Bucket*), "initialiseHostListStore");
+   return (char *) list >= list_store.small_integers &&
+          (char *) list < (char *) smallIntegerList(SMALL_INTEGER_MAX + 1);
+}
+#endif
+
+/* Returns the slot holding the list equal to the passed array, or the empty
+ * slot where such a list belongs. */
+static ListStoreSlot *findSlot(HostAtom *array, unsigned length, unsigned hash)
+{
+   unsigned long mask = list_store.capacity - 1;
+   unsigned long index = hash & mask;
+   while(list_store.slots[index].list != NULL)
+   {
+      ListStoreSlot *slot = &(list_store.slots[index]);
+      if(slot->hash == hash && listEqualsArray(slot->list, array, length)) return slot;
+      index = (index + 1) & mask;
+   }
+   return &(list_store.slots[index]);
+}
+
+/* Doubles the capacity of the table and reinserts every entry. The stored
+ * hashes are reused, so no list is rehashed or compared. */
+static void growHostListStore(void)
+{
+   ListStoreSlot *old_slots = list_store.slots;
+   unsigned long old_capacity = list_store.capacity;
+   list_store.capacity *= 2;
+   list_store.slots = callocSafe(list_store.capacity, sizeof(ListStoreSlot),
+                                 "growHostListStore");
+   unsigned long mask = list_store.capacity - 1;
+   unsigned long index;
+   for(index = 0; index < old_capacity; index++)
+   {
+      if(old_slots[index].list == NULL) continue;
+      unsigned long new_index = old_slots[index].hash & mask;
+      while(list_store.slots[new_index].list != NULL) new_index = (new_index + 1) & mask;
+      list_store.slots[new_index] = old_slots[index];
+   }
+   free(old_slots);
 }
 
 /* Adds a host list, represented by the passed array and its length, to the hash
  * table. The array and the length is passed to the hashing function. 
  *
- * The free_strings flag is true if the strings in the passed array have already
- * been allocated by the caller. It controls the freeing of such strings in the
- * case that the passed list already exists in the hash table. 
- * This is a necessary inconvenience: addListToStore is called by the Bison/Flex generated
- * host graph parser which requires the strings it parses to be strdup'd (otherwise 
- * things go wrong). Calls to addListToStore in other contexts pass arrays with 
- * automatic strings which should not be freed. */
-HostList *makeHostList(HostAtom *array, unsigned short length, bool free_strings)
+ * The strings in the array must be interned. The free_strings flag is true if
+ * the caller holds a reference to each of them that is handed over to the
+ * store: it is kept by a new list and removed if the passed list already
+ * exists in the hash table. This is the case for the host graph loaders.
+ * Calls to makeHostList in other contexts pass strings owned by someone else,
+ * and the new list takes its own references to them. */
+HostList *makeHostList(HostAtom *array, unsigned length, bool free_strings)
 {
-   assert(list_store != NULL);
-   unsigned hash = hashHostList(array, length);
-   if(list_store[hash] == NULL)
+   assert(list_store.slots != NULL);
+   if(isSmallIntegerArray(array, length))
    {
-      Bucket *bucket = makeBucket(array, length, free_strings);
-      list_store[hash] = bucket;
-      bucket->list->hash = hash;
-      return bucket->list;
+      HostList *list = smallIntegerList(array[0].num);
+      if(list->length == 0)
+      {
+         list->hash = hashHostList(array, length);
+         list->atoms[0] = array[0];
+         list->length = 1;
+      }
+      return list;
    }
-   /* Check each list in the bucket for equality with the list represented
-    * by the passed array. */
-   else
+   unsigned hash = hashHostList(array, length);
+   ListStoreSlot *slot = findSlot(array, length, hash);
+   if(slot->list != NULL)
    {
-      Bucket *bucket = list_store[hash];
-      unsigned short index;
-      bool make_bucket = true;
-      while(bucket != NULL)
+      #ifndef MINIMAL_GC
+      if(slot->reference_count < UINT_MAX) slot->reference_count++;
+      if(free_strings)
       {
-         HostListItem *item = bucket->list->first;
+         unsigned index;
          for(index = 0; index < length; index++) 
-         {
-            if(item == NULL) break;
-            HostAtom atom = array[index];
-            if(item->atom.type != atom.type) break;
-            if(item->atom.type == 'i') 
-            {
-               if(item->atom.num != atom.num) break;
-            }
-            else
-            {
-               if(strcmp(item->atom.str, atom.str) != 0) break;
-            }
-            item = item->next;
-         }
-         /* The lists are equal if and only if the ends of both lists are reached.
-          * If an atom comparison failed, the for loop breaks before the end of
-          * either list is reached. If the array is shorter, then the for loop
-          * exits before item reaches its terminating NULL pointer. If the list
-          * is shorter, the first line in the for loop body will cause the loop
-          * to break before index == length. */
-         if(index == length && item == NULL)
-         {
-            make_bucket = false; 
-            break;
-         }
-         /* Exit the loop while maintaining the pointer to the last item in the
-          * bucket list, because a list is going to be appended! */
-         if(bucket->next == NULL) break;
-         bucket = bucket->next;
-      }
-      /* If control reaches this point, then no list in the bucket is equal to
-       * the passed list. Make a new list! */
-      if(make_bucket)
-      {
-         Bucket *new_bucket = makeBucket(array, length, free_strings);
-         bucket->next = new_bucket;
-         new_bucket->prev = bucket;
-         new_bucket->list->hash = hash;
-         return new_bucket->list;
-      }
-      else 
-      {
-         #ifndef MINIMAL_GC
-         bucket->reference_count++;
-         #endif
-         if(free_strings)
-         {
-            for(index = 0; index < length; index++) 
-               if(array[index].type == 's') free(array[index].str);
-         }
-         return bucket->list;
+            if(array[index].type == 's') removeString(array[index].str);
       }
+      #endif
+      return slot->list;
+   }
+   /* The list is new. Grow the table first if the insertion would take it past
+    * three-quarters full; the free slot then has to be found again. */
+   if((list_store.count + 1) * 4 > list_store.capacity * 3)
+   {
+      growHostListStore();
+      slot = findSlot(array, length, hash);
+   }
+   slot->list = allocateHostList(array, length, free_strings);
+   slot->list->hash = hash;
+   slot->hash = hash;
+   #ifndef MINIMAL_GC
+   slot->reference_count = 1;
+   #endif
+   list_store.count++;
+   return slot->list;
+}
+
+HostList *lookupHostList(HostAtom *array, unsigned length)
+{
+   assert(list_store.slots != NULL);
+   /* An entry that has never been made is not written here, as lookups may run
+    * concurrently. */
+   if(isSmallIntegerArray(array, length))
+   {
+      HostList *list = smallIntegerList(array[0].num);
+      return list->length == 0 ? NULL : list;
    }
+   return findSlot(array, length, hashHostList(array, length))->list;
 }
 
 #ifndef MINIMAL_GC
-/* Returns the bucket containing the passed list. */
-static Bucket *getBucket(HostList *list)
+/* The static variables holding constant lists. */
+static struct ConstantVariables {
+   HostList ***variables;
+   int capacity, count;
+} constants = {NULL, 0, 0};
+#endif
+
+HostList *makeConstantList(HostList **constant, HostAtom *array, unsigned length)
 {
-   assert(list_store != NULL);
-   Bucket *bucket = list_store[list->hash];
-   assert(bucket != NULL);
-   while(bucket != NULL)
+   #ifndef MINIMAL_GC
+   if(constants.count == constants.capacity)
    {
-      if(bucket->list == list) return bucket;
-      bucket = bucket->next;
-   } 
-   return NULL;
+      constants.capacity = constants.capacity == 0 ? 16 : 2 * constants.capacity;
+      constants.variables = reallocSafe(constants.variables,
+                                        constants.capacity * sizeof(HostList **),
+                                        "makeConstantList");
+   }
+   constants.variables[constants.count++] = constant;
+   #endif
+   *constant = makeHostList(array, length, true);
+   return *constant;
+}
+
+#ifndef MINIMAL_GC
+/* Returns the index of the slot containing the passed list. */
+static unsigned long getSlot(HostList *list)
+{
+   assert(list_store.slots != NULL);
+   unsigned long mask = list_store.capacity - 1;
+   unsigned long index = list->hash & mask;
+   while(list_store.slots[index].list != list)
+   {
+      /* The passed list is expected to exist in the host table. */
+      assert(list_store.slots[index].list != NULL);
+      index = (index + 1) & mask;
+   }
+   return index;
 }
 
 void addHostList(HostList *list)
 {
-   if(list == NULL) return;
-   Bucket *bucket = getBucket(list); 
-   /* The passed list is expected to exist in the host table. */
-   assert(bucket != NULL);
-   bucket->reference_count++;
+   if(list == NULL || isSmallIntegerList(list)) return;
+   ListStoreSlot *slot = &(list_store.slots[getSlot(list)]);
+   if(slot->reference_count < UINT_MAX) slot->reference_count++;
+}
+
+/* Empties the slot at hole. Entries later in the same run of occupied slots
+ * are shifted back into the hole when it lies on their probe path, so lookups
+ * never stop early and no tombstones are needed. */
+static void removeSlot(unsigned long hole)
+{
+   unsigned long mask = list_store.capacity - 1;
+   unsigned long index = (hole + 1) & mask;
+   while(list_store.slots[index].list != NULL)
+   {
+      unsigned long home = list_store.slots[index].hash & mask;
+      if(((index - home) & mask) >= ((index - hole) & mask))
+      {
+         list_store.slots[hole] = list_store.slots[index];
+         hole = index;
+      }
+      index = (index + 1) & mask;
+   }
+   list_store.slots[hole].list = NULL;
+   list_store.count--;
 }
 
 void removeHostList(HostList *list)
 {
-   if(list == NULL) return;
-   Bucket *bucket = getBucket(list); 
-   /* The passed list is expected to exist in the host table. */
-   assert(bucket != NULL);
-   bucket->reference_count--;
-   if(bucket->reference_count == 0)
+   if(list == NULL || isSmallIntegerList(list)) return;
+   unsigned long index = getSlot(list);
+   if(list_store.slots[index].reference_count == UINT_MAX) return;
+   list_store.slots[index].reference_count--;
+   if(list_store.slots[index].reference_count == 0)
    {
-      /* Delete the bucket. */
-      assert(list_store != NULL);
-      if(bucket->prev == NULL) list_store[list->hash] = bucket->next;
-      else bucket->prev->next = bucket->next;
-      if(bucket->next != NULL) bucket->next->prev = bucket->prev;
+      removeSlot(index);
       freeHostList(list);
-      free(bucket);
    }
 }
 #endif
@@ -229,7 +322,7 @@ HostLabel makeEmptyLabel(MarkType mark)
    return label;
 }
 
-HostLabel makeHostLabel(MarkType mark, unsigned short length, HostList *list)
+HostLabel makeHostLabel(MarkType mark, unsigned length, HostList *list)
 {
    HostLabel label = { .mark = mark, .length = length, .list = list };
    return label;
@@ -251,10 +344,10 @@ bool equalHostLabelsModMarks(HostLabel label1, HostLabel label2)
    return true;
 }
 
-bool equalHostLists(HostAtom *left_list, HostAtom *right_list, unsigned short left_length, unsigned short right_length)
+bool equalHostLists(HostAtom *left_list, HostAtom *right_list, unsigned left_length, unsigned right_length)
 { 
    if(left_length != right_length) return false;
-   unsigned short index;
+   unsigned index;
    for(index = 0; index < left_length; index++)
    {
       HostAtom left_atom = left_list[index];
@@ -265,7 +358,10 @@ bool equalHostLists(HostAtom *left_list, HostAtom *right_list, unsigned short le
       {
          if(left_atom.num != right_atom.num) return false;
       }
-      else if(strcmp(left_atom.str, right_atom.str) != 0) return false;
+      /* Lists evaluated in conditions may hold strings that are not interned,
+       * so different pointers do not imply different strings. */
+      else if(left_atom.str != right_atom.str &&
+              strcmp(left_atom.str, right_atom.str) != 0) return false;
    }
    return true;
 }
@@ -273,20 +369,13 @@ bool equalHostLists(HostAtom *left_list, HostAtom *right_list, unsigned short le
 HostList *copyHostList(HostList *list)
 {
    if(list == NULL) return NULL;
-   HostList *list_copy = NULL;
-   HostListItem *item = list->first;
-   while(item != NULL)
-   {
-      list_copy = appendHostAtom(list_copy, item->atom, false);
-      item = item->next;
-   }
-   return list_copy;
+   return allocateHostList(list->atoms, list->length, false);
 }
    
 void printHostLabel(HostLabel label, FILE *file) 
 {
    if(label.length == 0) fprintf(file, "empty");
-   else printHostList(label.list->first, file);
+   else printHostList(label.list, file);
    if(label.mark == RED) fprintf(file, " # red"); 
    if(label.mark == GREEN) fprintf(file, " # green");
    if(label.mark == BLUE) fprintf(file, " # blue");
@@ -294,48 +383,75 @@ void printHostLabel(HostLabel label, FILE *file)
    if(label.mark == DASHED) fprintf(file, " # dashed");
 }
 
-void printHostList(HostListItem *item, FILE *file)
+void printHostList(HostList *list, FILE *file)
 {
-   while(item != NULL)
+   if(list == NULL) return;
+   unsigned index;
+   for(index = 0; index < list->length; index++)
    {
-      if(item->atom.type == 'i') fprintf(file, "%d", item->atom.num);
-      else fprintf(file, "\"%s\"", item->atom.str);
-      if(item->next != NULL) fprintf(file, " : ");
-      item = item->next;
+      if(index > 0) fprintf(file, " : ");
+      if(list->atoms[index].type == 'i') fprintf(file, "%ld", list->atoms[index].num);
+      else fprintf(file, "\"%s\"", list->atoms[index].str);
    }
 }
 
 #ifndef MINIMAL_GC
-static void freeHostListItems(HostListItem *item)
-{
-   if(item == NULL) return;
-   if(item->atom.type == 's')
-      free(item->atom.str);
-   freeHostListItems(item->next);
-   free(item);
-}
-
 void freeHostList(HostList *list)
 {
    if(list == NULL) return;
-   freeHostListItems(list->first);
+   unsigned index;
+   for(index = 0; index < list->length; index++)
+      if(list->atoms[index].type == 's') removeString(list->atoms[index].str);
    free(list);
 }
 
-static void freeBuckets(Bucket *bucket)
+void freeHostListStore(void)
 {
-   if(bucket == NULL) return; 
-   freeHostList(bucket->list);
-   freeBuckets(bucket->next);
-   free(bucket);
+   if(list_store.slots == NULL) return;
+   unsigned long index;
+   for(index = 0; index < list_store.capacity; index++)
+      if(list_store.slots[index].list != NULL) freeHostList(list_store.slots[index].list);
+   free(list_store.slots);
+   list_store.slots = NULL;
+   free(list_store.small_integers);
+   list_store.small_integers = NULL;
+   list_store.capacity = 0;
+   list_store.count = 0;
+   int constant;
+   for(constant = 0; constant < constants.count; constant++)
+      *(constants.variables[constant]) = NULL;
+   free(constants.variables);
+   constants.variables = NULL;
+   constants.capacity = constants.count = 0;
 }
+#endif
 
-void freeHostListStore(void)
+#ifndef NDEBUG
+void printHostListStoreStats(FILE *file)
 {
-   if(list_store == NULL) return;
-   int index;
-   for(index = 0; index < LIST_TABLE_SIZE; index++)
-      freeBuckets(list_store[index]);
-   free(list_store);
+   if(list_store.slots == NULL) return;
+   unsigned long mask = list_store.capacity - 1;
+   unsigned long index, max_probe = 0, run = 0, max_run = 0;
+   unsigned long total_probe = 0;
+   for(index = 0; index < list_store.capacity; index++)
+   {
+      ListStoreSlot *slot = &(list_store.slots[index]);
+      if(slot->list == NULL)
+      {
+         run = 0;
+         continue;
+      }
+      if(++run > max_run) max_run = run;
+      /* The number of slots inspected by a successful lookup of this entry. */
+      unsigned long probe = ((index - (slot->hash & mask)) & mask) + 1;
+      total_probe += probe;
+      if(probe > max_probe) max_probe = probe;
+   }
+   fprintf(file, "List store: %lu lists in %lu slots (load factor %.2f).\n",
+           list_store.count, list_store.capacity,
+           (double) list_store.count / list_store.capacity);
+   fprintf(file, "List store probe lengths: mean %.2f, max %lu. Longest run: %lu.\n",
+           list_store.count == 0 ? 0.0 : (double) total_probe / list_store.count,
+           max_probe, max_run);
 }
 #endif
@@ -20,18 +20,38 @@
   ============
 
   Defines data types and operations host labels. Host lists are implemented 
-  as doubly-linked lists, and are stored in a hash table to avoid duplication
-  of lists that occur multiple times in a graph over the course of a program
-  execution.
+  as length-prefixed arrays of atoms stored in a single allocation, and are
+  stored in a hash table to avoid duplication of lists that occur multiple
+  times in a graph over the course of a program execution. String atoms are
+  interned in the string table, so two atoms are equal exactly when their
+  values are the same handle. The table uses
+  open addressing with linear probing. It starts small and doubles whenever
+  it becomes three-quarters full.
+
+  Lists holding a single integer in a small range, the most common labels,
+  bypass the table: each has a fixed entry in a block allocated with the
+  store, so making, referencing and removing such a list is a range check and
+  never allocates. The entries hold ordinary lists, so they are read and
+  compared like any other list.
+
+  Integer atoms are 64 bits wide. List lengths are 32 bits, which keeps a
+  host label in 13 bytes, and reference counts saturate at UINT_MAX: a list
+  or string referenced that often is never freed.
 
 /////////////////////////////////////////////////////////////////////////// */
 
 #ifndef INC_LABEL_H
 #define INC_LABEL_H
 
-#define LIST_TABLE_SIZE 100003
+#define LIST_STORE_INITIAL_SIZE 64
+/* The range of integers with a preallocated single-integer list. The block is
+ * zeroed by the allocator and an entry is only written when first used, so
+ * pages of unused entries are never touched. */
+#define SMALL_INTEGER_MIN (-1024)
+#define SMALL_INTEGER_MAX ((1 << 20) - 1)
 
 #include "common.h"
+#include "stringTable.h"
 
 #include <assert.h>
 #include <stdbool.h>
@@ -44,91 +64,115 @@ typedef enum {
   NONE = 0, RED, GREEN, BLUE, GREY, DASHED, ANY, ANYP
 } __attribute__ ((__packed__)) MarkType;
 
-// 11 bytes
+// 13 bytes
 typedef struct HostLabel {
    struct HostList *list;
-   unsigned short length;
+   unsigned length;
    MarkType mark;
 } __attribute__((packed)) HostLabel;
 
 extern struct HostLabel blank_label;
 
-// 24 bytes
-typedef struct HostList {
-   int hash;
-   struct HostListItem *first;
-   struct HostListItem *last;
-} HostList;
-
 // 16 bytes
 typedef struct HostAtom {
    char type; /* (i)nteger or (s)tring */ // TODO: ENUM
    union {
-      int num; // TODO: LONG
-      string str;
+      long num;
+      string str; /* A handle from the string table. */
    };
 } HostAtom;
 
-// 24 bytes
-typedef struct HostListItem {
-   struct HostAtom atom;
-   struct HostListItem *next;
-   struct HostListItem *prev;
-} HostListItem;
+// 8 bytes + 16 bytes per atom
+// The atoms are stored inline, so a list is a single allocation and its atoms
+// are indexed directly. Lists in the store are never empty: the empty list is
+// represented by a NULL pointer.
+typedef struct HostList {
+   unsigned hash;
+   unsigned length;
+   HostAtom atoms[];
+} HostList;
 
-// 24/32 bytes
-typedef struct Bucket {
+// 12/16 bytes
+// The full hash is kept in the slot so that most probes are rejected without
+// touching the list. A reference count that reaches UINT_MAX stays there, and
+// the list is kept until the store is freed.
+typedef struct ListStoreSlot {
    HostList *list;
+   unsigned hash;
    #ifndef MINIMAL_GC
    unsigned int reference_count;
    #endif
-   struct Bucket *next;
-   struct Bucket *prev;
-} Bucket;
+} ListStoreSlot;
+
+/* Hash table to store lists at runtime. Lists are added to the host table by
+ * making an array of HostAtoms representing the list and passing it to
+ * makeHostList. In this way, each specific list is allocated to heap exactly
+ * once and has a single point of reference. The capacity is a power of two and
+ * an empty slot has a NULL list. */
+typedef struct ListStore {
+   ListStoreSlot *slots;
+   unsigned long capacity, count;
+   /* The single-integer lists of the small integers, SMALL_INTEGER_LIST_SIZE
+    * bytes apart. An entry with length 0 has not been used yet. */
+   char *small_integers;
+} ListStore;
 
-/* Hash table to store lists at runtime. Collisions are handled by separate chaining
- * implemented by singly-linked lists ("buckets" as defined above). Lists are added
- * to the host table by making an array of HostAtoms representing the list and 
- * passing it to makeHostList. In this way, each specific list is allocated to heap
- * exactly once and has a single point of reference. */
-extern Bucket **list_store;
+#define SMALL_INTEGER_LIST_SIZE (sizeof(HostList) + sizeof(HostAtom))
+
+extern ListStore list_store;
 
 void initialiseHostListStore(void);
 
 /* If list hashing is enabled, makeHostList returns a pointer to the HostList represented 
  * by the passed array from the hash table (list_store). If not, the function returns a
- * pointer to a newly-allocated HostList. */
-HostList *makeHostList(HostAtom *array, unsigned short length, bool free_strings);
+ * pointer to a newly-allocated HostList. The strings in the array must be interned. */
+HostList *makeHostList(HostAtom *array, unsigned length, bool free_strings);
+
+/* Returns the list represented by the passed array if it is in the hash table,
+ * and NULL otherwise. Neither the table nor any reference count is changed. */
+HostList *lookupHostList(HostAtom *array, unsigned length);
+
+/* Generated code caches the lists of its constant labels in static variables,
+ * made on first use by this function from an array holding references to its
+ * strings. The reference to the list is held until the list store is freed,
+ * which resets the variable to NULL. */
+HostList *makeConstantList(HostList **constant, HostAtom *array, unsigned length);
 
 #ifndef MINIMAL_GC
 /* Expects the passed pointer to exist in the list hash table. Increments the reference
- * count of the list's bucket. */
+ * count of the list's slot. */
 void addHostList(HostList *list);
 /* Expects the passed pointer to exist in the list hash table. Decrements the reference
- * count of the list's bucket. Deletes/frees the list and its containing bucket if
- * the new reference count is 0. */
+ * count of the list's slot. Deletes/frees the list and empties its slot if the
+ * new reference count is 0. */
 void removeHostList(HostList *list);
 #endif
 
 /* Called at runtime to build labels. */
 HostLabel makeEmptyLabel(MarkType mark);
-HostLabel makeHostLabel(MarkType mark, unsigned short length, HostList *list);
+HostLabel makeHostLabel(MarkType mark, unsigned length, HostList *list);
 
 /* Used to determine whether a node or edge needs relabelling, and to evaluate
  * the edge predicate if a label argument is provided. */
 bool equalHostLabels(HostLabel label1, HostLabel label2);
 bool equalHostLabelsModMarks(HostLabel label1, HostLabel label2);
 /* Used to evaluate list comparison predicates. */
-bool equalHostLists(HostAtom *left_list, HostAtom *right_list, unsigned short left_length, unsigned short right_length);
+bool equalHostLists(HostAtom *left_list, HostAtom *right_list, unsigned left_length, unsigned right_length);
 /* Used when adding list assignments to the morphism and when copying the host graph. */
 HostList *copyHostList(HostList *list);
 
 void printHostLabel(HostLabel label, FILE *file);
-void printHostList(HostListItem *item, FILE *file);
+void printHostList(HostList *list, FILE *file);
 
 #ifndef MINIMAL_GC
 void freeHostList(HostList *list);
 void freeHostListStore(void);
 #endif
 
+#ifndef NDEBUG
+/* Prints the size and load factor of the list store along with the mean and
+ * maximum probe lengths of its entries and its longest run of occupied slots. */
+void printHostListStoreStats(FILE *file);
+#endif
+
 #endif /* INC_LABEL_H */
@@ -38,6 +38,7 @@ Morphism *makeMorphism(int nodes, int edges, int variables)
       morphism->assignment = NULL;
       morphism->assigned_variables = NULL;
    }
+   morphism->references = true;
    initialiseMorphism(morphism);
    return morphism;
 }
@@ -55,13 +56,15 @@ void initialiseMorphism(Morphism *morphism)
    {
       if(morphism->assignment[index].type == 's')
       {
-         free(morphism->assignment[index].str);
+         #ifndef MINIMAL_GC
+         if(morphism->references) removeString(morphism->assignment[index].str);
+         #endif
          morphism->assignment[index].str = NULL;
       }
       else if(morphism->assignment[index].type == 'l')
       {
          #ifndef MINIMAL_GC
-         removeHostList(morphism->assignment[index].list);
+         if(morphism->references) removeHostList(morphism->assignment[index].list);
          #endif
          morphism->assignment[index].list = NULL;
       }
@@ -107,7 +110,7 @@ int addListAssignment(Morphism *morphism, int id, HostList *list)
    {
       morphism->assignment[id].type = 'l';
       #ifndef MINIMAL_GC
-      addHostList(list);
+      if(morphism->references) addHostList(list);
       #endif
       morphism->assignment[id].list = list;
       pushVariableId(morphism, id);
@@ -120,7 +123,7 @@ int addListAssignment(Morphism *morphism, int id, HostList *list)
    return -1;
 }
 
-int addIntegerAssignment(Morphism *morphism, int id, int num)
+int addIntegerAssignment(Morphism *morphism, int id, long num)
 {
    assert(id < morphism->variables);
 
@@ -144,16 +147,42 @@ int addStringAssignment(Morphism *morphism, int id, string str)
    if(morphism->assignment[id].type == 'n') 
    {
       morphism->assignment[id].type = 's';
-      morphism->assignment[id].str = strdup(str);
+      #ifndef MINIMAL_GC
+      if(morphism->references) addString(str);
+      #endif
+      morphism->assignment[id].str = str;
       pushVariableId(morphism, id);
       return 1;
    }
    
-   if(strcmp(morphism->assignment[id].str, str) == 0) return 0;
+   if(morphism->assignment[id].str == str) return 0;
    
    return -1;
 }
 
+int addSubstringAssignment(Morphism *morphism, int id, const char *chars, unsigned length)
+{
+   assert(id < morphism->variables);
+   /* Interning the substring would modify the string table. */
+   assert(morphism->references);
+
+   /* An existing assignment is compared in place, so that a failed match
+    * does not add the substring to the string table. */
+   if(morphism->assignment[id].type != 'n')
+   {
+      string str = morphism->assignment[id].str;
+      if(length == stringLength(str) && memcmp(str, chars, length) == 0) return 0;
+      return -1;
+   }
+   string str = makeStringOfLength(chars, length);
+   int result = addStringAssignment(morphism, id, str);
+   #ifndef MINIMAL_GC
+   /* The assignment holds its own reference. */
+   removeString(str);
+   #endif
+   return result;
+}
+
 void removeNodeMap(Morphism *morphism, int left_index)
 {
    morphism->node_map[left_index].node = NULL;
@@ -176,13 +205,15 @@ void removeAssignments(Morphism *morphism, int number)
       int id = popVariableId(morphism);
       if(morphism->assignment[id].type == 's')
       {
-         free(morphism->assignment[id].str);
+         #ifndef MINIMAL_GC
+         if(morphism->references) removeString(morphism->assignment[id].str);
+         #endif
          morphism->assignment[id].str = NULL;
       }
       else if(morphism->assignment[id].type == 'l')
       {
          #ifndef MINIMAL_GC
-         removeHostList(morphism->assignment[id].list);
+         if(morphism->references) removeHostList(morphism->assignment[id].list);
          #endif
          morphism->assignment[id].list = NULL;
       }
@@ -213,7 +244,21 @@ Edge *lookupEdge(Morphism *morphism, int left_index)
    return morphism->edge_map[left_index].edge;
 }
 
-int getIntegerValue(Morphism *morphism, int id)
+bool nodeInMorphism(Morphism *morphism, Node *node)
+{
+   for(int index = 0; index < morphism->nodes; index++)
+      if(morphism->node_map[index].node == node) return true;
+   return false;
+}
+
+bool edgeInMorphism(Morphism *morphism, Edge *edge)
+{
+   for(int index = 0; index < morphism->edges; index++)
+      if(morphism->edge_map[index].edge == edge) return true;
+   return false;
+}
+
+long getIntegerValue(Morphism *morphism, int id)
 {
    assert(id < morphism->variables);
    return morphism->assignment[id].num;
@@ -231,43 +276,33 @@ Assignment getAssignment(Morphism *morphism, int id)
    return morphism->assignment[id];
 }
 
-int getAssignmentLength(Assignment assignment)
+unsigned getAssignmentLength(Assignment assignment)
 {
    if(assignment.type != 'l') return 1;
    if(assignment.list == NULL) return 0;
-   HostListItem *item = assignment.list->first;
-   int length = 0;
-   while(item != NULL) 
-   {
-      length++;
-      item = item->next;
-   }
-   return length;
+   return assignment.list->length;
 }
 
 /* If rule_string is a prefix of host_string, return the position in host_string
  * immediately after the end of rule_string. Otherwise return -1. */
-int isPrefix(const string rule_string, const string host_string)
+int isPrefix(const string rule_string, int rule_length, const string host_string,
+             int host_length)
 {
-   int length = strlen(rule_string);
-   int offset = strlen(host_string) - length;
-   if(offset < 0) return -1;
-   /* strncmp compares rule_string against the first strlen(rule_string) characters
-    * of host_string. */
-   if(!strncmp(host_string, rule_string, length)) return length;
+   if(host_length < rule_length) return -1;
+   /* Compare rule_string against the first rule_length characters of host_string. */
+   if(!memcmp(host_string, rule_string, rule_length)) return rule_length;
    else return -1;
 }
 
-/* If rule_string is a proper suffix of host_string, return the position in 
- * host_string immediately before the start of rule_string. If rule_string
- * equals host_string, return 0. Otherwise return -1. */
-int isSuffix(const string rule_string, const string host_string)
+/* If rule_string is a suffix of host_string, return the position in 
+ * host_string of the start of rule_string. Otherwise return -1. */
+int isSuffix(const string rule_string, int rule_length, const string host_string,
+             int host_length)
 {
-   int offset = strlen(host_string) - strlen(rule_string);
+   int offset = host_length - rule_length;
    if(offset < 0) return -1;
-   /* Compare the last strlen(rule_string) characters of str with rule_string. */
-   if(!strcmp(host_string + offset, rule_string)) 
-      return offset == 0 ? 0 : offset - 1;
+   /* Compare the last rule_length characters of host_string with rule_string. */
+   if(!memcmp(host_string + offset, rule_string, rule_length)) return offset;
    else return -1;
 }
 
@@ -280,10 +315,10 @@ void freeMorphism(Morphism *morphism)
    if(morphism->assignment != NULL)
    {
       int index;
-      for(index = 0; index < morphism->variables; index++)
+      for(index = 0; index < morphism->variables && morphism->references; index++)
       {
          if(morphism->assignment[index].type == 's') 
-            free(morphism->assignment[index].str);
+            removeString(morphism->assignment[index].str);
          if(morphism->assignment[index].type == 'l')
             removeHostList(morphism->assignment[index].list);
       }
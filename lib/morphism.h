@@ -42,7 +42,7 @@
 typedef struct Assignment {
    char type; /* (n)ot assigned, (i)nteger, (s)tring, (l)ist */
    union {
-      int num;
+      long num;
       string str;
       struct HostList *list;
    };
@@ -77,6 +77,11 @@ typedef struct Morphism {
    /* Stack to record the order of variable assignments during rule matching. */
    int *assigned_variables;
    int variable_index;
+
+   /* If false, assignments do not take references to their values. This is
+    * the case for the morphisms of parallel matching workers, which are only
+    * used while the host graph cannot change. */
+   bool references;
 } Morphism;
 
 /* Allocates memory for the morphism, and calls initialiseMorphism. */
@@ -104,8 +109,13 @@ void removeEdgeMap(Morphism *morphism, int left_index);
  * the passed value.
  * Returns 1 if the variable did not previously exist in the assignment. */
 int addListAssignment(Morphism *morphism, int id, HostList *list);
-int addIntegerAssignment(Morphism *morphism, int id, int num);
+int addIntegerAssignment(Morphism *morphism, int id, long num);
+/* The value must be an interned string. The assignment takes a reference to it. */
 int addStringAssignment(Morphism *morphism, int id, string value);
+/* As addStringAssignment, for the length characters at chars, which are not
+ * interned and need not be terminated, such as the part of a host string
+ * matched by a string variable. */
+int addSubstringAssignment(Morphism *morphism, int id, const char *chars, unsigned length);
 
 void removeAssignments(Morphism *morphism, int number);
 void pushVariableId(Morphism *morphism, int id);
@@ -114,27 +124,37 @@ int popVariableId(Morphism *morphism);
 Node *lookupNode(Morphism *morphism, int left_index);
 Edge *lookupEdge(Morphism *morphism, int left_index);
 
+/* Return true if the host item is the image of an item in the morphism. The
+ * matchers of parallel workers use these in place of the matched flags of
+ * host items, which are shared by all threads. */
+bool nodeInMorphism(Morphism *morphism, Node *node);
+bool edgeInMorphism(Morphism *morphism, Edge *edge);
+
 /* These functions expect to be passed the id of a variable of the appropriate type. */
-int getIntegerValue(Morphism *morphism, int id);
+long getIntegerValue(Morphism *morphism, int id);
 string getStringValue(Morphism *morphism, int id);
 Assignment getAssignment(Morphism *morphism, int id);
 /* Used in rule application to get the length of the value matched by a list variable. */
-int getAssignmentLength(Assignment assignment);
+unsigned getAssignmentLength(Assignment assignment);
 
 /* Used to test string constants in the rule against a host string. If 
  * rule_string is a prefix of the host_string, then the index of the host 
  * character directly after this prefix is returned, so that the caller knows
- * where in the host string to resume matching. 
- * For example, isPrefix("ab", "abcd") returns 2, the index of the first 
+ * where in the host string to resume matching. The lengths of both strings
+ * are passed by the caller: the rule string is a constant whose length is
+ * known at compile time, and the host string is the part of an interned
+ * string left to match.
+ * For example, isPrefix("ab", 2, "abcd", 4) returns 2, the index of the first 
  * character ('c') after the matched substring ("ab").
  * Returns -1 if it the rule string is not a prefix of the host string. */
-int isPrefix(const string rule_string, const string host_string);
-
-/* Analogous to isPrefix. Example: isSuffix("cd", "abcd") returns 1, the index
- * of the character ('b') directly preceding the matched suffix ("cd"). 
- * The exception is if rule_string equals host_string, in which case 0 is
- * returned. */
-int isSuffix(const string rule_string, const string host_string);
+int isPrefix(const string rule_string, int rule_length, const string host_string,
+             int host_length);
+
+/* Analogous to isPrefix. Example: isSuffix("cd", 2, "abcd", 4) returns 2, the
+ * index of the first character of the matched suffix, which is the number of
+ * host characters before it. */
+int isSuffix(const string rule_string, int rule_length, const string host_string,
+             int host_length);
 
 #ifndef MINIMAL_GC
 void freeMorphism(Morphism *morphism);
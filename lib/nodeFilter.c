@@ -0,0 +1,136 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "nodeFilter.h"
+
+#ifdef NODE_FILTER
+
+#include <string.h>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+static uint8_t saturate(long value)
+{
+   return value > 255 ? 255 : (uint8_t) value;
+}
+
+void updateNodeFilter(Graph *graph, Node *node)
+{
+   long index = node->index;
+   if(index >= graph->filter_size)
+   {
+      long size = graph->filter_size == 0 ? NODE_FILTER_INITIAL_SIZE : graph->filter_size;
+      while(size <= index) size *= 2;
+      graph->filter_marks = reallocSafe(graph->filter_marks, size, "updateNodeFilter");
+      graph->filter_indegrees = reallocSafe(graph->filter_indegrees, size, "updateNodeFilter");
+      graph->filter_outdegrees = reallocSafe(graph->filter_outdegrees, size, "updateNodeFilter");
+      // Positions not yet handed out hold no node.
+      long added = size - graph->filter_size;
+      memset(graph->filter_marks + graph->filter_size, 0, added);
+      memset(graph->filter_indegrees + graph->filter_size, 0, added);
+      memset(graph->filter_outdegrees + graph->filter_size, 0, added);
+      graph->filter_size = size;
+   }
+   graph->filter_marks[index] = nodeDeleted(node) ? 0 : (uint8_t) (1 << node->label.mark);
+   graph->filter_indegrees[index] = saturate(node->indegree);
+   graph->filter_outdegrees[index] = saturate(node->outdegree);
+}
+
+static bool passesFilter(Graph *graph, long index, const NodeFilter *filter)
+{
+   uint8_t indegree = graph->filter_indegrees[index],
+           outdegree = graph->filter_outdegrees[index];
+   return (graph->filter_marks[index] & filter->marks) &&
+          indegree >= filter->indegree && outdegree >= filter->outdegree &&
+          saturate(indegree + outdegree) >= filter->degree;
+}
+
+long nextNodeCandidate(Graph *graph, long start, long end, const NodeFilter *filter)
+{
+   long index = start;
+   const uint8_t *marks = graph->filter_marks, *indegrees = graph->filter_indegrees,
+                 *outdegrees = graph->filter_outdegrees;
+   /* The comparisons are unsigned: x >= y exactly when max(x, y) == x. */
+   #if defined(__AVX2__)
+   const __m256i mark_mask = _mm256_set1_epi8((char) filter->marks),
+                 least_in = _mm256_set1_epi8((char) filter->indegree),
+                 least_out = _mm256_set1_epi8((char) filter->outdegree),
+                 least_degree = _mm256_set1_epi8((char) filter->degree),
+                 zero = _mm256_setzero_si256();
+   for(; index + 32 <= end; index += 32)
+   {
+      __m256i mark = _mm256_loadu_si256((const __m256i *) (marks + index)),
+              in = _mm256_loadu_si256((const __m256i *) (indegrees + index)),
+              out = _mm256_loadu_si256((const __m256i *) (outdegrees + index));
+      __m256i degree = _mm256_adds_epu8(in, out);
+      __m256i rejected = _mm256_cmpeq_epi8(_mm256_and_si256(mark, mark_mask), zero);
+      __m256i passed = _mm256_and_si256(
+         _mm256_cmpeq_epi8(_mm256_max_epu8(in, least_in), in),
+         _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(out, least_out), out),
+                          _mm256_cmpeq_epi8(_mm256_max_epu8(degree, least_degree), degree)));
+      unsigned bits = (unsigned) _mm256_movemask_epi8(_mm256_andnot_si256(rejected, passed));
+      if(bits != 0) return index + __builtin_ctz(bits);
+   }
+   #elif defined(__SSE2__)
+   const __m128i mark_mask = _mm_set1_epi8((char) filter->marks),
+                 least_in = _mm_set1_epi8((char) filter->indegree),
+                 least_out = _mm_set1_epi8((char) filter->outdegree),
+                 least_degree = _mm_set1_epi8((char) filter->degree),
+                 zero = _mm_setzero_si128();
+   for(; index + 16 <= end; index += 16)
+   {
+      __m128i mark = _mm_loadu_si128((const __m128i *) (marks + index)),
+              in = _mm_loadu_si128((const __m128i *) (indegrees + index)),
+              out = _mm_loadu_si128((const __m128i *) (outdegrees + index));
+      __m128i degree = _mm_adds_epu8(in, out);
+      __m128i rejected = _mm_cmpeq_epi8(_mm_and_si128(mark, mark_mask), zero);
+      __m128i passed = _mm_and_si128(
+         _mm_cmpeq_epi8(_mm_max_epu8(in, least_in), in),
+         _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(out, least_out), out),
+                       _mm_cmpeq_epi8(_mm_max_epu8(degree, least_degree), degree)));
+      unsigned bits = (unsigned) _mm_movemask_epi8(_mm_andnot_si128(rejected, passed));
+      if(bits != 0) return index + __builtin_ctz(bits);
+   }
+   #elif defined(__ARM_NEON) && defined(__aarch64__)
+   const uint8x16_t mark_mask = vdupq_n_u8(filter->marks),
+                    least_in = vdupq_n_u8(filter->indegree),
+                    least_out = vdupq_n_u8(filter->outdegree),
+                    least_degree = vdupq_n_u8(filter->degree);
+   for(; index + 16 <= end; index += 16)
+   {
+      uint8x16_t mark = vld1q_u8(marks + index), in = vld1q_u8(indegrees + index),
+                 out = vld1q_u8(outdegrees + index);
+      uint8x16_t passed = vandq_u8(vtstq_u8(mark, mark_mask),
+                                   vandq_u8(vcgeq_u8(in, least_in),
+                                            vandq_u8(vcgeq_u8(out, least_out),
+                                                     vcgeq_u8(vqaddq_u8(in, out), least_degree))));
+      // NEON has no movemask, so the block is searched once it holds a candidate.
+      if(vmaxvq_u8(passed) != 0) break;
+   }
+   #else
+   UNUSED(marks);
+   UNUSED(indegrees);
+   UNUSED(outdegrees);
+   #endif
+   for(; index < end; index++)
+      if(passesFilter(graph, index, filter)) return index;
+   return end;
+}
+
+#endif /* NODE_FILTER */
@@ -0,0 +1,67 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ==================
+  Node Filter Module
+  ==================
+
+  Candidate filtering for the node array scans of programs compiled without
+  node lists. With NODE_FILTER defined, the graph keeps three byte arrays
+  parallel to its node array: the mark of each node as a bit (0 for deleted
+  nodes and free positions), and its indegree and outdegree, saturated at
+  255. The graph functions update them together with the nodes.
+
+  A scan for a rule node asks for the next position whose mark is one the
+  rule node can match and whose degrees are at least those the rule node
+  needs, and only builds the host nodes at the positions found. The arrays
+  are compared 32 or 16 positions at a time with AVX2, SSE2 or NEON
+  instructions where the compiler targets them, and one at a time otherwise.
+  The filter only discards nodes that cannot match, so the matcher still
+  checks every candidate, including the flags and exact degrees the filter
+  does not hold.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_NODE_FILTER_H
+#define INC_NODE_FILTER_H
+
+#include "common.h"
+#include "graph.h"
+
+#include <stdint.h>
+
+#ifdef NODE_FILTER
+#define NODE_FILTER_INITIAL_SIZE 256
+
+/* The requirements of a rule node. marks has bit m set if the rule node
+ * matches mark m. indegree, outdegree and degree are the least indegree,
+ * outdegree and sum of the two of a candidate, at most 255. */
+typedef struct NodeFilter {
+   uint8_t marks, indegree, outdegree, degree;
+} NodeFilter;
+
+/* Writes the current mark and degrees of the node to the filter arrays of the
+ * graph, growing them if the node is past their end. */
+void updateNodeFilter(Graph *graph, Node *node);
+
+/* Returns the first position from start to end - 1 of the node array whose
+ * node passes the filter, or end if there is none. */
+long nextNodeCandidate(Graph *graph, long start, long end, const NodeFilter *filter);
+
+#endif /* NODE_FILTER */
+
+#endif /* INC_NODE_FILTER_H */
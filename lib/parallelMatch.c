@@ -0,0 +1,154 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "parallelMatch.h"
+
+#ifdef PARALLEL_MATCHING
+
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+
+atomic_long parallel_match_position = LONG_MAX;
+
+/* The search in progress. The fields other than the atomics are written by
+ * the calling thread under the lock before the workers are woken. */
+static struct SearchJob {
+   CandidateSearch search;
+   long candidates;
+   int nodes, edges, variables;
+   atomic_long next_block;
+} job;
+
+static struct ThreadPool {
+   pthread_mutex_t lock;
+   pthread_cond_t start, done;
+   bool initialised;
+   int workers;
+   /* Incremented for each search so that the workers can tell a new one. */
+   unsigned long generation;
+   /* The number of workers yet to finish the current search. */
+   int running;
+} pool = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+          PTHREAD_COND_INITIALIZER, false, 0, 0, 0};
+
+/* Publishes a match at the passed position unless one has been found below
+ * it. */
+static void publishMatch(long position)
+{
+   long found = atomic_load(&parallel_match_position);
+   while(position < found &&
+         !atomic_compare_exchange_weak(&parallel_match_position, &found, position));
+}
+
+/* Freed by hand because freeMorphism is not available with MINIMAL_GC. The
+ * morphism holds no references. */
+static void freeWorkerMorphism(Morphism *morphism)
+{
+   if(morphism->node_map != NULL) free(morphism->node_map);
+   if(morphism->edge_map != NULL) free(morphism->edge_map);
+   if(morphism->assignment != NULL) free(morphism->assignment);
+   if(morphism->assigned_variables != NULL) free(morphism->assigned_variables);
+   free(morphism);
+}
+
+static void runSearch(void)
+{
+   Morphism *morphism = makeMorphism(job.nodes, job.edges, job.variables);
+   morphism->references = false;
+   while(true)
+   {
+      long start = atomic_fetch_add(&job.next_block, PARALLEL_BLOCK_SIZE);
+      if(start >= job.candidates || parallelMatchFound(start)) break;
+      long end = start + PARALLEL_BLOCK_SIZE;
+      if(end > job.candidates) end = job.candidates;
+      long position;
+      if(job.search(morphism, start, end, &position))
+      {
+         publishMatch(position);
+         break;
+      }
+   }
+   freeWorkerMorphism(morphism);
+}
+
+static void *runWorker(void *argument)
+{
+   unsigned long generation = 0;
+   while(true)
+   {
+      pthread_mutex_lock(&pool.lock);
+      while(pool.generation == generation) pthread_cond_wait(&pool.start, &pool.lock);
+      generation = pool.generation;
+      pthread_mutex_unlock(&pool.lock);
+
+      runSearch();
+
+      pthread_mutex_lock(&pool.lock);
+      if(--pool.running == 0) pthread_cond_signal(&pool.done);
+      pthread_mutex_unlock(&pool.lock);
+   }
+   return NULL;
+}
+
+/* Creates one worker per further online processor. If a thread cannot be
+ * created, the searches run with the workers created so far. */
+static void initialisePool(void)
+{
+   pool.initialised = true;
+   long processors = sysconf(_SC_NPROCESSORS_ONLN);
+   int workers = processors > 1 ? (int) processors - 1 : 0;
+   if(workers > PARALLEL_MAX_THREADS - 1) workers = PARALLEL_MAX_THREADS - 1;
+   for(int index = 0; index < workers; index++)
+   {
+      pthread_t thread;
+      if(pthread_create(&thread, NULL, runWorker, NULL) != 0)
+      {
+         print_to_log("Warning (parallelSearch): could only create %d of %d "
+                      "matching threads.\n", index, workers);
+         break;
+      }
+      pthread_detach(thread);
+      pool.workers++;
+   }
+}
+
+long parallelSearch(CandidateSearch search, long candidates, int nodes, int edges,
+                    int variables)
+{
+   if(!pool.initialised) initialisePool();
+   pthread_mutex_lock(&pool.lock);
+   job.search = search;
+   job.candidates = candidates;
+   job.nodes = nodes;
+   job.edges = edges;
+   job.variables = variables;
+   atomic_store(&job.next_block, 0);
+   atomic_store(&parallel_match_position, LONG_MAX);
+   pool.running = pool.workers;
+   pool.generation++;
+   pthread_cond_broadcast(&pool.start);
+   pthread_mutex_unlock(&pool.lock);
+
+   runSearch();
+
+   pthread_mutex_lock(&pool.lock);
+   while(pool.running > 0) pthread_cond_wait(&pool.done, &pool.lock);
+   pthread_mutex_unlock(&pool.lock);
+   long position = atomic_load(&parallel_match_position);
+   return position == LONG_MAX ? -1 : position;
+}
+
+#endif /* PARALLEL_MATCHING */
@@ -0,0 +1,80 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ========================
+  Parallel Matching Module
+  ========================
+
+  Runs the first searchplan operation of a rule over the host node array on
+  several threads. The candidate positions are split into blocks which the
+  threads claim in order. Each thread matches with its own morphism and must
+  neither write to the host graph nor take references to host values, so the
+  generated worker matchers test membership of their morphism instead of the
+  matched flags of host items.
+
+  The lowest position at which a thread completes a match is published, and
+  the threads stop searching above it. Every position below it has been tried
+  when the search returns, so it is the position at which the sequential
+  matcher would succeed. The caller rebuilds the match from that position
+  sequentially, which keeps the results of a program independent of the
+  number of threads.
+
+  The threads are created on first use and kept for the rest of the run. The
+  calling thread takes part in every search. Only compiled with
+  PARALLEL_MATCHING.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_PARALLEL_MATCH_H
+#define INC_PARALLEL_MATCH_H
+
+#ifdef PARALLEL_MATCHING
+
+#include "common.h"
+#include "morphism.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/* Searches with fewer candidate positions than this run sequentially. */
+#define PARALLEL_MIN_CANDIDATES 4096
+#define PARALLEL_BLOCK_SIZE 512
+/* Including the calling thread. */
+#define PARALLEL_MAX_THREADS 8
+
+/* Tries the candidate positions from start up to end in order. On success,
+ * stores the position of the match in *position and returns true. */
+typedef bool (*CandidateSearch)(Morphism *morphism, long start, long end, long *position);
+
+/* Runs the search over the positions from 0 up to candidates, passing each
+ * thread a morphism of the given size. Returns the lowest position at which
+ * the search succeeds, or -1 if it fails everywhere. */
+long parallelSearch(CandidateSearch search, long candidates, int nodes, int edges,
+                    int variables);
+
+extern atomic_long parallel_match_position;
+
+/* True if a match has been found at or below the passed position, in which
+ * case a worker need not try it. */
+static inline bool parallelMatchFound(long position)
+{
+   return position >= atomic_load_explicit(&parallel_match_position, memory_order_relaxed);
+}
+
+#endif /* PARALLEL_MATCHING */
+
+#endif /* INC_PARALLEL_MATCH_H */
@@ -0,0 +1,103 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "profile.h"
+#include "graphStacks.h"
+
+#include <string.h>
+
+typedef struct RestorePointProfile {
+   unsigned long undo_calls, undone, discard_calls, discarded;
+} RestorePointProfile;
+
+/* Indexed by the number of the restore point in the generated code, and grown
+ * on demand. */
+static RestorePointProfile *restore_points = NULL;
+static int restore_point_count = 0;
+
+static RestorePointProfile *restorePointProfile(int id)
+{
+   if(id >= restore_point_count)
+   {
+      int count = restore_point_count == 0 ? 16 : restore_point_count;
+      while(count <= id) count *= 2;
+      restore_points = reallocSafe(restore_points, count * sizeof(RestorePointProfile),
+                                   "restorePointProfile");
+      memset(restore_points + restore_point_count, 0,
+             (count - restore_point_count) * sizeof(RestorePointProfile));
+      restore_point_count = count;
+   }
+   return &restore_points[id];
+}
+
+void profileUndo(int id, long restore_point)
+{
+   RestorePointProfile *profile = restorePointProfile(id);
+   profile->undo_calls++;
+   profile->undone += graphChangeStackSize() - restore_point;
+}
+
+void profileDiscard(int id, long restore_point)
+{
+   RestorePointProfile *profile = restorePointProfile(id);
+   profile->discard_calls++;
+   profile->discarded += graphChangeStackSize() - restore_point;
+}
+
+static bool isNodeOperation(char type)
+{
+   return type == 'n' || type == 'r' || type == 'i' || type == 'o' || type == 'b';
+}
+
+void writeProfile(string file_name, RuleProfile **rules)
+{
+   FILE *file = fopen(file_name, "w");
+   if(file == NULL)
+   {
+      perror(file_name);
+      return;
+   }
+   for(int rule = 0; rules[rule] != NULL; rule++)
+   {
+      RuleProfile *profile = rules[rule];
+      fprintf(file, "rule\t%s\t%lu\t%lu\t%.9f\t%lu\t%.9f\n", profile->name,
+              profile->match_calls, profile->matches, profile->match_time / 1e9,
+              profile->apply_calls, profile->apply_time / 1e9);
+   }
+   for(int rule = 0; rules[rule] != NULL; rule++)
+   {
+      RuleProfile *profile = rules[rule];
+      for(int position = 0; profile->operations[position] != '\0'; position++)
+      {
+         char type = profile->operations[position];
+         int item = profile->operation_items[position];
+         bool node = isNodeOperation(type);
+         fprintf(file, "operation\t%s\t%d\t%c\t%c%d\t%lu\n", profile->name, position, type,
+                 node ? 'n' : 'e', item,
+                 node ? profile->node_candidates[item] : profile->edge_candidates[item]);
+      }
+   }
+   for(int id = 0; id < restore_point_count; id++)
+   {
+      RestorePointProfile *profile = &restore_points[id];
+      if(profile->undo_calls == 0 && profile->discard_calls == 0) continue;
+      fprintf(file, "restore_point\t%d\t%lu\t%lu\t%lu\t%lu\n", id, profile->undo_calls,
+              profile->undone, profile->discard_calls, profile->discarded);
+   }
+   fclose(file);
+   free(restore_points);
+   restore_points = NULL;
+   restore_point_count = 0;
+}
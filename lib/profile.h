@@ -0,0 +1,106 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ==============
+  Profile Module
+  ==============
+
+  Counters and timers of programs compiled with -P. Each generated rule
+  module defines a RuleProfile. The calls of its matching and application
+  functions in the generated main function are timed, and its matchers count
+  the host items they try for each LHS item. The generated calls of
+  undoChanges and discardChanges record how many changes they roll back or
+  drop at each restore point.
+
+  writeProfile prints the counts in gp2.profile as lines of tab-separated
+  fields. The first field names the kind of the line:
+
+  rule <name> <match calls> <matches> <match seconds> <apply calls> <apply seconds>
+  operation <rule> <position> <type> <item> <candidates>
+  restore_point <id> <undo calls> <undone changes> <discard calls> <discarded changes>
+
+  The operations are those of the rule's searchplan, in the order and with the
+  types described in the compiler's searchplan module. The item is n<index> or
+  e<index> for the LHS node or edge matched by the operation. Candidates are
+  counted by LHS item, so for rules with alternative searchplans the lines of
+  the first plan also count the candidates of the others. Candidates tried by
+  parallel workers are not counted. The matching time of a batch application
+  (-b) includes its application.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_PROFILE_H
+#define INC_PROFILE_H
+
+#include "common.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef struct RuleProfile {
+   string name;
+   /* The types of the searchplan operations, and the LHS item of each. */
+   string operations;
+   const int *operation_items;
+   /* The number of host items tried for each LHS node and edge. */
+   unsigned long *node_candidates, *edge_candidates;
+   unsigned long match_calls, matches, apply_calls;
+   uint64_t match_time, apply_time, start;
+} RuleProfile;
+
+/* Nanoseconds from an arbitrary origin. */
+static inline uint64_t profileClock(void)
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+static inline void profileStart(RuleProfile *profile)
+{
+   profile->start = profileClock();
+}
+
+static inline bool profileMatched(RuleProfile *profile, bool matched)
+{
+   profile->match_time += profileClock() - profile->start;
+   profile->match_calls++;
+   if(matched) profile->matches++;
+   return matched;
+}
+
+static inline void profileApplied(RuleProfile *profile)
+{
+   profile->apply_time += profileClock() - profile->start;
+   profile->apply_calls++;
+}
+
+/* An expression with the value of the passed matching call, timed as a call
+ * of the rule's matcher. */
+#define profiledMatch(profile, call) (profileStart(profile), profileMatched(profile, call))
+
+/* Record the changes above the restore point with the passed number before
+ * they are undone or discarded. */
+void profileUndo(int id, long restore_point);
+void profileDiscard(int id, long restore_point);
+
+/* Writes the profiles of the rules in the NULL-terminated array and of the
+ * restore points to the named file. */
+void writeProfile(string file_name, RuleProfile **rules);
+
+#endif /* INC_PROFILE_H */
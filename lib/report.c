@@ -0,0 +1,178 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "report.h"
+#include "graphStacks.h"
+#include "label.h"
+
+#include <sys/resource.h>
+#include <time.h>
+
+static string phase_names[PHASE_COUNT] = {"startup", "parsing", "execution", "output",
+                                          "teardown"};
+
+static struct {
+   /* The phase being timed, or -1, and the clocks at its start. */
+   int current;
+   double wall_start, cpu_start;
+   double wall[PHASE_COUNT], cpu[PHASE_COUNT];
+} phases = {-1, 0, 0, {0}, {0}};
+
+typedef struct ArrayFigures {
+   string name;
+   long capacity, used, live, bytes;
+} ArrayFigures;
+
+/* node_array, edge_array, node_lists, adjacency, edge_lists, edge_arrays */
+#define MAX_ARRAYS 6
+
+static struct {
+   bool recorded;
+   int array_count;
+   ArrayFigures arrays[MAX_ARRAYS];
+   long list_store_slots, list_store_lists, list_store_bytes;
+   long change_stack_high_water;
+} memory = {false, 0};
+
+static double clockSeconds(clockid_t clock)
+{
+   struct timespec now;
+   clock_gettime(clock, &now);
+   return (double) now.tv_sec + now.tv_nsec / 1e9;
+}
+
+static void endPhase(void)
+{
+   if(phases.current < 0) return;
+   phases.wall[phases.current] += clockSeconds(CLOCK_MONOTONIC) - phases.wall_start;
+   phases.cpu[phases.current] += clockSeconds(CLOCK_PROCESS_CPUTIME_ID) - phases.cpu_start;
+   phases.current = -1;
+}
+
+void stopPhase(void)
+{
+   endPhase();
+}
+
+void startPhase(Phase phase)
+{
+   endPhase();
+   phases.current = phase;
+   phases.wall_start = clockSeconds(CLOCK_MONOTONIC);
+   phases.cpu_start = clockSeconds(CLOCK_PROCESS_CPUTIME_ID);
+}
+
+static void addArray(string name, BigArray *array, long live)
+{
+   ArrayFigures *figures = &memory.arrays[memory.array_count++];
+   figures->name = name;
+   figures->capacity = array->capacity;
+   figures->used = array->size;
+   figures->live = live;
+   figures->bytes = (long) array->capacity * array->elem_sz;
+}
+
+void recordMemory(Graph *graph)
+{
+   memory.array_count = 0;
+   if(graph != NULL)
+   {
+      addArray("node_array", &(graph->_nodearray), graph->number_of_nodes);
+      addArray("edge_array", &(graph->_edgearray), graph->number_of_edges);
+      #ifndef NO_NODE_LIST
+      addArray("node_lists", &(graph->_nodelistarray), graph->number_of_nodes);
+      #endif
+      #ifdef COMPACT_NODES
+      addArray("adjacency", &(graph->_adjacencyarray), graph->number_of_nodes);
+      #endif
+      /* Each edge is in the outgoing edges of its source and the incoming
+       * edges of its target. */
+      #if defined(COMPACT_NODES) && !defined(ARRAY_ADJACENCY)
+      addArray("edge_lists", &(graph->_edgelistarray), 2L * graph->number_of_edges);
+      #else
+      ArrayFigures *total = &memory.arrays[memory.array_count++];
+      #ifdef ARRAY_ADJACENCY
+      total->name = "edge_arrays";
+      #else
+      total->name = "edge_lists";
+      #endif
+      total->capacity = total->used = total->bytes = 0;
+      total->live = 2L * graph->number_of_edges;
+      for(long index = 0; index < graph->_nodearray.size; index++)
+      {
+         Node *node = getBigArrayValue(&(graph->_nodearray), index);
+         if(nodeDeleted(node)) continue;
+         #ifdef ARRAY_ADJACENCY
+         for(int mark = 0; mark < 6; mark++)
+            for(int orientation = 0; orientation < 2; orientation++)
+               for(int loop = 0; loop < 2; loop++)
+               {
+                  EdgeArray *array = nodeEdgeArray(node, mark, orientation, loop);
+                  total->capacity += array->capacity;
+                  total->used += array->size;
+                  total->bytes += (long) array->capacity * sizeof(Edge *);
+               }
+         #else
+         total->capacity += node->_edgelistarray.capacity;
+         total->used += node->_edgelistarray.size;
+         total->bytes += (long) node->_edgelistarray.capacity * node->_edgelistarray.elem_sz;
+         #endif
+      }
+      #endif
+   }
+   memory.list_store_slots = list_store.capacity;
+   memory.list_store_lists = list_store.count;
+   memory.list_store_bytes = (long) list_store.capacity * sizeof(ListStoreSlot);
+   for(unsigned index = 0; index < list_store.capacity; index++)
+   {
+      HostList *list = list_store.slots[index].list;
+      if(list != NULL) memory.list_store_bytes += sizeof(HostList) + list->length * sizeof(HostAtom);
+   }
+   memory.change_stack_high_water = graphChangeStackHighWater();
+   memory.recorded = true;
+}
+
+bool writeReport(string file_name)
+{
+   endPhase();
+   FILE *report = fopen(file_name, "w");
+   if(report == NULL)
+   {
+      perror(file_name);
+      return false;
+   }
+   for(int phase = 0; phase < PHASE_COUNT; phase++)
+      fprintf(report, "phase\t%s\t%.9f\t%.9f\n", phase_names[phase], phases.wall[phase],
+              phases.cpu[phase]);
+   if(memory.recorded)
+   {
+      for(int array = 0; array < memory.array_count; array++)
+      {
+         ArrayFigures *figures = &memory.arrays[array];
+         fprintf(report, "array\t%s\t%ld\t%ld\t%ld\t%ld\n", figures->name, figures->capacity,
+                 figures->used, figures->live, figures->bytes);
+      }
+      fprintf(report, "list_store\t%ld\t%ld\t%ld\n", memory.list_store_slots,
+              memory.list_store_lists, memory.list_store_bytes);
+      fprintf(report, "change_stack\t%ld\t%ld\n", memory.change_stack_high_water,
+              memory.change_stack_high_water * (long) arenaSize(sizeof(GraphChange)));
+   }
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   /* ru_maxrss is in kilobytes on Linux. */
+   fprintf(report, "peak_rss\t%ld\n", usage.ru_maxrss);
+   fclose(report);
+   return true;
+}
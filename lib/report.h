@@ -0,0 +1,79 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  =============
+  Report Module
+  =============
+
+  The run report of a compiled program, written to gp2.report. The generated
+  main function splits the run into phases: startup (setting up the string
+  table and the list store), parsing (building the host graph), execution,
+  output (writing the output graph) and teardown (garbage collection). The
+  memory used by the host graph and the list store is recorded before the
+  teardown.
+
+  The report has one line of tab-separated fields per figure. The first field
+  names the kind of the line:
+
+  phase <name> <wall seconds> <CPU seconds>
+  array <name> <capacity> <used> <live> <bytes>
+  list_store <slots> <lists> <bytes>
+  change_stack <high-water records> <high-water bytes>
+  peak_rss <kilobytes>
+
+  The arrays are the internal arrays of the host graph. Their used slots
+  include the holes left by removed items, and live is the number of items
+  in them. The arrays of edge list entries (edge_lists) and of adjacency
+  arrays (edge_arrays) are summed over the nodes if each node has its own.
+  Wall-clock times are monotonic. Times and memory of a run that fails are
+  reported up to the failure.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_REPORT_H
+#define INC_REPORT_H
+
+#include "common.h"
+#include "graph.h"
+
+#include <stdbool.h>
+
+typedef enum {
+   STARTUP_PHASE = 0,
+   PARSING_PHASE,
+   EXECUTION_PHASE,
+   OUTPUT_PHASE,
+   TEARDOWN_PHASE,
+   PHASE_COUNT
+} Phase;
+
+/* Ends the current phase, if any, and starts the passed one. */
+void startPhase(Phase phase);
+
+/* Ends the current phase, if any, without starting another. A process forked
+ * outside a phase can go on timing phases in its own CPU clock. */
+void stopPhase(void);
+
+/* Records the memory figures of the graph, the list store and the graph change
+ * stack. */
+void recordMemory(Graph *graph);
+
+/* Ends the current phase and writes the report to the named file. Returns
+ * false if the file cannot be written. */
+bool writeReport(string file_name);
+
+#endif /* INC_REPORT_H */
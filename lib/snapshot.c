@@ -0,0 +1,465 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* ================
+ * Snapshot Reading
+ * ================ */
+
+bool isGraphSnapshot(string file_name)
+{
+   FILE *file = fopen(file_name, "rb");
+   if(file == NULL) return false;
+   char magic[8];
+   bool result = fread(magic, 1, 8, file) == 8 &&
+                 memcmp(magic, SNAPSHOT_MAGIC, 8) == 0;
+   fclose(file);
+   return result;
+}
+
+/* Pointers to the sections of a mapped snapshot. */
+typedef struct Snapshot {
+   const SnapshotHeader *header;
+   const SnapshotLabel *labels;
+   const SnapshotAtom *atoms;
+   const SnapshotNode *nodes;
+   const SnapshotEdge *edges;
+   const uint64_t *roots;
+   const char *strings;
+   uint32_t max_length; /* Length of the longest list. */
+} Snapshot;
+
+/* Moves offset past a section of count records of the passed size. Returns
+ * false if the section runs past the end of the file. */
+static bool skipSection(uint64_t *offset, uint64_t count, size_t record_size, size_t size)
+{
+   if(count > (size - *offset) / record_size) return false;
+   *offset += count * record_size;
+   return true;
+}
+
+/* Sets up the section pointers of the snapshot and checks every record
+ * against the header, so that building the graph cannot fail half way. */
+static bool validateSnapshot(Snapshot *snapshot, const char *data, size_t size)
+{
+   if(size < sizeof(SnapshotHeader))
+   {
+      print_to_log("Error (loadGraphSnapshot): file too short.\n");
+      return false;
+   }
+   const SnapshotHeader *header = (const SnapshotHeader *) data;
+   if(memcmp(header->magic, SNAPSHOT_MAGIC, 8) != 0 ||
+      header->version != SNAPSHOT_VERSION)
+   {
+      print_to_log("Error (loadGraphSnapshot): unknown format or version.\n");
+      return false;
+   }
+   /* The counts are checked against the file size before they are
+    * multiplied, so the offsets cannot overflow. */
+   uint64_t offset = sizeof(SnapshotHeader);
+   uint64_t labels = offset, atoms = 0, nodes = 0, edges = 0, roots = 0, strings = 0;
+   bool fits = skipSection(&offset, header->label_count, sizeof(SnapshotLabel), size);
+   atoms = offset;
+   fits = fits && skipSection(&offset, header->atom_count, sizeof(SnapshotAtom), size);
+   nodes = offset;
+   fits = fits && skipSection(&offset, header->node_count, sizeof(SnapshotNode), size);
+   edges = offset;
+   fits = fits && skipSection(&offset, header->edge_count, sizeof(SnapshotEdge), size);
+   roots = offset;
+   fits = fits && skipSection(&offset, header->root_count, sizeof(uint64_t), size);
+   strings = offset;
+   if(!fits || header->string_bytes != size - offset)
+   {
+      print_to_log("Error (loadGraphSnapshot): section sizes do not match "
+                   "the file size.\n");
+      return false;
+   }
+   snapshot->header = header;
+   snapshot->labels = (const SnapshotLabel *) (data + labels);
+   snapshot->atoms = (const SnapshotAtom *) (data + atoms);
+   snapshot->nodes = (const SnapshotNode *) (data + nodes);
+   snapshot->edges = (const SnapshotEdge *) (data + edges);
+   snapshot->roots = (const uint64_t *) (data + roots);
+   snapshot->strings = data + strings;
+
+   /* Every string offset is checked to be in the pool, and the pool is
+    * NUL-terminated, so every string atom ends inside the file. */
+   if(header->string_bytes > 0 && snapshot->strings[header->string_bytes - 1] != '\0')
+   {
+      print_to_log("Error (loadGraphSnapshot): unterminated string pool.\n");
+      return false;
+   }
+   uint64_t index;
+   snapshot->max_length = 0;
+   for(index = 0; index < header->atom_count; index++)
+   {
+      SnapshotAtom atom = snapshot->atoms[index];
+      if(atom.type == 'i') continue;
+      if(atom.type != 's' || atom.value < 0 ||
+         (uint64_t) atom.value >= header->string_bytes)
+      {
+         print_to_log("Error (loadGraphSnapshot): bad atom %" PRIu64 ".\n", index);
+         return false;
+      }
+   }
+   for(index = 0; index < header->label_count; index++)
+   {
+      SnapshotLabel label = snapshot->labels[index];
+      if(label.length == 0 || label.first_atom > header->atom_count ||
+         label.length > header->atom_count - label.first_atom)
+      {
+         print_to_log("Error (loadGraphSnapshot): bad label %" PRIu64 ".\n", index);
+         return false;
+      }
+      if(label.length > snapshot->max_length) snapshot->max_length = label.length;
+   }
+   for(index = 0; index < header->node_count; index++)
+   {
+      SnapshotNode node = snapshot->nodes[index];
+      if(node.mark > DASHED || (node.label != SNAPSHOT_EMPTY_LABEL &&
+         node.label >= header->label_count))
+      {
+         print_to_log("Error (loadGraphSnapshot): bad node %" PRIu64 ".\n", index);
+         return false;
+      }
+   }
+   for(index = 0; index < header->edge_count; index++)
+   {
+      SnapshotEdge edge = snapshot->edges[index];
+      if(edge.mark > DASHED || edge.source >= header->node_count ||
+         edge.target >= header->node_count ||
+         (edge.label != SNAPSHOT_EMPTY_LABEL && edge.label >= header->label_count))
+      {
+         print_to_log("Error (loadGraphSnapshot): bad edge %" PRIu64 ".\n", index);
+         return false;
+      }
+   }
+   for(index = 0; index < header->root_count; index++)
+   {
+      if(snapshot->roots[index] >= header->node_count)
+      {
+         print_to_log("Error (loadGraphSnapshot): bad root %" PRIu64 ".\n", index);
+         return false;
+      }
+   }
+   return true;
+}
+
+/* Returns the host label for a label index. Each list is added to the list
+ * store on its first use; later uses only take another reference. */
+static HostLabel getSnapshotLabel(Snapshot *snapshot, HostList **lists,
+                                  HostAtom *array, uint64_t label_index, uint8_t mark)
+{
+   if(label_index == SNAPSHOT_EMPTY_LABEL) return makeEmptyLabel(mark);
+   SnapshotLabel label = snapshot->labels[label_index];
+   if(lists[label_index] == NULL)
+   {
+      uint32_t index;
+      for(index = 0; index < label.length; index++)
+      {
+         SnapshotAtom atom = snapshot->atoms[label.first_atom + index];
+         array[index].type = (char) atom.type;
+         if(atom.type == 'i') array[index].num = atom.value;
+         /* The string is copied into the string table, the mapping is
+          * released once the graph is built. */
+         else array[index].str = makeString((string) snapshot->strings + atom.value);
+      }
+      lists[label_index] = makeHostList(array, label.length, true);
+   }
+   #ifndef MINIMAL_GC
+   else addHostList(lists[label_index]);
+   #endif
+   return makeHostLabel(mark, label.length, lists[label_index]);
+}
+
+Graph *loadGraphSnapshot(string file_name)
+{
+   return loadGraphSnapshotAt(file_name, 0);
+}
+
+Graph *loadGraphSnapshotAt(string file_name, size_t offset)
+{
+   int fd = open(file_name, O_RDONLY);
+   if(fd < 0)
+   {
+      perror(file_name);
+      return NULL;
+   }
+   struct stat file_stat;
+   if(fstat(fd, &file_stat) != 0)
+   {
+      perror(file_name);
+      close(fd);
+      return NULL;
+   }
+   size_t size = (size_t) file_stat.st_size;
+   const char *data = size == 0 ? NULL : mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if(data == MAP_FAILED)
+   {
+      perror(file_name);
+      return NULL;
+   }
+   Snapshot snapshot;
+   if(data == NULL || size < offset ||
+      !validateSnapshot(&snapshot, data + offset, size - offset))
+   {
+      if(data != NULL) munmap((void *) data, size);
+      return NULL;
+   }
+   #ifdef MADV_SEQUENTIAL
+   madvise((void *) data, size, MADV_SEQUENTIAL);
+   #endif
+
+   const SnapshotHeader *header = snapshot.header;
+   HostList **lists = callocSafe(header->label_count + 1, sizeof(HostList *), "loadGraphSnapshot");
+   HostAtom *array = mallocSafe((snapshot.max_length + 1) * sizeof(HostAtom), "loadGraphSnapshot");
+   Node **nodes = mallocSafe((header->node_count + 1) * sizeof(Node *), "loadGraphSnapshot");
+   Graph *graph = newGraph();
+
+   /* Nodes and edges are pushed onto the front of their lists, so the records
+    * are added in reverse to reproduce the order in which they were written. */
+   uint64_t index;
+   for(index = header->node_count; index-- > 0;)
+   {
+      SnapshotNode record = snapshot.nodes[index];
+      HostLabel label = getSnapshotLabel(&snapshot, lists, array, record.label, record.mark);
+      nodes[index] = addNode(graph, false, label);
+   }
+   for(index = header->edge_count; index-- > 0;)
+   {
+      SnapshotEdge record = snapshot.edges[index];
+      HostLabel label = getSnapshotLabel(&snapshot, lists, array, record.label, record.mark);
+      addEdge(graph, label, nodes[record.source], nodes[record.target]);
+   }
+   for(index = 0; index < header->root_count; index++)
+   {
+      Node *node = nodes[snapshot.roots[index]];
+      if(!nodeRoot(node)) changeRoot(graph, node);
+   }
+
+   free(nodes);
+   free(array);
+   free(lists);
+   munmap((void *) data, size);
+   return graph;
+}
+
+/* ================
+ * Snapshot Writing
+ * ================ */
+
+/* A growable byte buffer holding one section of the snapshot. */
+typedef struct SnapshotBuffer {
+   char *data;
+   size_t size, capacity;
+} SnapshotBuffer;
+
+static void *appendToBuffer(SnapshotBuffer *buffer, size_t size)
+{
+   if(buffer->size + size > buffer->capacity)
+   {
+      size_t capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+      while(buffer->size + size > capacity) capacity <<= 1;
+      buffer->data = reallocSafe(buffer->data, capacity, "appendToBuffer");
+      buffer->capacity = capacity;
+   }
+   void *end = buffer->data + buffer->size;
+   buffer->size += size;
+   return end;
+}
+
+/* Maps each distinct HostList pointer to its index in the label section.
+ * Lists are hash-consed in the list store, so pointer equality is list
+ * equality. Open addressing with linear probing; the capacity is a power of
+ * two at least twice the number of labelled items, so it never fills. */
+typedef struct LabelTable {
+   HostList **lists;
+   uint64_t *indices;
+   size_t capacity;
+} LabelTable;
+
+typedef struct SnapshotWriter {
+   SnapshotBuffer labels, atoms, nodes, edges, roots, strings;
+   uint64_t label_count, atom_count;
+   LabelTable table;
+} SnapshotWriter;
+
+static uint64_t getLabelIndex(SnapshotWriter *writer, HostLabel label)
+{
+   if(label.length == 0) return SNAPSHOT_EMPTY_LABEL;
+   LabelTable *table = &(writer->table);
+   size_t slot = ((uintptr_t) label.list >> 4) & (table->capacity - 1);
+   while(table->lists[slot] != NULL)
+   {
+      if(table->lists[slot] == label.list) return table->indices[slot];
+      slot = (slot + 1) & (table->capacity - 1);
+   }
+   table->lists[slot] = label.list;
+   table->indices[slot] = writer->label_count;
+
+   SnapshotLabel *record = appendToBuffer(&(writer->labels), sizeof(SnapshotLabel));
+   record->first_atom = writer->atom_count;
+   record->length = label.length;
+   HostAtom *item;
+   for(item = label.list->atoms; item < label.list->atoms + label.list->length; item++)
+   {
+      SnapshotAtom *atom = appendToBuffer(&(writer->atoms), sizeof(SnapshotAtom));
+      atom->type = item->type;
+      if(item->type == 'i') atom->value = item->num;
+      else
+      {
+         size_t length = stringLength(item->str) + 1;
+         atom->value = (int64_t) writer->strings.size;
+         memcpy(appendToBuffer(&(writer->strings), length), item->str, length);
+      }
+      writer->atom_count++;
+   }
+   return writer->label_count++;
+}
+
+static void writeSnapshotNode(SnapshotWriter *writer, uint64_t *node_ids,
+                              uint64_t *node_count, Node *node)
+{
+   SnapshotNode *record = appendToBuffer(&(writer->nodes), sizeof(SnapshotNode));
+   memset(record, 0, sizeof(SnapshotNode));
+   record->label = getLabelIndex(writer, node->label);
+   record->mark = node->label.mark;
+   node_ids[node->index] = (*node_count)++;
+}
+
+static void writeSnapshotEdges(SnapshotWriter *writer, uint64_t *node_ids,
+                               uint64_t *edge_count, Graph *graph, Node *node)
+{
+   #ifndef ARRAY_ADJACENCY
+   EdgeList *elistpos = NULL;
+   #endif
+   for(int i = 0; i < 6; i++){
+      for(int j = 0; j < 2; j++){
+         #ifdef ARRAY_ADJACENCY
+         EdgeArray *array = outEdgeArray(node, i, j);
+         for(long position = array->size - 1; position >= 0; position--)
+         {
+            Edge *edge = array->edges[position];
+         #else
+         elistpos = NULL;
+         for(Edge *edge; (edge = yieldNextOutEdgeFast(graph, node, &elistpos, i, j)) != NULL;)
+         {
+         #endif
+            /* Edges to nodes that are not written (see printGraphFast) are
+             * dropped rather than left dangling. */
+            if(node_ids[edgeTarget(edge)->index] == UINT64_MAX) continue;
+            SnapshotEdge *record = appendToBuffer(&(writer->edges), sizeof(SnapshotEdge));
+            memset(record, 0, sizeof(SnapshotEdge));
+            record->source = node_ids[edgeSource(edge)->index];
+            record->target = node_ids[edgeTarget(edge)->index];
+            record->label = getLabelIndex(writer, edge->label);
+            record->mark = edge->label.mark;
+            (*edge_count)++;
+         }
+      }
+   }
+}
+
+void printGraphSnapshot(Graph *graph, FILE *file)
+{
+   SnapshotWriter writer;
+   memset(&writer, 0, sizeof(SnapshotWriter));
+   uint64_t node_count = 0, edge_count = 0, root_count = 0;
+   uint64_t *node_ids = NULL;
+   if(graph != NULL)
+   {
+      size_t items = (size_t) graph->number_of_nodes + graph->number_of_edges;
+      writer.table.capacity = 16;
+      while(writer.table.capacity < 2 * items) writer.table.capacity <<= 1;
+      writer.table.lists = callocSafe(writer.table.capacity, sizeof(HostList *), "printGraphSnapshot");
+      writer.table.indices = mallocSafe(writer.table.capacity * sizeof(uint64_t), "printGraphSnapshot");
+      /* Indexed by the node's position in the node array. */
+      node_ids = mallocSafe((graph->_nodearray.size + 1) * sizeof(uint64_t), "printGraphSnapshot");
+      memset(node_ids, 0xff, (graph->_nodearray.size + 1) * sizeof(uint64_t));
+
+      /* The nodes are visited exactly as printGraphFast visits them, so the
+       * dense IDs follow the order of the text output. */
+      #ifndef NO_NODE_LIST
+      NodeList *nlistpos = NULL;
+      for(int n = 0; n < 6; n++){
+         if(n == DASHED) continue;
+         nlistpos = NULL;
+         for(Node *node; (node = yieldNextNodeFast(graph, &nlistpos, n)) != NULL;)
+            writeSnapshotNode(&writer, node_ids, &node_count, node);
+      }
+      for(int n = 0; n < 6; n++){
+         if(n == DASHED) continue;
+         nlistpos = NULL;
+         for(Node *node; (node = yieldNextNodeFast(graph, &nlistpos, n)) != NULL;)
+            writeSnapshotEdges(&writer, node_ids, &edge_count, graph, node);
+      }
+      #else
+      Node *node;
+      for(long i = 0; i < graph->_nodearray.size; i++)
+      {
+         node = (Node *) getBigArrayValue(&(graph->_nodearray), i);
+         if(nodeDeleted(node)) continue;
+         writeSnapshotNode(&writer, node_ids, &node_count, node);
+      }
+      for(long i = 0; i < graph->_nodearray.size; i++)
+      {
+         node = (Node *) getBigArrayValue(&(graph->_nodearray), i);
+         if(nodeDeleted(node)) continue;
+         writeSnapshotEdges(&writer, node_ids, &edge_count, graph, node);
+      }
+      #endif
+
+      for(int mark = 0; mark < 6; mark++)
+         for(RootNodes *root = getRootNodeList(graph, mark); root != NULL; root = root->next)
+         {
+            if(node_ids[root->node->index] == UINT64_MAX) continue;
+            uint64_t *id = appendToBuffer(&(writer.roots), sizeof(uint64_t));
+            *id = node_ids[root->node->index];
+            root_count++;
+         }
+   }
+
+   SnapshotHeader header;
+   memset(&header, 0, sizeof(SnapshotHeader));
+   memcpy(header.magic, SNAPSHOT_MAGIC, 8);
+   header.version = SNAPSHOT_VERSION;
+   header.node_count = node_count;
+   header.edge_count = edge_count;
+   header.root_count = root_count;
+   header.label_count = writer.label_count;
+   header.atom_count = writer.atom_count;
+   header.string_bytes = writer.strings.size;
+
+   fwrite(&header, sizeof(SnapshotHeader), 1, file);
+   SnapshotBuffer *sections[] = {&writer.labels, &writer.atoms, &writer.nodes,
+                                 &writer.edges, &writer.roots, &writer.strings};
+   for(int i = 0; i < 6; i++)
+   {
+      if(sections[i]->size > 0) fwrite(sections[i]->data, 1, sections[i]->size, file);
+      free(sections[i]->data);
+   }
+   free(writer.table.lists);
+   free(writer.table.indices);
+   free(node_ids);
+}
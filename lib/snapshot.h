@@ -0,0 +1,106 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ===============
+  Snapshot Module
+  ===============
+
+  A binary, memory-mappable format for host graphs. A snapshot is read by
+  mapping the file and building the graph directly from its records, which
+  avoids the host graph parser entirely. The output graph of a GP 2 program
+  can be written in the same format so that programs can be chained.
+
+  The file is laid out as a fixed header followed by six sections, in order:
+  - labels:  one record per distinct list, naming a range of the atom table;
+  - atoms:   integer atoms store their value, string atoms store an offset
+             into the string pool;
+  - nodes:   dense records, so a node's ID is its position in this section;
+  - edges:   source and target refer to node IDs;
+  - roots:   the IDs of the root nodes;
+  - strings: the string pool, a sequence of NUL-terminated strings.
+  All integers are stored in the byte order of the machine that wrote the
+  file. Counts, IDs, offsets and integer atoms are 64 bits wide; version 1
+  snapshots, which had 32-bit fields, are not read.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_SNAPSHOT_H
+#define INC_SNAPSHOT_H
+
+#include "common.h"
+#include "graph.h"
+#include "label.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define SNAPSHOT_MAGIC "GP2SNAP"
+#define SNAPSHOT_VERSION 2
+/* Label index of nodes and edges with the empty list. */
+#define SNAPSHOT_EMPTY_LABEL UINT64_MAX
+
+typedef struct SnapshotHeader {
+   char magic[8];
+   uint32_t version;
+   uint32_t reserved;
+   uint64_t node_count, edge_count, root_count;
+   uint64_t label_count, atom_count, string_bytes;
+} SnapshotHeader;
+
+typedef struct SnapshotLabel {
+   uint64_t first_atom;
+   uint32_t length;
+   uint32_t unused;
+} SnapshotLabel;
+
+typedef struct SnapshotAtom {
+   int32_t type; /* 'i' or 's' */
+   int32_t unused;
+   int64_t value; /* The integer, or the string's offset in the pool. */
+} SnapshotAtom;
+
+typedef struct SnapshotNode {
+   uint64_t label;
+   uint8_t mark;
+   uint8_t unused[7];
+} SnapshotNode;
+
+typedef struct SnapshotEdge {
+   uint64_t source, target;
+   uint64_t label;
+   uint8_t mark;
+   uint8_t unused[7];
+} SnapshotEdge;
+
+/* Returns true if the file starts with the snapshot magic string. */
+bool isGraphSnapshot(string file_name);
+
+/* Maps the file into memory and builds a new graph from its records. Returns
+ * NULL and writes the reason to the log file if the snapshot is malformed. */
+Graph *loadGraphSnapshot(string file_name);
+
+/* As loadGraphSnapshot, for a snapshot that starts offset bytes into the file
+ * and runs to its end. The offset must be a multiple of 8. */
+Graph *loadGraphSnapshotAt(string file_name, size_t offset);
+
+/* Writes the graph in snapshot format. Nodes are renumbered densely in the
+ * order they are visited. Does not garbage collect, so it may be called at
+ * any point during execution. */
+void printGraphSnapshot(Graph *graph, FILE *file);
+
+#endif /* INC_SNAPSHOT_H */
@@ -0,0 +1,282 @@
+/* Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>. */
+
+#include "stringTable.h"
+
+#include <limits.h>
+#include <string.h>
+
+typedef struct StringTableSlot {
+   InternedString *string;
+   unsigned hash;
+} StringTableSlot;
+
+static struct StringTable {
+   StringTableSlot *slots;
+   unsigned long capacity, count;
+} string_table = {NULL, 0, 0};
+
+static unsigned finishHash(unsigned hash)
+{
+   hash ^= hash >> 16;
+   hash *= 0x85EBCA6Bu;
+   hash ^= hash >> 13;
+   hash *= 0xC2B2AE35u;
+   hash ^= hash >> 16;
+   return hash;
+}
+
+/* FNV-1a over the characters followed by a final avalanche. The length is
+ * computed in the same pass. */
+static unsigned hashString(const char *chars, unsigned *length)
+{
+   unsigned hash = 2166136261u;
+   const unsigned char *c;
+   for(c = (const unsigned char *) chars; *c != '\0'; c++)
+      hash = (hash ^ *c) * 16777619u;
+   *length = (unsigned) (c - (const unsigned char *) chars);
+   return finishHash(hash);
+}
+
+/* The hash of the first length characters, equal to that of hashString for a
+ * string of that length. */
+static unsigned hashChars(const char *chars, unsigned length)
+{
+   unsigned hash = 2166136261u;
+   const unsigned char *c = (const unsigned char *) chars;
+   for(unsigned index = 0; index < length; index++)
+      hash = (hash ^ c[index]) * 16777619u;
+   return finishHash(hash);
+}
+
+void initialiseStringTable(void)
+{
+   string_table.capacity = STRING_TABLE_INITIAL_SIZE;
+   string_table.count = 0;
+   string_table.slots = callocSafe(string_table.capacity, sizeof(StringTableSlot),
+                                   "initialiseStringTable");
+}
+
+/* Returns the slot holding the passed string, or the empty slot where it
+ * belongs. */
+static StringTableSlot *findSlot(const char *chars, unsigned length, unsigned hash)
+{
+   unsigned long mask = string_table.capacity - 1;
+   unsigned long index = hash & mask;
+   while(string_table.slots[index].string != NULL)
+   {
+      StringTableSlot *slot = &(string_table.slots[index]);
+      if(slot->hash == hash && slot->string->length == length &&
+         memcmp(slot->string->chars, chars, length) == 0) return slot;
+      index = (index + 1) & mask;
+   }
+   return &(string_table.slots[index]);
+}
+
+static void growStringTable(void)
+{
+   StringTableSlot *old_slots = string_table.slots;
+   unsigned long old_capacity = string_table.capacity;
+   string_table.capacity *= 2;
+   string_table.slots = callocSafe(string_table.capacity, sizeof(StringTableSlot),
+                                   "growStringTable");
+   unsigned long mask = string_table.capacity - 1;
+   unsigned long index;
+   for(index = 0; index < old_capacity; index++)
+   {
+      if(old_slots[index].string == NULL) continue;
+      unsigned long new_index = old_slots[index].hash & mask;
+      while(string_table.slots[new_index].string != NULL)
+         new_index = (new_index + 1) & mask;
+      string_table.slots[new_index] = old_slots[index];
+   }
+   free(old_slots);
+}
+
+static string internString(const char *chars, unsigned length, unsigned hash)
+{
+   assert(string_table.slots != NULL);
+   StringTableSlot *slot = findSlot(chars, length, hash);
+   if(slot->string == NULL)
+   {
+      if((string_table.count + 1) * 4 > string_table.capacity * 3)
+      {
+         growStringTable();
+         slot = findSlot(chars, length, hash);
+      }
+      InternedString *interned = mallocSafe(sizeof(InternedString) + length + 1,
+                                            "makeString");
+      interned->hash = hash;
+      interned->length = length;
+      #ifndef MINIMAL_GC
+      interned->reference_count = 0;
+      #endif
+      memcpy(interned->chars, chars, length);
+      interned->chars[length] = '\0';
+      slot->string = interned;
+      slot->hash = hash;
+      string_table.count++;
+   }
+   #ifndef MINIMAL_GC
+   if(slot->string->reference_count < UINT_MAX) slot->string->reference_count++;
+   #endif
+   return slot->string->chars;
+}
+
+string makeString(const char *chars)
+{
+   unsigned length;
+   unsigned hash = hashString(chars, &length);
+   return internString(chars, length, hash);
+}
+
+string makeStringOfLength(const char *chars, unsigned length)
+{
+   return internString(chars, length, hashChars(chars, length));
+}
+
+void startString(StringBuilder *builder, unsigned length)
+{
+   if(length >= builder->capacity)
+   {
+      /* Doubled so that a builder reused for growing strings is reallocated
+       * a logarithmic number of times. */
+      unsigned capacity = builder->capacity == 0 ? 64 : 2 * builder->capacity;
+      while(capacity <= length) capacity *= 2;
+      builder->chars = reallocSafe(builder->chars, capacity, "startString");
+      builder->capacity = capacity;
+   }
+   builder->length = 0;
+}
+
+#ifndef MINIMAL_GC
+/* The static variables holding interned constants. */
+static struct ConstantVariables {
+   string **variables;
+   int capacity, count;
+} constants = {NULL, 0, 0};
+#endif
+
+string makeConstant(string *constant, const char *chars)
+{
+   #ifndef MINIMAL_GC
+   if(constants.count == constants.capacity)
+   {
+      constants.capacity = constants.capacity == 0 ? 16 : 2 * constants.capacity;
+      constants.variables = reallocSafe(constants.variables,
+                                        constants.capacity * sizeof(string *), "makeConstant");
+   }
+   constants.variables[constants.count++] = constant;
+   #else
+   UNUSED(constant);
+   #endif
+   return makeString(chars);
+}
+
+string lookupString(const char *chars)
+{
+   assert(string_table.slots != NULL);
+   unsigned length;
+   unsigned hash = hashString(chars, &length);
+   StringTableSlot *slot = findSlot(chars, length, hash);
+   return slot->string == NULL ? NULL : slot->string->chars;
+}
+
+#ifndef MINIMAL_GC
+void addString(string str)
+{
+   InternedString *interned = getInternedString(str);
+   if(interned->reference_count < UINT_MAX) interned->reference_count++;
+}
+
+/* Empties the slot at hole, shifting later entries of the same run back as
+ * in the list store. */
+static void removeSlot(unsigned long hole)
+{
+   unsigned long mask = string_table.capacity - 1;
+   unsigned long index = (hole + 1) & mask;
+   while(string_table.slots[index].string != NULL)
+   {
+      unsigned long home = string_table.slots[index].hash & mask;
+      if(((index - home) & mask) >= ((index - hole) & mask))
+      {
+         string_table.slots[hole] = string_table.slots[index];
+         hole = index;
+      }
+      index = (index + 1) & mask;
+   }
+   string_table.slots[hole].string = NULL;
+   string_table.count--;
+}
+
+void removeString(string str)
+{
+   InternedString *interned = getInternedString(str);
+   assert(interned->reference_count > 0);
+   if(interned->reference_count == UINT_MAX || --interned->reference_count > 0) return;
+   unsigned long mask = string_table.capacity - 1;
+   unsigned long index = interned->hash & mask;
+   while(string_table.slots[index].string != interned)
+   {
+      /* The passed string is expected to exist in the table. */
+      assert(string_table.slots[index].string != NULL);
+      index = (index + 1) & mask;
+   }
+   removeSlot(index);
+   free(interned);
+}
+
+void freeStringTable(void)
+{
+   if(string_table.slots == NULL) return;
+   unsigned long index;
+   for(index = 0; index < string_table.capacity; index++)
+      if(string_table.slots[index].string != NULL) free(string_table.slots[index].string);
+   free(string_table.slots);
+   string_table.slots = NULL;
+   string_table.capacity = 0;
+   string_table.count = 0;
+   int constant;
+   for(constant = 0; constant < constants.count; constant++)
+      *(constants.variables[constant]) = NULL;
+   free(constants.variables);
+   constants.variables = NULL;
+   constants.capacity = constants.count = 0;
+}
+#endif
+
+#ifndef NDEBUG
+void printStringTableStats(FILE *file)
+{
+   if(string_table.slots == NULL) return;
+   unsigned long mask = string_table.capacity - 1;
+   unsigned long index, max_probe = 0;
+   unsigned long total_probe = 0;
+   for(index = 0; index < string_table.capacity; index++)
+   {
+      StringTableSlot *slot = &(string_table.slots[index]);
+      if(slot->string == NULL) continue;
+      unsigned long probe = ((index - (slot->hash & mask)) & mask) + 1;
+      total_probe += probe;
+      if(probe > max_probe) max_probe = probe;
+   }
+   fprintf(file, "String table: %lu strings in %lu slots (load factor %.2f).\n",
+           string_table.count, string_table.capacity,
+           (double) string_table.count / string_table.capacity);
+   fprintf(file, "String table probe lengths: mean %.2f, max %lu.\n",
+           string_table.count == 0 ? 0.0 : (double) total_probe / string_table.count,
+           max_probe);
+}
+#endif
@@ -0,0 +1,149 @@
+/* ///////////////////////////////////////////////////////////////////////////
+
+  Copyright 2015-2017 Christopher Bak
+
+  This file is part of the GP 2 Compiler. The GP 2 Compiler is free software:
+  you can redistribute it and/or modify it under the terms of the GNU General
+  Public License as published by the Free Software Foundation, either version 3
+  of the License, or (at your option) any later version.
+
+  The GP 2 Compiler is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+  more details.
+
+  You should have received a copy of the GNU General Public License
+  along with the GP 2 Compiler. If not, see <http://www.gnu.org/licenses/>.
+
+  ===================
+  String Table Module
+  ===================
+
+  Interns the strings of host atoms and morphism assignments. Each distinct
+  string is stored once, behind a header holding its length and hash, and is
+  referred to by a pointer to its characters. Such a handle can be used
+  anywhere a C string is expected, and two handles are equal if and only if
+  the strings are equal.
+
+  The table uses open addressing with linear probing and doubles whenever it
+  becomes three-quarters full. Unless MINIMAL_GC is defined, strings are
+  reference counted and freed when their last reference is removed.
+
+  Strings built at runtime, such as the values of concatenations in rule
+  labels, are assembled in a string builder from pieces of known length and
+  interned straight from its buffer. A builder is reused for every string it
+  builds, so building a string copies each piece once and allocates nothing
+  once the buffer is large enough; interning allocates only a string that is
+  not already in the table.
+
+/////////////////////////////////////////////////////////////////////////// */
+
+#ifndef INC_STRING_TABLE_H
+#define INC_STRING_TABLE_H
+
+#define STRING_TABLE_INITIAL_SIZE 64
+
+#include "common.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+// 8/12 bytes + the characters
+typedef struct InternedString {
+   unsigned hash;
+   unsigned length;
+   #ifndef MINIMAL_GC
+   /* Saturates at UINT_MAX, after which the string is never freed. */
+   unsigned int reference_count;
+   #endif
+   char chars[];
+} InternedString;
+
+void initialiseStringTable(void);
+
+/* Returns the handle of the passed string, adding a copy of it to the table
+ * if it is not already there, and takes a reference to it. */
+string makeString(const char *chars);
+
+/* As makeString, for the first length characters of chars, which need not be
+ * followed by a terminator. */
+string makeStringOfLength(const char *chars, unsigned length);
+
+/* Returns the handle of the passed string, or NULL if it is not in the
+ * table. No reference is taken. */
+string lookupString(const char *chars);
+
+/* Generated code caches the handles of its string constants in static
+ * variables. The constant is interned on first use, and its reference is
+ * held until the table is freed, which resets the variable to NULL. */
+string makeConstant(string *constant, const char *chars);
+
+static inline string internConstant(string *constant, const char *chars)
+{
+   if(*constant == NULL) *constant = makeConstant(constant, chars);
+   return *constant;
+}
+
+static inline InternedString *getInternedString(const char *str)
+{
+   return (InternedString *) (str - offsetof(InternedString, chars));
+}
+
+/* The length and hash stored with an interned string. Only to be called on
+ * handles returned by this module. */
+static inline unsigned stringLength(const char *str)
+{
+   return getInternedString(str)->length;
+}
+
+static inline unsigned stringHash(const char *str)
+{
+   return getInternedString(str)->hash;
+}
+
+/* A buffer of capacity bytes whose first length characters are the string
+ * built so far. A builder starts as {NULL, 0, 0} and keeps its buffer for the
+ * next string. */
+typedef struct StringBuilder {
+   char *chars;
+   unsigned length, capacity;
+} StringBuilder;
+
+/* Empties the builder and makes room for a string of the passed length and
+ * its terminator. */
+void startString(StringBuilder *builder, unsigned length);
+
+static inline void appendChars(StringBuilder *builder, const char *chars, unsigned length)
+{
+   assert(builder->length + length < builder->capacity);
+   memcpy(builder->chars + builder->length, chars, length);
+   builder->length += length;
+}
+
+/* Terminates the built string and returns it. It is valid until the builder
+ * is next started. */
+static inline char *finishString(StringBuilder *builder)
+{
+   builder->chars[builder->length] = '\0';
+   return builder->chars;
+}
+
+#ifndef MINIMAL_GC
+/* Increments the reference count of an interned string. */
+void addString(string str);
+/* Decrements the reference count of an interned string, removing it from the
+ * table and freeing it if the new reference count is 0. */
+void removeString(string str);
+void freeStringTable(void);
+#endif
+
+#ifndef NDEBUG
+/* Prints the size and load factor of the table along with the mean and
+ * maximum probe lengths of its entries. */
+void printStringTableStats(FILE *file);
+#endif
+
+#endif /* INC_STRING_TABLE_H */
@@ -355,7 +355,7 @@ GPAtom *newASTVariable(YYLTYPE location, string name)
     return atom;
 }
 
-GPAtom *newASTNumber(YYLTYPE location, int number)
+GPAtom *newASTNumber(YYLTYPE location, long number)
 {
     GPAtom *atom = makeGPAtom(location, INTEGER_CONSTANT);
     atom->number = number;
@@ -523,6 +523,10 @@ GPRule *newASTRule(YYLTYPE location, string name, List *variables,
     rule->predicate_count = 0;
     rule->empty_lhs = false;
     rule->is_predicate = false;
+    rule->resumable = false;
+    rule->shared_scan = 0;
+    rule->shared_scan_mark = 0;
+    rule->change_kinds = 0;
     return rule;
 }    
 
@@ -229,7 +229,7 @@ typedef struct GPAtom {
   AtomType type;
   YYLTYPE location;
   union {
-    int number; 	 	  /* INTEGER_CONSTANT */
+    long number; 	 	  /* INTEGER_CONSTANT */
     string string;		  /* STRING_CONSTANT */
     struct {
        string name;		  
@@ -246,7 +246,7 @@ typedef struct GPAtom {
 
 GPAtom *makeGPAtom(YYLTYPE location, AtomType type);
 GPAtom *newASTVariable (YYLTYPE location, string name);
-GPAtom *newASTNumber (YYLTYPE location, int number);
+GPAtom *newASTNumber (YYLTYPE location, long number);
 GPAtom *newASTCharacter (YYLTYPE location, string character);
 GPAtom *newASTString (YYLTYPE location, string string);
 GPAtom *newASTDegreeOp (AtomType exp_type, YYLTYPE location, string node_id);
@@ -286,6 +286,16 @@ typedef struct GPRule {
    int predicate_count;
    bool empty_lhs;
    bool is_predicate;
+   bool resumable;
+   /* The type of the first searchplan operation ('n' or 'r') if the rule has
+    * a matcher from a given host node (see generateMatchingCode), and 0
+    * otherwise. shared_scan_mark is the mark of the node it matches. */
+   char shared_scan;
+   int shared_scan_mark;
+   /* With -R, the kinds of host graph change after which the rule may have a
+    * match it did not have before, bit k standing for kind k of the lib's
+    * CHANGE_STAMPS, and 0 if the rule is always tried. */
+   unsigned change_kinds;
 } GPRule;
 
 GPRule *newASTRule(YYLTYPE location, string name, List *variables, 
@@ -55,6 +55,23 @@ extern bool fast_shutdown;
 extern bool minimal_gc;
 extern bool reflect_roots;
 extern bool no_node_list;
+extern bool print_searchplans;
+extern bool adaptive_searchplans;
+extern bool label_index;
+extern bool array_adjacency;
+extern bool edge_index;
+extern bool resumable_loops;
+extern bool parallel_matching;
+extern bool batch_apply;
+extern bool compact_graphs;
+extern bool shared_scans;
+extern bool profile_runtime;
+extern bool whole_program;
+extern bool degree_index;
+extern bool node_filter;
+extern bool flat_matchers;
+extern bool edge_lists;
+extern bool applicability_tracking;
 
 /* Bison uses a global variable yylloc of type YYLTYPE to keep track of the 
  * locations of tokens and nonterminals. The scanner will set these values upon
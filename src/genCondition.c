@@ -127,6 +127,68 @@ static bool labelIsIntegerExpression(RuleLabel label)
    return false;
 }
 
+/* Prints the body of a loop over candidate edges for an edge predicate. The
+ * candidate is in the variable edge, and the loop is printed with the passed
+ * indent. */
+static void emitEdgePredicateBody(Predicate *predicate, int target, int *list_count,
+                                  int indent)
+{
+   PTFI("if(edge != NULL && edgeTarget(edge) == n%d)\n", indent + 3, target);
+   if(predicate->edge_pred.label.length >= 0)
+   {
+      PTFI("{\n", indent + 3);
+      PTFI("HostLabel label;\n", indent + 6);
+      /* Create runtime variables for each variable in the label. */
+      if(predicate->edge_pred.label.length > 0)
+      {
+         RuleListItem *item = predicate->edge_pred.label.list->first;
+         int count;
+         for(count = 0; count < predicate->edge_pred.label.length; count++)
+         {
+            if(item->atom->type == VARIABLE)
+            {
+               /* generateVariableCode prints with indent 3. */
+               PTF("%*s", indent + 3, "");
+               generateVariableCode(item->atom->variable.id, item->atom->variable.type);
+            }
+            item = item->next;
+         }
+      }
+      bool label_any_marked = false;
+      if (predicate->edge_pred.label.mark == ANY) {
+         label_any_marked = true;
+         predicate->edge_pred.label.mark = GREY;
+      }
+      generateLabelEvaluationCode(predicate->edge_pred.label, false, (*list_count)++, 1,
+                                  indent + 6);
+      if (label_any_marked)
+      {
+         PTFI("if(equalHostLabelsModMarks(label, edge->label))\n", indent + 6);
+         predicate->edge_pred.label.mark = ANY;
+      }
+      else
+      {
+         PTFI("if(equalHostLabels(label, edge->label))\n", indent + 6);
+      }
+      PTFI("{\n", indent + 6);
+      PTFI("b%d = true;\n", indent + 9, predicate->bool_id);
+      PTFI("edge_found = true;\n", indent + 9);
+      if(!minimal_gc) PTFI("removeHostList(label.list);\n", indent + 9);
+      PTFI("break;\n", indent + 9);
+      PTFI("}\n", indent + 6);
+      if(!minimal_gc) PTFI("removeHostList(label.list);\n", indent + 6);
+      PTFI("}\n", indent + 3);
+   }
+   else
+   {
+      PTFI("{\n", indent + 3);
+      PTFI("b%d = true;\n", indent + 6, predicate->bool_id);
+      PTFI("edge_found = true;\n", indent + 6);
+      PTFI("break;\n", indent + 6);
+      PTFI("}\n", indent + 3);
+   }
+}
+
 /* Writes a function that evaluates a predicate. The generated function checks
  * if all appropriate nodes and variables are instantiated. If so, it sets the
  * appropriate runtime boolean value to the result of the predicate's evalution
@@ -170,7 +232,7 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
             switch(variable.type)
             {
                case INTEGER_VAR:
-                    PTFI("int var_%d = getIntegerValue(morphism, %d);\n\n", 3,
+                    PTFI("long var_%d = getIntegerValue(morphism, %d);\n\n", 3,
                          index, index);
                     break;
 
@@ -205,7 +267,7 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
 
       case CHAR_CHECK:
            PTFI("if(assignment_%d.type == 's' &&\n", 3, predicate->variable_id);
-           PTFI("strlen(assignment_%d.string) == 1)\n", 6, predicate->variable_id);
+           PTFI("stringLength(assignment_%d.str) == 1)\n", 6, predicate->variable_id);
            PTFI("b%d = true;\n", 6, predicate->bool_id);
            PTFI("else b%d = false;\n", 3, predicate->bool_id);
            break;
@@ -227,67 +289,46 @@ static void generatePredicateCode(Rule *rule, Predicate *predicate)
            int source = predicate->edge_pred.source;
            int target = predicate->edge_pred.target;
            PTFI("bool edge_found = false;\n", 3);
-           PTFI("EdgeList *elist;\n", 3);
+           int indent = 3;
+           if(edge_index)
+           {
+              /* The edges between the two nodes are read from the index if one
+               * of them is indexed. */
+              PTFI("if(edgesIndexed(n%d, n%d))\n", 3, source, target);
+              PTFI("{\n", 3);
+              PTFI("for(int mark = 0; mark < 6 && !edge_found; mark++)\n", 6);
+              PTFI("for(Edge *edge = firstEdgeBetween(host, n%d, n%d, mark); edge != NULL && !edge_found;\n",
+                   9, source, target);
+              PTFI("edge = nextEdgeBetween(edge))\n", 12);
+              PTFI("{\n", 9);
+              emitEdgePredicateBody(predicate, target, &list_count, 9);
+              PTFI("}\n", 9);
+              PTFI("}\n", 3);
+              PTFI("else\n", 3);
+              PTFI("{\n", 3);
+              indent = 6;
+           }
+           if(array_adjacency) PTFI("EdgeArray *earray;\n", indent);
+           else PTFI("EdgeList *elist;\n", indent);
            //PTFI("for(counter = 0; counter < source->out_edges.size + 2; counter++)\n", 3);
            for(int mark = 0; mark < 6; mark++){
-               PTFI("elist = NULL;\n", 3);
-               PTFI("for(Edge *edge; (edge = yieldNextOutEdge(host, n%d, &elist, %d, %d)) != NULL && !edge_found;)\n", 3, source, mark, source == target);
-               PTFI("{\n", 3);
-               PTFI("if(edge != NULL && edgeTarget(edge) == n%d)\n", 6, target);
-               if(predicate->edge_pred.label.length >= 0)
-               {
-               PTFI("{\n", 6);
-               PTFI("HostLabel label;\n", 9);
-               /* Create runtime variables for each variable in the label. */
-               if(predicate->edge_pred.label.length > 0)
+               if(array_adjacency)
                {
-                    RuleListItem *item = predicate->edge_pred.label.list->first;
-                    int count;
-                    for(count = 0; count < predicate->edge_pred.label.length; count++)
-                    {
-                         if(item->atom->type == VARIABLE)
-                         {
-                         /* generateVariableCode prints with indent 3. Indent of 9 is required. */
-                         PTF("      ");
-                         generateVariableCode(item->atom->variable.id, item->atom->variable.type);
-                         }
-                         item = item->next;
-                    }
-               }
-               bool label_any_marked = false;
-               if (predicate->edge_pred.label.mark == ANY) {
-                    label_any_marked = true;
-                    predicate->edge_pred.label.mark = GREY;
-               }
-               generateLabelEvaluationCode(predicate->edge_pred.label, false, list_count++, 1, 9);
-               if (label_any_marked)
-               {
-                    PTFI("if(equalHostLabelsModMarks(label, edge->label))\n", 9);
-                    predicate->edge_pred.label.mark = ANY;
-               }
-               else
-               {
-                    PTFI("if(equalHostLabels(label, edge->label))\n", 9);
-               }
-               PTFI("{\n", 9);
-               PTFI("b%d = true;\n", 12, predicate->bool_id);
-               PTFI("edge_found = true;\n", 12);
-               if(!minimal_gc) PTFI("removeHostList(label.list);\n", 12);
-               PTFI("break;\n", 12);
-               PTFI("}\n", 9);
-               if(!minimal_gc) PTFI("removeHostList(label.list);\n", 9);
-               PTFI("}\n", 6);
+                  PTFI("earray = outEdgeArray(n%d, %d, %d);\n", indent, source, mark, source == target);
+                  PTFI("for(long position = earray->size - 1; position >= 0 && !edge_found; position--)\n", indent);
+                  PTFI("{\n", indent);
+                  PTFI("Edge *edge = earray->edges[position];\n", indent + 3);
                }
                else
                {
-               PTFI("{\n", 6);
-               PTFI("b%d = true;\n", 9, predicate->bool_id);
-               PTFI("edge_found = true;\n", 9);
-               PTFI("break;\n", 9);
-               PTFI("}\n", 6);
+                  PTFI("elist = NULL;\n", indent);
+                  PTFI("for(Edge *edge; (edge = yieldNextOutEdge(host, n%d, &elist, %d, %d)) != NULL && !edge_found;)\n", indent, source, mark, source == target);
+                  PTFI("{\n", indent);
                }
-               PTFI("}\n", 3);
+               emitEdgePredicateBody(predicate, target, &list_count, indent);
+               PTFI("}\n", indent);
            }
+           if(edge_index) PTFI("}\n", 3);
            PTFI("if(!edge_found) b%d = false;\n", 3, predicate->bool_id);
            break;
       }
@@ -35,7 +35,8 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent);
 static void generateStringMatchingCode(Rule *rule, StringList *string_exp, 
                                        bool prefix, int indent);
 static void generateStringLengthCode(RuleAtom *atom, int indent);
-static void generateStringExpression(RuleAtom *atom, bool first, int indent);
+static void generateStringExpression(RuleAtom *atom, string builder, int indent);
+static void generateConstantListMatchingCode(RuleLabel label, int indent);
 
 StringList *appendStringExp(StringList *list, int type, string constant, int id)
 {
@@ -119,6 +120,12 @@ void freeStringList(StringList *list)
  * declared at most once per label at runtime. */
 bool result_declared = false;
 
+/* Used to generate fresh names for the static variables that hold the interned
+ * handles of string constants and constant lists at runtime. */
+int string_constant_count = 0;
+
+bool lookup_string_constants = false;
+
 void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent)
 {
    PTFI("/* Label Matching */\n", indent);
@@ -130,6 +137,9 @@ void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent)
       PTFI("match = label.length == 0 ? true : false;\n", indent);
       return;
    }
+   /* Worker matchers run concurrently and must not add to the list store. */
+   else if(isConstantLabel(label) && !lookup_string_constants)
+      generateConstantListMatchingCode(label, indent);
    else
    {
       /* A do-while loop is generated so that the label matching code can be exited
@@ -143,14 +153,15 @@ void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent)
       /* Lists without list variables admit relatively simple code generation as each
       * rule atom maps directly to the host atom in the same position. */
       RuleListItem *item = label.list->first;
-      PTFI("HostListItem *item = label.list->first;\n", indent + 3);
+      PTFI("HostAtom *item;\n", indent + 3);
       int atom_count = 1;
       while(item != NULL)
       {
          PTFI("/* Matching rule atom %d. */\n", indent + 3, atom_count);
+         PTFI("item = &label.list->atoms[%d];\n", indent + 3, atom_count - 1);
          generateAtomMatchingCode(rule, item->atom, indent + 3);
          atom_count++;
-         if(item->next != NULL) PTFI("item = item->next;\n\n", indent + 3);
+         if(item->next != NULL) PTF("\n");
          item = item->next;
       }
       PTFI("match = true;\n", indent + 3);
@@ -160,6 +171,38 @@ void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent)
    result_declared = false;
 }
 
+/* Host lists are hash-consed, so a host list is equal to a constant rule list
+ * only if it is the same list. The rule list is made on first use and held in
+ * a static variable, and the label is matched by comparing the pointers. */
+static void generateConstantListMatchingCode(RuleLabel label, int indent)
+{
+   int constant = string_constant_count++;
+   PTFI("static HostList *constant_list%d = NULL;\n", indent, constant);
+   PTFI("if(constant_list%d == NULL)\n", indent, constant);
+   PTFI("{\n", indent);
+   PTFI("HostAtom array[%d];\n", indent + 3, label.length);
+   RuleListItem *item = label.list->first;
+   int index = 0;
+   while(item != NULL)
+   {
+      if(item->atom->type == INTEGER_CONSTANT)
+      {
+         PTFI("array[%d].type = 'i';\n", indent + 3, index);
+         PTFI("array[%d].num = %ld;\n", indent + 3, index, item->atom->number);
+      }
+      else
+      {
+         PTFI("array[%d].type = 's';\n", indent + 3, index);
+         PTFI("array[%d].str = makeString(\"%s\");\n", indent + 3, index, item->atom->string);
+      }
+      index++;
+      item = item->next;
+   }
+   PTFI("makeConstantList(&constant_list%d, array, %d);\n", indent + 3, constant, label.length);
+   PTFI("}\n", indent);
+   PTFI("match = label.list == constant_list%d;\n\n", indent, constant);
+}
+
 void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
 { 
    PTFI("/* Label Matching */\n", indent);
@@ -188,10 +231,10 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
       }
       PTFI("if(label.length == 1)\n", indent );
       PTFI("{\n", indent);
-      PTFI("if(label.list->first->atom.type == 'i')\n", indent + 3);
-      PTFI("result = addIntegerAssignment(morphism, %d, label.list->first->atom.num);\n", 
+      PTFI("if(label.list->atoms[0].type == 'i')\n", indent + 3);
+      PTFI("result = addIntegerAssignment(morphism, %d, label.list->atoms[0].num);\n", 
            indent + 6, list_variable_id);
-      PTFI("else result = addStringAssignment(morphism, %d, label.list->first->atom.str);\n",
+      PTFI("else result = addStringAssignment(morphism, %d, label.list->atoms[0].str);\n",
            indent + 3, list_variable_id);
       PTFI("}\n", indent);
       PTFI("else result = addListAssignment(morphism, %d, label.list);\n",
@@ -202,7 +245,6 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
       return;
    }
   
-   item = label.list->first;
    /* A do-while loop is generated so that the label matching code can be exited
     * at any time with a break statement immediately after an atom match fails. */
    PTFI("do\n", indent);
@@ -210,73 +252,60 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
    /* Check if the host label has enough atoms to match those in the rule. 
     * Subtracting 1 from the rule label's length gives the number of atoms it
     * contains: the list variable is not counted because it can match the
-    * empty list. */
+    * empty list. Once this check passes, every rule atom before the list
+    * variable is matched against the host atom at the same position from
+    * the start, and every rule atom after it against the host atom at the
+    * same position from the end. */
    PTFI("if(label.length < %d) break;\n", indent + 3, label.length - 1); 
+   PTFI("HostAtom *item;\n", indent + 3);
    PTFI("/* Matching from the start of the host list. */\n", indent + 3);
-   PTFI("HostListItem *item = label.list->first;\n", indent + 3);
-   int atom_count = 1;
+   int prefix_atoms = 0;
+   item = label.list->first;
    while(item != NULL)
    {
       if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR) break;
-      PTFI("/* Check if the end of the host list has been reached. */\n", indent + 3);
-      PTFI("if(item == NULL) break;\n", indent + 3);
-      PTFI("/* Matching rule atom %d. */\n", indent + 3, atom_count);
+      PTFI("/* Matching rule atom %d. */\n", indent + 3, prefix_atoms + 1);
+      PTFI("item = &label.list->atoms[%d];\n", indent + 3, prefix_atoms);
       generateAtomMatchingCode(rule, item->atom, indent + 3);
-      PTFI("item = item->next;\n\n", indent + 3);
-      atom_count++;
+      PTF("\n");
+      prefix_atoms++;
       item = item->next;
    }
-
-   item = label.list->last;
    if(!result_declared)
    {
       PTFI("int result = -1;\n", indent + 3);
       result_declared = true;
    }
-   PTFI("HostListItem *start = item;\n", indent + 3);
-   PTFI("item = label.list->last;\n", indent + 3);
-   int host_atoms_matched = atom_count -1;
-   atom_count = label.length;
-   if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR)
+   int suffix_atoms = 0;
+   item = label.list->last;
+   if(!(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR))
+      PTFI("/* Matching from the end of the host list. */\n", indent + 3);
+   while(item != NULL)
    {
-      PTFI("/* Matching list variable %d. */\n", indent + 3, list_variable_id);
-      /* All host atoms are matched: assign the empty list to the list variable. */
-      PTFI("if(start == NULL) result = addListAssignment(morphism, %d, NULL);\n", 
-           indent + 3, list_variable_id);
+      if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR) break;
+      suffix_atoms++;
+      PTFI("/* Matching rule atom %d. */\n", indent + 3, label.length - suffix_atoms + 1);
+      PTFI("item = &label.list->atoms[label.length - %d];\n", indent + 3, suffix_atoms);
+      generateAtomMatchingCode(rule, item->atom, indent + 3);
+      PTF("\n");
+      item = item->prev;
    }
-   else
-   {
-      PTFI("/* The current host list position marks the start of the list that is\n", indent + 3);
-      PTFI("   assigned to the list variable. */\n", indent + 3);
-      PTFI("/* More rule atoms to match. If the end of the host list is reached, break. */\n",
-           indent + 3);
-      PTFI("if(start == NULL) break;\n\n", indent + 3);
-      PTFI("/* Matching from the end of the host list. */\n", indent + 3);
-      while(item != NULL)
-      {
-         if(item->atom->type == VARIABLE && item->atom->variable.type == LIST_VAR) break;
-         PTFI("/* Check if the host list has passed \"start\". */\n", indent + 3);
-         PTFI("if(item == start->prev) break;\n", indent + 3);
-         PTFI("/* Matching rule atom %d */\n", indent + 3, atom_count);
-         generateAtomMatchingCode(rule, item->atom, indent + 3);
-         PTFI("item = item->prev;\n", indent + 3);
-         atom_count--;
-         item = item->prev;
-      }
-      /* Assign the list variable to the rest of the host list. */
-      PTFI("/* Matching list variable %d. */\n", indent + 3, list_variable_id);
-
-      /* All host atoms are matched: assign the empty list to the list variable. */
-      PTFI("if(item == start->prev) ", indent + 3);
-      PTF("result = addListAssignment(morphism, %d, NULL);\n", list_variable_id);
-   }  
 
+   /* The list variable is assigned the host atoms between the matched prefix
+    * and the matched suffix. */
+   PTFI("/* Matching list variable %d. */\n", indent + 3, list_variable_id);
+   PTFI("unsigned sublist_length = label.length - %d;\n", indent + 3, 
+        prefix_atoms + suffix_atoms);
+   /* All host atoms are matched: assign the empty list to the list variable. */
+   PTFI("if(sublist_length == 0) result = addListAssignment(morphism, %d, NULL);\n", 
+        indent + 3, list_variable_id);
    /* All but 1 host atoms are matched: assign the remaining host atom to the list variable. */
-   PTFI("else if(item == start)\n", indent + 3);
+   PTFI("else if(sublist_length == 1)\n", indent + 3);
    PTFI("{\n", indent + 3);
-   PTFI("if(item->atom.type == 'i') result = addIntegerAssignment(morphism, %d, item->atom.num);\n", 
+   PTFI("item = &label.list->atoms[%d];\n", indent + 6, prefix_atoms);
+   PTFI("if(item->type == 'i') result = addIntegerAssignment(morphism, %d, item->num);\n", 
         indent + 6, list_variable_id);
-   PTFI("else result = addStringAssignment(morphism, %d, item->atom.str);\n", 
+   PTFI("else result = addStringAssignment(morphism, %d, item->str);\n", 
         indent + 6, list_variable_id);
    PTFI("}\n", indent + 3);
 
@@ -285,17 +314,8 @@ void generateVariableListMatchingCode(Rule *rule, RuleLabel label, int indent)
    PTFI("{\n", indent + 3);
    PTFI("/* Assign to variable %d the unmatched sublist of the host list. */\n",
         indent + 6, list_variable_id);
-   host_atoms_matched += (label.length - atom_count);
-   PTFI("HostAtom sublist[label.length - %d];\n", indent + 6, host_atoms_matched);
-   PTFI("int list_index = 0;\n", indent + 6);
-   PTFI("HostListItem *iterator = start;\n", indent + 6);
-   PTFI("while(iterator != item->next)\n", indent + 6);
-   PTFI("{\n", indent + 6);
-   PTFI("sublist[list_index++] = iterator->atom;\n", indent + 9);
-   PTFI("iterator = iterator->next;\n", indent + 9);
-   PTFI("}\n", indent + 6);
-   PTFI("HostList *list = makeHostList(sublist, label.length - %hu, false);\n", indent + 6,  
-        (unsigned short) host_atoms_matched);
+   PTFI("HostList *list = makeHostList(&label.list->atoms[%d], sublist_length, false);\n",
+        indent + 6, prefix_atoms);
    PTFI("result = addListAssignment(morphism, %d, list);\n", indent + 6,
         list_variable_id);
    PTFI("}\n", indent + 3);
@@ -315,18 +335,28 @@ static void generateAtomMatchingCode(Rule *rule, RuleAtom *atom, int indent)
            break;
       
       case INTEGER_CONSTANT:
-           PTFI("if(item->atom.type != 'i') break;\n", indent);
-           PTFI("else if(item->atom.num != %d) break;\n", indent, atom->number);
+           PTFI("if(item->type != 'i') break;\n", indent);
+           PTFI("else if(item->num != %ld) break;\n", indent, atom->number);
            break;
 
       case STRING_CONSTANT:
-           PTFI("if(item->atom.type != 's') break;\n", indent);
-           PTFI("else if(strcmp(item->atom.str, \"%s\") != 0) break;\n",
-                indent, atom->string);
+           /* Host strings are interned, so the comparison is a pointer compare
+            * against the interned constant. */
+           if(lookup_string_constants)
+           {
+              PTFI("if(item->type != 's') break;\n", indent);
+              PTFI("else if(item->str != lookupString(\"%s\")) break;\n", indent, atom->string);
+              break;
+           }
+           PTFI("static string constant%d = NULL;\n", indent, string_constant_count);
+           PTFI("if(item->type != 's') break;\n", indent);
+           PTFI("else if(item->str != internConstant(&constant%d, \"%s\")) break;\n",
+                indent, string_constant_count, atom->string);
+           string_constant_count++;
            break;
 
       case CONCAT:
-           PTFI("if(item->atom.type != 's') break;\n", indent);
+           PTFI("if(item->type != 's') break;\n", indent);
            PTFI("else\n", indent);
            PTFI("{\n", indent);
            generateConcatMatchingCode(rule, atom, indent + 3);
@@ -351,35 +381,35 @@ static void generateVariableMatchingCode(Rule *rule, RuleAtom *atom, int indent)
    {
       case INTEGER_VAR:
            PTFI("/* Matching integer variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type != 'i') break;\n", indent);
-           PTFI("result = addIntegerAssignment(morphism, %d, item->atom.num);\n",
+           PTFI("if(item->type != 'i') break;\n", indent);
+           PTFI("result = addIntegerAssignment(morphism, %d, item->num);\n",
                 indent, atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
 
       case CHARACTER_VAR:
            PTFI("/* Matching character variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type != 's') break;\n", indent);
-           PTFI("if(strlen(item->atom.str) != 1) break;\n", indent);
-           PTFI("result = addStringAssignment(morphism, %d, item->atom.str);\n", 
+           PTFI("if(item->type != 's') break;\n", indent);
+           PTFI("if(stringLength(item->str) != 1) break;\n", indent);
+           PTFI("result = addStringAssignment(morphism, %d, item->str);\n", 
                 indent , atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
 
       case STRING_VAR:
            PTFI("/* Matching string variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type != 's') break;\n", indent);
-           PTFI("result = addStringAssignment(morphism, %d, item->atom.str);\n",
+           PTFI("if(item->type != 's') break;\n", indent);
+           PTFI("result = addStringAssignment(morphism, %d, item->str);\n",
                 indent, atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
 
       case ATOM_VAR:
            PTFI("/* Matching atom variable %d. */\n", indent, atom->variable.id);
-           PTFI("if(item->atom.type == 'i') "
-                "result = addIntegerAssignment(morphism, %d, item->atom.num);\n",
+           PTFI("if(item->type == 'i') "
+                "result = addIntegerAssignment(morphism, %d, item->num);\n",
                 indent, atom->variable.id);
-           PTFI("else result = addStringAssignment(morphism, %d, item->atom.str);\n",
+           PTFI("else result = addStringAssignment(morphism, %d, item->str);\n",
                 indent, atom->variable.id);
            generateVariableResultCode(rule, atom->variable.id, false, indent);
            break;
@@ -396,8 +426,12 @@ static void generateVariableMatchingCode(Rule *rule, RuleAtom *atom, int indent)
    }
 }
 
+/* Declared by generateStringMatchingCode in the scope of host_string. */
+static bool offset_declared = false;
+
 static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
 {
+   offset_declared = false;
    StringList *list = NULL;
    list = stringExpToList(list, atom->bin_op.left_exp);
    list = stringExpToList(list, atom->bin_op.right_exp);
@@ -414,18 +448,24 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
       iterator = iterator->next;
    }
    iterator = list;
-   PTFI("string host_string = item->atom.str;\n", indent);
-   PTFI("unsigned int start = 0, end = strlen(host_string) - 1;\n\n", indent);
+   PTFI("string host_string = item->str;\n", indent);
+   PTFI("unsigned int host_length = stringLength(host_string);\n", indent);
+   if(has_string_variable) PTFI("unsigned int start = 0, end = host_length - 1;\n\n", indent);
+   else PTFI("unsigned int start = 0;\n\n", indent);
    /* If there is no string variable, iterate through the StringList and 
-    * generate code for each string expression. */
+    * generate code for each string expression. The expressions must cover
+    * the whole host string. */
    if(!has_string_variable)
    {
       while(iterator != NULL) 
       {
-         PTFI("if(start >= strlen(host_string)) break;\n", indent);
+         PTFI("if(start >= host_length) break;\n", indent);
          generateStringMatchingCode(rule, iterator, true, indent);
          iterator = iterator->next;
       }
+      PTFI("if(start != host_length) break;\n", indent);
+      freeStringList(list);
+      return;
    }
    /* Otherwise, iterate through the StringList until the string variable
     * is reached, generating code for each string expression, then iterate
@@ -435,11 +475,11 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
       PTFI("/* Matching from the start of the host string. */\n", indent);
       while(iterator->type != 3) 
       {
-         PTFI("if(start >= strlen(host_string)) break;\n", indent);
+         PTFI("if(start >= host_length) break;\n", indent);
          generateStringMatchingCode(rule, iterator, true, indent);
          iterator = iterator->next;
       }
-      PTFI("if(start > strlen(host_string)) break;\n", indent);
+      PTFI("if(start > host_length) break;\n", indent);
       /* Move iterator to the end of the list. */
       while(iterator != NULL) 
       {
@@ -447,12 +487,13 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
          iterator = iterator->next;
       }
       /* This loop is not executed if the string variable is the last item in
-       * the string list. */
+       * the string list. The characters from start to end are left to match,
+       * none if end + 1 is start. */
       PTF("\n");
       PTFI("/* Matching from the end of the host string. */\n", indent);
       while(iterator->type != 3) 
       {
-         PTFI("if(end < start) break;\n", indent );
+         PTFI("if(end + 1 == start) break;\n", indent);
          generateStringMatchingCode(rule, iterator, false, indent);
          iterator = iterator->prev;
       }
@@ -462,25 +503,16 @@ static void generateConcatMatchingCode(Rule *rule, RuleAtom *atom, int indent)
       PTFI("int result = -1;\n", indent);
       result_declared = true;
    }
-   /* Assign the string variable to the rest of the host string. */
+   /* Assign the string variable to the rest of the host string, which is
+    * empty if end is start - 1. The characters are passed in place. */
    PTF("\n");
    PTFI("/* Matching string variable %d. */\n", indent, iterator->variable_id);
-   PTFI("if(end == start - 1) ", indent);
-   PTF("result = addStringAssignment(morphism, %d, \"\");\n", iterator->variable_id);
-   PTFI("else\n", indent);
-   PTFI("{\n", indent);
-   PTFI("char substring[end - start + 1];\n", indent + 3);
-   PTFI("strncpy(substring, host_string + start, end - start + 1);\n", indent + 3);
-   PTFI("substring[end - start + 1] = '\\0';\n", indent + 3);
-   PTFI("result = addStringAssignment(morphism, %d, substring);\n", 
-        indent + 3, iterator->variable_id);
+   PTFI("result = addSubstringAssignment(morphism, %d, host_string + start, end - start + 1);\n",
+        indent, iterator->variable_id);
    generateVariableResultCode(rule, iterator->variable_id, false, indent);
-   PTFI("}\n", indent);
    freeStringList(list);
 }
 
-bool offset_declared = false, host_character_declared = false;
-
 static void generateStringMatchingCode(Rule *rule, StringList *string_exp, 
                                        bool prefix, int indent)
 {
@@ -494,8 +526,8 @@ static void generateStringMatchingCode(Rule *rule, StringList *string_exp,
             PTFI("unsigned int offset = 0;\n", indent);
             offset_declared = true;
          }
-         PTFI("offset = isPrefix(\"%s\", host_string + start);\n",
-              indent, string_exp->constant);
+         PTFI("offset = isPrefix(\"%s\", %d, host_string + start, host_length - start);\n",
+              indent, string_exp->constant, (int) strlen(string_exp->constant));
          PTFI("if(offset == -1) break; else start += offset;\n", indent);
       }
       else
@@ -505,9 +537,9 @@ static void generateStringMatchingCode(Rule *rule, StringList *string_exp,
             PTFI("unsigned int offset = 0;\n", indent);
             offset_declared = true;
          }
-         PTFI("offset = isSuffix(\"%s\", host_string);\n", 
-              indent, string_exp->constant);
-         PTFI("if(offset == -1) break; else end -= offset;\n", indent);
+         PTFI("offset = isSuffix(\"%s\", %d, host_string + start, end + 1 - start);\n",
+              indent, string_exp->constant, (int) strlen(string_exp->constant));
+         PTFI("if(offset == -1) break; else end = start + offset - 1;\n", indent);
       }
    }
    /* Character Variable */
@@ -521,21 +553,8 @@ static void generateStringMatchingCode(Rule *rule, StringList *string_exp,
          result_declared = true;
       }
       PTFI("/* Matching character variable %d. */\n", indent, string_exp->variable_id);
-      if(!host_character_declared)
-      {
-         PTFI("char host_character[2] = ", indent);
-         host_character_declared = true;
-         if(prefix) PTF("{host_string[start++], '\\0'};\n");
-         else PTF("{host_string[end--], '\\0'};\n");
-      }
-      else
-      {
-         PTFI("host_character[0] = ", indent);
-         if(prefix) PTF("host_string[start++];\n");
-         else PTF("host_string[end--];\n");
-      }
-      PTFI("result = addStringAssignment(morphism, %d, host_character);\n",
-           indent, string_exp->variable_id);
+      PTFI("result = addSubstringAssignment(morphism, %d, host_string + %s, 1);\n",
+           indent, string_exp->variable_id, prefix ? "start++" : "end--");
       generateVariableResultCode(rule, string_exp->variable_id, false, indent);
    }
 }
@@ -584,7 +603,7 @@ void generateVariableCode(int id, GPType type)
    switch(type)
    {
       case INTEGER_VAR:
-           PTFI("int var_%d = getIntegerValue(morphism, %d);\n", 3, id, id);
+           PTFI("long var_%d = getIntegerValue(morphism, %d);\n", 3, id, id);
            break;
 
       case CHARACTER_VAR:
@@ -642,7 +661,7 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
       }
       else
       {
-         PTFI("unsigned short list_length%d = 0;\n", indent, count);
+         PTFI("unsigned list_length%d = 0;\n", indent, count);
          PTFI("HostAtom *array%d = NULL;\n", indent, count);
       }
       return;
@@ -652,7 +671,9 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
     * its length to the runtime accumulator <list_var_length>. A compile-time
     * accumulator <number_of_atoms> counts the number of non-list-variable atoms. */
    int number_of_atoms = 0;
-   PTFI("unsigned short list_var_length%d = 0;\n", indent, count);
+   /* Concatenated strings evaluated for this label are numbered from here. */
+   int first_concat = length_count;
+   PTFI("unsigned list_var_length%d = 0;\n", indent, count);
    RuleListItem *item = label.list->first;
    while(item != NULL)
    {
@@ -662,9 +683,9 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
       else number_of_atoms++;
       item = item->next;
    }
-   PTFI("unsigned short list_length%d = list_var_length%d + %d;\n", indent, count, count, number_of_atoms);
+   PTFI("unsigned list_length%d = list_var_length%d + %d;\n", indent, count, count, number_of_atoms);
    PTFI("HostAtom array%d[list_length%d];\n", indent, count, count);
-   PTFI("int index%d = 0;\n\n", indent, count);
+   PTFI("unsigned index%d = 0;\n\n", indent, count);
    /* Generate code to build the list. */
    item = label.list->first;
    while(item != NULL)
@@ -674,12 +695,22 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
       {
          case INTEGER_CONSTANT:
               PTFI("array%d[index%d].type = 'i';\n", indent, count, count);
-              PTFI("array%d[index%d++].num = %d;\n", indent, count, count, atom->number);
+              PTFI("array%d[index%d++].num = %ld;\n", indent, count, count, atom->number);
               break;
 
          case STRING_CONSTANT:
               PTFI("array%d[index%d].type = 's';\n", indent, count, count);
-              PTFI("array%d[index%d++].str = \"%s\";\n", indent, count, count, atom->string);
+              /* Lists built for the host graph hold interned strings. Lists
+               * evaluated in conditions are only compared, so constants are
+               * used as they are. */
+              if(context < 2)
+              {
+                 PTFI("static string constant%d = NULL;\n", indent, string_constant_count);
+                 PTFI("array%d[index%d++].str = internConstant(&constant%d, \"%s\");\n",
+                      indent, count, count, string_constant_count, atom->string);
+                 string_constant_count++;
+              }
+              else PTFI("array%d[index%d++].str = \"%s\";\n", indent, count, count, atom->string);
               break;
 
          case VARIABLE:
@@ -717,12 +748,9 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
               {
                  PTFI("if(var_%d.type == 'l' && var_%d.list != NULL)\n", indent, id, id);
                  PTFI("{\n", indent);
-                 PTFI("HostListItem *item%d = var_%d.list->first;\n", indent + 3, count, id);
-                 PTFI("while(item%d != NULL)\n", indent + 3, count);
-                 PTFI("{\n", indent + 3);
-                 PTFI("array%d[index%d++] = item%d->atom;\n", indent + 6, count, count, count);
-                 PTFI("item%d = item%d->next;\n", indent + 6, count, count);
-                 PTFI("}\n", indent + 3);
+                 PTFI("memcpy(array%d + index%d, var_%d.list->atoms, var_%d.list->length * sizeof(HostAtom));\n",
+                      indent + 3, count, count, id, id);
+                 PTFI("index%d += var_%d.list->length;\n", indent + 3, count, id);
                  PTFI("}\n", indent);
                  PTFI("else if(var_%d.type == 'i')\n", indent, id);
                  PTFI("{\n", indent);
@@ -776,13 +804,33 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
                * concatenated, and updates the runtime length variable with the 
                * total length of the concatenated string. */
               generateStringLengthCode(atom, indent);
-              /* Build host_string from the evaluated strings that make up the
-               * RHS label. */
-              PTFI("char host_string%d[length%d + 1];\n", indent, length_count, length_count);
-              generateStringExpression(atom, true, indent);
-              PTFI("host_string%d[length%d] = '\\0';\n\n", indent, length_count, length_count);
-              PTFI("array%d[index%d].type = 's';\n", indent, count, count); 
-              PTFI("array%d[index%d++].str = host_string%d;\n", indent, count, count, length_count);
+              /* Strings for the host graph are built in the scratch builder of
+               * the rule and interned from it. A string evaluated in a
+               * condition is only compared, and must stay valid while the
+               * other strings of the condition are built, so it is built on
+               * the stack. */
+              if(context < 2)
+              {
+                 PTFI("startString(&scratch, length%d);\n", indent, length_count);
+                 generateStringExpression(atom, "&scratch", indent);
+                 /* The reference taken here is removed once the list is built. */
+                 PTFI("string interned%d = makeStringOfLength(scratch.chars, scratch.length);\n",
+                      indent, length_count);
+                 PTFI("array%d[index%d].type = 's';\n", indent, count, count);
+                 PTFI("array%d[index%d++].str = interned%d;\n", indent, count, count, length_count);
+              }
+              else
+              {
+                 PTFI("char host_string%d[length%d + 1];\n", indent, length_count, length_count);
+                 PTFI("StringBuilder builder%d = {host_string%d, 0, length%d + 1};\n", indent,
+                      length_count, length_count, length_count);
+                 char builder[20];
+                 sprintf(builder, "&builder%d", length_count);
+                 generateStringExpression(atom, builder, indent);
+                 PTFI("array%d[index%d].type = 's';\n", indent, count, count);
+                 PTFI("array%d[index%d++].str = finishString(&builder%d);\n", indent, count,
+                      count, length_count);
+              }
               length_count++;
               break;
       
@@ -808,6 +856,12 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
       PTFI("{\n", indent);
       PTFI("HostList *list%d = makeHostList(array%d, list_length%d, false);\n",
            indent + 3, count, count, count);
+      if(!minimal_gc)
+      {
+         int concat;
+         for(concat = first_concat; concat < length_count; concat++)
+            PTFI("removeString(interned%d);\n", indent + 3, concat);
+      }
       if(label.mark == ANY)
          PTFI("label = makeHostLabel(host_label%d.mark, list_length%d, list%d);\n", 
               indent + 3, host_label_count, count, count);
@@ -825,21 +879,21 @@ void generateLabelEvaluationCode(RuleLabel label, bool node, int count, int cont
 /* Navigates an integer expression tree and writes the arithmetic expression it 
  * represents. For example, given the label (i + 1) * length(s), where i is an
  * integer variable and s is a string variable, generateIntExpression prints:
- * (i_var + 1) * (int)strlen(s_var); */
+ * (i_var + 1) * (int)stringLength(s_var); */
 void generateIntExpression(RuleAtom *atom, int context, bool nested)
 {
    switch(atom->type)
    {
       case INTEGER_CONSTANT:
-           PTF("%d", atom->number);
+           PTF("%ld", atom->number);
            break;
 
       case LENGTH:
            if(atom->variable.type == STRING_VAR)
-              PTF("(int)strlen(var_%d)", atom->variable.id);
+              PTF("(int)stringLength(var_%d)", atom->variable.id);
 
            else if(atom->variable.type == ATOM_VAR)
-              PTF("((var_%d.type == 's') ? (int)strlen(var_%d.str) : 1)", 
+              PTF("((var_%d.type == 's') ? (int)stringLength(var_%d.str) : 1)", 
                   atom->variable.id, atom->variable.id);
 
            else if(atom->variable.type == LIST_VAR)
@@ -901,31 +955,28 @@ void generateIntExpression(RuleAtom *atom, int context, bool nested)
  * For example, "a".s.c (s string variable, c character variable) is as follows.
  * generateStringLengthCode prints:
  * length = 0; 
- * length += strlen("a"); 
- * length += strlen(s_var);
- * length += strlen(c_var);
- *
- * The character array host_string of size <length> is created by the caller
- * before calling generateStringExpression. 
+ * length += 1;
+ * length += stringLength(s_var);
+ * length += stringLength(c_var);
  *
- * generateStringExpression prints:
- * host_string = strcpy(host_string, "a"); 
- * host_string = strcat(host_string, s_var); 
- * host_string = strcat(host_string, c_var);
+ * The caller starts a string builder with room for <length> characters before
+ * calling generateStringExpression, which appends each piece with its length:
+ * appendChars(builder, "a", 1);
+ * appendChars(builder, s_var, stringLength(s_var));
+ * appendChars(builder, c_var, stringLength(c_var));
  *
- * The 'bool first' argument of generateStringExpression is used to control
- * which of 'strcpy' and 'strcat' is printed. C doesn't like it when you call
- * strcpy on a newly-created character array. */ 
+ * The variables hold interned strings, so no piece is scanned for its length
+ * and each is copied once. */ 
 void generateStringLengthCode(RuleAtom *atom, int indent)
 {
    switch(atom->type)
    {
       case STRING_CONSTANT:
-           PTFI("length%d += strlen(\"%s\");\n", indent, length_count, atom->string);
+           PTFI("length%d += %d;\n", indent, length_count, (int) strlen(atom->string));
            break;
 
       case VARIABLE:
-           PTFI("length%d += strlen(var_%d);\n", indent, length_count, atom->variable.id);
+           PTFI("length%d += stringLength(var_%d);\n", indent, length_count, atom->variable.id);
            break;
 
       case CONCAT:
@@ -940,26 +991,23 @@ void generateStringLengthCode(RuleAtom *atom, int indent)
    }
 }
 
-void generateStringExpression(RuleAtom *atom, bool first, int indent)
+void generateStringExpression(RuleAtom *atom, string builder, int indent)
 {
    switch(atom->type)
    { 
       case STRING_CONSTANT:
-           if(first) PTFI("strcpy(host_string%d, \"%s\");\n", indent, 
-                          length_count, atom->string);
-           else PTFI("strcat(host_string%d, \"%s\");\n", indent, 
-                     length_count, atom->string);
+           PTFI("appendChars(%s, \"%s\", %d);\n", indent, builder, atom->string,
+                (int) strlen(atom->string));
+           break;
 
       case VARIABLE:
-           if(first) PTFI("strcpy(host_string%d, var_%d);\n", indent, 
-                          length_count, atom->variable.id);
-           else PTFI("strcat(host_string%d, var_%d);\n", indent, 
-                     length_count, atom->variable.id);
+           PTFI("appendChars(%s, var_%d, stringLength(var_%d));\n", indent, builder,
+                atom->variable.id, atom->variable.id);
            break;
 
       case CONCAT:
-           generateStringExpression(atom->bin_op.left_exp, first, indent);
-           generateStringExpression(atom->bin_op.right_exp, false, indent);
+           generateStringExpression(atom->bin_op.left_exp, builder, indent);
+           generateStringExpression(atom->bin_op.right_exp, builder, indent);
            break;
           
       default:
@@ -39,6 +39,11 @@
 /* Used by genLabel, genRule and genCondition. Defined in genRule. */
 extern FILE *file;
 
+/* Set by genRule while it generates matchers that may run on several threads
+ * at once. Such matchers look up their string constants on each use instead
+ * of caching them in static variables. Defined in genLabel. */
+extern bool lookup_string_constants;
+
 /* Generates code to match a rule list not containing a list variable to a host graph list. */
 void generateFixedListMatchingCode(Rule *rule, RuleLabel label, int indent);
 
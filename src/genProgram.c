@@ -39,7 +39,8 @@ typedef enum {MAIN_BODY, IF_BODY, TRY_BODY, LOOP_BODY} ContextType;
 /* Structure containing data to pass between code generation functions.
  * context - The context of the current command.
  * loop_depth - Marks the current loop depth. Initialised at 0 and incremented
- *              when a loop body is entered. Used to generate correct backtracking
+ *              when a branch condition or a loop body that records changes is
+ *              entered. Used to generate correct backtracking
  *              management code for nested loops.
  * record_changes - Set to true if the command is a branch statement or loop
  *                  requiring graph recording in the condition or loop body
@@ -49,115 +50,252 @@ typedef enum {MAIN_BODY, IF_BODY, TRY_BODY, LOOP_BODY} ContextType;
  *                 Its value is assigned the value of the global restore_point_count.
  *		   The count is incremented when assigned to ensure unique restore
  *		   point names at runtime.
- * indent - For formatting the printed C code. */
+ * indent - For formatting the printed C code.
+ * resume_match - Set to true if the command is the rule call forming the body of
+ *                a loop, and rule calls with a resumable matcher call it.
+ * batch_apply - Set to true if the command is the rule call forming the body of
+ *               a loop compiled with -b. Calls of rules that are not predicates
+ *               apply a batch of disjoint matches.
+ * keep_match - Set to true if the command is the rule call forming the condition
+ *              of an if statement whose then-branch starts with a call of the
+ *              same rule. The match is kept for that call.
+ * reuse_match - Set to true if the command starts the then-branch of such an
+ *               if statement. Its first rule call applies the kept match
+ *               instead of matching again.
+ * procedure_level - Set to true if the command is in the body of a procedure
+ *                   function and not inside a C loop of it. A break there
+ *                   leaves the function instead (see breakStatement). */
  typedef struct CommandData {
    ContextType context;
    int loop_depth;
    bool record_changes;
    int restore_point;
    int indent;
+   bool resume_match;
+   bool batch_apply;
+   bool keep_match;
+   bool reuse_match;
+   bool procedure_level;
 } CommandData;
 
+/* Procedures that are called more than once and whose bodies are larger than
+ * this many commands are compiled to static functions of program.c. The
+ * others are inlined at their call sites. */
+#define PROCEDURE_INLINE_SIZE 4
+
+/* A function generated for a procedure. The code of a procedure body depends
+ * on the context of its call, so a function is generated for each distinct
+ * context the procedure is called from, and shared by the calls from that
+ * context. The function returns PROCEDURE_BREAK if the body breaks out of
+ * the loop of its caller, and PROCEDURE_END_RUN if it ends the run, after
+ * which the caller does the same.
+ * data - The context of the calls, with the restore point of the caller, if
+ *        any, numbered restore_point. The function takes its address as the
+ *        argument restore_point.
+ * number - The function is named run<procedure name><number>.
+ * breaks, ends_run - Set while the body is generated if it contains the
+ *                    corresponding return. */
+typedef struct ProcedureFunction {
+   CommandData data;
+   int restore_point;
+   int number;
+   bool breaks;
+   bool ends_run;
+   struct ProcedureFunction *next;
+} ProcedureFunction;
+
+/* The procedures of the program, with the number of their call sites, the
+ * size of their bodies and the functions generated for them. */
+typedef struct ProcedureInfo {
+   GPProcedure *procedure;
+   int calls;
+   int size;
+   ProcedureFunction *functions;
+} ProcedureInfo;
+
+static ProcedureInfo *procedures = NULL;
+static int procedure_count = 0, function_count = 0;
+
+/* The function whose body is being generated, or NULL while gp2_run is
+ * generated. The code of the functions is collected in procedure_code and
+ * printed before gp2_run. */
+static ProcedureFunction *current_function = NULL;
+static FILE *procedure_code = NULL;
+
+/* The number of checkpoint sites of gp2_run (see the lib's checkpoint module),
+ * numbered from 1, and the identifier of the program written to its
+ * checkpoints. */
+static int checkpoint_sites = 0;
+static unsigned checkpoint_program = 0;
+
+static void generateProgramHeader(string output_dir);
+static void generateProgramFunction(List *declarations, string output_dir);
 static void generateMorphismCode(List *declarations, char type, bool first_call);
 static void generateProgramCode(GPCommand *command, CommandData data);
 static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
-                             bool last_rule, CommandData data);
+                             bool last_rule, bool resume, int shared,
+                             unsigned change_kinds, CommandData data);
+static void generateRuleApplication(string rule_name, CommandData data, int indent);
+static void generateApplyCall(string rule_name, bool record_changes, int indent);
+static void generateRestoreCall(bool undo, int restore_point, int indent);
+static GPRule *sharedScanRule(List *rules);
+static bool sharesScan(GPRule *rule, GPRule *first);
+static void generateSharedScan(List *rules, GPRule *first, CommandData data);
+static void generateSharedScanCalls(List *rules, GPRule *first, int indent);
 static void generateBranchStatement(GPCommand *command, CommandData data);
 static void generateLoopStatement(GPCommand *command, CommandData data);
 static void generateFailureCode(string rule_name, CommandData data);
+static void countProcedureCalls(List *declarations);
+static void countCommandCalls(GPCommand *command);
+static int commandSize(GPCommand *command);
+static void generateProcedureCall(GPProcedure *procedure, CommandData data);
+static string breakStatement(CommandData data);
+static string endRunStatement(void);
+static string restorePoint(int restore_point);
+static bool checkpointSite(CommandData data);
+static unsigned programHash(List *declarations, unsigned hash);
 static bool nullCommand(GPCommand *command);
+static bool mayFail(GPCommand *command);
+static bool failsBeforeChanging(GPCommand *command);
 static bool singleRule(GPCommand *command);
+static bool singleRuleCall(GPCommand *command);
+static GPCommand *leadingRuleCall(GPCommand *command);
 
-void generateRuntimeMain(List *declarations, string output_dir)
+/* Opens the named file in the output directory as the target of PTF. */
+static void openOutputFile(string output_dir, string name)
 {
-   int length = strlen(output_dir) + 7;
-   char main_file[length];
-   strcpy(main_file, output_dir);
-   strcat(main_file, "/main.c");
-   file = fopen(main_file, "w");
+   int length = strlen(output_dir) + strlen(name) + 2;
+   char file_name[length];
+   strcpy(file_name, output_dir);
+   strcat(file_name, "/");
+   strcat(file_name, name);
+   file = fopen(file_name, "w");
    if(file == NULL) {
-     perror(main_file);
+     perror(file_name);
      exit(1);
    }
+}
+
+/* Returns a temporary file for code printed out of order. */
+static FILE *openTemporaryFile(void)
+{
+   FILE *temporary = tmpfile();
+   if(temporary == NULL)
+   {
+      perror("tmpfile");
+      exit(1);
+   }
+   return temporary;
+}
+
+/* Copies the contents of the temporary file to the end of the target of PTF. */
+static void appendFile(FILE *source)
+{
+   char buffer[4096];
+   size_t length;
+   rewind(source);
+   while((length = fread(buffer, 1, sizeof(buffer), source)) > 0)
+      fwrite(buffer, 1, length, file);
+}
 
+void generateRuntimeMain(List *declarations, string output_dir)
+{
+   generateProgramHeader(output_dir);
+   generateProgramFunction(declarations, output_dir);
+
+   openOutputFile(output_dir, "main.c");
    PTF("#include <time.h>\n");
-   PTF("#include <Judy.h>\n");
+   PTF("#include \"batch.h\"\n");
+   PTF("#include \"checkpoint.h\"\n");
    PTF("#include \"common.h\"\n");
+   PTF("#include \"context.h\"\n");
    PTF("#include \"debug.h\"\n");
    PTF("#include \"graph.h\"\n");
-   PTF("#include \"graphStacks.h\"\n");
-   PTF("#include \"parser.h\"\n");
-   PTF("#include \"lexer.c\"\n");
-   PTF("#include \"morphism.h\"\n\n");
-
-   /* Declare the global morphism variables for each rule. */
-   generateMorphismCode(declarations, 'd', true);
+   PTF("#include \"graphWriter.h\"\n");
+   PTF("#include \"hostLoader.h\"\n");
+   PTF("#include \"program.h\"\n");
+   PTF("#include \"report.h\"\n");
+   PTF("#include \"snapshot.h\"\n\n");
 
-   if(!fast_shutdown)
-   {
-      /* Declare the runtime global variables and functions. */
-      generateMorphismCode(declarations, 'f', true);
-
-      PTF("static void garbageCollect(void)\n");
-      PTF("{\n");
-      PTF("   freeMorphisms();\n");
-      PTF("   freeGraphChangeStack();\n");
-      PTF("   freeGraph(host);\n");
-      PTF("   freeHostListStore();\n");
-      PTF("}\n\n");
-   }
-
-   PTF("Graph *host = NULL;\n");
-   PTF("Pvoid_t node_map = (Pvoid_t) NULL;\n\n");
-
-   /* Print the function that builds the host graph via the host graph parser. */
+   /* Print the function that builds the host graph with the host graph loader. */
    PTF("static Graph *buildHostGraph(char *host_file)\n");
    PTF("{\n");
-   PTFI("yyin = fopen(host_file, \"r\");\n", 3);
-   PTFI("if(yyin == NULL)\n", 3);
-   PTFI("{\n", 3);
-   PTFI("perror(host_file);\n", 6);
-   PTFI("return NULL;\n", 6);
-   PTFI("}\n\n", 3);
-   PTFI("host = newGraph();\n", 3);
-   PTFI("setStackGraph(host);\n", 3);
-   PTFI("/* The parser populates the host graph using node_map to add edges with\n", 3);
-   PTFI(" * the correct source and target indices. */\n", 3);
-   PTFI("int result = yyparse();\n", 3);
-   PTFI("fclose(yyin);\n", 3);
-   PTFI("yylex_destroy();\n", 3);
-   PTFI("yy_delete_buffer(YY_CURRENT_BUFFER);\n", 3);
-   PTFI("Word_t Rc_word;\n", 3);
-   PTFI("JLFA(Rc_word, node_map);\n", 3);
-   PTFI("if(result == 0) return host;\n", 3);
-   PTFI("else\n", 3);
-   PTFI("{\n", 3);
-   if(!fast_shutdown) PTFI("freeGraph(host);\n", 6);
-   PTFI("return NULL;\n", 6);
-   PTFI("}\n", 3);
+   PTFI("/* Binary snapshots are mapped and built directly, bypassing the parser. */\n", 3);
+   PTFI("if(isGraphSnapshot(host_file)) return loadGraphSnapshot(host_file);\n", 3);
+   PTFI("return loadHostGraph(host_file);\n", 3);
    PTF("}\n\n");
 
-   PTF("bool success = true;\n\n");
-
    /* Open the runtime's main function and set up the execution environment. */
    PTF("int main(int argc, char **argv)\n");
    PTF("{\n");
    PTFI("srand(time(NULL));\n", 3);
    PTFI("openLogFile(\"gp2.log\");\n\n", 3);
-   PTFI("if(argc != 2)\n", 3);
+   PTFI("/* --snapshot writes the output graph in the binary snapshot format.\n", 3);
+   PTFI(" * --dense-ids numbers the nodes and edges of the output graph densely.\n", 3);
+   PTFI(" * --jobs <n> runs the program on the host files on n worker processes.\n", 3);
+   PTFI(" * --manifest <file> reads the host files from the file, one per line.\n", 3);
+   PTFI(" * With several host files, the output of each goes to <host file>.output.\n", 3);
+   PTFI(" * --checkpoint <file> writes a checkpoint to the file on SIGUSR1.\n", 3);
+   PTFI(" * --checkpoint-interval <s> also writes one every s seconds.\n", 3);
+   PTFI(" * --resume continues the run of the checkpoint instead of reading a host file.\n", 3);
+   PTFI(" * The checkpoint file is gp2.checkpoint unless given. */\n", 3);
+   PTFI("bool snapshot_output = false, dense_ids = false, resume = false;\n", 3);
+   PTFI("int jobs = 0, host_count = 0, checkpoint_interval = 0;\n", 3);
+   PTFI("char *manifest = NULL, *checkpoint_file = NULL, *host_files[argc];\n", 3);
+   PTFI("for(int arg = 1; arg < argc; arg++)\n", 3);
+   PTFI("{\n", 3);
+   PTFI("if(strcmp(argv[arg], \"--snapshot\") == 0) snapshot_output = true;\n", 6);
+   PTFI("else if(strcmp(argv[arg], \"--dense-ids\") == 0) dense_ids = true;\n", 6);
+   PTFI("else if(strcmp(argv[arg], \"--jobs\") == 0 && arg + 1 < argc) jobs = atoi(argv[++arg]);\n", 6);
+   PTFI("else if(strcmp(argv[arg], \"--manifest\") == 0 && arg + 1 < argc) manifest = argv[++arg];\n", 6);
+   PTFI("else if(strcmp(argv[arg], \"--checkpoint\") == 0 && arg + 1 < argc)\n", 6);
+   PTFI("checkpoint_file = argv[++arg];\n", 9);
+   PTFI("else if(strcmp(argv[arg], \"--checkpoint-interval\") == 0 && arg + 1 < argc)\n", 6);
+   PTFI("checkpoint_interval = atoi(argv[++arg]);\n", 9);
+   PTFI("else if(strcmp(argv[arg], \"--resume\") == 0) resume = true;\n", 6);
+   PTFI("else host_files[host_count++] = argv[arg];\n", 6);
+   PTFI("}\n", 3);
+   PTFI("if(checkpoint_file == NULL && (resume || checkpoint_interval > 0))\n", 3);
+   PTFI("checkpoint_file = \"gp2.checkpoint\";\n", 6);
+   PTFI("if(manifest != NULL || host_count > 1 || jobs > 0)\n", 3);
+   PTFI("{\n", 3);
+   PTFI("char **batch_files = host_files;\n", 6);
+   PTFI("if(manifest != NULL) batch_files = readManifest(manifest, &host_count);\n", 6);
+   PTFI("if(batch_files == NULL) return 1;\n", 6);
+   PTFI("BatchOptions options = {jobs, snapshot_output, dense_ids, %s};\n", 6,
+        profile_runtime ? "rule_profiles" : "NULL");
+   PTFI("bool completed = runBatch(gp2_run, batch_files, host_count, options);\n", 6);
+   PTFI("closeLogFile();\n", 6);
+   PTFI("return completed ? 0 : 1;\n", 6);
+   PTFI("}\n", 3);
+   PTFI("if(host_count == 0 && !resume)\n", 3);
    PTFI("{\n", 3);
    PTFI("fprintf(stderr, \"Error: missing <host-file> argument.\\n\");\n", 6);
    PTFI("return 0;\n", 6);
-   PTFI("}\n\n", 3);
-   PTFI("clock_t start_time_gb = clock();\n", 3);
-   PTFI("initialiseHostListStore();\n", 3);
+   PTFI("}\n", 3);
+   PTFI("char *host_file = host_files[0];\n\n", 3);
+   PTFI("startPhase(STARTUP_PHASE);\n", 3);
+   PTFI("GP2Context *context = makeContext();\n", 3);
 
-   PTFI("host = buildHostGraph(argv[1]);\n", 3);
-   PTFI("if(host == NULL)\n", 3);
+   PTFI("startPhase(PARSING_PHASE);\n", 3);
+   PTFI("Graph *graph = NULL;\n", 3);
+   PTFI("if(resume)\n", 3);
+   PTFI("{\n", 3);
+   PTFI("graph = loadCheckpoint(checkpoint_file, 0x%08xu, &context->resume_site);\n", 6,
+        checkpoint_program);
+   PTFI("if(graph == NULL)\n", 6);
+   PTFI("{\n", 6);
+   PTFI("fprintf(stderr, \"Error reading checkpoint file %%s.\\n\", checkpoint_file);\n", 9);
+   PTFI("return 0;\n", 9);
+   PTFI("}\n", 6);
+   PTFI("}\n", 3);
+   PTFI("else graph = buildHostGraph(host_file);\n", 3);
+   PTFI("if(graph == NULL)\n", 3);
    PTFI("{\n", 3);
    PTFI("fprintf(stderr, \"Error parsing host graph file.\\n\");\n", 6);
    PTFI("return 0;\n", 6);
    PTFI("}\n", 3);
+   PTFI("if(checkpoint_file != NULL) enableCheckpoints(checkpoint_file, checkpoint_interval);\n", 3);
 
    PTFI("FILE *output_file = fopen(\"gp2.output\", \"w\");\n", 3);
    PTFI("if(output_file == NULL)\n", 3);
@@ -165,11 +303,112 @@ void generateRuntimeMain(List *declarations, string output_dir)
    PTFI("perror(\"gp2.output\");\n", 6);
    PTFI("exit(1);\n", 6);
    PTFI("}\n", 3);
-   PTFI("clock_t start_time_ngb = clock();\n", 3);
+   PTFI("startPhase(EXECUTION_PHASE);\n", 3);
+   PTFI("if(gp2_run(context, graph))\n", 3);
+   PTFI("{\n", 3);
+   PTFI("startPhase(OUTPUT_PHASE);\n", 6);
+   PTFI("if(snapshot_output) printGraphSnapshot(context->host, output_file);\n", 6);
+   PTFI("else printGraphBuffered(context->host, output_file, dense_ids);\n", 6);
+   PTF("      #ifndef NDEBUG\n");
+   PTFI("printHostListStoreStats(log_file);\n", 6);
+   PTFI("printStringTableStats(log_file);\n", 6);
+   PTF("      #endif\n");
+   PTFI("printf(\"Output graph saved to file gp2.output\\n\");\n", 6);
+   PTFI("}\n", 3);
+   PTFI("else\n", 3);
+   PTFI("{\n", 3);
+   PTFI("fprintf(output_file, \"No output graph: %%s\\n\", context->failure);\n", 6);
+   PTFI("printf(\"Output information saved to file gp2.output\\n\");\n", 6);
+   PTFI("}\n", 3);
+   if(profile_runtime) PTFI("writeProfile(\"gp2.profile\", rule_profiles);\n", 3);
+   PTFI("recordMemory(context->host);\n", 3);
+   PTFI("startPhase(TEARDOWN_PHASE);\n", 3);
+   if(!fast_shutdown)
+   {
+      PTFI("gp2_free();\n", 3);
+      PTFI("freeContext(context);\n", 3);
+   }
+   PTFI("writeReport(\"gp2.report\");\n", 3);
+   PTFI("printf(\"Run report saved to file gp2.report\\n\");\n", 3);
+   PTFI("closeLogFile();\n", 3);
+   PTFI("fclose(output_file);\n", 3);
+   PTFI("return 0;\n", 3);
+   PTF("}\n\n");
+   fclose(file);
+}
 
+/* Prints program.h, the interface of the compiled program. */
+static void generateProgramHeader(string output_dir)
+{
+   openOutputFile(output_dir, "program.h");
+   PTF("#ifndef INC_PROGRAM_H\n");
+   PTF("#define INC_PROGRAM_H\n\n");
+   PTF("#include \"context.h\"\n");
+   PTF("#include \"graph.h\"\n");
+   if(profile_runtime) PTF("#include \"profile.h\"\n");
+   PTF("\n");
+   PTF("/* Runs the program on the graph, which the context takes over. Returns false\n");
+   PTF(" * if the program fails, with the reason in context->failure. Otherwise the\n");
+   PTF(" * output graph is context->host. */\n");
+   PTF("bool gp2_run(GP2Context *context, Graph *graph);\n\n");
+   PTF("/* Frees the morphisms allocated by the first run. */\n");
+   PTF("void gp2_free(void);\n\n");
+   if(profile_runtime)
+   {
+      PTF("/* The profiles of the rules, accumulated over all runs. */\n");
+      PTF("extern RuleProfile *rule_profiles[];\n\n");
+   }
+   PTF("#endif /* INC_PROGRAM_H */\n");
+   fclose(file);
+}
 
-   /* Print the calls to allocate memory for each morphism. */
+/* Prints program.c, which defines gp2_run: the commands of the main
+ * declaration, working on the global host graph. */
+static void generateProgramFunction(List *declarations, string output_dir)
+{
+   openOutputFile(output_dir, "program.c");
+   PTF("#include \"checkpoint.h\"\n");
+   PTF("#include \"common.h\"\n");
+   PTF("#include \"debug.h\"\n");
+   PTF("#include \"graph.h\"\n");
+   PTF("#include \"graphStacks.h\"\n");
+   PTF("#include \"morphism.h\"\n");
+   PTF("#include \"program.h\"\n\n");
+
+   /* Declare the global morphism variables for each rule. */
+   generateMorphismCode(declarations, 'd', true);
+   if(profile_runtime) generateMorphismCode(declarations, 'p', true);
    generateMorphismCode(declarations, 'm', true);
+   /* Morphisms are not freed with minimal garbage collection. */
+   if(!minimal_gc) generateMorphismCode(declarations, 'f', true);
+
+   PTF("Graph *host = NULL;\n");
+   PTF("bool success = true;\n\n");
+
+   PTF("void gp2_free(void)\n");
+   PTF("{\n");
+   if(!minimal_gc)
+   {
+      PTFI("if(!morphisms_made) return;\n", 3);
+      PTFI("freeMorphisms();\n", 3);
+      PTFI("morphisms_made = false;\n", 3);
+   }
+   PTF("}\n\n");
+
+   /* gp2_run is generated into a temporary file, so that the functions
+    * generated for procedures on the way can be printed before it. */
+   countProcedureCalls(declarations);
+   FILE *program_file = file;
+   file = openTemporaryFile();
+   procedure_code = openTemporaryFile();
+
+   PTF("bool gp2_run(GP2Context *context, Graph *graph)\n");
+   PTF("{\n");
+   PTFI("beginRun(context, graph);\n", 3);
+   PTFI("host = graph;\n", 3);
+   PTFI("success = true;\n", 3);
+   PTFI("if(!morphisms_made) makeMorphisms();\n", 3);
+   PTFI("if(context->resume_site > 0) goto resume;\n", 3);
 
    /* Find the main declaration and generate code from its command sequence. */
    List *iterator = declarations;
@@ -178,32 +417,53 @@ void generateRuntimeMain(List *declarations, string output_dir)
       GPDeclaration *decl = iterator->declaration;
       if(decl->type == MAIN_DECLARATION)
       {
-         CommandData initialData = {MAIN_BODY, 0, false, -1, 3};
+         CommandData initialData = {MAIN_BODY, 0, false, -1, 3, false, false, false, false,
+                                    false};
          generateProgramCode(decl->main_program, initialData);
       }
       iterator = iterator->next;
    }
+   PTFI("endRun(context, host, NULL);\n", 3);
+   PTFI("return true;\n\n", 3);
+   /* A resumed run jumps to the site of its checkpoint. */
+   PTF("resume:\n");
+   PTFI("{\n", 3);
+   PTFI("int site = context->resume_site;\n", 6);
+   PTFI("context->resume_site = 0;\n", 6);
+   PTFI("switch(site)\n", 6);
+   PTFI("{\n", 6);
+   for(int site = 1; site <= checkpoint_sites; site++)
+      PTFI("case %d: goto checkpoint%d;\n", 9, site, site);
+   PTFI("}\n", 6);
+   PTFI("}\n", 3);
+   PTFI("endRun(context, host, \"Unknown checkpoint site.\");\n", 3);
+   PTFI("return false;\n", 3);
+   PTF("}\n\n");
 
-   PTF("   double elapsed_time_gb = (double)(clock()-start_time_gb)/CLOCKS_PER_SEC;\n");
-   PTF("   double elapsed_time_ngb = (double)(clock()-start_time_ngb)/CLOCKS_PER_SEC;\n");
-   PTF("   FILE *bench = fopen(\"timings_gp2.dat\", \"w\");\n");
-   PTF("   fprintf(bench, \"Incl. graph building (ms): %%f\\n\", elapsed_time_gb*1000);\n");
-   PTF("   fprintf(bench, \"Excl. graph building (ms): %%f\", elapsed_time_ngb*1000);\n");
-   if(fast_shutdown) PTF("   printGraphFast(host, output_file);\n");
-   else
+   FILE *run_code = file;
+   file = program_file;
+   checkpoint_program = programHash(declarations, 2166136261u ^ (unsigned) checkpoint_sites);
+   PTF("#define CHECKPOINT_PROGRAM 0x%08xu\n\n", checkpoint_program);
+   if(function_count > 0)
+      PTF("typedef enum {PROCEDURE_CONTINUE = 0, PROCEDURE_BREAK, PROCEDURE_END_RUN} "
+          "ProcedureExit;\n\n");
+   appendFile(procedure_code);
+   appendFile(run_code);
+   fclose(procedure_code);
+   fclose(run_code);
+   fclose(file);
+
+   for(int index = 0; index < procedure_count; index++)
    {
-      PTF("   printGraph(host, output_file);\n");
-      PTF("   garbageCollect();\n");
+      ProcedureFunction *function = procedures[index].functions;
+      while(function != NULL)
+      {
+         ProcedureFunction *next = function->next;
+         free(function);
+         function = next;
+      }
    }
-
-   PTF("   closeLogFile();\n");
-   PTF("   printf(\"Output graph saved to file gp2.output\\n\");\n");
-   PTF("   printf(\"Execution timings saved to file timings_gp2.dat\\n\");\n");
-   PTF("   fclose(output_file);\n");
-   PTF("   fclose(bench);\n");
-   PTF("   return 0;\n");
-   PTF("}\n\n");
-   fclose(file);
+   free(procedures);
 }
 
 /* For each rule declaration, generate code to handle the morphism variables at
@@ -212,20 +472,26 @@ void generateRuntimeMain(List *declarations, string output_dir)
  *
  * Type (d)eclarations switches on the printing of the declaration of the global
  * morphism variables and the include directives to the <rule_name>.h headers.
- * This is called before the definition of the main function is printed.
+ * This is called before the definition of gp2_run is printed.
  *
- * Type (m)akeMorphism switches on the printing of the definition and allocation
- * of the morphism structures by the makeMorphism function. At runtime this is done
- * at the start of the main function. Data from the rule declaration is used to print
- * the correct arguments for calls to makeMorphism.
+ * Type (m)akeMorphism switches on the printing of the makeMorphisms function,
+ * which allocates the morphism structures with the makeMorphism function. At
+ * runtime this is done by the first run of the program. Data from the rule
+ * declaration is used to print the correct arguments for calls to makeMorphism.
  *
  * Type (f)reeMorphism switches on the printing of the freeMorphisms function.
- * For each rule declaration, a call to freeMorphism is printed. */
+ * For each rule declaration, a call to freeMorphism is printed.
+ *
+ * Type (p)rofile switches on the printing of the NULL-terminated array of the
+ * rule profiles written at the end of a run compiled with -P. */
 
 static void generateMorphismCode(List *declarations, char type, bool first_call)
 {
-   assert(type == 'm' || type == 'f' || type == 'd');
+   assert(type == 'm' || type == 'f' || type == 'd' || type == 'p');
+   if(type == 'm' && first_call)
+      PTF("static bool morphisms_made = false;\n\nstatic void makeMorphisms(void)\n{\n");
    if(type == 'f' && first_call) PTF("static void freeMorphisms(void)\n{\n");
+   if(type == 'p' && first_call) PTF("RuleProfile *rule_profiles[] = {\n");
    while(declarations != NULL)
    {
       GPDeclaration *decl = declarations->declaration;
@@ -246,12 +512,19 @@ static void generateMorphismCode(List *declarations, char type, bool first_call)
               {
                  PTF("#include \"%s.h\"\n", rule->name);
                  PTF("Morphism *M_%s = NULL;\n", rule->name);
+                 /* The change clock at the last failure of the rule with -R. */
+                 if(rule->change_kinds != 0) PTF("long failed_%s = -1;\n", rule->name);
               }
               if(type == 'm')
                  PTFI("M_%s = makeMorphism(%d, %d, %d);\n", 3, rule->name,
                       rule->left_nodes, rule->left_edges, rule->variable_count);
               if(type == 'f')
+              {
                  PTFI("freeMorphism(M_%s);\n", 3, rule->name);
+                 if(batch_apply && !rule->empty_lhs && !rule->is_predicate)
+                    PTFI("freeBatch%s();\n", 3, rule->name);
+              }
+              if(type == 'p') PTFI("&%s_profile,\n", 3, rule->name);
               break;
          }
          default:
@@ -262,13 +535,31 @@ static void generateMorphismCode(List *declarations, char type, bool first_call)
       }
       declarations = declarations->next;
    }
-   if(type == 'd' || type == 'm') PTF("\n");
+   if(type == 'd') PTF("\n");
+   else if(type == 'p')
+   {
+      if(first_call) PTF("   NULL\n};\n\n");
+   }
+   else if(type == 'm')
+   {
+      if(first_call) PTF("   morphisms_made = true;\n}\n\n");
+   }
    else if(first_call) PTF("}\n\n");
 }
 
 
 static void generateProgramCode(GPCommand *command, CommandData data)
 {
+   /* The sites of a command sequence or an inlined procedure body are its
+    * commands. A loop is also checked for a checkpoint at each iteration. */
+   if(command->type != COMMAND_SEQUENCE && command->type != PROCEDURE_CALL &&
+      checkpointSite(data))
+   {
+      checkpoint_sites++;
+      PTF("%*scheckpoint%d:\n", data.indent - 3, "", checkpoint_sites);
+      PTFI("if(checkpoint_requested) writeCheckpoint(host, CHECKPOINT_PROGRAM, %d);\n",
+           data.indent, checkpoint_sites);
+   }
    switch(command->type)
    {
       case COMMAND_SEQUENCE:
@@ -279,8 +570,10 @@ static void generateProgramCode(GPCommand *command, CommandData data)
            {
               GPCommand *command = commands->command;
               generateProgramCode(command, new_data);
+              /* Only the first command can reuse a kept match. */
+              new_data.reuse_match = false;
               if(data.context == LOOP_BODY && commands->next != NULL)
-                 PTFI("if(!success) break;\n\n", data.indent);
+                 PTFI("if(!success) %s\n\n", data.indent, breakStatement(data));
               commands = commands->next;
            }
            break;
@@ -288,7 +581,9 @@ static void generateProgramCode(GPCommand *command, CommandData data)
       case RULE_CALL:
            PTFI("/* Rule Call */\n", data.indent);
            generateRuleCall(command->rule_call.rule_name, command->rule_call.rule->empty_lhs,
-                            command->rule_call.rule->is_predicate, true, data);
+                            command->rule_call.rule->is_predicate, true,
+                            data.resume_match && command->rule_call.rule->resumable, -1,
+                            0, data);
            break;
 
       case RULE_SET_CALL:
@@ -298,24 +593,45 @@ static void generateProgramCode(GPCommand *command, CommandData data)
            PTFI("{\n", data.indent);
            CommandData new_data = data;
            new_data.indent = data.indent + 3;
-           List *rules = command->rule_set;
-           while(rules != NULL)
+           new_data.procedure_level = false;
+           /* The rules sharing a scan are called first, in the order of the
+            * set, followed by the other rules. The last rule called generates
+            * the failure code. */
+           GPRule *first = sharedScanRule(command->rule_set);
+           List *last_shared = NULL, *last_other = NULL, *rules;
+           for(rules = command->rule_set; rules != NULL; rules = rules->next)
+           {
+              if(first != NULL && sharesScan(rules->rule_call.rule, first)) last_shared = rules;
+              else last_other = rules;
+           }
+           List *last = last_other != NULL ? last_other : last_shared;
+           if(first != NULL)
+           {
+              generateSharedScan(command->rule_set, first, new_data);
+              int shared = 0;
+              for(rules = command->rule_set; rules != NULL; rules = rules->next)
+              {
+                 if(!sharesScan(rules->rule_call.rule, first)) continue;
+                 generateRuleCall(rules->rule_call.rule_name, false, false, rules == last,
+                                  false, shared++, 0, new_data);
+              }
+           }
+           for(rules = command->rule_set; rules != NULL; rules = rules->next)
            {
+              if(first != NULL && sharesScan(rules->rule_call.rule, first)) continue;
               string rule_name = rules->rule_call.rule_name;
               bool empty_lhs = rules->rule_call.rule->empty_lhs;
               bool predicate = rules->rule_call.rule->is_predicate;
-              generateRuleCall(rule_name, empty_lhs, predicate, rules->next == NULL, new_data);
-              rules = rules->next;
+              generateRuleCall(rule_name, empty_lhs, predicate, rules == last, false, -1,
+                               rules->rule_call.rule->change_kinds, new_data);
            }
            PTFI("} while(false);\n", data.indent);
            break;
       }
       case PROCEDURE_CALL:
-      {
-           GPProcedure *procedure = command->proc_call.procedure;
-           generateProgramCode(procedure->commands, data);
+           generateProcedureCall(command->proc_call.procedure, data);
            break;
-      }
+
       case IF_STATEMENT:
       case TRY_STATEMENT:
            generateBranchStatement(command, data);
@@ -341,7 +657,7 @@ static void generateProgramCode(GPCommand *command, CommandData data)
            generateProgramCode(command->or_stmt.right_command, new_data);
            PTFI("}\n", data.indent);
            if(data.context == IF_BODY || data.context == TRY_BODY)
-              PTFI("break;\n", data.indent);
+              PTFI("%s\n", data.indent, breakStatement(data));
            break;
       }
       case SKIP_STATEMENT:
@@ -361,16 +677,17 @@ static void generateProgramCode(GPCommand *command, CommandData data)
             if (data.loop_depth > 1)
             {
                PTFI("/* Update restore point for next iteration of inner loop. */\n", data.indent);
-               PTFI("if(success) restore_point%d = topOfGraphChangeStack();\n", data.indent, data.restore_point);
+               PTFI("if(success) %s = topOfGraphChangeStack();\n", data.indent,
+                    restorePoint(data.restore_point));
             }
             else
             {
                PTFI("/* Graph changes from loop body not required.\n", data.indent);
                PTFI("   Discard them so that future graph roll backs are uncorrupted. */\n", data.indent);
-               PTFI("discardChanges(restore_point%d);\n", data.indent, data.restore_point);
+               generateRestoreCall(false, data.restore_point, data.indent);
             }
          }
-         PTFI("break;\n", data.indent);
+         PTFI("%s\n", data.indent, breakStatement(data));
          break;
 
       default:
@@ -389,53 +706,73 @@ static void generateProgramCode(GPCommand *command, CommandData data)
  * predicate: If this flag is set, code to apply the rule is not generated.
  * last_rule: Set if this is the last rule in a rule set call. Controls the
  *            generation of failure code.
+ * resume:    If this flag is set, the rule is matched by its resumable matcher.
+ * shared:    The position of the rule among the rules of the shared scan of its
+ *            rule set (see generateSharedScan), or -1. If non-negative, the
+ *            rule has been matched if the scan stopped at this position.
+ * change_kinds: The change kinds of the rule (see GPRule) if a failure of the
+ *            rule is remembered, in which case the rule is only matched if
+ *            the host graph has changed in one of these kinds since its last
+ *            failure. 0 otherwise.
  * data:      CommandData passed from the calling command. */
 static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
-                             bool last_rule, CommandData data)
+                             bool last_rule, bool resume, int shared,
+                             unsigned change_kinds, CommandData data)
 {
    if(empty_lhs)
    {
       if(predicate) return;
-      if(data.restore_point >= 0)
-         PTFI("apply%s(M_%s, true);\n", data.indent, rule_name, rule_name);
-      else
-         PTFI("apply%s(M_%s, false);\n", data.indent, rule_name, rule_name);
+      generateApplyCall(rule_name, data.restore_point >= 0, data.indent);
       PTFI("success = true;\n\n", data.indent);
    }
+   else if(data.reuse_match)
+   {
+      /* The condition of the enclosing if statement has matched the rule, and
+       * nothing has been executed since. */
+      PTFI("/* Reusing the match of the condition. */\n", data.indent);
+      generateRuleApplication(rule_name, data, data.indent);
+      PTFI("success = true;\n", data.indent);
+   }
    else
    {
-      PTFI("if(match%s(M_%s))\n", data.indent, rule_name, rule_name);
-      PTFI("{\n", data.indent);
-      if(!predicate)
+      bool batch = data.batch_apply && !predicate;
+      /* Under -P, the matching call is timed by profiledMatch. A batch is
+       * timed as matching. */
+      if(shared >= 0) PTFI("if(shared_rule == %d)\n", data.indent, shared);
+      else
       {
-         /* It is incorrect to apply the rule in a program such as "if r1 then P else Q",
-          * even if the match has succeeded. This situation occurs only when the context
-          * is IF_BODY and there is no graph recording.
-          * Hence, only generate rule application if the context is not IF_BODY or
-          * graph recording is on (signified by a restore_point >= 0). */
-         if(data.context != IF_BODY || data.restore_point >= 0)
-         {
-            if(data.record_changes)
-                 PTFI("apply%s(M_%s, true);\n", data.indent + 3, rule_name, rule_name);
-            else PTFI("apply%s(M_%s, false);\n", data.indent + 3, rule_name, rule_name);
-         }
-         else
+         PTFI("if(", data.indent);
+         if(change_kinds != 0)
+            PTF("changedSince(failed_%s, 0x%xu) && ", rule_name, change_kinds);
+         if(profile_runtime)
          {
-            PTFI("clearMatched(M_%s);\n", data.indent + 3, rule_name);
-            PTFI("initialiseMorphism(M_%s);\n", data.indent + 3, rule_name);
+            if(batch)
+               PTF("profiledMatch(&%s_profile, applyBatch%s(M_%s, %s) > 0))\n", rule_name,
+                   rule_name, rule_name, data.record_changes ? "true" : "false");
+            else PTF("profiledMatch(&%s_profile, %s%s(M_%s)))\n", rule_name,
+                     resume ? "resumeMatch" : "match", rule_name, rule_name);
          }
+         else if(batch)
+            PTF("applyBatch%s(M_%s, %s) > 0)\n", rule_name, rule_name,
+                data.record_changes ? "true" : "false");
+         else PTF("%s%s(M_%s))\n", resume ? "resumeMatch" : "match", rule_name, rule_name);
       }
+      PTFI("{\n", data.indent);
+      if(!predicate && !batch) generateRuleApplication(rule_name, data, data.indent + 3);
       PTFI("success = true;\n", data.indent + 3);
       /* If this rule call is within a rule set, and it is not the last rule in that
        * set, print a break statement to exit the containing do-while loop of the rule
        * set call. */
       if(!last_rule) PTFI("break;\n", data.indent + 3);
       PTFI("}\n", data.indent);
+      if(change_kinds != 0 && !last_rule)
+         PTFI("else failed_%s = change_clock;\n", data.indent, rule_name);
       /* Only generate failure code if the last rule in the set fails. */
       if(last_rule)
       {
          PTFI("else\n", data.indent);
          PTFI("{\n", data.indent);
+         if(change_kinds != 0) PTFI("failed_%s = change_clock;\n", data.indent + 3, rule_name);
          CommandData new_data = data;
          new_data.indent = data.indent + 3;
          generateFailureCode(rule_name, new_data);
@@ -444,6 +781,152 @@ static void generateRuleCall(string rule_name, bool empty_lhs, bool predicate,
    }
 }
 
+/* Prints the code run after a successful match of a rule that is not a
+ * predicate. It is incorrect to apply the rule in a program such as
+ * "if r1 then P else Q", even if the match has succeeded. This situation occurs
+ * only when the context is IF_BODY and there is no graph recording.
+ * Hence, only generate rule application if the context is not IF_BODY or
+ * graph recording is on (signified by a restore_point >= 0). Otherwise the
+ * match is discarded, unless it is kept for the then-branch. */
+static void generateRuleApplication(string rule_name, CommandData data, int indent)
+{
+   if(data.context != IF_BODY || data.restore_point >= 0)
+      generateApplyCall(rule_name, data.record_changes, indent);
+   else if(!data.keep_match)
+   {
+      PTFI("clearMatched(M_%s);\n", indent, rule_name);
+      PTFI("initialiseMorphism(M_%s);\n", indent, rule_name);
+   }
+}
+
+/* Prints the call of the rule's application function, timed under -P. */
+static void generateApplyCall(string rule_name, bool record_changes, int indent)
+{
+   if(profile_runtime) PTFI("profileStart(&%s_profile);\n", indent, rule_name);
+   PTFI("apply%s(M_%s, %s);\n", indent, rule_name, rule_name,
+        record_changes ? "true" : "false");
+   if(profile_runtime) PTFI("profileApplied(&%s_profile);\n", indent, rule_name);
+}
+
+/* Prints the call that undoes or discards the graph changes since the passed
+ * restore point. Under -P, the changes are first counted for the profile. */
+static void generateRestoreCall(bool undo, int restore_point, int indent)
+{
+   if(profile_runtime)
+   {
+      /* A procedure function is passed the number of its caller's restore
+       * point. */
+      if(current_function != NULL && restore_point == current_function->restore_point)
+         PTFI("profile%s(restore_point_id, %s);\n", indent, undo ? "Undo" : "Discard",
+              restorePoint(restore_point));
+      else PTFI("profile%s(%d, %s);\n", indent, undo ? "Undo" : "Discard",
+                restore_point, restorePoint(restore_point));
+   }
+   PTFI("%sChanges(%s);\n", indent, undo ? "undo" : "discard", restorePoint(restore_point));
+}
+
+/* Returns the first rule of the rule set whose first searchplan operation is
+ * shared with another rule of the set, or NULL if there is none. */
+static GPRule *sharedScanRule(List *rules)
+{
+   for(List *first = rules; first != NULL; first = first->next)
+   {
+      GPRule *rule = first->rule_call.rule;
+      if(rule->shared_scan == 0) continue;
+      for(List *other = first->next; other != NULL; other = other->next)
+         if(sharesScan(other->rule_call.rule, rule)) return rule;
+   }
+   return NULL;
+}
+
+/* Returns true if the rule's first searchplan operation scans the same host
+ * nodes as the first operation of the passed rule. */
+static bool sharesScan(GPRule *rule, GPRule *first)
+{
+   return rule->shared_scan != 0 && rule->shared_scan == first->shared_scan &&
+          rule->shared_scan_mark == first->shared_scan_mark;
+}
+
+/* Generates the scan of the host nodes shared by the rules of a rule set with
+ * the same first searchplan operation as the passed rule. Each candidate is
+ * passed to the match<rule>At function of every such rule in turn. The scan
+ * stops at the first match and sets the runtime variable shared_rule to the
+ * position of its rule among them, and leaves it -1 if no rule matches.
+ * Rules are thus tried on each candidate instead of on the whole host graph
+ * one after the other, which the semantics of rule sets allow. */
+static void generateSharedScan(List *rules, GPRule *first, CommandData data)
+{
+   int indent = data.indent;
+   PTFI("int shared_rule = -1;\n", indent);
+   if(first->shared_scan == 'r')
+   {
+      /* Roots of any mark but none are in the lists of marks 1 to 5. */
+      bool any = first->shared_scan_mark == ANY;
+      for(int mark = any ? 1 : first->shared_scan_mark;
+          mark <= (any ? 5 : first->shared_scan_mark); mark++)
+      {
+         if(mark == DASHED) continue;
+         PTFI("for(RootNodes *nodes = getRootNodeList(host, %d); shared_rule < 0 && nodes != NULL;\n",
+              indent, mark);
+         PTFI("nodes = nodes->next)\n", indent + 4);
+         PTFI("{\n", indent);
+         PTFI("Node *host_node = nodes->node;\n", indent + 3);
+         PTFI("if(host_node == NULL) continue;\n", indent + 3);
+         generateSharedScanCalls(rules, first, indent + 3);
+         PTFI("}\n", indent);
+      }
+   }
+   else if(no_node_list)
+   {
+      PTFI("Node *host_node;\n", indent);
+      PTFI("for(long i = 0; shared_rule < 0 && i < host->_nodearray.size; i++)\n", indent);
+      PTFI("{\n", indent);
+      PTFI("host_node = (Node *) getBigArrayValue(&(host->_nodearray), i);\n", indent + 3);
+      PTFI("if(nodeDeleted(host_node))\n", indent + 3);
+      PTFI("{\n", indent + 3);
+      PTFI("clearNodeInGraph(host_node);\n", indent + 6);
+      PTFI("continue;\n", indent + 6);
+      PTFI("}\n", indent + 3);
+      generateSharedScanCalls(rules, first, indent + 3);
+      PTFI("}\n", indent);
+   }
+   else
+   {
+      /* Nodes of any mark but none are in the lists of marks 1 to 5. */
+      PTFI("NodeList *nlistpos;\n", indent);
+      bool any = first->shared_scan_mark == ANY;
+      for(int mark = any ? 1 : first->shared_scan_mark;
+          mark <= (any ? 5 : first->shared_scan_mark); mark++)
+      {
+         if(mark == DASHED) continue;
+         PTFI("nlistpos = NULL;\n", indent);
+         PTFI("for(Node *host_node; shared_rule < 0 &&\n", indent);
+         PTFI("(host_node = yieldNextNode(host, &nlistpos, %d)) != NULL;)\n", indent + 4, mark);
+         PTFI("{\n", indent);
+         generateSharedScanCalls(rules, first, indent + 3);
+         PTFI("}\n", indent);
+      }
+   }
+}
+
+/* Prints the calls of the match<rule>At functions on host_node in the body of
+ * the shared scan. */
+static void generateSharedScanCalls(List *rules, GPRule *first, int indent)
+{
+   int shared = 0;
+   for(; rules != NULL; rules = rules->next)
+   {
+      if(!sharesScan(rules->rule_call.rule, first)) continue;
+      string rule_name = rules->rule_call.rule_name;
+      if(profile_runtime)
+         PTFI("%sif(profiledMatch(&%s_profile, match%sAt(M_%s, host_node))) shared_rule = %d;\n",
+              indent, shared == 0 ? "" : "else ", rule_name, rule_name, rule_name, shared);
+      else PTFI("%sif(match%sAt(M_%s, host_node)) shared_rule = %d;\n", indent,
+                shared == 0 ? "" : "else ", rule_name, rule_name, shared);
+      shared++;
+   }
+}
+
 /* generateBranchStatement passes on the second argument 'data' to the calls to
  * generate code for the then and else branches.
  * The flags from the GPCommand structure are used only to generate code for
@@ -455,6 +938,7 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    condition_data.context = command->type == IF_STATEMENT ? IF_BODY : TRY_BODY;
    condition_data.indent = data.indent + 3;
    condition_data.loop_depth++;
+   condition_data.procedure_level = false;
 
    /* No restore point set if:
     * (1) The branch is if-then-else and the condition is sufficiently simple.
@@ -488,12 +972,25 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
       }
    }
 
+   /* In "if r then (r; P) else Q", where the condition is only matched, the
+    * match of the condition is kept and applied by the first call of r in the
+    * then-branch. */
+   condition_data.keep_match = false;
+   GPCommand *then_call = leadingRuleCall(command->cond_branch.then_command);
+   if(condition_data.context == IF_BODY && condition_data.restore_point < 0 &&
+      singleRuleCall(command->cond_branch.condition) && then_call != NULL)
+   {
+      GPRule *rule = leadingRuleCall(command->cond_branch.condition)->rule_call.rule;
+      condition_data.keep_match = rule == then_call->rule_call.rule && !rule->empty_lhs &&
+                                  !rule->is_predicate;
+   }
+
    if(condition_data.context == IF_BODY) PTFI("/* If Statement */\n", data.indent);
    else PTFI("/* Try Statement */\n", data.indent);
 
    PTFI("/* Condition */\n", data.indent);
    if(condition_data.restore_point >= 0)
-      PTFI("int restore_point%d = topOfGraphChangeStack();\n", data.indent, condition_data.restore_point);
+      PTFI("long restore_point%d = topOfGraphChangeStack();\n", data.indent, condition_data.restore_point);
 
    PTFI("do\n", data.indent);
    PTFI("{\n", data.indent);
@@ -501,18 +998,19 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    PTFI("} while(false);\n\n", data.indent);
 
    if(condition_data.context == IF_BODY && condition_data.restore_point >= 0)
-      PTFI("undoChanges(restore_point%d);\n", data.indent, condition_data.restore_point);
+      generateRestoreCall(true, condition_data.restore_point, data.indent);
 
    /* Update the indentation of the passed command data for the calls to generate the
     * then-branch and else-branch code. */
    CommandData new_data = data;
    new_data.indent = data.indent + 3;
+   new_data.reuse_match = condition_data.keep_match;
    PTFI("/* Then Branch */\n", data.indent);
    PTFI("if(success)\n", data.indent);
    PTFI("{\n", data.indent);
 
    if(condition_data.context == TRY_BODY && condition_data.restore_point >= 0 && condition_data.loop_depth == 1)
-      PTFI("discardChanges(restore_point%d);\n", new_data.indent, condition_data.restore_point);
+      generateRestoreCall(false, condition_data.restore_point, new_data.indent);
 
    generateProgramCode(command->cond_branch.then_command, new_data);
    PTFI("}\n", data.indent);
@@ -521,8 +1019,9 @@ static void generateBranchStatement(GPCommand *command, CommandData data)
    PTFI("{\n", data.indent);
 
    if(condition_data.context == TRY_BODY && condition_data.restore_point >= 0)
-      PTFI("undoChanges(restore_point%d);\n", new_data.indent, condition_data.restore_point);
+      generateRestoreCall(true, condition_data.restore_point, new_data.indent);
 
+   new_data.reuse_match = false;
    PTFI("success = true;\n", new_data.indent); /* Reset success flag before executing else branch. */
    generateProgramCode(command->cond_branch.else_command, new_data);
    PTFI("}\n", data.indent);
@@ -535,24 +1034,39 @@ void generateLoopStatement(GPCommand *command, CommandData data)
 
    CommandData loop_data = data;
    loop_data.context = LOOP_BODY;
-   loop_data.loop_depth++;
    loop_data.indent = data.indent + 3;
-
-   /* If the loop body requires recording, assign it the next restore point. */
-   if(singleRule(command->loop_stmt.loop_body))
+   loop_data.procedure_level = false;
+   /* Only the loop's rule is applied between its matches, so its matcher can
+    * resume from the previous match, or its matches can be applied in
+    * batches. */
+   bool single_rule_call = singleRuleCall(command->loop_stmt.loop_body);
+   loop_data.resume_match = single_rule_call;
+   loop_data.batch_apply = batch_apply && single_rule_call;
+
+   /* If the loop body requires recording, assign it the next restore point.
+    * A body that cannot fail after changing the host graph never has to be
+    * rolled back. Such a loop does not count towards the loop depth, so that
+    * the recording constructs in its body discard their changes themselves
+    * unless an enclosing construct records. */
+   GPCommand *body = command->loop_stmt.loop_body;
+   if(singleRule(body) || failsBeforeChanging(body))
       loop_data.restore_point = -1;
    else
    {
+      loop_data.loop_depth++;
       loop_data.record_changes = true;
       loop_data.restore_point = restore_point_count++;
    }
 
    PTFI("/* Loop Statement */\n", data.indent);
    if(loop_data.restore_point >= 0)
-      PTFI("int restore_point%d = topOfGraphChangeStack();\n", data.indent, loop_data.restore_point);
+      PTFI("long restore_point%d = topOfGraphChangeStack();\n", data.indent, loop_data.restore_point);
 
    PTFI("while(success)\n", data.indent);
    PTFI("{\n", data.indent);
+   if(checkpointSite(data))
+      PTFI("if(checkpoint_requested) writeCheckpoint(host, CHECKPOINT_PROGRAM, %d);\n",
+           loop_data.indent, checkpoint_sites);
    generateProgramCode(command->loop_stmt.loop_body, loop_data);
    if(loop_data.restore_point >= 0)
    {
@@ -565,11 +1079,21 @@ void generateLoopStatement(GPCommand *command, CommandData data)
       {
          PTFI("/* Graph changes from loop body may not have been used.\n", data.indent + 3);
          PTFI("   Discard them so that future graph roll backs are uncorrupted. */\n", data.indent + 3);
-         PTFI("if(success) discardChanges(restore_point%d);\n", data.indent + 3, loop_data.restore_point);
+         if(profile_runtime)
+         {
+            PTFI("if(success)\n", data.indent + 3);
+            PTFI("{\n", data.indent + 3);
+            generateRestoreCall(false, loop_data.restore_point, data.indent + 6);
+            PTFI("}\n", data.indent + 3);
+         }
+         else PTFI("if(success) discardChanges(restore_point%d);\n", data.indent + 3, loop_data.restore_point);
       }
    }
    PTFI("}\n", data.indent);
    PTFI("success = true;\n", data.indent);
+   /* The loop has deleted what it is going to delete, and no morphism refers
+    * to the host graph between commands. */
+   if(compact_graphs) PTFI("host = compactGraphIfSparse(host);\n", data.indent);
 }
 
 /* Generates code to handle failure, which is context-dependent. There are two
@@ -579,28 +1103,288 @@ void generateLoopStatement(GPCommand *command, CommandData data)
  * (2) The fail statement is called. NULL is passed as the first argument. */
 static void generateFailureCode(string rule_name, CommandData data)
 {
-   /* A failure in the main body ends the execution. Emit code to report the
-    * failure, garbage collect and return 0. */
+   /* A failure in the main body ends the run. Emit code to record the failure
+    * in the context and return false. */
    if(data.context == MAIN_BODY)
    {
       if(rule_name != NULL)
-         PTFI("fprintf(output_file, \"No output graph: rule %s not applicable.\\n\");\n",
-              data.indent, rule_name);
-      else PTFI("fprintf(output_file, \"No output graph: Fail statement invoked\\n\");\n",
-                data.indent);
-      PTFI("printf(\"Output information saved to file gp2.output\\n\");\n", data.indent);
-      if(!fast_shutdown) PTFI("garbageCollect();\n", data.indent);
-      PTFI("closeLogFile();\n", data.indent);
-      PTFI("fclose(output_file);\n", data.indent);
-      PTFI("return 0;\n", data.indent);
+         PTFI("endRun(context, host, \"rule %s not applicable.\");\n", data.indent, rule_name);
+      else PTFI("endRun(context, host, \"Fail statement invoked\");\n", data.indent);
+      PTFI("%s\n", data.indent, endRunStatement());
    }
    /* In other contexts, set the runtime success flag to false. */
    else PTFI("success = false;\n", data.indent);
 
-   if(data.context == IF_BODY || data.context == TRY_BODY) PTFI("break;\n", data.indent);
+   if(data.context == IF_BODY || data.context == TRY_BODY)
+      PTFI("%s\n", data.indent, breakStatement(data));
 
    if(data.context == LOOP_BODY && data.restore_point >= 0)
-      PTFI("undoChanges(restore_point%d);\n", data.indent, data.restore_point);
+      generateRestoreCall(true, data.restore_point, data.indent);
+}
+
+/* Returns the entry of the procedure in the procedures array, or NULL if the
+ * procedure is not called. */
+static ProcedureInfo *procedureInfo(GPProcedure *procedure)
+{
+   for(int index = 0; index < procedure_count; index++)
+      if(procedures[index].procedure == procedure) return &procedures[index];
+   return NULL;
+}
+
+/* Counts the call sites of each procedure in the declarations and in the
+ * local declarations of procedures. */
+static void countProcedureCalls(List *declarations)
+{
+   for(; declarations != NULL; declarations = declarations->next)
+   {
+      GPDeclaration *decl = declarations->declaration;
+      if(decl->type == MAIN_DECLARATION) countCommandCalls(decl->main_program);
+      else if(decl->type == PROCEDURE_DECLARATION)
+      {
+         countCommandCalls(decl->procedure->commands);
+         countProcedureCalls(decl->procedure->local_decls);
+      }
+   }
+}
+
+static void countCommandCalls(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+           for(List *commands = command->commands; commands != NULL; commands = commands->next)
+              countCommandCalls(commands->command);
+           break;
+
+      case PROCEDURE_CALL:
+      {
+           GPProcedure *procedure = command->proc_call.procedure;
+           ProcedureInfo *info = procedureInfo(procedure);
+           if(info == NULL)
+           {
+              ProcedureInfo *new_procedures = realloc(procedures,
+                                                      (procedure_count + 1) * sizeof(ProcedureInfo));
+              if(new_procedures == NULL)
+              {
+                 print_to_log("Error (countCommandCalls): realloc failure.\n");
+                 exit(1);
+              }
+              procedures = new_procedures;
+              info = &procedures[procedure_count++];
+              info->procedure = procedure;
+              info->calls = 0;
+              info->size = commandSize(procedure->commands);
+              info->functions = NULL;
+           }
+           info->calls++;
+           break;
+      }
+      case IF_STATEMENT:
+      case TRY_STATEMENT:
+           countCommandCalls(command->cond_branch.condition);
+           countCommandCalls(command->cond_branch.then_command);
+           countCommandCalls(command->cond_branch.else_command);
+           break;
+
+      case ALAP_STATEMENT:
+           countCommandCalls(command->loop_stmt.loop_body);
+           break;
+
+      case PROGRAM_OR:
+           countCommandCalls(command->or_stmt.left_command);
+           countCommandCalls(command->or_stmt.right_command);
+           break;
+
+      default:
+           break;
+   }
+}
+
+/* Returns the number of commands and rule calls the command would generate
+ * if its procedure calls were inlined. */
+static int commandSize(GPCommand *command)
+{
+   int size = 0;
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+           for(List *commands = command->commands; commands != NULL; commands = commands->next)
+              size += commandSize(commands->command);
+           return size;
+
+      case RULE_SET_CALL:
+           for(List *rules = command->rule_set; rules != NULL; rules = rules->next) size++;
+           return size;
+
+      case PROCEDURE_CALL:
+           return commandSize(command->proc_call.procedure->commands);
+
+      case IF_STATEMENT:
+      case TRY_STATEMENT:
+           return 1 + commandSize(command->cond_branch.condition) +
+                  commandSize(command->cond_branch.then_command) +
+                  commandSize(command->cond_branch.else_command);
+
+      case ALAP_STATEMENT:
+           return 1 + commandSize(command->loop_stmt.loop_body);
+
+      case PROGRAM_OR:
+           return 1 + commandSize(command->or_stmt.left_command) +
+                  commandSize(command->or_stmt.right_command);
+
+      default:
+           return 1;
+   }
+}
+
+/* Returns true if the code generated for a procedure body is the same in
+ * both contexts, apart from the numbering of the restore point. */
+static bool sameContext(CommandData data, CommandData other)
+{
+   return data.context == other.context && data.loop_depth == other.loop_depth &&
+          data.record_changes == other.record_changes &&
+          (data.restore_point >= 0) == (other.restore_point >= 0) &&
+          data.resume_match == other.resume_match && data.batch_apply == other.batch_apply &&
+          data.keep_match == other.keep_match && data.reuse_match == other.reuse_match;
+}
+
+/* Generates the procedure body inline, or a call of the function generated
+ * for the procedure and the context of the call. The function is generated
+ * on its first call from the context. */
+static void generateProcedureCall(GPProcedure *procedure, CommandData data)
+{
+   ProcedureInfo *info = procedureInfo(procedure);
+   if(info == NULL || info->calls <= 1 || info->size <= PROCEDURE_INLINE_SIZE)
+   {
+      generateProgramCode(procedure->commands, data);
+      return;
+   }
+   ProcedureFunction *function = info->functions;
+   while(function != NULL && !sameContext(function->data, data)) function = function->next;
+   if(function == NULL)
+   {
+      function = malloc(sizeof(ProcedureFunction));
+      if(function == NULL)
+      {
+         print_to_log("Error (generateProcedureCall): malloc failure.\n");
+         exit(1);
+      }
+      function->restore_point = data.restore_point >= 0 ? restore_point_count++ : -1;
+      function->data = data;
+      function->data.restore_point = function->restore_point;
+      function->data.indent = 3;
+      function->data.procedure_level = true;
+      function->number = function_count++;
+      function->breaks = false;
+      function->ends_run = false;
+      function->next = info->functions;
+      info->functions = function;
+
+      ProcedureFunction *caller = current_function;
+      FILE *caller_file = file;
+      current_function = function;
+      file = openTemporaryFile();
+      PTF("static ProcedureExit run%s%d(GP2Context *context%s%s)\n", procedure->name,
+          function->number, function->restore_point >= 0 ? ", long *restore_point" : "",
+          function->restore_point >= 0 && profile_runtime ? ", int restore_point_id" : "");
+      PTF("{\n");
+      generateProgramCode(procedure->commands, function->data);
+      PTFI("return PROCEDURE_CONTINUE;\n", 3);
+      PTF("}\n\n");
+      FILE *function_code = file;
+      file = procedure_code;
+      appendFile(function_code);
+      fclose(function_code);
+      file = caller_file;
+      current_function = caller;
+   }
+
+   /* A run cannot end in a loop body or a branch condition, and a break
+    * cannot leave the main body, so a function does at most one of the two. */
+   assert(!function->breaks || !function->ends_run);
+   char arguments[64] = "context";
+   if(function->restore_point >= 0)
+   {
+      bool outer = current_function != NULL && data.restore_point == current_function->restore_point;
+      size_t length = strlen(arguments);
+      if(outer)
+         snprintf(arguments + length, sizeof(arguments) - length, ", restore_point%s",
+                  profile_runtime ? ", restore_point_id" : "");
+      else if(profile_runtime)
+         snprintf(arguments + length, sizeof(arguments) - length, ", &restore_point%d, %d",
+                  data.restore_point, data.restore_point);
+      else
+         snprintf(arguments + length, sizeof(arguments) - length, ", &restore_point%d",
+                  data.restore_point);
+   }
+   PTFI("/* Procedure Call */\n", data.indent);
+   if(function->ends_run)
+      PTFI("if(run%s%d(%s) == PROCEDURE_END_RUN) %s\n", data.indent, procedure->name,
+           function->number, arguments, endRunStatement());
+   else if(function->breaks)
+      PTFI("if(run%s%d(%s) == PROCEDURE_BREAK) %s\n", data.indent, procedure->name,
+           function->number, arguments, breakStatement(data));
+   else PTFI("run%s%d(%s);\n", data.indent, procedure->name, function->number, arguments);
+}
+
+/* Returns the statement that breaks out of the innermost loop of the
+ * generated code. At the level of a procedure function, that loop is in the
+ * caller, so the function returns and the caller breaks. */
+static string breakStatement(CommandData data)
+{
+   if(!data.procedure_level) return "break;";
+   current_function->breaks = true;
+   return "return PROCEDURE_BREAK;";
+}
+
+/* Returns the statement that returns from gp2_run after the run has ended. */
+static string endRunStatement(void)
+{
+   if(current_function == NULL) return "return false;";
+   current_function->ends_run = true;
+   return "return PROCEDURE_END_RUN;";
+}
+
+/* Returns the variable holding the restore point with the passed number. The
+ * restore point of the caller of a procedure function is passed by address. */
+static string restorePoint(int restore_point)
+{
+   static char name[32];
+   if(current_function != NULL && restore_point == current_function->restore_point)
+      return "*restore_point";
+   snprintf(name, sizeof(name), "restore_point%d", restore_point);
+   return name;
+}
+
+/* Returns true if the command is a checkpoint site: gp2_run can jump to it
+ * when a run is resumed. The command must be in the main body of gp2_run
+ * itself, with no changes recorded, and must not apply the match kept by an
+ * if condition, which a resumed run does not have. */
+static bool checkpointSite(CommandData data)
+{
+   return data.context == MAIN_BODY && current_function == NULL &&
+          data.restore_point < 0 && !data.reuse_match;
+}
+
+/* Returns the FNV-1a hash of the names of the rules and procedures of the
+ * program, which identifies the program in its checkpoints. */
+static unsigned programHash(List *declarations, unsigned hash)
+{
+   for(; declarations != NULL; declarations = declarations->next)
+   {
+      GPDeclaration *decl = declarations->declaration;
+      string name = NULL;
+      if(decl->type == PROCEDURE_DECLARATION)
+      {
+         name = decl->procedure->name;
+         hash = programHash(decl->procedure->local_decls, hash);
+      }
+      else if(decl->type == RULE_DECLARATION) name = decl->rule->name;
+      if(name == NULL) continue;
+      for(; *name != '\0'; name++) hash = (hash ^ (unsigned char) *name) * 16777619u;
+      hash = (hash ^ ';') * 16777619u;
+   }
+   return hash;
 }
 
 /* The function singleRule returns true if the passed command amounts to a single
@@ -658,6 +1442,48 @@ static bool singleRule(GPCommand *command)
    return false;
 }
 
+/* Returns true if the passed command is a single rule call, possibly within
+ * a procedure or a command sequence of one command. */
+static bool singleRuleCall(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+           if(command->commands == NULL || command->commands->next != NULL) return false;
+           return singleRuleCall(command->commands->command);
+
+      case RULE_CALL:
+           return true;
+
+      case PROCEDURE_CALL:
+           return singleRuleCall(command->proc_call.procedure->commands);
+
+      default:
+           return false;
+   }
+}
+
+/* Returns the rule call executed first by the passed command if it starts with
+ * one, possibly within procedures and command sequences, and NULL otherwise. */
+static GPCommand *leadingRuleCall(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+           if(command->commands == NULL) return NULL;
+           return leadingRuleCall(command->commands->command);
+
+      case RULE_CALL:
+           return command;
+
+      case PROCEDURE_CALL:
+           return leadingRuleCall(command->proc_call.procedure->commands);
+
+      default:
+           return NULL;
+   }
+}
+
 /* Returns true if the passed GP 2 command does not change the host graph. */
 static bool nullCommand(GPCommand *command)
 {
@@ -722,3 +1548,116 @@ static bool nullCommand(GPCommand *command)
    }
    return false;
 }
+
+/* Returns true if the passed GP 2 command can fail. A branch statement fails
+ * only if the branch taken fails, and a loop never fails. */
+static bool mayFail(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+           for(List *commands = command->commands; commands != NULL; commands = commands->next)
+              if(mayFail(commands->command)) return true;
+           return false;
+
+      case RULE_CALL:
+           return !command->rule_call.rule->empty_lhs;
+
+      case RULE_SET_CALL:
+           for(List *rule_set = command->rule_set; rule_set != NULL; rule_set = rule_set->next)
+              if(!rule_set->rule_call.rule->empty_lhs) return true;
+           return false;
+
+      case PROCEDURE_CALL:
+           return mayFail(command->proc_call.procedure->commands);
+
+      case IF_STATEMENT:
+      case TRY_STATEMENT:
+           return mayFail(command->cond_branch.then_command) ||
+                  mayFail(command->cond_branch.else_command);
+
+      case PROGRAM_OR:
+           return mayFail(command->or_stmt.left_command) ||
+                  mayFail(command->or_stmt.right_command);
+
+      case FAIL_STATEMENT:
+           return true;
+
+      case ALAP_STATEMENT:
+      case BREAK_STATEMENT:
+      case SKIP_STATEMENT:
+           return false;
+
+      default:
+           print_to_log("Error (mayFail): Unexpected command type %d.\n", command->type);
+           break;
+   }
+   return true;
+}
+
+/* Returns true if the passed GP 2 command cannot fail after it has changed the
+ * host graph, such as (pred1; pred2; r) or ({r1, r2}; s) with s an empty-LHS
+ * rule. A loop with such a body need not record its changes: a failed
+ * iteration has not changed the host graph, so there is nothing to roll back.
+ * The changes made by the condition of an if statement are always undone, and
+ * a failed branch condition or loop body restores the graph itself. */
+static bool failsBeforeChanging(GPCommand *command)
+{
+   switch(command->type)
+   {
+      case COMMAND_SEQUENCE:
+      {
+           bool changed = false;
+           for(List *commands = command->commands; commands != NULL; commands = commands->next)
+           {
+              GPCommand *command = commands->command;
+              if(!failsBeforeChanging(command)) return false;
+              if(changed && mayFail(command)) return false;
+              if(!nullCommand(command)) changed = true;
+           }
+           return true;
+      }
+      case RULE_CALL:
+           return true;
+
+      case RULE_SET_CALL:
+           /* An empty-LHS rule is applied without leaving the rule set, after
+            * which a later rule of the set can fail. */
+           for(List *rule_set = command->rule_set; rule_set != NULL; rule_set = rule_set->next)
+           {
+              GPRule *rule = rule_set->rule_call.rule;
+              if(rule->empty_lhs && !rule->is_predicate) return false;
+           }
+           return true;
+
+      case PROCEDURE_CALL:
+           return failsBeforeChanging(command->proc_call.procedure->commands);
+
+      case IF_STATEMENT:
+           return failsBeforeChanging(command->cond_branch.then_command) &&
+                  failsBeforeChanging(command->cond_branch.else_command);
+
+      case TRY_STATEMENT:
+           if(!failsBeforeChanging(command->cond_branch.then_command)) return false;
+           if(!failsBeforeChanging(command->cond_branch.else_command)) return false;
+           /* The changes of a successful condition are kept. */
+           return nullCommand(command->cond_branch.condition) ||
+                  !mayFail(command->cond_branch.then_command);
+
+      case PROGRAM_OR:
+           return failsBeforeChanging(command->or_stmt.left_command) &&
+                  failsBeforeChanging(command->or_stmt.right_command);
+
+      case ALAP_STATEMENT:
+      case BREAK_STATEMENT:
+      case SKIP_STATEMENT:
+      case FAIL_STATEMENT:
+           return true;
+
+      default:
+           print_to_log("Error (failsBeforeChanging): Unexpected command type %d.\n",
+                        command->type);
+           break;
+   }
+   return false;
+}
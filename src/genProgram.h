@@ -19,9 +19,12 @@
   Generate Program Module
   =======================    
 
-  Generates the main function of the runtime system, which processes the host
-  graph and calls the functions to apply and match rules according to the
-  control constructs of the GP 2 program.
+  Generates the runtime system of the GP 2 program. program.c defines the
+  function gp2_run, which calls the functions to apply and match rules on a
+  host graph according to the control constructs of the program. It can be
+  called repeatedly on a context (see the lib's context module). main.c
+  defines the main function, which builds the host graph from a file, runs
+  the program on it once and writes the output graph.
 
 /////////////////////////////////////////////////////////////////////////// */
 
@@ -184,6 +187,26 @@ void generateRuntimeMain(List *declarations, string output_dir);
  *    <program code for Q>
  * }
  *   
+ * Procedure Call P
+ * ================
+ * The body of P is inlined if P is called once or its body is small. Otherwise
+ * it is compiled to a static function runP<n> for each context it is called
+ * from, which the calls from that context share. A break or the end of the run
+ * in the body returns a code, and the caller does the same:
+ * if(runP0(context) == PROCEDURE_BREAK) break;
+ * A function called where graph changes are recorded is passed the address of
+ * the caller's restore point.
+ *
+ * Checkpoint Sites
+ * ================
+ * The commands of the main body outside branch conditions, loop bodies and
+ * procedure functions are labelled, and the run is checkpointed there if a
+ * checkpoint has been requested (see the lib's checkpoint module):
+ * checkpoint<n>:
+ * if(checkpoint_requested) writeCheckpoint(host, CHECKPOINT_PROGRAM, <n>);
+ * A loop at such a site repeats the check at the start of each iteration. A
+ * resumed run jumps from the start of gp2_run to the label of its site.
+ *
  * Skip, Fail and Break
  * ====================
  * 'skip' => success = true;
@@ -15,23 +15,57 @@
 
 #include "genRule.h"
 
-static void generateMatchingCode(Rule *rule, bool predicate);
+static bool generateMatchingCode(Rule *rule, bool predicate);
 static bool emitDegreeCheck(RuleNode *left_node, int indent);
+static void emitConditionFilter(Rule *rule, RuleNode *left_node, string fail_code, int indent);
 static void emitRootNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
+static void emitRootNodeCandidate(Rule *rule, RuleNode *left_node, SearchOp *next_op,
+                                  int indent);
 static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
+static void emitIndexedNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
+static void emitDegreeNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
+static bool usesLabelIndex(RuleNode *left_node);
+static bool usesDegreeIndex(RuleNode *left_node);
+static bool usesNodeIndex(RuleNode *left_node);
+static void emitNodeFilter(RuleNode *left_node, string name);
+static void emitNodeArrayLoop(RuleNode *left_node, string start);
+static void emitNodeCandidate(Rule *rule, RuleNode *left_node, SearchOp *next_op, int indent);
+static void emitResumingNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op);
+static void emitStartingNodeMatcher(Rule *rule, RuleNode *left_node, char type,
+                                    SearchOp *next_op);
+static bool parallelMatchable(Rule *rule);
+static bool buildsStrings(Rule *rule);
+static void emitParallelMatchers(Rule *rule, RuleNode *left_node, SearchOp *next_op);
 static void emitNodeFromEdgeMatcher(Rule *rule, RuleNode *left_node, char type, SearchOp *next_op);
 static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int indent);
 static void emitEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op);
 static void emitLoopEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op);
 static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool source,
                                     bool initialise, bool exit, SearchOp *next_op);
+static void emitEdgeFromNodeCandidate(Rule *rule, RuleEdge *left_edge, bool source,
+                                      SearchOp *next_op, int indent);
+static void emitIncidentEdgeLoop(string orientation, int mark, bool loop, int indent);
 static void emitEdgeMatchResultCode(int index, SearchOp *next_op, int indent);
 static void emitNextMatcherCall(SearchOp *next_operation);
+static void emitCandidateCount(bool node, int index, int indent);
+static void emitFlatMatcher(Rule *rule, char start);
 
 FILE *header = NULL;
 FILE *file = NULL;
 Searchplan *searchplan = NULL;
 
+/* Set by generateMatchingCode to the type of the first searchplan operation
+ * and the mark of its node if the rule gets the function match<rule>At, and
+ * to 0 otherwise. */
+static char shared_scan = 0;
+static int shared_scan_mark = 0;
+
+/* Set by generateMatchingCode under -P to the types of the operations of the
+ * rule's first searchplan, for the rule's profile. */
+static string profile_operations = NULL;
+
+static unsigned changeKinds(Rule *rule);
+
 void generateRules(List *declarations, string output_dir)
 {
    while(declarations != NULL)
@@ -55,7 +89,12 @@ void generateRules(List *declarations, string output_dir)
                * program. */
               decl->rule->empty_lhs = rule->lhs == NULL;
               decl->rule->is_predicate = isPredicate(rule);
-              generateRuleCode(rule, decl->rule->is_predicate, output_dir);
+              decl->rule->resumable = generateRuleCode(rule, decl->rule->is_predicate,
+                                                       output_dir);
+              decl->rule->shared_scan = shared_scan;
+              decl->rule->shared_scan_mark = shared_scan_mark;
+              if(applicability_tracking && rule->lhs != NULL)
+                 decl->rule->change_kinds = changeKinds(rule);
               freeRule(rule);
               break;
          }
@@ -69,7 +108,7 @@ void generateRules(List *declarations, string output_dir)
 }
 
 /* Create a C module to match and apply the rule. */
-void generateRuleCode(Rule *rule, bool predicate, string output_dir)
+bool generateRuleCode(Rule *rule, bool predicate, string output_dir)
 {
    /* Create files <output dir>/<rule name>.h and <output dir>/<rule name>.c */
    int length = strlen(output_dir) + strlen(rule->name) + 3;
@@ -101,9 +140,24 @@ void generateRuleCode(Rule *rule, bool predicate, string output_dir)
    fprintf(header, "#include \"graph.h\"\n"
                    "#include \"label.h\"\n"
                    "#include \"graphStacks.h\"\n"
-                   "#include \"parser.h\"\n"
-                   "#include \"morphism.h\"\n\n");
+                   "#include \"hostLoader.h\"\n"
+                   "#include \"morphism.h\"\n");
+   if(parallel_matching) fprintf(header, "#include \"parallelMatch.h\"\n");
+   if(node_filter) fprintf(header, "#include \"nodeFilter.h\"\n");
+   if(profile_runtime) fprintf(header, "#include \"profile.h\"\n");
+   fprintf(header, "\n");
    PTF("#include \"%s.h\"\n\n", rule->name);
+   /* The builder of the concatenated strings of the rule's host labels. */
+   if(buildsStrings(rule)) PTF("static StringBuilder scratch = {NULL, 0, 0};\n\n");
+   if(profile_runtime && rule->lhs != NULL)
+   {
+      /* Counted by emitCandidateCount. */
+      if(rule->lhs->node_index > 0)
+         PTF("static unsigned long node_candidates[%d];\n", rule->lhs->node_index);
+      if(rule->lhs->edge_index > 0)
+         PTF("static unsigned long edge_candidates[%d];\n", rule->lhs->edge_index);
+      PTF("\n");
+   }
 
    if(rule->condition != NULL)
    {
@@ -117,65 +171,324 @@ void generateRuleCode(Rule *rule, bool predicate, string output_dir)
       generateConditionEvaluator(rule->condition, false);
       generatePredicateEvaluators(rule, rule->condition);
    }
+   bool resumable = false;
+   shared_scan = 0;
    if(rule->lhs != NULL) 
    {
-      generateMatchingCode(rule, predicate);
+      resumable = generateMatchingCode(rule, predicate);
       if(!predicate)
       {
          if(rule->rhs == NULL) generateRemoveLHSCode(rule->name);
          else generateApplicationCode(rule);
+         if(batch_apply) generateBatchApplicationCode(rule);
       }
    }
    else
    {
       if(rule->rhs != NULL) generateAddRHSCode(rule);
    }
+   if(profile_runtime)
+   {
+      fprintf(header, "extern RuleProfile %s_profile;\n", rule->name);
+      bool nodes = rule->lhs != NULL && rule->lhs->node_index > 0;
+      bool edges = rule->lhs != NULL && rule->lhs->edge_index > 0;
+      PTF("RuleProfile %s_profile = {\"%s\", \"%s\", %s, %s, %s};\n", rule->name,
+          rule->name, profile_operations == NULL ? "" : profile_operations,
+          profile_operations == NULL ? "NULL" : "operation_items",
+          nodes ? "node_candidates" : "NULL", edges ? "edge_candidates" : "NULL");
+      if(profile_operations != NULL) free(profile_operations);
+      profile_operations = NULL;
+   }
    fclose(header);
    fclose(file);
-   return;
+   return resumable;
 }
 
-static void generateMatchingCode(Rule *rule, bool predicate)
+/* The kinds of host graph change with -R. These must be the values of
+ * NODE_CHANGE, EDGE_CHANGE and DEGREE_CHANGE in lib/graph.h. */
+#define NODE_CHANGE(mark) (mark)
+#define EDGE_CHANGE(mark) (6 + (mark))
+#define DEGREE_CHANGE 12
+
+/* The change kinds of items getting a mark that an LHS item with the passed
+ * mark matches. NODE_CHANGE or EDGE_CHANGE is passed as kind. */
+#define markChanges(mark, kind) \
+   ((mark) == ANY ? (0x3Eu << kind(0)) : (1u << kind(mark)))
+
+static bool usesDegree(RuleAtom *atom)
 {
-   searchplan = generateSearchplan(rule->lhs); 
-   if(searchplan->first == NULL)
+   switch(atom->type)
    {
-      print_to_log("Error: empty searchplan. Aborting.\n");
-      freeSearchplan(searchplan);
-      return;
+      case INDEGREE:
+      case OUTDEGREE:
+           return true;
+
+      case NEG:
+           return usesDegree(atom->neg_exp);
+
+      case ADD:
+      case SUBTRACT:
+      case MULTIPLY:
+      case DIVIDE:
+      case CONCAT:
+           return usesDegree(atom->bin_op.left_exp) || usesDegree(atom->bin_op.right_exp);
+
+      default:
+           return false;
    }
-   SearchOp *operation = searchplan->first;
-   /* Iterator over the searchplan to print the prototypes of the matching functions. */
-   while(operation != NULL)
+}
+
+static bool listUsesDegree(RuleLabel label)
+{
+   if(label.list == NULL) return false;
+   for(RuleListItem *item = label.list->first; item != NULL; item = item->next)
+      if(usesDegree(item->atom)) return true;
+   return false;
+}
+
+/* Returns the change kinds on which the predicates of the condition depend
+ * beyond the labels of the matched items: the degrees of the matched nodes
+ * and, for edge predicates, the edges between them. */
+static unsigned conditionChanges(Condition *condition)
+{
+   switch(condition->type)
    {
-      char type = operation->type;
-      switch(type)
+      case 'e':
       {
-         case 'n':
-         case 'r':
-              PTF("static bool match_n%d(Morphism *morphism);\n", operation->index);
-              break;
+           Predicate *predicate = condition->predicate;
+           if(predicate->type == EDGE_PRED)
+              return (1u << DEGREE_CHANGE) | (0x3Fu << EDGE_CHANGE(0));
+           if(predicate->type == EQUAL || predicate->type == NOT_EQUAL)
+           {
+              if(listUsesDegree(predicate->list_comp.left_label) ||
+                 listUsesDegree(predicate->list_comp.right_label)) return 1u << DEGREE_CHANGE;
+           }
+           else if(predicate->type == GREATER || predicate->type == GREATER_EQUAL ||
+                   predicate->type == LESS || predicate->type == LESS_EQUAL)
+           {
+              if(usesDegree(predicate->atom_comp.left_atom) ||
+                 usesDegree(predicate->atom_comp.right_atom)) return 1u << DEGREE_CHANGE;
+           }
+           return 0;
+      }
+      case 'n':
+           return conditionChanges(condition->neg_condition);
 
-         case 'i': 
-         case 'o': 
-         case 'b':
-              PTF("static bool match_n%d(Morphism *morphism, Edge *host_edge);\n",
-                  operation->index);
-              break;
+      case 'a':
+      case 'o':
+           return conditionChanges(condition->left_condition) |
+                  conditionChanges(condition->right_condition);
 
-         case 'e': 
-         case 's': 
-         case 't':
-         case 'l':
-              PTF("static bool match_e%d(Morphism *morphism);\n", operation->index);
-              break;
+      default:
+           return 0;
+   }
+}
 
-         default:
-              print_to_log("Error (generateMatchingCode): Unexpected "
-                           "operation type %c.\n", operation->type);
-              break;
+/* Returns the change kinds after which the rule may have a match that it did
+ * not have before. A match can only be gained from a host item getting a mark
+ * that an LHS item matches, as removing items or changing their root status
+ * only takes candidates away, with two exceptions. The condition may depend
+ * on the degrees or edges of the matched nodes, and a node deleted by the rule
+ * must have no edges other than those in the LHS, so for such rules the
+ * removal of edges counts as well. Changes of root status are counted as
+ * changes of the node's mark, which covers the rooted LHS nodes and -m. */
+static unsigned changeKinds(Rule *rule)
+{
+   unsigned kinds = 0;
+   for(int index = 0; index < rule->lhs->node_index; index++)
+   {
+      RuleNode *node = getRuleNode(rule->lhs, index);
+      kinds |= markChanges(node->label.mark, NODE_CHANGE);
+      if(node->interface == NULL) kinds |= 1u << DEGREE_CHANGE;
+   }
+   for(int index = 0; index < rule->lhs->edge_index; index++)
+      kinds |= markChanges(getRuleEdge(rule->lhs, index)->label.mark, EDGE_CHANGE);
+   if(rule->condition != NULL) kinds |= conditionChanges(rule->condition);
+   return kinds;
+}
+
+static bool conditionBuildsStrings(Condition *condition)
+{
+   switch(condition->type)
+   {
+      case 'e':
+           return condition->predicate->type == EDGE_PRED &&
+                  hasConcatenation(condition->predicate->edge_pred.label);
+
+      case 'n':
+           return conditionBuildsStrings(condition->neg_condition);
+
+      case 'a':
+      case 'o':
+           return conditionBuildsStrings(condition->left_condition) ||
+                  conditionBuildsStrings(condition->right_condition);
+
+      default:
+           return false;
+   }
+}
+
+/* Returns true if the code of the rule evaluates a label with a concatenation
+ * for the host graph: the label of an added or relabelled RHS item, or the
+ * label argument of an edge predicate. */
+static bool buildsStrings(Rule *rule)
+{
+   if(rule->rhs != NULL)
+   {
+      for(int index = 0; index < rule->rhs->node_index; index++)
+      {
+         RuleNode *node = getRuleNode(rule->rhs, index);
+         if((node->interface == NULL || node->relabelled) && hasConcatenation(node->label))
+            return true;
+      }
+      for(int index = 0; index < rule->rhs->edge_index; index++)
+      {
+         RuleEdge *edge = getRuleEdge(rule->rhs, index);
+         if((edge->interface == NULL || edge->relabelled) && hasConcatenation(edge->label))
+            return true;
+      }
+   }
+   return rule->condition != NULL && conditionBuildsStrings(rule->condition);
+}
+
+/* Runtime-adaptive matching emits at most this many searchplans per rule. */
+#define MAX_SEARCHPLANS 3
+
+/* The number of degree lists of each mark with -v. This must be the value of
+ * DEGREE_INDEX_BUCKETS in lib/graph.h. */
+#define DEGREE_INDEX_BUCKETS 4
+
+/* Appended to the names of the matching functions of the searchplan being
+ * emitted, so that the functions of alternative searchplans do not clash. */
+static char plan_suffix[8] = "";
+
+/* The LHS node matched by the first operation of the searchplan if the rule
+ * gets a resumable matcher, and NULL otherwise. */
+static RuleNode *resumable_node = NULL;
+
+/* The index of the LHS node of the resumable matcher of the last rule
+ * generated, or -1 if it has none. Read by generateBatchApplicationCode. */
+static int resume_matcher_index = -1;
+
+/* Set while the matchers run by parallel workers are emitted (see
+ * emitParallelMatchers). These test membership of the morphism instead of
+ * the matched flags of host items, and write nothing to the host graph. */
+static bool worker_matcher = false;
+
+/* The head of the test for a matched host node or edge in the matcher being
+ * emitted, completed by the item and a closing parenthesis. */
+#define MATCHED_NODE (worker_matcher ? "nodeInMorphism(morphism, " : "nodeMatched(")
+#define MATCHED_EDGE (worker_matcher ? "edgeInMorphism(morphism, " : "edgeMatched(")
+
+static void emitMatcherPrototypes(SearchOp *operation);
+static void emitMatchers(Rule *rule, SearchOp *operation);
+static void emitSearchplanSelection(Rule *rule, Searchplan **plans, int plan_count);
+
+/* Generates the matching functions of the rule. Returns true if the rule
+ * also gets the function resumeMatch<rule>, which loops of the single rule
+ * call instead of match<rule>. It continues the search from the host node
+ * matched first in the previous iteration, so that a loop applying the rule
+ * across a node list does not rescan the head of the list each time. This
+ * requires a searchplan starting with a node list scan, and the rule must
+ * preserve the node matched first. With -b, the batches of a rule resume in
+ * the same way between their matches, whether or not the rule preserves the
+ * node, as nothing is applied until the batch is complete.
+ *
+ * With -j, a rule whose single searchplan starts by scanning the root list or
+ * a node list also gets match<rule>At, which matches the rule with its first
+ * node bound to a given host node. Rule set calls use it to scan the
+ * candidates of rules with the same first scan only once.
+ *
+ * With -z, each of these functions is a flat matcher holding the operations
+ * of the whole searchplan (see emitFlatMatcher). */
+static bool generateMatchingCode(Rule *rule, bool predicate)
+{
+   Searchplan *plans[MAX_SEARCHPLANS];
+   int plan_count = 1, plan;
+   if(adaptive_searchplans) 
+      plan_count = generateAlternativeSearchplans(rule, plans, MAX_SEARCHPLANS);
+   else plans[0] = generateSearchplan(rule);
+   searchplan = plans[0];
+   if(searchplan->first == NULL)
+   {
+      print_to_log("Error: empty searchplan. Aborting.\n");
+      freeSearchplan(searchplan);
+      return false;
+   }
+   if(profile_runtime)
+   {
+      /* The LHS item of each operation of the first searchplan. */
+      int operations = 0;
+      for(SearchOp *op = searchplan->first; op != NULL; op = op->next) operations++;
+      profile_operations = malloc(operations + 1);
+      if(profile_operations == NULL)
+      {
+         print_to_log("Error (generateMatchingCode): malloc failure.\n");
+         exit(1);
+      }
+      PTF("static const int operation_items[] = {");
+      operations = 0;
+      for(SearchOp *op = searchplan->first; op != NULL; op = op->next)
+      {
+         PTF("%s%d", operations == 0 ? "" : ", ", op->index);
+         profile_operations[operations++] = op->type;
+      }
+      profile_operations[operations] = '\0';
+      PTF("};\n\n");
+   }
+   resumable_node = NULL;
+   bool resumable = false;
+   if((resumable_loops || batch_apply) && !predicate && plan_count == 1 &&
+      searchplan->first->type == 'n')
+   {
+      RuleNode *node = getRuleNode(rule->lhs, searchplan->first->index);
+      if(!usesNodeIndex(node))
+      {
+         resumable = resumable_loops && node->interface != NULL;
+         if(resumable || batch_apply) resumable_node = node;
+      }
+   }
+   bool parallel = plan_count == 1 && parallelMatchable(rule);
+   if(shared_scans && !predicate && plan_count == 1 &&
+      (searchplan->first->type == 'r' || (searchplan->first->type == 'n' &&
+       !usesNodeIndex(getRuleNode(rule->lhs, searchplan->first->index)))))
+   {
+      shared_scan = searchplan->first->type;
+      shared_scan_mark = getRuleNode(rule->lhs, searchplan->first->index)->label.mark;
+   }
+   if(resumable_node != NULL)
+   {
+      if(no_node_list) PTF("static long resume_index = 0;\n");
+      else PTF("static Node *resume_node = NULL;\n");
+      if(resumable) PTF("static bool resume_ready = false;\n");
+      PTF("static bool match_n%d_resume(Morphism *morphism);\n", resumable_node->index);
+   }
+   for(plan = 0; plan < plan_count; plan++)
+   {
+      if(print_searchplans)
+      {
+         if(plan == 0) printf("Searchplan for rule %s:\n", rule->name);
+         else printf("Alternative searchplan %d for rule %s:\n", plan, rule->name);
+         printSearchplan(plans[plan]);
+      }
+      searchplan = plans[plan];
+      if(plan == 0) plan_suffix[0] = '\0';
+      else sprintf(plan_suffix, "_p%d", plan);
+      emitMatcherPrototypes(searchplan->first);
+   }
+   if(parallel)
+   {
+      int index = searchplan->first->index;
+      PTF("static bool match_n%d_parallel(Morphism *morphism);\n", index);
+      PTF("static bool match_n%d_from(Morphism *morphism, long start);\n", index);
+      PTF("static bool match_n%d_w(Morphism *morphism, long start, long end, long *position);\n",
+          index);
+      if(!flat_matchers)
+      {
+         strcpy(plan_suffix, "_w");
+         emitMatcherPrototypes(searchplan->first->next);
+         plan_suffix[0] = '\0';
       }
-      operation = operation->next;
    }
    /* Generate the main matching function which sets up the runtime matching 
     * environment and calls the first matching function. */
@@ -199,11 +512,23 @@ static void generateMatchingCode(Rule *rule, bool predicate)
         3, rule->lhs->edge_index);
    }
 
+   searchplan = plans[0];
    char item = searchplan->first->is_node ? 'n' : 'e';
+   string first_suffix = parallel ? "_parallel" : "";
 
-   if(predicate)
+   if(plan_count > 1)
    {
-      PTFI("bool match = match_%c%d(morphism);\n", 3, item, searchplan->first->index);
+      emitSearchplanSelection(rule, plans, plan_count);
+      if(!predicate) PTFI("if(match) return true;\n", 3);
+      PTFI("clearMatched(morphism);\n", 3);
+      PTFI("initialiseMorphism(morphism);\n", 3);
+      if(predicate) PTFI("return match;\n", 3);
+      else PTFI("return false;\n", 3);
+   }
+   else if(predicate)
+   {
+      PTFI("bool match = match_%c%d%s(morphism);\n", 3, item, searchplan->first->index,
+           first_suffix);
       /* Reset the matched flags in the host graph. This is normally done after
        * rule application, but predicate rules are not applied. */
       PTFI("clearMatched(morphism);\n", 3);
@@ -212,7 +537,8 @@ static void generateMatchingCode(Rule *rule, bool predicate)
    }
    else 
    {
-      PTFI("if(match_%c%d(morphism)) return true;\n", 3, item, searchplan->first->index);
+      PTFI("if(match_%c%d%s(morphism)) return true;\n", 3, item, searchplan->first->index,
+           first_suffix);
       PTFI("else\n", 3);
       PTFI("{\n", 3);
       PTFI("clearMatched(morphism);\n", 6);
@@ -222,8 +548,99 @@ static void generateMatchingCode(Rule *rule, bool predicate)
    }
    PTF("}\n\n");
 
+   if(resumable)
+   {
+      /* Within a loop, the recorded node is valid after each successful match
+       * as the rule is the only one applied in between. */
+      fprintf(header, "bool resumeMatch%s(Morphism *morphism);\n\n", rule->name);
+      PTF("bool resumeMatch%s(Morphism *morphism)\n", rule->name);
+      PTF("{\n");
+      PTFI("if(resume_ready)\n", 3);
+      PTFI("{\n", 3);
+      PTFI("if(match_n%d_resume(morphism)) return true;\n", 6, resumable_node->index);
+      PTFI("clearMatched(morphism);\n", 6);
+      PTFI("initialiseMorphism(morphism);\n", 6);
+      PTFI("}\n", 3);
+      PTFI("resume_ready = match%s(morphism);\n", 3, rule->name);
+      PTFI("return resume_ready;\n", 3);
+      PTF("}\n\n");
+   }
+
+   if(shared_scan != 0)
+      emitStartingNodeMatcher(rule, getRuleNode(rule->lhs, searchplan->first->index),
+                              shared_scan, searchplan->first->next);
+
+   for(plan = 0; plan < plan_count; plan++)
+   {
+      searchplan = plans[plan];
+      if(plan == 0) plan_suffix[0] = '\0';
+      else sprintf(plan_suffix, "_p%d", plan);
+      if(flat_matchers)
+      {
+         PTF("static bool match_%c%d%s(Morphism *morphism)\n", searchplan->first->is_node ? 'n' : 'e',
+             searchplan->first->index, plan_suffix);
+         emitFlatMatcher(rule, 'm');
+      }
+      else emitMatchers(rule, searchplan->first);
+      if(plan == 0 && resumable_node != NULL)
+         emitResumingNodeMatcher(rule, resumable_node, searchplan->first->next);
+      if(parallel)
+         emitParallelMatchers(rule, getRuleNode(rule->lhs, searchplan->first->index),
+                              searchplan->first->next);
+      freeSearchplan(searchplan);
+   }
+   searchplan = NULL;
+   plan_suffix[0] = '\0';
+   resume_matcher_index = resumable_node == NULL ? -1 : resumable_node->index;
+   resumable_node = NULL;
+   return resumable;
+}
+
+/* Prints the prototypes of the matching functions of the current searchplan
+ * from the passed operation. */
+static void emitMatcherPrototypes(SearchOp *operation)
+{
+   /* Iterator over the searchplan to print the prototypes of the matching functions. */
+   while(operation != NULL)
+   {
+      char type = operation->type;
+      switch(type)
+      {
+         case 'n':
+         case 'r':
+              PTF("static bool match_n%d%s(Morphism *morphism);\n", operation->index, plan_suffix);
+              break;
+
+         case 'i': 
+         case 'o': 
+         case 'b':
+              PTF("static bool match_n%d%s(Morphism *morphism, Edge *host_edge);\n",
+                  operation->index, plan_suffix);
+              break;
+
+         case 'e': 
+         case 's': 
+         case 't':
+         case 'l':
+              PTF("static bool match_e%d%s(Morphism *morphism);\n", operation->index, plan_suffix);
+              break;
+
+         default:
+              print_to_log("Error (generateMatchingCode): Unexpected "
+                           "operation type %c.\n", operation->type);
+              break;
+      }
+      /* A flat matcher is the only function of its searchplan. */
+      if(flat_matchers) break;
+      operation = operation->next;
+   }
+}
+
+/* Prints the definitions of the matching functions of the current searchplan
+ * from the passed operation. */
+static void emitMatchers(Rule *rule, SearchOp *operation)
+{
    /* Iterator over the searchplan to print the definitions of the matching functions. */
-   operation = searchplan->first;
    RuleNode *node = NULL;
    RuleEdge *edge = NULL;
    while(operation != NULL)
@@ -284,9 +701,40 @@ static void generateMatchingCode(Rule *rule, bool predicate)
       }
       operation = operation->next;
    }
-   freeSearchplan(searchplan);
 }
 
+/* Generates code to run the alternative searchplan with the lowest estimated
+ * cost for the current host graph, storing the result in the variable match.
+ * The cost of a plan is its weight multiplied by the number of host nodes
+ * with the mark of its first node, read from the counters maintained by the
+ * graph module. */
+static void emitSearchplanSelection(Rule *rule, Searchplan **plans, int plan_count)
+{
+   PTFI("/* Choose a searchplan from the current host graph mark counts. */\n", 3);
+   PTFI("int plan = 0;\n", 3);
+   PTFI("double cost, best_cost;\n", 3);
+   int plan;
+   for(plan = 0; plan < plan_count; plan++)
+   {
+      RuleNode *start = getRuleNode(rule->lhs, plans[plan]->first->index);
+      PTFI("cost = %g * ", 3, searchplanWeight(plans[plan], rule->lhs));
+      if(start->label.mark == ANY) PTF("(host->number_of_nodes - host->nodes_by_mark[0]);\n");
+      else PTF("host->nodes_by_mark[%d];\n", start->label.mark);
+      if(plan == 0) PTFI("best_cost = cost;\n", 3);
+      else PTFI("if(cost < best_cost) { best_cost = cost; plan = %d; }\n", 3, plan);
+   }
+   PTFI("bool match;\n", 3);
+   PTFI("switch(plan)\n", 3);
+   PTFI("{\n", 3);
+   for(plan = 0; plan < plan_count; plan++)
+   {
+      if(plan == 0) PTFI("default: match = match_n%d(morphism); break;\n", 6,
+                         plans[plan]->first->index);
+      else PTFI("case %d: match = match_n%d_p%d(morphism); break;\n", 6, plan,
+                plans[plan]->first->index, plan);
+   }
+   PTFI("}\n", 3);
+}
 
 /* The host node does not match the rule node if:
  * (1) The host node's indegree is strictly less than the rule node's indegree.
@@ -376,6 +824,97 @@ static bool emitDegreeCheck(RuleNode *left_node, int indent)
    return emitted;
 }
 
+/* Returns true if the integer expression only depends on the degrees of the
+ * rule node with the passed index. Division is excluded because evaluating it
+ * early could divide by zero where the condition would not. */
+static bool degreeExpression(RuleAtom *atom, int node_index)
+{
+   switch(atom->type)
+   {
+      case INTEGER_CONSTANT:
+           return true;
+
+      case INDEGREE:
+      case OUTDEGREE:
+           return atom->node_id == node_index;
+
+      case NEG:
+           return degreeExpression(atom->neg_exp, node_index);
+
+      case ADD:
+      case SUBTRACT:
+      case MULTIPLY:
+           return degreeExpression(atom->bin_op.left_exp, node_index) &&
+                  degreeExpression(atom->bin_op.right_exp, node_index);
+
+      default:
+           return false;
+   }
+}
+
+static bool degreeLabel(RuleLabel label, int node_index)
+{
+   return label.length == 1 && label.list != NULL &&
+          degreeExpression(label.list->first->atom, node_index);
+}
+
+/* Prints a check that rejects the candidate host_node with fail_code if it
+ * fails a predicate that the rule's condition requires and that only compares
+ * degrees of the rule node, such as "indeg(n) > 3". The check runs before
+ * label matching, so that such candidates are rejected without binding any
+ * variables or evaluating the whole condition after the node is matched. The
+ * predicate is still evaluated with the others in emitNodeMatchResultCode. */
+static void emitConditionFilter(Rule *rule, RuleNode *left_node, string fail_code, int indent)
+{
+   if(left_node->predicates == NULL) return;
+   int index;
+   for(index = 0; index < left_node->predicate_count; index++)
+   {
+      Predicate *predicate = left_node->predicates[index];
+      bool negated = false;
+      if(!requiredPredicate(rule->condition, predicate, &negated)) continue;
+      RuleAtom *left_atom = NULL, *right_atom = NULL;
+      string operator = NULL;
+      switch(predicate->type)
+      {
+         case EQUAL:
+         case NOT_EQUAL:
+              if(!degreeLabel(predicate->list_comp.left_label, left_node->index) ||
+                 !degreeLabel(predicate->list_comp.right_label, left_node->index)) continue;
+              left_atom = predicate->list_comp.left_label.list->first->atom;
+              right_atom = predicate->list_comp.right_label.list->first->atom;
+              operator = predicate->type == EQUAL ? " == " : " != ";
+              break;
+
+         case GREATER:
+         case GREATER_EQUAL:
+         case LESS:
+         case LESS_EQUAL:
+              if(!degreeExpression(predicate->atom_comp.left_atom, left_node->index) ||
+                 !degreeExpression(predicate->atom_comp.right_atom, left_node->index)) continue;
+              left_atom = predicate->atom_comp.left_atom;
+              right_atom = predicate->atom_comp.right_atom;
+              if(predicate->type == GREATER) operator = " > ";
+              if(predicate->type == GREATER_EQUAL) operator = " >= ";
+              if(predicate->type == LESS) operator = " < ";
+              if(predicate->type == LESS_EQUAL) operator = " <= ";
+              break;
+
+         default:
+              continue;
+      }
+      /* The generated integer expression refers to the node as n<index>. */
+      PTFI("{\n", indent);
+      PTFI("Node *n%d = host_node;\n", indent + 3, left_node->index);
+      PTFI("if(%s(", indent + 3, negated ? "" : "!");
+      generateIntExpression(left_atom, 1, false);
+      PTF("%s", operator);
+      generateIntExpression(right_atom, 1, false);
+      PTF(")) %s\n", fail_code);
+      PTFI("}\n", indent);
+   }
+}
+
  
 /* The emitMatcher functions in this module take an LHS item and emit a function 
  * that searches for a matching host item. The generated code queries the host graph
@@ -400,59 +939,91 @@ static bool emitDegreeCheck(RuleNode *left_node, int indent)
  * left, code is generated to return true. */
 static void emitRootNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
 {
-   PTF("static bool match_n%d(Morphism *morphism)\n", left_node->index);
+   PTF("static bool match_n%d%s(Morphism *morphism)\n", left_node->index, plan_suffix);
    PTF("{\n");
    PTFI("RootNodes *nodes;\n", 3);   
-   PTFI("for(nodes = getRootNodeList(host); nodes != NULL; nodes = nodes->next)\n", 3);
-   PTFI("{\n", 3);
-   PTFI("Node *host_node = nodes->node;\n", 6);
-   PTFI("if(host_node == NULL) continue;\n", 6);
-   PTFI("if(nodeMatched(host_node)) continue;\n", 6);
-   if(left_node->label.mark == ANY) PTFI("if(host_node->label.mark == 0) continue;\n", 6);
-   else PTFI("if(host_node->label.mark != %d) continue;\n", 6, left_node->label.mark);
-   if(emitDegreeCheck(left_node, 6)) PTF("continue;\n");
-   PTF("\n");
-
-   PTFI("HostLabel label = host_node->label;\n", 6);
-   PTFI("bool match = false;\n", 6);
-   if(hasListVariable(left_node->label)) generateVariableListMatchingCode(rule, left_node->label, 6);
-   else generateFixedListMatchingCode(rule, left_node->label, 6);
-   emitNodeMatchResultCode(left_node, next_op, 6);
-   PTFI("}\n", 3);
+   /* Only the root lists of the marks matched by the rule node are scanned. */
+   for(int m = 0; m < 6; m++)
+   {
+      if(left_node->label.mark == ANY ? m == NONE || m == DASHED : left_node->label.mark != m)
+         continue;
+      PTFI("for(nodes = getRootNodeList(host, %d); nodes != NULL; nodes = nodes->next)\n", 3, m);
+      PTFI("{\n", 3);
+      PTFI("Node *host_node = nodes->node;\n", 6);
+      PTFI("if(host_node == NULL) continue;\n", 6);
+      emitRootNodeCandidate(rule, left_node, next_op, 6);
+      PTFI("}\n", 3);
+   }
    PTFI("return false;\n", 3);
    PTF("}\n\n");
 }
 
+/* Prints the checks on a candidate root host_node and the code to match its
+ * label, with the passed indent. */
+static void emitRootNodeCandidate(Rule *rule, RuleNode *left_node, SearchOp *next_op,
+                                  int indent)
+{
+   emitCandidateCount(true, left_node->index, indent);
+   PTFI("if(%shost_node)) continue;\n", indent, MATCHED_NODE);
+   if(left_node->label.mark == ANY) PTFI("if(host_node->label.mark == 0) continue;\n", indent);
+   else PTFI("if(host_node->label.mark != %d) continue;\n", indent, left_node->label.mark);
+   if(emitDegreeCheck(left_node, indent)) PTF("continue;\n");
+   emitConditionFilter(rule, left_node, "continue;", indent);
+   PTF("\n");
+
+   PTFI("HostLabel label = host_node->label;\n", indent);
+   PTFI("bool match = false;\n", indent);
+   if(hasListVariable(left_node->label)) generateVariableListMatchingCode(rule, left_node->label, indent);
+   else generateFixedListMatchingCode(rule, left_node->label, indent);
+   emitNodeMatchResultCode(left_node, next_op, indent);
+}
+
+/* Returns true if the rule node is matched in isolation through the label
+ * index (see emitIndexedNodeMatcher). */
+static bool usesLabelIndex(RuleNode *left_node)
+{
+   return label_index && left_node->label.mark != ANY && isConstantLabel(left_node->label);
+}
+
+/* Returns true if the rule node is matched in isolation through the degree
+ * lists (see emitDegreeNodeMatcher). This is the case for a node deleted by
+ * the rule with few incident edges: the dangling condition requires the host
+ * node to have exactly the degree of the rule node. */
+static bool usesDegreeIndex(RuleNode *left_node)
+{
+   return degree_index && left_node->interface == NULL &&
+          left_node->outdegree + left_node->indegree + left_node->bidegree < DEGREE_INDEX_BUCKETS;
+}
+
+/* Returns true if the candidates of the rule node come from an index instead
+ * of a node list scan. */
+static bool usesNodeIndex(RuleNode *left_node)
+{
+   return usesDegreeIndex(left_node) || usesLabelIndex(left_node);
+}
+
 /* The rule node is matched "in isolation", in that it is not the source or
  * target of a previously-matched edge. In this case, the candidate host
  * graph nodes are obtained from the appropriate label class tables. */
 static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
 {
-   PTF("static bool match_n%d(Morphism *morphism)\n", left_node->index);
+   if(usesDegreeIndex(left_node))
+   {
+      emitDegreeNodeMatcher(rule, left_node, next_op);
+      return;
+   }
+   if(usesLabelIndex(left_node))
+   {
+      emitIndexedNodeMatcher(rule, left_node, next_op);
+      return;
+   }
+   PTF("static bool match_n%d%s(Morphism *morphism)\n", left_node->index, plan_suffix);
    PTF("{\n");
    if(no_node_list)
    {
       PTFI("Node *host_node;\n", 3);
-      PTFI("for (int i = 0; i < host->_nodearray.size; i++)\n", 3);
-      PTFI("{\n", 3);
-      PTFI("host_node = (Node *) getBigArrayValue(&(host->_nodearray), i);\n", 6);
-      PTFI("if(nodeDeleted(host_node))\n", 6);
-      PTFI("{\n", 6);
-      PTFI("clearNodeInGraph(host_node);\n", 9);
-      PTFI("continue;\n", 6);
-      PTFI("}\n", 6);
-      if(reflect_roots) PTFI("if(nodeMatched(host_node) || nodeRoot(host_node)) continue;\n", 6);
-      else PTFI("if(nodeMatched(host_node)) continue;\n", 6);
-      if(left_node->label.mark == ANY) PTFI("if(host_node->label.mark == 0) continue;\n", 6);
-      else PTFI("if(host_node->label.mark != %d) continue;\n", 6, left_node->label.mark);
-      if(emitDegreeCheck(left_node, 6)) PTF("continue;\n");
-      PTF("\n");
-
-      PTFI("HostLabel label = host_node->label;\n", 6);
-      PTFI("bool match = false;\n", 6);
-      if(hasListVariable(left_node->label)) generateVariableListMatchingCode(rule, left_node->label, 6);
-      else generateFixedListMatchingCode(rule, left_node->label, 6);
-      emitNodeMatchResultCode(left_node, next_op, 6);
+      emitNodeArrayLoop(left_node, "0");
+      emitNodeCandidate(rule, left_node, next_op, 6);
       PTFI("}\n", 3);
       PTFI("return false;\n", 3);
       PTF("}\n\n");
@@ -469,23 +1040,364 @@ static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
          else
             PTFI("for(Node *host_node; (host_node = yieldNextNode(host, &nlistpos, %d)) != NULL;)\n", 3, left_node->label.mark);
          PTFI("{\n", 3);
-         if(reflect_roots) PTFI("if(nodeMatched(host_node) || nodeRoot(host_node)) continue;\n", 6);
-         else PTFI("if(nodeMatched(host_node)) continue;\n", 6);
-         if(left_node->label.mark == ANY) PTFI("if(host_node->label.mark == 0) continue;\n", 6);
-         else PTFI("if(host_node->label.mark != %d) continue;\n", 6, left_node->label.mark);
-         if(emitDegreeCheck(left_node, 6)) PTF("continue;\n");
-         PTF("\n");
+         emitNodeCandidate(rule, left_node, next_op, 6);
+         PTFI("}\n", 3);
+      }
+      PTFI("return false;\n", 3);
+      PTF("}\n\n");
+   }
+}
+
+/* With -y, prints the filter of the host nodes that can match the rule node,
+ * from its mark and the least degrees checked by emitDegreeCheck, as the
+ * variable with the passed name. Filtered positions hold live nodes, since
+ * deleted nodes have no mark bits. */
+static void emitNodeFilter(RuleNode *left_node, string name)
+{
+   int marks = left_node->label.mark == ANY ? 0x3E : 1 << left_node->label.mark;
+   int degree = left_node->outdegree + left_node->indegree + left_node->bidegree;
+   PTFI("static const NodeFilter %s = {0x%02X, %d, %d, %d};\n", 3, name, marks,
+        left_node->indegree > 255 ? 255 : left_node->indegree,
+        left_node->outdegree > 255 ? 255 : left_node->outdegree,
+        degree > 255 ? 255 : degree);
+}
+
+/* Prints the head of a loop over the node array from the passed start index,
+ * and the skipping of deleted nodes at the top of its body. Each iteration
+ * binds host_node. With -y, the loop only visits the positions that pass the
+ * filter of the rule node. */
+static void emitNodeArrayLoop(RuleNode *left_node, string start)
+{
+   if(node_filter)
+   {
+      emitNodeFilter(left_node, "filter");
+      PTFI("for(long i = nextNodeCandidate(host, %s, host->_nodearray.size, &filter);\n",
+           3, start);
+      PTFI("i < host->_nodearray.size;\n", 7);
+      PTFI("i = nextNodeCandidate(host, i + 1, host->_nodearray.size, &filter))\n", 7);
+      PTFI("{\n", 3);
+      PTFI("host_node = (Node *) getBigArrayValue(&(host->_nodearray), i);\n", 6);
+      return;
+   }
+   PTFI("for (long i = %s; i < host->_nodearray.size; i++)\n", 3, start);
+   PTFI("{\n", 3);
+   PTFI("host_node = (Node *) getBigArrayValue(&(host->_nodearray), i);\n", 6);
+   if(worker_matcher)
+   {
+      PTFI("if(nodeDeleted(host_node)) continue;\n", 6);
+      return;
+   }
+   PTFI("if(nodeDeleted(host_node))\n", 6);
+   PTFI("{\n", 6);
+   PTFI("clearNodeInGraph(host_node);\n", 9);
+   PTFI("continue;\n", 6);
+   PTFI("}\n", 6);
+}
+
+/* Prints the checks on a candidate host_node for a rule node matched in
+ * isolation, and the code to match its label, with the passed indent. The
+ * first matcher of a resumable searchplan also records the candidate. */
+static void emitNodeCandidate(Rule *rule, RuleNode *left_node, SearchOp *next_op, int indent)
+{
+   emitCandidateCount(true, left_node->index, indent);
+   if(reflect_roots) PTFI("if(%shost_node) || nodeRoot(host_node)) continue;\n", indent, MATCHED_NODE);
+   else PTFI("if(%shost_node)) continue;\n", indent, MATCHED_NODE);
+   if(left_node->label.mark == ANY) PTFI("if(host_node->label.mark == 0) continue;\n", indent);
+   else PTFI("if(host_node->label.mark != %d) continue;\n", indent, left_node->label.mark);
+   if(emitDegreeCheck(left_node, indent)) PTF("continue;\n");
+   emitConditionFilter(rule, left_node, "continue;", indent);
+   PTF("\n");
+
+   PTFI("HostLabel label = host_node->label;\n", indent);
+   PTFI("bool match = false;\n", indent);
+   if(hasListVariable(left_node->label)) generateVariableListMatchingCode(rule, left_node->label, indent);
+   else generateFixedListMatchingCode(rule, left_node->label, indent);
+   if(left_node == resumable_node)
+   {
+      if(no_node_list) PTFI("resume_index = i;\n", indent);
+      else PTFI("resume_node = host_node;\n", indent);
+   }
+   emitNodeMatchResultCode(left_node, next_op, indent);
+}
 
-         PTFI("HostLabel label = host_node->label;\n", 6);
-         PTFI("bool match = false;\n", 6);
-         if(hasListVariable(left_node->label)) generateVariableListMatchingCode(rule, left_node->label, 6);
-         else generateFixedListMatchingCode(rule, left_node->label, 6);
-         emitNodeMatchResultCode(left_node, next_op, 6);
+/* Emits match_n<index>_resume, which scans the candidates of the first
+ * matcher of a resumable searchplan like match_n<index>, but starting from
+ * the host node recorded by the last successful match. That node is in the
+ * host graph because the rule preserves it. Candidates before it are not
+ * tried, so resumeMatch<rule> falls back to a full search if this fails. */
+static void emitResumingNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
+{
+   PTF("static bool match_n%d_resume(Morphism *morphism)\n", left_node->index);
+   if(flat_matchers)
+   {
+      emitFlatMatcher(rule, 'u');
+      return;
+   }
+   PTF("{\n");
+   if(no_node_list)
+   {
+      PTFI("Node *host_node;\n", 3);
+      emitNodeArrayLoop(left_node, "resume_index");
+      emitNodeCandidate(rule, left_node, next_op, 6);
+      PTFI("}\n", 3);
+   }
+   else if(left_node->label.mark != ANY)
+   {
+      /* The recorded node is in another list if the rule changed its mark. */
+      PTFI("if(resume_node->label.mark != %d) return false;\n", 3, left_node->label.mark);
+      PTFI("NodeList *nlistpos = nodeListPosition(resume_node);\n", 3);
+      PTFI("for(Node *host_node = resume_node; host_node != NULL;\n", 3);
+      PTFI("host_node = yieldNextNode(host, &nlistpos, %d))\n", 7, left_node->label.mark);
+      PTFI("{\n", 3);
+      emitNodeCandidate(rule, left_node, next_op, 6);
+      PTFI("}\n", 3);
+   }
+   else
+   {
+      /* The mark lists are scanned in order from the list of the recorded
+       * node. */
+      PTFI("Node *start = resume_node;\n", 3);
+      PTFI("int start_mark = start->label.mark;\n", 3);
+      PTFI("NodeList *nlistpos;\n", 3);
+      PTFI("Node *host_node;\n", 3);
+      for(int m = 0; m < 6; m++){
+         if(m == DASHED) continue;
+         PTFI("if(start_mark <= %d)\n", 3, m);
+         PTFI("{\n", 3);
+         PTFI("if(start_mark == %d)\n", 6, m);
+         PTFI("{\n", 6);
+         PTFI("nlistpos = nodeListPosition(start);\n", 9);
+         PTFI("host_node = start;\n", 9);
+         PTFI("}\n", 6);
+         PTFI("else\n", 6);
+         PTFI("{\n", 6);
+         PTFI("nlistpos = NULL;\n", 9);
+         PTFI("host_node = yieldNextNode(host, &nlistpos, %d);\n", 9, m);
+         PTFI("}\n", 6);
+         PTFI("for(; host_node != NULL; host_node = yieldNextNode(host, &nlistpos, %d))\n", 6, m);
+         PTFI("{\n", 6);
+         emitNodeCandidate(rule, left_node, next_op, 9);
+         PTFI("}\n", 6);
          PTFI("}\n", 3);
       }
+   }
+   PTFI("return false;\n", 3);
+   PTF("}\n\n");
+}
+
+/* Emits match<rule>At, which tries the host node passed by the caller as the
+ * only candidate of the first matcher. The caller scans the candidates, so
+ * the checks of the scan are repeated here except for the root flag of
+ * candidates from the root list. On failure the morphism is left empty, as
+ * every matcher undoes its own changes when it backtracks. */
+static void emitStartingNodeMatcher(Rule *rule, RuleNode *left_node, char type,
+                                    SearchOp *next_op)
+{
+   fprintf(header, "bool match%sAt(Morphism *morphism, Node *host_node);\n\n", rule->name);
+   PTF("bool match%sAt(Morphism *morphism, Node *host_node)\n", rule->name);
+   /* The host node is recorded only by the scans of the rule's own matchers. */
+   RuleNode *recorded_node = resumable_node;
+   resumable_node = NULL;
+   if(flat_matchers) emitFlatMatcher(rule, 'a');
+   else
+   {
+      PTF("{\n");
+      PTFI("do\n", 3);
+      PTFI("{\n", 3);
+      if(type == 'r') emitRootNodeCandidate(rule, left_node, next_op, 6);
+      else emitNodeCandidate(rule, left_node, next_op, 6);
+      PTFI("} while(false);\n", 3);
       PTFI("return false;\n", 3);
       PTF("}\n\n");
    }
+   resumable_node = recorded_node;
+}
+
+/* Returns true if the first operation of the rule's searchplan can be run by
+ * parallel workers. The worker matchers must not write to the host graph or
+ * the string table, which rules out conditions, list variables and string
+ * concatenation in the LHS, and edges matched in isolation, whose candidates
+ * are drawn from a list that is garbage collected during the scan. The first
+ * operation must scan the node array. */
+static bool parallelMatchable(Rule *rule)
+{
+   if(!parallel_matching || !no_node_list || rule->condition != NULL) return false;
+   if(searchplan->first->type != 'n') return false;
+   if(usesNodeIndex(getRuleNode(rule->lhs, searchplan->first->index))) return false;
+   for(SearchOp *operation = searchplan->first; operation != NULL; operation = operation->next)
+      if(operation->type == 'e') return false;
+   for(int index = 0; index < rule->lhs->node_index; index++)
+   {
+      RuleLabel label = getRuleNode(rule->lhs, index)->label;
+      if(hasListVariable(label) || hasConcatenation(label)) return false;
+   }
+   for(int index = 0; index < rule->lhs->edge_index; index++)
+   {
+      RuleLabel label = getRuleEdge(rule->lhs, index)->label;
+      if(hasListVariable(label) || hasConcatenation(label)) return false;
+   }
+   return true;
+}
+
+/* Emits the matchers of a rule whose first operation is run on several
+ * threads. match_n<index>_parallel replaces the call of the first matcher.
+ * On host graphs with enough candidates it has the workers run
+ * match_n<index>_w over blocks of the node array, followed by the "_w" copies
+ * of the other matchers, and then rebuilds the match at the position found
+ * with match_n<index>_from. */
+static void emitParallelMatchers(Rule *rule, RuleNode *left_node, SearchOp *next_op)
+{
+   int index = left_node->index;
+   PTF("static bool match_n%d_parallel(Morphism *morphism)\n", index);
+   PTF("{\n");
+   PTFI("if(host->_nodearray.size < PARALLEL_MIN_CANDIDATES) return match_n%d(morphism);\n",
+        3, index);
+   PTFI("long position = parallelSearch(match_n%d_w, host->_nodearray.size, morphism->nodes,\n",
+        3, index);
+   PTFI("morphism->edges, morphism->variables);\n", 33);
+   PTFI("if(position < 0) return false;\n", 3);
+   PTFI("return match_n%d_from(morphism, position);\n", 3, index);
+   PTF("}\n\n");
+
+   PTF("static bool match_n%d_from(Morphism *morphism, long start)\n", index);
+   if(flat_matchers) emitFlatMatcher(rule, 'f');
+   else
+   {
+      PTF("{\n");
+      PTFI("Node *host_node;\n", 3);
+      emitNodeArrayLoop(left_node, "start");
+      emitNodeCandidate(rule, left_node, next_op, 6);
+      PTFI("}\n", 3);
+      PTFI("return false;\n", 3);
+      PTF("}\n\n");
+   }
+
+   /* The workers must not record the node for resumed matching. */
+   RuleNode *recorded_node = resumable_node;
+   resumable_node = NULL;
+   worker_matcher = true;
+   lookup_string_constants = true;
+   strcpy(plan_suffix, "_w");
+   PTF("static bool match_n%d_w(Morphism *morphism, long start, long end, long *position)\n", index);
+   if(flat_matchers) emitFlatMatcher(rule, 'w');
+   else
+   {
+      PTF("{\n");
+      PTFI("Node *host_node;\n", 3);
+      if(node_filter)
+      {
+         emitNodeFilter(left_node, "filter");
+         PTFI("for(long i = nextNodeCandidate(host, start, end, &filter);\n", 3);
+         PTFI("i < end && !parallelMatchFound(i); i = nextNodeCandidate(host, i + 1, end, &filter))\n", 7);
+         PTFI("{\n", 3);
+         PTFI("host_node = (Node *) getBigArrayValue(&(host->_nodearray), i);\n", 6);
+      }
+      else
+      {
+         PTFI("for(long i = start; i < end && !parallelMatchFound(i); i++)\n", 3);
+         PTFI("{\n", 3);
+         PTFI("host_node = (Node *) getBigArrayValue(&(host->_nodearray), i);\n", 6);
+         PTFI("if(nodeDeleted(host_node)) continue;\n", 6);
+      }
+      PTFI("*position = i;\n", 6);
+      emitNodeCandidate(rule, left_node, next_op, 6);
+      PTFI("}\n", 3);
+      PTFI("return false;\n", 3);
+      PTF("}\n\n");
+      emitMatchers(rule, searchplan->first->next);
+   }
+   plan_suffix[0] = '\0';
+   lookup_string_constants = false;
+   worker_matcher = false;
+   resumable_node = recorded_node;
+}
+
+/* A rule node with a constant label and a fixed mark is matched in isolation
+ * by looking up the host list of its label in the list store, and iterating
+ * over the label index class of that list and mark. If the list is not in the
+ * store, no host node can match. */
+static void emitIndexedNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
+{
+   PTF("static bool match_n%d%s(Morphism *morphism)\n", left_node->index, plan_suffix);
+   PTF("{\n");
+   if(left_node->label.length == 0) PTFI("HostList *list = NULL;\n", 3);
+   else
+   {
+      PTFI("HostAtom array[%d];\n", 3, left_node->label.length);
+      RuleListItem *item = left_node->label.list->first;
+      int index = 0;
+      while(item != NULL)
+      {
+         if(item->atom->type == INTEGER_CONSTANT)
+         {
+            PTFI("array[%d].type = 'i';\n", 3, index);
+            PTFI("array[%d].num = %ld;\n", 3, index, item->atom->number);
+         }
+         else
+         {
+            /* A string that is not interned occurs in no host label. */
+            PTFI("array[%d].type = 's';\n", 3, index);
+            PTFI("array[%d].str = lookupString(\"%s\");\n", 3, index, item->atom->string);
+            PTFI("if(array[%d].str == NULL) return false;\n", 3, index);
+         }
+         index++;
+         item = item->next;
+      }
+      PTFI("HostList *list = lookupHostList(array, %d);\n", 3, left_node->label.length);
+      PTFI("if(list == NULL) return false;\n", 3);
+   }
+   PTFI("for(Node *host_node = firstNodeWithLabel(host, %d, list); host_node != NULL;\n", 3,
+        left_node->label.mark);
+   PTFI("    host_node = nextNodeWithLabel(host_node))\n", 3);
+   PTFI("{\n", 3);
+   emitCandidateCount(true, left_node->index, 6);
+   if(reflect_roots) PTFI("if(%shost_node) || nodeRoot(host_node)) continue;\n", 6, MATCHED_NODE);
+   else PTFI("if(%shost_node)) continue;\n", 6, MATCHED_NODE);
+   if(emitDegreeCheck(left_node, 6)) PTF("continue;\n");
+   emitConditionFilter(rule, left_node, "continue;", 6);
+   PTF("\n");
+
+   PTFI("HostLabel label = host_node->label;\n", 6);
+   PTFI("bool match = false;\n", 6);
+   generateFixedListMatchingCode(rule, left_node->label, 6);
+   emitNodeMatchResultCode(left_node, next_op, 6);
+   PTFI("}\n", 3);
+   PTFI("return false;\n", 3);
+   PTF("}\n\n");
+}
+
+/* A rule node deleted by the rule is matched in isolation by iterating over
+ * the degree list of its degree and mark, or of each mark if its mark is ANY.
+ * The degree check still tests the indegree and the outdegree. */
+static void emitDegreeNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
+{
+   PTF("static bool match_n%d%s(Morphism *morphism)\n", left_node->index, plan_suffix);
+   PTF("{\n");
+   int degree = left_node->outdegree + left_node->indegree + left_node->bidegree;
+   for(int m = 0; m < 6; m++)
+   {
+      if(left_node->label.mark == ANY ? m == NONE || m == DASHED : left_node->label.mark != m)
+         continue;
+      PTFI("for(Node *host_node = firstNodeWithDegree(host, %d, %d); host_node != NULL;\n", 3,
+           left_node->label.mark == ANY ? m : left_node->label.mark, degree);
+      PTFI("    host_node = nextNodeWithDegree(host_node))\n", 3);
+      PTFI("{\n", 3);
+      emitCandidateCount(true, left_node->index, 6);
+      if(reflect_roots) PTFI("if(%shost_node) || nodeRoot(host_node)) continue;\n", 6, MATCHED_NODE);
+      else PTFI("if(%shost_node)) continue;\n", 6, MATCHED_NODE);
+      if(emitDegreeCheck(left_node, 6)) PTF("continue;\n");
+      emitConditionFilter(rule, left_node, "continue;", 6);
+      PTF("\n");
+
+      PTFI("HostLabel label = host_node->label;\n", 6);
+      PTFI("bool match = false;\n", 6);
+      if(hasListVariable(left_node->label)) generateVariableListMatchingCode(rule, left_node->label, 6);
+      else generateFixedListMatchingCode(rule, left_node->label, 6);
+      emitNodeMatchResultCode(left_node, next_op, 6);
+      PTFI("}\n", 3);
+   }
+   PTFI("return false;\n", 3);
+   PTF("}\n\n");
 }
 
 /* Matching a node from a matched incident edge always follow an edge match in
@@ -497,21 +1409,23 @@ static void emitNodeMatcher(Rule *rule, RuleNode *left_node, SearchOp *next_op)
 static void emitNodeFromEdgeMatcher(Rule *rule, RuleNode *left_node, char type,
                                     SearchOp *next_op)
 {
-   PTF("static bool match_n%d(Morphism *morphism, Edge *host_edge)\n",
-       left_node->index);
+   PTF("static bool match_n%d%s(Morphism *morphism, Edge *host_edge)\n",
+       left_node->index, plan_suffix);
    PTF("{\n");
    if(type == 'i' || type == 'b') 
         PTFI("Node *host_node = edgeTarget(host_edge);\n\n", 3);
    else PTFI("Node *host_node = edgeSource(host_edge);\n\n", 3);
+   emitCandidateCount(true, left_node->index, 3);
 
    string fail_code = (type == 'b') ? "candidate_node = false;" : "return false;";
    if(type == 'b') PTFI("bool candidate_node = true;\n", 3);
-   PTFI("if(nodeMatched(host_node)) %s\n", 3, fail_code);
+   PTFI("if(%shost_node)) %s\n", 3, MATCHED_NODE, fail_code);
    if(left_node->root) PTFI("if(!nodeRoot(host_node)) %s\n", 3, fail_code);
    if(reflect_roots && !left_node->root) PTFI("if(nodeRoot(host_node)) %s\n", 3, fail_code);
    if(left_node->label.mark == ANY) PTFI("if(host_node->label.mark == 0) %s\n", 3, fail_code);
    else PTFI("if(host_node->label.mark != %d) %s\n", 3, left_node->label.mark, fail_code);
    if(emitDegreeCheck(left_node, 6)) PTF("%s\n", fail_code);
+   emitConditionFilter(rule, left_node, fail_code, 3);
    PTF("\n");
 
    /* If the above check fails and the edge is bidirectional, check the other 
@@ -523,12 +1437,14 @@ static void emitNodeFromEdgeMatcher(Rule *rule, RuleNode *left_node, char type,
       PTFI("/* Matching from bidirectional edge: check the second incident node. */\n", 6);
       if(type == 'i' || type == 'b') PTFI("host_node = edgeSource(host_edge);\n", 6);
       else PTFI("host_node = edgeTarget(host_edge);\n", 6);
-      PTFI("if(nodeMatched(host_node)) return false;\n", 6);
+      emitCandidateCount(true, left_node->index, 6);
+      PTFI("if(%shost_node)) return false;\n", 6, MATCHED_NODE);
       if(left_node->root) PTFI("if(!nodeRoot(host_node)) return false;\n", 6);
       if(reflect_roots && !left_node->root) PTFI("if(nodeRoot(host_node)) return false;\n", 6);
       if(left_node->label.mark == ANY) PTFI("if(host_node->label.mark == 0) return false;\n", 6);
       else PTFI("if(host_node->label.mark != %d) return false;\n", 6, left_node->label.mark);
       if (emitDegreeCheck(left_node, 6)) PTF("return false;\n");
+      emitConditionFilter(rule, left_node, "return false;", 6);
       PTF("\n");
       PTFI("}\n", 3);
    }
@@ -555,7 +1471,7 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
    PTFI("{\n", indent);
    PTFI("addNodeMap(morphism, %d, host_node, new_assignments);\n",
         indent + 3, node->index);
-   PTFI("setNodeMatched(host_node);\n", indent + 3);
+   if(!worker_matcher) PTFI("setNodeMatched(host_node);\n", indent + 3);
    if(node->predicates != NULL)
    {
       PTFI("/* Update global booleans representing the node's predicates. */\n", indent + 3);
@@ -591,7 +1507,7 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
          else PTFI("b%d = true;\n", indent + 6, predicate->bool_id);
       }
       PTFI("removeNodeMap(morphism, %d);\n", indent + 6, node->index);
-      PTFI("clearNodeMatched(host_node);\n", indent + 6);  
+      if(!worker_matcher) PTFI("clearNodeMatched(host_node);\n", indent + 6);
       PTFI("}\n", indent + 3);
    }
    else
@@ -609,7 +1525,7 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
          PTFI("else\n", indent + 3);
          PTFI("{\n", indent + 3);  
          PTFI("removeNodeMap(morphism, %d);\n", indent + 6, node->index);
-         PTFI("clearNodeMatched(host_node);\n", indent + 6);  
+         if(!worker_matcher) PTFI("clearNodeMatched(host_node);\n", indent + 6);
          PTFI("}\n", indent + 3);
       }
    }
@@ -619,49 +1535,64 @@ static void emitNodeMatchResultCode(RuleNode *node, SearchOp *next_op, int inden
 }
 
 /* The rule edge is matched "in isolation", in that it is not incident to a
- * previously-matched node. In this case, the candidate host graph edges
- * are obtained from the appropriate label class tables. */
+ * previously-matched node. The candidate host graph edges are obtained from
+ * the lists of edges by mark kept with -E (EDGE_LISTS in the lib), one list
+ * for each mark the rule edge can match. The incident nodes are matched from
+ * the host edge by the next operations of the searchplan. */
 static void emitEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op)
 {
-   PTF("static bool match_e%d(Morphism *morphism)\n", left_edge->index);
+   PTF("static bool match_e%d%s(Morphism *morphism)\n", left_edge->index, plan_suffix);
    PTF("{\n");
-   PTFI("EdgeList *elistpos = NULL;\n", 3);
-   PTFI("for(Edge *host_edge; (host_edge = yieldNextEdge(host, &elistpos)) != NULL;)\n", 3);
-   PTFI("{\n", 3);
-   PTFI("if(edgeMatched(host_edge)) continue;\n", 6);
-   if(left_edge->label.mark == ANY) 
-      PTFI("if(host_edge->label.mark == 0) continue;\n\n", 6);
-   else PTFI("if(host_edge->label.mark != %d) continue;\n\n", 6, left_edge->label.mark);
-   PTFI("HostLabel label = host_edge->label;\n", 6);
-   PTFI("bool match = false;\n", 6);
+   int indent = 3;
+   string mark = "mark";
+   char fixed_mark[8];
+   if(left_edge->label.mark == ANY)
+   {
+      PTFI("for(int mark = 1; mark < 6; mark++)\n", 3);
+      PTFI("{\n", 3);
+      indent = 6;
+   }
+   else
+   {
+      sprintf(fixed_mark, "%d", left_edge->label.mark);
+      mark = fixed_mark;
+   }
+   PTFI("for(Edge *host_edge = firstEdgeWithMark(host, %s); host_edge != NULL;\n", indent, mark);
+   PTFI("    host_edge = nextEdgeWithMark(host_edge))\n", indent);
+   PTFI("{\n", indent);
+   emitCandidateCount(false, left_edge->index, indent + 3);
+   PTFI("if(%shost_edge)) continue;\n", indent + 3, MATCHED_EDGE);
+   PTFI("if(edgeSource(host_edge) %s edgeTarget(host_edge)) continue;\n\n", indent + 3,
+        left_edge->source == left_edge->target ? "!=" : "==");
+   PTFI("HostLabel label = host_edge->label;\n", indent + 3);
+   PTFI("bool match = false;\n", indent + 3);
    if(hasListVariable(left_edge->label))
-      generateVariableListMatchingCode(rule, left_edge->label, 6);
-   else generateFixedListMatchingCode(rule, left_edge->label, 6);
-   emitEdgeMatchResultCode(left_edge->index, next_op, 6);
-   PTFI("}\n", 3);
+      generateVariableListMatchingCode(rule, left_edge->label, indent + 3);
+   else generateFixedListMatchingCode(rule, left_edge->label, indent + 3);
+   emitEdgeMatchResultCode(left_edge->index, next_op, indent + 3);
+   PTFI("}\n", indent);
+   if(left_edge->label.mark == ANY) PTFI("}\n", 3);
    PTFI("return false;\n", 3);
    PTF("}\n\n");
 }
 
 static void emitLoopEdgeMatcher(Rule *rule, RuleEdge *left_edge, SearchOp *next_op)
 {
-   PTF("static bool match_e%d(Morphism *morphism)\n", left_edge->index);
+   PTF("static bool match_e%d%s(Morphism *morphism)\n", left_edge->index, plan_suffix);
    PTF("{\n");
    PTFI("/* Matching a loop. */\n", 3);
    PTFI("Node *host_node = lookupNode(morphism, %d);\n", 3, left_edge->source->index);
    PTFI("if(host_node == NULL) return false;\n", 3);
 
-   PTFI("EdgeList *elistpos;\n", 3);
+   if(array_adjacency) PTFI("EdgeArray *earray;\n", 3);
+   else PTFI("EdgeList *elistpos;\n", 3);
    
    int times = (left_edge->label.mark == ANY)? 6: 1;
 
    for(int i = 0; i < times; i++){
-      PTFI("elistpos = NULL;\n", 3);
-      if(left_edge->label.mark == ANY)
-         PTFI("for(Edge *host_edge; (host_edge = yieldNextOutEdge(host, host_node, &elistpos, %d, true)) != NULL;)\n", 3, i);
-      else PTFI("for(Edge *host_edge; (host_edge = yieldNextOutEdge(host, host_node, &elistpos, %d, true)) != NULL;)\n", 3, left_edge->label.mark);
-      PTFI("{\n", 3);
-      PTFI("if(edgeMatched(host_edge)) continue;\n", 6);
+      emitIncidentEdgeLoop("Out", left_edge->label.mark == ANY ? i : left_edge->label.mark, true, 3);
+      emitCandidateCount(false, left_edge->index, 6);
+      PTFI("if(%shost_edge)) continue;\n", 6, MATCHED_EDGE);
       PTFI("if(edgeSource(host_edge) != edgeTarget(host_edge)) continue;\n", 6);
       if(left_edge->label.mark == ANY)
          PTFI("if(host_edge->label.mark == 0) continue;\n\n", 6);
@@ -704,66 +1635,113 @@ static void emitEdgeFromNodeMatcher(Rule *rule, RuleEdge *left_edge, bool source
 {
    int start_index = source ? left_edge->source->index : left_edge->target->index;
    int end_index = source ? left_edge->target->index : left_edge->source->index;
-   string end_node_access = source ? "edgeTarget" : "edgeSource";
 
    if(initialise)
    {
-      PTF("static bool match_e%d(Morphism *morphism)\n", left_edge->index);
+      PTF("static bool match_e%d%s(Morphism *morphism)\n", left_edge->index, plan_suffix);
       PTF("{\n");
       PTFI("/* Start node is the already-matched node from which the candidate\n", 3);
       PTFI("   edges are drawn. End node may or may not have been matched already. */\n", 3);
       PTFI("Node *host_node = lookupNode(morphism, %d);\n", 3, start_index);
       PTFI("Node *end_node = lookupNode(morphism, %d);\n", 3, end_index);
       PTFI("if(host_node == NULL) return false;\n", 3);
-      PTFI("EdgeList *elistpos;\n", 3);
+      if(array_adjacency) PTFI("EdgeArray *earray;\n", 3);
+      else PTFI("EdgeList *elistpos;\n", 3);
    }
 
    int times = (left_edge->label.mark == ANY)? 6: 1;
 
    for(int i = 0; i < times; i++){
-      PTFI("elistpos = NULL;\n", 3);
-      if(source){
-         if(left_edge->label.mark == ANY)
-            PTFI("for(Edge *host_edge; (host_edge = yieldNextOutEdge(host, host_node, &elistpos, %d, false)) != NULL;)\n", 3, i);
-         else PTFI("for(Edge *host_edge; (host_edge = yieldNextOutEdge(host, host_node, &elistpos, %d, false)) != NULL;)\n", 3, left_edge->label.mark);
-      }
-      else{
-         if(left_edge->label.mark == ANY) 
-            PTFI("for(Edge *host_edge; (host_edge = yieldNextInEdge(host, host_node, &elistpos, %d, false)) != NULL;)\n", 3, i);
-         else PTFI("for(Edge *host_edge; (host_edge = yieldNextInEdge(host, host_node, &elistpos, %d, false)) != NULL;)\n", 3, left_edge->label.mark);
-      }
-
-      PTFI("{\n", 3);
-      PTFI("if(edgeMatched(host_edge)) continue;\n", 6);
-      PTFI("if(edgeSource(host_edge) == edgeTarget(host_edge)) continue;\n", 6);
-      if(left_edge->label.mark == ANY)
-         PTFI("if(host_edge->label.mark == 0) continue;\n\n", 6);
-      else PTFI("if(host_edge->label.mark != %d) continue;\n\n", 6, left_edge->label.mark);
-
-      PTFI("/* If the end node has been matched, check that the %s of the\n", 6, end_node_access);
-      PTFI(" * host edge is the image of the end node. */\n", 6);
-      PTFI("if(end_node != NULL)\n", 6);
-      PTFI("{\n", 6);
-      PTFI("if(%s(host_edge) != end_node) continue;\n", 9, end_node_access);
-      PTFI("}\n", 6);
-      PTFI("/* Otherwise, the %s of the host edge should be unmatched. */\n", 6, end_node_access);
-      if(source)
-         PTFI("else if(nodeMatched(edgeTarget(host_edge))) continue;\n", 6);
+      int mark = left_edge->label.mark == ANY ? i : left_edge->label.mark;
+      if(edge_index)
+      {
+         /* Once the end node is matched, the candidates are the edges between
+          * the two nodes, which are read from the index if either is indexed. */
+         PTFI("if(end_node != NULL && edgesIndexed(host_node, end_node))\n", 3);
+         PTFI("{\n", 3);
+         PTFI("for(Edge *host_edge = firstEdgeBetween(host, %s, %s, %d); host_edge != NULL;\n",
+              6, source ? "host_node" : "end_node", source ? "end_node" : "host_node", mark);
+         PTFI("host_edge = nextEdgeBetween(host_edge))\n", 10);
+         PTFI("{\n", 6);
+         emitEdgeFromNodeCandidate(rule, left_edge, source, next_op, 9);
+         PTFI("}\n", 6);
+         PTFI("}\n", 3);
+         PTFI("else\n", 3);
+         PTFI("{\n", 3);
+         emitIncidentEdgeLoop(source ? "Out" : "In", mark, false, 6);
+         emitEdgeFromNodeCandidate(rule, left_edge, source, next_op, 9);
+         PTFI("}\n", 6);
+         PTFI("}\n\n", 3);
+      }
       else
-         PTFI("else if(nodeMatched(edgeSource(host_edge))) continue;\n", 6);
-
-      PTFI("HostLabel label = host_edge->label;\n", 6);
-      PTFI("bool match = false;\n", 6);
-      if(hasListVariable(left_edge->label))
-         generateVariableListMatchingCode(rule, left_edge->label, 6);
-      else generateFixedListMatchingCode(rule, left_edge->label, 6);
-      emitEdgeMatchResultCode(left_edge->index, next_op, 6);
-      PTFI("}\n\n", 3);
+      {
+         emitIncidentEdgeLoop(source ? "Out" : "In", mark, false, 3);
+         emitEdgeFromNodeCandidate(rule, left_edge, source, next_op, 6);
+         PTFI("}\n\n", 3);
+      }
    }
 
    if(exit) PTFI("return false;\n}\n\n", 3);
 }
 
+/* Prints the checks on a candidate host_edge for emitEdgeFromNodeMatcher, and
+ * the code to match its label, with the passed indent. */
+static void emitEdgeFromNodeCandidate(Rule *rule, RuleEdge *left_edge, bool source,
+                                      SearchOp *next_op, int indent)
+{
+   string end_node_access = source ? "edgeTarget" : "edgeSource";
+   emitCandidateCount(false, left_edge->index, indent);
+   PTFI("if(%shost_edge)) continue;\n", indent, MATCHED_EDGE);
+   PTFI("if(edgeSource(host_edge) == edgeTarget(host_edge)) continue;\n", indent);
+   if(left_edge->label.mark == ANY)
+      PTFI("if(host_edge->label.mark == 0) continue;\n\n", indent);
+   else PTFI("if(host_edge->label.mark != %d) continue;\n\n", indent, left_edge->label.mark);
+
+   PTFI("/* If the end node has been matched, check that the %s of the\n", indent, end_node_access);
+   PTFI(" * host edge is the image of the end node. */\n", indent);
+   PTFI("if(end_node != NULL)\n", indent);
+   PTFI("{\n", indent);
+   PTFI("if(%s(host_edge) != end_node) continue;\n", indent + 3, end_node_access);
+   PTFI("}\n", indent);
+   PTFI("/* Otherwise, the %s of the host edge should be unmatched. */\n", indent, end_node_access);
+   if(source)
+      PTFI("else if(%sedgeTarget(host_edge))) continue;\n", indent, MATCHED_NODE);
+   else
+      PTFI("else if(%sedgeSource(host_edge))) continue;\n", indent, MATCHED_NODE);
+
+   PTFI("HostLabel label = host_edge->label;\n", indent);
+   PTFI("bool match = false;\n", indent);
+   if(hasListVariable(left_edge->label))
+      generateVariableListMatchingCode(rule, left_edge->label, indent);
+   else generateFixedListMatchingCode(rule, left_edge->label, indent);
+   emitEdgeMatchResultCode(left_edge->index, next_op, indent);
+}
+
+/* Prints the head of a loop over the host edges of host_node with the given
+ * orientation ("Out" or "In"), mark and loop status, and the opening brace of
+ * its body, with the passed indent. Each iteration binds host_edge. With array adjacency the loop
+ * scans the node's edge array from the newest edge, so that candidates are
+ * tried in the same order as with the linked lists. */
+static void emitIncidentEdgeLoop(string orientation, int mark, bool loop, int indent)
+{
+   if(array_adjacency)
+   {
+      PTFI("earray = %sEdgeArray(host_node, %d, %s);\n", indent, orientation[0] == 'O' ? "out" : "in",
+           mark, loop ? "true" : "false");
+      PTFI("for(long position = earray->size - 1; position >= 0; position--)\n", indent);
+      PTFI("{\n", indent);
+      PTFI("Edge *host_edge = earray->edges[position];\n", indent + 3);
+   }
+   else
+   {
+      PTFI("elistpos = NULL;\n", indent);
+      /* Workers do not collect deleted edges. */
+      PTFI("for(Edge *host_edge; (host_edge = yieldNext%sEdge%s(host, host_node, &elistpos, %d, %s)) != NULL;)\n",
+           indent, orientation, worker_matcher ? "Fast" : "", mark, loop ? "true" : "false");
+      PTFI("{\n", indent);
+   }
+}
+
 /* Generates code to test the result of label matching a edge. If the label matching
  * succeeds, the morphism and matched_edges array are updated, and matching
  * continues. If not,  any assignments made during label matching are undone. */
@@ -772,7 +1750,7 @@ static void emitEdgeMatchResultCode(int index, SearchOp *next_op, int indent)
    PTFI("if(match)\n", indent);
    PTFI("{\n", indent);
    PTFI("addEdgeMap(morphism, %d, host_edge, new_assignments);\n", indent + 3, index);
-   PTFI("setEdgeMatched(host_edge);\n", indent + 3);
+   if(!worker_matcher) PTFI("setEdgeMatched(host_edge);\n", indent + 3);
    if(next_op == NULL)
    {
       PTFI("/* All items matched! */\n", indent);
@@ -786,7 +1764,7 @@ static void emitEdgeMatchResultCode(int index, SearchOp *next_op, int indent)
       PTFI("else\n", indent + 3);
       PTFI("{\n", indent + 3);
       PTFI("removeEdgeMap(morphism, %d);\n", indent + 6, index);
-      PTFI("clearEdgeMatched(host_edge);\n", indent + 6); 
+      if(!worker_matcher) PTFI("clearEdgeMatched(host_edge);\n", indent + 6);
       PTFI("}\n", indent + 3);
    } 
    PTFI("}\n", indent);
@@ -799,20 +1777,20 @@ static void emitNextMatcherCall(SearchOp *next_operation)
    {
       case 'n':
       case 'r':
-           PTF("match_n%d(morphism)", next_operation->index);
+           PTF("match_n%d%s(morphism)", next_operation->index, plan_suffix);
            break;
 
       case 'i':
       case 'o':
       case 'b':
-           PTF("match_n%d(morphism, host_edge)", next_operation->index);
+           PTF("match_n%d%s(morphism, host_edge)", next_operation->index, plan_suffix);
            break;
   
       case 'e':
       case 's':
       case 't':
       case 'l':
-           PTF("match_e%d(morphism)", next_operation->index);
+           PTF("match_e%d%s(morphism)", next_operation->index, plan_suffix);
            break;
 
       default:
@@ -822,12 +1800,715 @@ static void emitNextMatcherCall(SearchOp *next_operation)
    }
 }
 
+/* Under -P, prints the count of a candidate host item for the LHS node or
+ * edge with the passed index. Candidates tried by parallel workers are not
+ * counted, as the counters are not shared safely. */
+static void emitCandidateCount(bool node, int index, int indent)
+{
+   if(!profile_runtime || worker_matcher) return;
+   PTFI("%s_candidates[%d]++;\n", indent, node ? "node" : "edge", index);
+}
+
+/* With -z, a searchplan compiles to a single matching function in place of one
+ * function per operation, so that matching does not go one call deeper per
+ * LHS item and the state of the search can be kept in registers. The state of
+ * each operation is held in local variables named after its LHS item, such as
+ * node_n2, the host node matched to rule node 2, and the iterators of its
+ * candidate loop, such as nlistpos_n2. They are declared at the top of the
+ * function, so that the goto statements below can enter the loops.
+ *
+ * An operation that matches its item jumps forward to the label match_<item>
+ * of the next operation, and the last one returns true. An operation with no
+ * candidates left jumps back to the label backtrack_<item> of the previous
+ * operation, which undoes that match and continues its loop with the next
+ * candidate, or returns false if it is the first. Candidates are tried in the
+ * same order as by the functions of emitMatchers. */
+
+/* Writes the name of the LHS item of the operation, such as "n2" or "e1", to
+ * tag. The variables and labels of the operation in a flat matcher end with
+ * it. */
+static void flatTag(SearchOp *operation, char *tag)
+{
+   sprintf(tag, "%c%d", operation->is_node ? 'n' : 'e', operation->index);
+}
+
+/* Returns true if the operation gets the label backtrack_<item>: it is jumped
+ * to from the next operation, and from the matching of a node with predicates
+ * if the condition fails. */
+static bool flatBacktracks(Rule *rule, SearchOp *operation)
+{
+   if(operation->next != NULL) return true;
+   return operation->is_node && getRuleNode(rule->lhs, operation->index)->predicates != NULL;
+}
+
+/* The number of candidate loops of an edge operation, each with its own copy
+ * of the candidate checks: a bidirectional edge is matched in both directions
+ * and, with -x, the edges between two matched nodes come from the edge index. */
+static int flatEdgeLoops(Rule *rule, SearchOp *operation)
+{
+   if(operation->type != 's' && operation->type != 't') return 1;
+   int loops = getRuleEdge(rule->lhs, operation->index)->bidirectional ? 2 : 1;
+   return edge_index ? 2 * loops : loops;
+}
+
+/* Prints the declarations of the variables of the operation at the top of a
+ * flat matcher. start is the first operation's entry (see emitFlatMatcher),
+ * and 'm' for the others. */
+static void emitFlatDeclarations(Rule *rule, SearchOp *operation, char start)
+{
+   char tag[16];
+   flatTag(operation, tag);
+   if(operation->is_node)
+   {
+      RuleNode *left_node = getRuleNode(rule->lhs, operation->index);
+      bool any = left_node->label.mark == ANY;
+      PTFI("Node *node_%s;\n", 3, tag);
+      if(start == 'a' || operation->type == 'i' || operation->type == 'o' ||
+         operation->type == 'b') return;
+      if(operation->type == 'r')
+      {
+         PTFI("RootNodes *nodes_%s;\n", 3, tag);
+         if(any) PTFI("int mark_%s;\n", 3, tag);
+      }
+      else if(start == 'm' && usesLabelIndex(left_node)) PTFI("HostList *list_%s;\n", 3, tag);
+      else if(start == 'm' && usesDegreeIndex(left_node))
+      {
+         if(any) PTFI("int mark_%s;\n", 3, tag);
+      }
+      else if(no_node_list)
+      {
+         PTFI("long i_%s;\n", 3, tag);
+         if(node_filter)
+         {
+            char filter[24];
+            sprintf(filter, "filter_%s", tag);
+            emitNodeFilter(left_node, filter);
+         }
+      }
+      else
+      {
+         PTFI("NodeList *nlistpos_%s;\n", 3, tag);
+         if(any) PTFI("int mark_%s;\n", 3, tag);
+         if(any && start == 'u')
+         {
+            PTFI("Node *start_%s = resume_node;\n", 3, tag);
+            PTFI("int start_mark_%s = start_%s->label.mark;\n", 3, tag, tag);
+         }
+      }
+   }
+   else
+   {
+      RuleEdge *left_edge = getRuleEdge(rule->lhs, operation->index);
+      PTFI("Edge *edge_%s;\n", 3, tag);
+      if(operation->type == 'e')
+      {
+         if(left_edge->label.mark == ANY) PTFI("int mark_%s;\n", 3, tag);
+         return;
+      }
+      PTFI("Node *start_%s;\n", 3, tag);
+      if(operation->type != 'l') PTFI("Node *end_%s;\n", 3, tag);
+      if(array_adjacency)
+      {
+         PTFI("EdgeArray *earray_%s;\n", 3, tag);
+         PTFI("long position_%s;\n", 3, tag);
+      }
+      else PTFI("EdgeList *elistpos_%s;\n", 3, tag);
+      if(left_edge->label.mark == ANY) PTFI("int mark_%s;\n", 3, tag);
+      if(flatEdgeLoops(rule, operation) > 1 && flatBacktracks(rule, operation))
+         PTFI("int loop_%s;\n", 3, tag);
+   }
+}
+
+/* Prints the checks on the candidate host_node of the rule node, each running
+ * reject if it fails. kind is 'r' for a candidate from the root list, 'n' for
+ * a node matched in isolation, 'x' for a node from the label or degree index,
+ * whose mark is not checked, and 'e' for the source or target of a matched
+ * edge. */
+static void emitFlatNodeChecks(Rule *rule, RuleNode *left_node, char kind, string reject,
+                               int indent)
+{
+   emitCandidateCount(true, left_node->index, indent);
+   if(kind == 'e')
+   {
+      PTFI("if(%shost_node)) %s\n", indent, MATCHED_NODE, reject);
+      if(left_node->root) PTFI("if(!nodeRoot(host_node)) %s\n", indent, reject);
+      if(reflect_roots && !left_node->root) PTFI("if(nodeRoot(host_node)) %s\n", indent, reject);
+   }
+   else if(reflect_roots && kind != 'r')
+      PTFI("if(%shost_node) || nodeRoot(host_node)) %s\n", indent, MATCHED_NODE, reject);
+   else PTFI("if(%shost_node)) %s\n", indent, MATCHED_NODE, reject);
+   if(kind != 'x')
+   {
+      if(left_node->label.mark == ANY) PTFI("if(host_node->label.mark == 0) %s\n", indent, reject);
+      else PTFI("if(host_node->label.mark != %d) %s\n", indent, left_node->label.mark, reject);
+   }
+   if(emitDegreeCheck(left_node, indent)) PTF("%s\n", reject);
+   emitConditionFilter(rule, left_node, reject, indent);
+}
+
+/* Prints the matching of the label of the candidate host_node that passed the
+ * checks, running reject if it does not match. Otherwise the node is added to
+ * the morphism and its predicates are evaluated before the next operation.
+ * A node matched by a single candidate block is only stored in node_<item>
+ * here, as it has no loop that binds it. */
+static void emitFlatNodeMatch(Rule *rule, RuleNode *left_node, SearchOp *operation,
+                              string reject, bool single, int indent)
+{
+   char tag[16];
+   flatTag(operation, tag);
+   PTF("\n");
+   PTFI("HostLabel label = host_node->label;\n", indent);
+   PTFI("bool match = false;\n", indent);
+   if(hasListVariable(left_node->label)) generateVariableListMatchingCode(rule, left_node->label, indent);
+   else generateFixedListMatchingCode(rule, left_node->label, indent);
+   if(left_node == resumable_node)
+   {
+      if(no_node_list) PTFI("resume_index = i_%s;\n", indent, tag);
+      else PTFI("resume_node = host_node;\n", indent);
+   }
+   PTFI("if(!match)\n", indent);
+   PTFI("{\n", indent);
+   PTFI("removeAssignments(morphism, new_assignments);\n", indent + 3);
+   PTFI("%s\n", indent + 3, reject);
+   PTFI("}\n", indent);
+   if(single) PTFI("node_%s = host_node;\n", indent, tag);
+   PTFI("addNodeMap(morphism, %d, host_node, new_assignments);\n", indent, left_node->index);
+   if(!worker_matcher) PTFI("setNodeMatched(host_node);\n", indent);
+   if(left_node->predicates != NULL)
+   {
+      PTFI("/* Update global booleans representing the node's predicates. */\n", indent);
+      for(int index = 0; index < left_node->predicate_count; index++)
+         PTFI("evaluatePredicate%d(morphism);\n", indent, left_node->predicates[index]->bool_id);
+      PTFI("if(!evaluateCondition()) goto backtrack_%s;\n", indent, tag);
+   }
+   if(operation->next == NULL)
+   {
+      PTFI("/* All items matched! */\n", indent);
+      PTFI("return true;\n", indent);
+   }
+   else
+   {
+      char next_tag[16];
+      flatTag(operation->next, next_tag);
+      PTFI("goto match_%s;\n", indent, next_tag);
+   }
+}
+
+/* Prints the code undoing the match of the operation's node at the label
+ * backtrack_<item>, which also resets the boolean variables of its predicates. */
+static void emitFlatNodeUndo(RuleNode *left_node, string tag, int indent)
+{
+   PTF("backtrack_%s:\n", tag);
+   for(int index = 0; index < left_node->predicate_count; index++)
+   {
+      Predicate *predicate = left_node->predicates[index];
+      PTFI("b%d = %s;\n", indent, predicate->bool_id, predicate->negated ? "false" : "true");
+   }
+   PTFI("removeNodeMap(morphism, %d);\n", indent, left_node->index);
+   if(!worker_matcher) PTFI("clearNodeMatched(node_%s);\n", indent, tag);
+}
+
+/* Prints the head of a loop over the node array from the passed start index
+ * binding node_<item>, as emitNodeArrayLoop does for the separate matchers.
+ * The first operation of a parallel worker scans the block given by its
+ * arguments. */
+static void emitFlatNodeArrayLoop(string tag, string start, bool worker_block)
+{
+   char bound[64];
+   if(worker_block) sprintf(bound, "i_%s < end && !parallelMatchFound(i_%s)", tag, tag);
+   else sprintf(bound, "i_%s < host->_nodearray.size", tag);
+   string end = worker_block ? "end" : "host->_nodearray.size";
+   if(node_filter)
+   {
+      PTFI("for(i_%s = nextNodeCandidate(host, %s, %s, &filter_%s);\n", 3, tag, start, end, tag);
+      PTFI("%s;\n", 7, bound);
+      PTFI("i_%s = nextNodeCandidate(host, i_%s + 1, %s, &filter_%s))\n", 7, tag, tag, end, tag);
+      PTFI("{\n", 3);
+      PTFI("node_%s = (Node *) getBigArrayValue(&(host->_nodearray), i_%s);\n", 6, tag, tag);
+   }
+   else
+   {
+      PTFI("for(i_%s = %s; %s; i_%s++)\n", 3, tag, start, bound, tag);
+      PTFI("{\n", 3);
+      PTFI("node_%s = (Node *) getBigArrayValue(&(host->_nodearray), i_%s);\n", 6, tag, tag);
+      if(worker_matcher) PTFI("if(nodeDeleted(node_%s)) continue;\n", 6, tag);
+      else
+      {
+         PTFI("if(nodeDeleted(node_%s))\n", 6, tag);
+         PTFI("{\n", 6);
+         PTFI("clearNodeInGraph(node_%s);\n", 9, tag);
+         PTFI("continue;\n", 9);
+         PTFI("}\n", 6);
+      }
+   }
+   if(worker_block) PTFI("*position = i_%s;\n", 6, tag);
+}
+
+/* Prints the scan of a rule node matched in isolation: the candidate loops
+ * binding node_<item>, the checks and matching of each candidate, and the
+ * undoing of its match when the next operation backtracks into the loop. */
+static void emitFlatNodeScan(Rule *rule, SearchOp *operation, char start, string fail_code)
+{
+   char tag[16], mark[24];
+   flatTag(operation, tag);
+   RuleNode *left_node = getRuleNode(rule->lhs, operation->index);
+   bool any = left_node->label.mark == ANY;
+   if(any) sprintf(mark, "mark_%s", tag);
+   else sprintf(mark, "%d", left_node->label.mark);
+   /* The marks of an ANY node are scanned in order. The root and degree lists
+    * of unmarked nodes are skipped, as they cannot hold a match. */
+   char kind = 'n';
+   /* The number of braces opened by the loops. */
+   int loops = 1;
+   if(operation->type == 'r')
+   {
+      kind = 'r';
+      if(any)
+      {
+         PTFI("for(mark_%s = 1; mark_%s <= 4; mark_%s++)\n", 3, tag, tag, tag);
+         PTFI("{\n", 3);
+         loops++;
+      }
+      PTFI("for(nodes_%s = getRootNodeList(host, %s); nodes_%s != NULL; nodes_%s = nodes_%s->next)\n",
+           3 * loops, tag, mark, tag, tag, tag);
+      PTFI("{\n", 3 * loops);
+      PTFI("node_%s = nodes_%s->node;\n", 3 * loops + 3, tag, tag);
+      PTFI("if(node_%s == NULL) continue;\n", 3 * loops + 3, tag);
+   }
+   else if(start == 'm' && usesLabelIndex(left_node))
+   {
+      kind = 'x';
+      if(left_node->label.length == 0) PTFI("list_%s = NULL;\n", 3, tag);
+      else
+      {
+         PTFI("{\n", 3);
+         PTFI("HostAtom array[%d];\n", 6, left_node->label.length);
+         int index = 0;
+         for(RuleListItem *item = left_node->label.list->first; item != NULL; item = item->next)
+         {
+            if(item->atom->type == INTEGER_CONSTANT)
+            {
+               PTFI("array[%d].type = 'i';\n", 6, index);
+               PTFI("array[%d].num = %ld;\n", 6, index, item->atom->number);
+            }
+            else
+            {
+               PTFI("array[%d].type = 's';\n", 6, index);
+               PTFI("array[%d].str = lookupString(\"%s\");\n", 6, index, item->atom->string);
+               PTFI("if(array[%d].str == NULL) %s\n", 6, index, fail_code);
+            }
+            index++;
+         }
+         PTFI("list_%s = lookupHostList(array, %d);\n", 6, tag, left_node->label.length);
+         PTFI("}\n", 3);
+         PTFI("if(list_%s == NULL) %s\n", 3, tag, fail_code);
+      }
+      PTFI("for(node_%s = firstNodeWithLabel(host, %d, list_%s); node_%s != NULL;\n", 3, tag,
+           left_node->label.mark, tag, tag);
+      PTFI("    node_%s = nextNodeWithLabel(node_%s))\n", 3, tag, tag);
+      PTFI("{\n", 3);
+   }
+   else if(start == 'm' && usesDegreeIndex(left_node))
+   {
+      kind = 'x';
+      if(any)
+      {
+         PTFI("for(mark_%s = 1; mark_%s <= 4; mark_%s++)\n", 3, tag, tag, tag);
+         PTFI("{\n", 3);
+         loops++;
+      }
+      PTFI("for(node_%s = firstNodeWithDegree(host, %s, %d); node_%s != NULL;\n", 3 * loops,
+           tag, mark, left_node->outdegree + left_node->indegree + left_node->bidegree, tag);
+      PTFI("    node_%s = nextNodeWithDegree(node_%s))\n", 3 * loops, tag, tag);
+      PTFI("{\n", 3 * loops);
+   }
+   else if(no_node_list)
+   {
+      string from = "0";
+      if(start == 'u') from = "resume_index";
+      if(start == 'f' || start == 'w') from = "start";
+      emitFlatNodeArrayLoop(tag, from, start == 'w');
+   }
+   else if(start == 'u' && !any)
+   {
+      /* The recorded node is in another list if the rule changed its mark. */
+      PTFI("if(resume_node->label.mark != %d) return false;\n", 3, left_node->label.mark);
+      PTFI("nlistpos_%s = nodeListPosition(resume_node);\n", 3, tag);
+      PTFI("for(node_%s = resume_node; node_%s != NULL;\n", 3, tag, tag);
+      PTFI("node_%s = yieldNextNode(host, &nlistpos_%s, %d))\n", 7, tag, tag, left_node->label.mark);
+      PTFI("{\n", 3);
+   }
+   else if(start == 'u')
+   {
+      /* The mark lists are scanned in order from the list of the recorded
+       * node. */
+      PTFI("for(mark_%s = start_mark_%s; mark_%s <= 4; mark_%s++)\n", 3, tag, tag, tag, tag);
+      PTFI("{\n", 3);
+      PTFI("if(mark_%s == start_mark_%s)\n", 6, tag, tag);
+      PTFI("{\n", 6);
+      PTFI("nlistpos_%s = nodeListPosition(start_%s);\n", 9, tag, tag);
+      PTFI("node_%s = start_%s;\n", 9, tag, tag);
+      PTFI("}\n", 6);
+      PTFI("else\n", 6);
+      PTFI("{\n", 6);
+      PTFI("nlistpos_%s = NULL;\n", 9, tag);
+      PTFI("node_%s = yieldNextNode(host, &nlistpos_%s, mark_%s);\n", 9, tag, tag, tag);
+      PTFI("}\n", 6);
+      PTFI("for(; node_%s != NULL; node_%s = yieldNextNode(host, &nlistpos_%s, mark_%s))\n", 6,
+           tag, tag, tag, tag);
+      PTFI("{\n", 6);
+      loops++;
+   }
+   else
+   {
+      if(any)
+      {
+         PTFI("for(mark_%s = 0; mark_%s <= 4; mark_%s++)\n", 3, tag, tag, tag);
+         PTFI("{\n", 3);
+         loops++;
+      }
+      PTFI("for(nlistpos_%s = NULL; (node_%s = yieldNextNode(host, &nlistpos_%s, %s)) != NULL;)\n",
+           3 * loops, tag, tag, tag, mark);
+      PTFI("{\n", 3 * loops);
+   }
+   int indent = 3 * loops + 3;
+   PTFI("Node *host_node = node_%s;\n", indent, tag);
+   emitFlatNodeChecks(rule, left_node, kind, "continue;", indent);
+   emitFlatNodeMatch(rule, left_node, operation, "continue;", false, indent);
+   if(flatBacktracks(rule, operation)) emitFlatNodeUndo(left_node, tag, indent);
+   for(; loops > 0; loops--) PTFI("}\n", 3 * loops);
+   PTFI("%s\n", 3, fail_code);
+}
+
+/* Prints the matching of a rule node with a single candidate: the host node
+ * passed to match<rule>At, or the endpoint of the host edge matched by the
+ * edge operation edge_op, the last edge operation before this one. For a node
+ * matched from a bidirectional edge, the source of the host edge is tried if
+ * its target fails the checks. */
+static void emitFlatNodeCandidate(Rule *rule, SearchOp *operation, SearchOp *edge_op,
+                                  char start, string fail_code)
+{
+   char tag[16], edge_tag[16];
+   flatTag(operation, tag);
+   RuleNode *left_node = getRuleNode(rule->lhs, operation->index);
+   PTFI("{\n", 3);
+   if(start == 'a') emitFlatNodeChecks(rule, left_node, operation->type, fail_code, 6);
+   else
+   {
+      flatTag(edge_op, edge_tag);
+      char type = operation->type;
+      PTFI("Node *host_node = %s(edge_%s);\n", 6, type == 'o' ? "edgeSource" : "edgeTarget",
+           edge_tag);
+      if(type == 'b')
+      {
+         PTFI("bool candidate_node = true;\n", 6);
+         emitFlatNodeChecks(rule, left_node, 'e', "candidate_node = false;", 6);
+         PTFI("if(!candidate_node)\n", 6);
+         PTFI("{\n", 6);
+         PTFI("/* Matching from bidirectional edge: check the second incident node. */\n", 9);
+         PTFI("host_node = edgeSource(edge_%s);\n", 9, edge_tag);
+         emitFlatNodeChecks(rule, left_node, 'e', fail_code, 9);
+         PTFI("}\n", 6);
+      }
+      else emitFlatNodeChecks(rule, left_node, 'e', fail_code, 6);
+   }
+   emitFlatNodeMatch(rule, left_node, operation, fail_code, true, 6);
+   PTFI("}\n", 3);
+   if(flatBacktracks(rule, operation))
+   {
+      emitFlatNodeUndo(left_node, tag, 3);
+      PTFI("%s\n", 3, fail_code);
+   }
+}
+
+/* Prints the head of a loop binding edge_<item> to the host edges of
+ * start_<item> with the given orientation ("Out" or "In"), mark and loop
+ * status, as emitIncidentEdgeLoop does for the separate matchers. */
+static void emitFlatIncidentEdgeLoop(string tag, string orientation, string mark, bool loop,
+                                     int indent)
+{
+   if(array_adjacency)
+   {
+      PTFI("for(earray_%s = %sEdgeArray(start_%s, %s, %s), position_%s = earray_%s->size - 1;\n",
+           indent, tag, orientation[0] == 'O' ? "out" : "in", tag, mark, loop ? "true" : "false",
+           tag, tag);
+      PTFI("position_%s >= 0; position_%s--)\n", indent + 4, tag, tag);
+      PTFI("{\n", indent);
+      PTFI("edge_%s = earray_%s->edges[position_%s];\n", indent + 3, tag, tag, tag);
+   }
+   else
+   {
+      PTFI("for(elistpos_%s = NULL;\n", indent, tag);
+      PTFI("(edge_%s = yieldNext%sEdge%s(host, start_%s, &elistpos_%s, %s, %s)) != NULL;)\n",
+           indent + 4, tag, orientation, worker_matcher ? "Fast" : "", tag, tag, mark,
+           loop ? "true" : "false");
+      PTFI("{\n", indent);
+   }
+}
+
+/* Prints the checks and label matching of the candidate host_edge in the
+ * candidate loop with the passed number, and the undoing of its match. source
+ * is set if the edge is drawn from the match of the source of an edge
+ * matched from a node. */
+static void emitFlatEdgeCandidate(Rule *rule, SearchOp *operation, int loop, bool source,
+                                  int indent)
+{
+   char tag[16];
+   flatTag(operation, tag);
+   RuleEdge *left_edge = getRuleEdge(rule->lhs, operation->index);
+   bool numbered = flatEdgeLoops(rule, operation) > 1;
+   PTFI("Edge *host_edge = edge_%s;\n", indent, tag);
+   emitCandidateCount(false, left_edge->index, indent);
+   PTFI("if(%shost_edge)) continue;\n", indent, MATCHED_EDGE);
+   if(operation->type == 'l') PTFI("if(edgeSource(host_edge) != edgeTarget(host_edge)) continue;\n", indent);
+   if(operation->type == 's' || operation->type == 't')
+      PTFI("if(edgeSource(host_edge) == edgeTarget(host_edge)) continue;\n", indent);
+   if(operation->type == 'e')
+      /* The edge lists by mark only hold edges of the mark. */
+      PTFI("if(edgeSource(host_edge) %s edgeTarget(host_edge)) continue;\n", indent,
+           left_edge->source == left_edge->target ? "!=" : "==");
+   else if(left_edge->label.mark == ANY) PTFI("if(host_edge->label.mark == 0) continue;\n", indent);
+   else PTFI("if(host_edge->label.mark != %d) continue;\n", indent, left_edge->label.mark);
+   if(operation->type == 's' || operation->type == 't')
+   {
+      string end_node_access = source ? "edgeTarget" : "edgeSource";
+      PTFI("/* The %s of the host edge is the image of the end node if it has\n", indent,
+           end_node_access);
+      PTFI(" * been matched, and unmatched otherwise. */\n", indent);
+      PTFI("if(end_%s != NULL)\n", indent, tag);
+      PTFI("{\n", indent);
+      PTFI("if(%s(host_edge) != end_%s) continue;\n", indent + 3, end_node_access, tag);
+      PTFI("}\n", indent);
+      PTFI("else if(%s%s(host_edge))) continue;\n", indent, MATCHED_NODE, end_node_access);
+   }
+   PTF("\n");
+
+   PTFI("HostLabel label = host_edge->label;\n", indent);
+   PTFI("bool match = false;\n", indent);
+   if(hasListVariable(left_edge->label)) generateVariableListMatchingCode(rule, left_edge->label, indent);
+   else generateFixedListMatchingCode(rule, left_edge->label, indent);
+   PTFI("if(!match)\n", indent);
+   PTFI("{\n", indent);
+   PTFI("removeAssignments(morphism, new_assignments);\n", indent + 3);
+   PTFI("continue;\n", indent + 3);
+   PTFI("}\n", indent);
+   PTFI("addEdgeMap(morphism, %d, host_edge, new_assignments);\n", indent, left_edge->index);
+   if(!worker_matcher) PTFI("setEdgeMatched(host_edge);\n", indent);
+   if(operation->next == NULL)
+   {
+      PTFI("/* All items matched! */\n", indent);
+      PTFI("return true;\n", indent);
+      return;
+   }
+   char next_tag[16];
+   flatTag(operation->next, next_tag);
+   if(numbered) PTFI("loop_%s = %d;\n", indent, tag, loop);
+   PTFI("goto match_%s;\n", indent, next_tag);
+   if(numbered) PTF("backtrack_%s_%d:\n", tag, loop);
+   else PTF("backtrack_%s:\n", tag);
+   PTFI("removeEdgeMap(morphism, %d);\n", indent, left_edge->index);
+   if(!worker_matcher) PTFI("clearEdgeMatched(edge_%s);\n", indent, tag);
+}
+
+/* Prints the candidate loops of an edge operation. A bidirectional edge is
+ * matched from the same host node in both directions, as by the two parts of
+ * the function of emitEdgeFromNodeMatcher. Each loop has its own label
+ * backtrack_<item>_<loop> if there are several, and the variable loop_<item>
+ * records the loop to resume at backtrack_<item>. */
+static void emitFlatEdgeScan(Rule *rule, SearchOp *operation, string fail_code)
+{
+   char tag[16], mark[24];
+   flatTag(operation, tag);
+   RuleEdge *left_edge = getRuleEdge(rule->lhs, operation->index);
+   bool any = left_edge->label.mark == ANY;
+   if(any) sprintf(mark, "mark_%s", tag);
+   else sprintf(mark, "%d", left_edge->label.mark);
+   if(operation->type == 'e')
+   {
+      int indent = 3;
+      if(any)
+      {
+         PTFI("for(mark_%s = 1; mark_%s < 6; mark_%s++)\n", 3, tag, tag, tag);
+         PTFI("{\n", 3);
+         indent = 6;
+      }
+      PTFI("for(edge_%s = firstEdgeWithMark(host, %s); edge_%s != NULL;\n", indent, tag, mark, tag);
+      PTFI("    edge_%s = nextEdgeWithMark(edge_%s))\n", indent, tag, tag);
+      PTFI("{\n", indent);
+      emitFlatEdgeCandidate(rule, operation, 0, false, indent + 3);
+      PTFI("}\n", indent);
+      if(any) PTFI("}\n", 3);
+      PTFI("%s\n", 3, fail_code);
+      return;
+   }
+   bool source = operation->type != 't';
+   int start_index = source ? left_edge->source->index : left_edge->target->index;
+   int end_index = source ? left_edge->target->index : left_edge->source->index;
+   PTFI("start_%s = lookupNode(morphism, %d);\n", 3, tag, start_index);
+   if(operation->type != 'l') PTFI("end_%s = lookupNode(morphism, %d);\n", 3, tag, end_index);
+   PTFI("if(start_%s == NULL) %s\n", 3, tag, fail_code);
+   int directions = operation->type != 'l' && left_edge->bidirectional ? 2 : 1, loop = 0;
+   for(int direction = 0; direction < directions; direction++)
+   {
+      bool from_source = direction == 0 ? source : !source;
+      string orientation = from_source ? "Out" : "In";
+      int indent = 3;
+      if(any)
+      {
+         PTFI("for(mark_%s = 0; mark_%s < 6; mark_%s++)\n", 3, tag, tag, tag);
+         PTFI("{\n", 3);
+         indent = 6;
+      }
+      if(operation->type == 'l')
+      {
+         emitFlatIncidentEdgeLoop(tag, "Out", mark, true, indent);
+         emitFlatEdgeCandidate(rule, operation, loop++, true, indent + 3);
+         PTFI("}\n", indent);
+      }
+      else if(edge_index)
+      {
+         /* Once the end node is matched, the candidates are the edges between
+          * the two nodes, which are read from the index if either is indexed. */
+         PTFI("if(end_%s != NULL && edgesIndexed(start_%s, end_%s))\n", indent, tag, tag, tag);
+         PTFI("{\n", indent);
+         PTFI("for(edge_%s = firstEdgeBetween(host, %s_%s, %s_%s, %s); edge_%s != NULL;\n",
+              indent + 3, tag, from_source ? "start" : "end", tag, from_source ? "end" : "start",
+              tag, mark, tag);
+         PTFI("edge_%s = nextEdgeBetween(edge_%s))\n", indent + 7, tag, tag);
+         PTFI("{\n", indent + 3);
+         emitFlatEdgeCandidate(rule, operation, loop++, from_source, indent + 6);
+         PTFI("}\n", indent + 3);
+         PTFI("}\n", indent);
+         PTFI("else\n", indent);
+         PTFI("{\n", indent);
+         emitFlatIncidentEdgeLoop(tag, orientation, mark, false, indent + 3);
+         emitFlatEdgeCandidate(rule, operation, loop++, from_source, indent + 6);
+         PTFI("}\n", indent + 3);
+         PTFI("}\n", indent);
+      }
+      else
+      {
+         emitFlatIncidentEdgeLoop(tag, orientation, mark, false, indent);
+         emitFlatEdgeCandidate(rule, operation, loop++, from_source, indent + 3);
+         PTFI("}\n", indent);
+      }
+      if(any) PTFI("}\n", 3);
+   }
+   PTFI("%s\n", 3, fail_code);
+   if(loop > 1 && flatBacktracks(rule, operation))
+   {
+      PTF("backtrack_%s:\n", tag);
+      for(int index = 0; index < loop - 1; index++)
+         PTFI("if(loop_%s == %d) goto backtrack_%s_%d;\n", 3, tag, index, tag, index);
+      PTFI("goto backtrack_%s_%d;\n", 3, tag, loop - 1);
+   }
+}
+
+/* Prints the body of the flat matcher of the current searchplan. start sets
+ * how the first operation gets its candidates:
+ * 'm' - The scan of the searchplan operation, for match_<item>.
+ * 'u' - The scan from the node recorded by the last match, for match_n<index>_resume.
+ * 'a' - The host node argument, for match<rule>At.
+ * 'f' - The node array from the argument start, for match_n<index>_from.
+ * 'w' - The block of the node array of a parallel worker, for match_n<index>_w. */
+static void emitFlatMatcher(Rule *rule, char start)
+{
+   PTF("{\n");
+   SearchOp *operation = searchplan->first;
+   for(; operation != NULL; operation = operation->next)
+      emitFlatDeclarations(rule, operation, operation == searchplan->first ? start : 'm');
+   char fail_code[32] = "return false;", tag[16];
+   SearchOp *previous = NULL, *edge_op = NULL;
+   for(operation = searchplan->first; operation != NULL; operation = operation->next)
+   {
+      flatTag(operation, tag);
+      PTF("\n");
+      if(previous != NULL) PTF("match_%s:\n", tag);
+      char entry = previous == NULL ? start : 'm';
+      switch(operation->type)
+      {
+         case 'r':
+         case 'n':
+              if(entry == 'a') emitFlatNodeCandidate(rule, operation, NULL, entry, fail_code);
+              else emitFlatNodeScan(rule, operation, entry, fail_code);
+              break;
+
+         case 'i':
+         case 'o':
+         case 'b':
+              emitFlatNodeCandidate(rule, operation, edge_op, entry, fail_code);
+              break;
+
+         case 'e':
+         case 'l':
+         case 's':
+         case 't':
+              emitFlatEdgeScan(rule, operation, fail_code);
+              break;
+
+         default:
+              print_to_log("Error (emitFlatMatcher): Unexpected "
+                           "operation type %c.\n", operation->type);
+              break;
+      }
+      sprintf(fail_code, "goto backtrack_%s;", tag);
+      if(!operation->is_node) edge_op = operation;
+      previous = operation;
+   }
+   PTF("}\n\n");
+}
+
+void generateBatchApplicationCode(Rule *rule)
+{
+   /* The morphisms of the batch are kept for the rest of the run. */
+   PTF("static Morphism **batch = NULL;\n");
+   PTF("static int batch_capacity = 0;\n\n");
+   fprintf(header, "int applyBatch%s(Morphism *morphism, bool record_changes);\n", rule->name);
+   PTF("int applyBatch%s(Morphism *morphism, bool record_changes)\n", rule->name);
+   PTF("{\n");
+   PTFI("int count = 0;\n", 3);
+   PTFI("while(true)\n", 3);
+   PTFI("{\n", 3);
+   PTFI("if(count == batch_capacity)\n", 6);
+   PTFI("{\n", 6);
+   PTFI("int capacity = batch_capacity == 0 ? 16 : 2 * batch_capacity;\n", 9);
+   PTFI("batch = reallocSafe(batch, capacity * sizeof(Morphism *), \"applyBatch%s\");\n",
+        9, rule->name);
+   PTFI("for(int index = batch_capacity; index < capacity; index++)\n", 9);
+   PTFI("batch[index] = makeMorphism(morphism->nodes, morphism->edges, morphism->variables);\n",
+        12);
+   PTFI("batch_capacity = capacity;\n", 9);
+   PTFI("}\n", 6);
+   /* Candidates before the first node of the previous match do not match, as
+    * they did not before and no item has been unflagged since. */
+   if(resume_matcher_index >= 0)
+      PTFI("if(!(count == 0 ? match%s(batch[0]) : match_n%d_resume(batch[count]))) break;\n",
+           6, rule->name, resume_matcher_index);
+   else PTFI("if(!match%s(batch[count])) break;\n", 6, rule->name);
+   PTFI("count++;\n", 6);
+   PTFI("}\n", 3);
+   PTFI("for(int index = 0; index < count; index++)\n", 3);
+   PTFI("apply%s(batch[index], record_changes);\n", 6, rule->name);
+   PTFI("return count;\n", 3);
+   PTF("}\n\n");
+
+   if(fast_shutdown) return;
+   fprintf(header, "void freeBatch%s(void);\n", rule->name);
+   PTF("void freeBatch%s(void)\n", rule->name);
+   PTF("{\n");
+   PTFI("for(int index = 0; index < batch_capacity; index++) freeMorphism(batch[index]);\n", 3);
+   PTFI("if(batch != NULL) free(batch);\n", 3);
+   PTF("}\n\n");
+}
+
 void generateRemoveLHSCode(string rule_name)
 {
    fprintf(header, "void apply%s(Morphism *morphism, bool record_changes);\n", rule_name);
    PTF("void apply%s(Morphism *morphism, bool record_changes)\n", rule_name);
    PTF("{\n");
 
+   /* Clearing the matched flags first also lets removed nodes be collected. */
+   PTFI("clearMatched(morphism);\n", 3);
    PTFI("int count;\n", 3);
    PTFI("for(count = 0; count < morphism->edges; count++)\n", 3);
    PTFI("{\n", 3);
@@ -942,6 +2623,9 @@ void generateApplicationCode(Rule *rule)
       Variable variable = rule->variable_list[index];
       if(variable.used_by_rule) generateVariableCode(index, variable.type);
    }
+   /* With array adjacency a removed edge is freed as soon as it leaves the
+    * host graph, so the matched flags are cleared before any edge is removed. */
+   PTFI("clearMatched(morphism);\n", 3);
    bool node_declared = false;
    for(index = 0; index < rule->lhs->node_index; index++)
    {
@@ -955,9 +2639,9 @@ void generateApplicationCode(Rule *rule)
          }
          else PTFI("node = lookupNode(morphism, %d);\n", 3, index);
          if(node->indegree_arg)
-            PTFI("int indegree%d = nodeInDegree(node);\n", 3, index);
+            PTFI("long indegree%d = nodeInDegree(node);\n", 3, index);
          if(node->outdegree_arg)
-            PTFI("int outdegree%d = nodeOutDegree(node);\n", 3, index);
+            PTFI("long outdegree%d = nodeOutDegree(node);\n", 3, index);
       }
    }
    bool label_declared = false, host_edge_declared = false,
@@ -1025,6 +2709,8 @@ void generateApplicationCode(Rule *rule)
                PTFI("if(record_changes) pushRelabelledEdge(host_edge, label_e%d);\n", 6, index);
                if(!minimal_gc) PTFI("removeHostList(host_edge->label.list);\n", 6);
                PTFI("relabelEdge(host_edge, label);\n", 6);
+               PTFI("if(label.mark != label_e%d.mark) relistEdge(host, host_edge, label_e%d.mark);\n",
+                    6, index, index);
                PTFI("}\n", 3);
             }
             /* The else branch is entered when only the mark needs to change (not the list
@@ -1094,7 +2780,7 @@ void generateApplicationCode(Rule *rule)
                PTFI("if(record_changes) pushRelabelledNode(host_node, label_n%d);\n", 6, index);
                if(!minimal_gc) PTFI("removeHostList(host_node->label.list);\n", 6);
                PTFI("int old_mark_relab_n%d = host_node->label.mark;\n", 6, index);
-               PTFI("relabelNode(host_node, label);\n", 6);
+               PTFI("relabelNode(host, host_node, label);\n", 6);
                PTFI("int new_mark_relab_n%d = host_node->label.mark;\n", 6, index);
                PTFI("if(new_mark_relab_n%d != old_mark_relab_n%d) relistNode(host, host_node, old_mark_relab_n%d);\n\n", 6, index, index, index);
                PTFI("}\n", 3);
@@ -1106,7 +2792,7 @@ void generateApplicationCode(Rule *rule)
                /* Generate code to re-mark the node. */
                PTFI("if(record_changes) pushRemarkedNode(host_node, label_n%d.mark);\n", 3, index);
                PTFI("int old_mark_n%d = host_node->label.mark;\n", 3, index);
-               PTFI("changeNodeMark(host_node, %d);\n", 3, label.mark);
+               PTFI("changeNodeMark(host, host_node, %d);\n", 3, label.mark);
                PTFI("relistNode(host, host_node, old_mark_n%d);\n\n", 3, index);
             }
          }
@@ -1249,7 +2935,6 @@ void generateApplicationCode(Rule *rule)
       PTFI("pushAddedEdge(host_edge);\n", 6);
    }
    PTFI("/* Reset the morphism. */\n", 3);
-   PTFI("clearMatched(morphism);\n", 3);
    PTFI("initialiseMorphism(morphism);\n", 3);
    PTF("}\n\n");
 }
\ No newline at end of file
@@ -64,8 +64,9 @@
 void generateRules(List *declarations, string output_dir);
 
 /* Create a C module to match and apply the rule. The generated files are
- * called <rule_name>.h and <rule_name>.c.*/
-void generateRuleCode(Rule *rule, bool predicate, string output_dir);
+ * called <rule_name>.h and <rule_name>.c. Returns true if the module has a
+ * resumable matcher (see generateMatchingCode). */
+bool generateRuleCode(Rule *rule, bool predicate, string output_dir);
 
 /* The three functions below write the function apply_<rule_name> that makes the 
  * necessary changes to the host graph according to the rule and morphism. 
@@ -85,4 +86,15 @@ void generateRemoveLHSCode(string rule_name);
 void generateAddRHSCode(Rule *rule);
 void generateApplicationCode(Rule *rule);
 
+/* Writes the function applyBatch<rule_name>, which loops of the single rule
+ * call when compiled with -b. It matches the rule repeatedly while keeping
+ * the items of each match flagged as matched, so that the matches found are
+ * pairwise disjoint, and then applies all of them with apply<rule_name>.
+ * Returns the number of matches applied. Disjoint matches remain matches
+ * while the others are applied: a rule only deletes or relabels items of its
+ * match, and the dangling condition prevents the deletion of a node incident
+ * to an item of another match. The rule must have a nonempty LHS and must
+ * not be a predicate. */
+void generateBatchApplicationCode(Rule *rule);
+
 #endif /* INC_GEN_RULE_H */
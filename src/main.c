@@ -42,6 +42,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 /* Toggle tracing of the Bison parser. The trace is printed to stderr. */
 #undef PARSER_TRACE 
@@ -120,9 +121,59 @@ static bool validateHostGraph(string host_file)
    return (yyparse() == 0);
 }
 
-bool debug_flags, fast_shutdown, minimal_gc, reflect_roots, no_node_list, quick_compile = false;
+bool debug_flags, fast_shutdown, minimal_gc, reflect_roots, no_node_list, quick_compile,
+     print_searchplans, adaptive_searchplans, label_index, compact_nodes,
+     array_adjacency, edge_index, resumable_loops, parallel_matching,
+     batch_apply, compact_graphs, shared_scans, profile_runtime, whole_program,
+     degree_index, node_filter, flat_matchers, edge_lists, applicability_tracking = false;
+
+/* The install directories of the prebuilt lib and its headers, defined by
+ * the build. Without them, generated programs are always compiled with the lib
+ * sources. */
+#ifndef GP2_LIBDIR
+#define GP2_LIBDIR NULL
+#endif
+#ifndef GP2_INCLUDEDIR
+#define GP2_INCLUDEDIR NULL
+#endif
+
+/* Returns the name of the installed library built with the same defines as
+ * the generated code, or NULL if the lib sources are compiled with the program.
+ * There are variants for the defines of -g and -n. Other lib defines, debugging,
+ * link-time optimisation and an explicit lib directory need the sources. */
+static string prebuiltLibrary(string lib_dir)
+{
+   if(GP2_LIBDIR == NULL || GP2_INCLUDEDIR == NULL || lib_dir != NULL) return NULL;
+   if(whole_program || debug_flags || label_index || compact_nodes ||
+      array_adjacency || edge_index || parallel_matching || degree_index ||
+      node_filter || edge_lists || applicability_tracking) return NULL;
+   string library = minimal_gc ? (no_node_list ? "gp2_gn" : "gp2_g")
+                               : (no_node_list ? "gp2_n" : "gp2");
+   char path[strlen(GP2_LIBDIR) + strlen(library) + 7];
+   sprintf(path, "%s/lib%s.a", GP2_LIBDIR, library);
+   if(access(path, R_OK) != 0) return NULL;
+   return library;
+}
+
+/* Prints the object file of each rule in the declaration list. */
+static void printRuleObjects(FILE *makefile, List *declarations)
+{
+   while(declarations != NULL)
+   {
+      GPDeclaration *decl = declarations->declaration;
+      if(decl->type == PROCEDURE_DECLARATION && decl->procedure->local_decls != NULL)
+         printRuleObjects(makefile, decl->procedure->local_decls);
+      if(decl->type == RULE_DECLARATION)
+         fprintf(makefile, " %s.o", decl->rule->name);
+      declarations = declarations->next;
+   }
+}
 
-void printMakeFile(string output_dir)
+/* If library is not NULL, the generated sources are linked against it.
+ * Otherwise every source file in the output directory is compiled, including
+ * the copied lib sources. Object files are cached in $(GP2_CACHE), keyed by a
+ * hash of the compiler flags and the preprocessed source. */
+void printMakeFile(string output_dir, string library)
 {
    int length = strlen(output_dir) + 9;
    char makefile_name[length];
@@ -136,11 +187,29 @@ void printMakeFile(string output_dir)
       exit(1);
    }
 
-   fprintf(makefile, "OBJECTS = $(patsubst lexer.o,,$(patsubst %%.c,%%.o,$(wildcard *.c)))\n");  
-   fprintf(makefile, "CC = gcc\n\n");
-   fprintf(makefile, "CFLAGS = -L/usr/lib -L/usr/lib/x86_64-linux-gnu -lJudy -Wall -Wno-unused-but-set-variable");
+   if(library == NULL)
+      fprintf(makefile, "OBJECTS = $(patsubst %%.c,%%.o,$(wildcard *.c))\n");  
+   else
+   {
+      fprintf(makefile, "OBJECTS = main.o program.o");
+      printRuleObjects(makefile, gp_program);
+      fprintf(makefile, "\n");
+   }
+   fprintf(makefile, "CC = gcc\n");
+   fprintf(makefile, "GP2_CACHE = $(HOME)/.cache/gp2\n\n");
+   fprintf(makefile, "CFLAGS = -Wall -Wno-unused-but-set-variable");
    if (minimal_gc) fprintf(makefile, " -DMINIMAL_GC");
    if (no_node_list) fprintf(makefile, " -DNO_NODE_LIST");
+   if (label_index) fprintf(makefile, " -DLABEL_INDEX");
+   if (degree_index) fprintf(makefile, " -DDEGREE_INDEX");
+   if (compact_nodes) fprintf(makefile, " -DCOMPACT_NODES");
+   if (array_adjacency) fprintf(makefile, " -DARRAY_ADJACENCY");
+   if (edge_index) fprintf(makefile, " -DEDGE_INDEX");
+   if (edge_lists) fprintf(makefile, " -DEDGE_LISTS");
+   if (applicability_tracking) fprintf(makefile, " -DCHANGE_STAMPS");
+   if (parallel_matching) fprintf(makefile, " -DPARALLEL_MATCHING -pthread");
+   if (node_filter) fprintf(makefile, " -DNODE_FILTER -march=native");
+   if (library != NULL) fprintf(makefile, " -I%s", GP2_INCLUDEDIR);
    if(quick_compile)
    {
       if(debug_flags) fprintf(makefile, " -g -O0\n\n");
@@ -149,17 +218,38 @@ void printMakeFile(string output_dir)
    else
    {
       if(debug_flags) fprintf(makefile, " -g -Og\n\n");
+      else if(library != NULL) fprintf(makefile, " -DNDEBUG -O3\n\n");
       else fprintf(makefile, " -DNDEBUG -O3 -flto -fuse-linker-plugin\n\n");
    }
 
-   fprintf(makefile, "default:\t$(OBJECTS)\n\t\t$(CC) $(OBJECTS) $(CFLAGS) -o gp2run\n\n");
-   fprintf(makefile, "%%.o:\t\t%%.c\n\t\t$(CC) -c $(CFLAGS) -o $@ $<\n\n");
+   if(library == NULL)
+      fprintf(makefile, "default:\t$(OBJECTS)\n\t\t$(CC) $(OBJECTS) $(CFLAGS) -o gp2run\n\n");
+   else
+   {
+      fprintf(makefile, "LIBS = -L%s -l%s\n\n", GP2_LIBDIR, library);
+      fprintf(makefile, "default:\t$(OBJECTS)\n\t\t$(CC) $(OBJECTS) $(CFLAGS) $(LIBS) -o gp2run\n\n");
+   }
+   fprintf(makefile, "%%.o:\t\t%%.c\n"
+           "\t\t@if [ -z \"$(GP2_CACHE)\" ]; then \\\n"
+           "\t\t   echo \"$(CC) -c $(CFLAGS) -o $@ $<\"; $(CC) -c $(CFLAGS) -o $@ $<; \\\n"
+           "\t\telse \\\n"
+           "\t\t   key=`{ echo \"$(CC) $(CFLAGS)\"; $(CC) -E $(CFLAGS) $<; } | sha1sum | cut -c1-40`; \\\n"
+           "\t\t   if [ -f \"$(GP2_CACHE)/$$key.o\" ]; then cp \"$(GP2_CACHE)/$$key.o\" $@; \\\n"
+           "\t\t   else \\\n"
+           "\t\t      echo \"$(CC) -c $(CFLAGS) -o $@ $<\"; $(CC) -c $(CFLAGS) -o $@ $< || exit 1; \\\n"
+           "\t\t      { mkdir -p \"$(GP2_CACHE)\" && cp $@ \"$(GP2_CACHE)/$$key.$$$$\" && \\\n"
+           "\t\t        mv \"$(GP2_CACHE)/$$key.$$$$\" \"$(GP2_CACHE)/$$key.o\"; } 2> /dev/null || true; \\\n"
+           "\t\t   fi; \\\n"
+           "\t\tfi\n\n");
+   /* The compiled program without its main function, for linking gp2_run
+    * into other executables. */
+   fprintf(makefile, "gp2program.a:\t$(OBJECTS)\n\t\tar rcs $@ $(filter-out main.o,$(OBJECTS))\n\n");
    fprintf(makefile, "clean:\t\n\t\trm *\n");
 
    fclose(makefile);
 } 
 
-void printBuildScript(string output_dir, string lib_dir)
+void printBuildScript(string output_dir, string lib_dir, string library)
 {
    int length = strlen(output_dir) + 9;
    char buildscript_name[length];
@@ -174,8 +264,11 @@ void printBuildScript(string output_dir, string lib_dir)
    }
 
    fprintf(buildscript, "#!/bin/bash\n\n");
-   if(lib_dir != NULL) fprintf(buildscript, "LIBDIR=\"%s\"\n\n", lib_dir);
-   fprintf(buildscript, "cp ${LIBDIR}/*.{c,h} ${PWD}\n");
+   if(library == NULL)
+   {
+      if(lib_dir != NULL) fprintf(buildscript, "LIBDIR=\"%s\"\n\n", lib_dir);
+      fprintf(buildscript, "cp ${LIBDIR}/*.{c,h} ${PWD}\n");
+   }
    fprintf(buildscript, "make -j4\n");
 
    fclose(buildscript);
@@ -185,17 +278,35 @@ void printBuildScript(string output_dir, string lib_dir)
 int main(int argc, char **argv)
 {
    string const usage = "Usage:\n"
-                        "gp2 [-d] [-f] [-g] [-m] [-n] [-q] [-l <libdir>] [-o <outdir>] <program_file>\n"
+                        "gp2 [-a] [-b] [-c] [-d] [-e] [-E] [-f] [-g] [-i] [-j] [-k] [-m] [-n] [-P] [-q] [-R] [-s] [-t] [-u] [-v] [-w] [-x] [-y] [-z] [-l <libdir>] [-o <outdir>] <program_file>\n"
                         "gp2 -p <program_file>\n"
                         "gp2 -r <rule_file>\n"
                         "gp2 -h <host_file>\n\n"
                         "Flags:\n"
+                        "-a - Compile with runtime-adaptive searchplans.\n"
+                        "-b - Compile loops of a single rule to apply a maximal set of disjoint matches per iteration.\n"
+                        "-c - Compile with compact host nodes, stored apart from their adjacency.\n"
                         "-d - Compile program with debugging flags.\n"
+                        "-e - Compile with host edges kept in per-node arrays instead of linked lists.\n"
+                        "-E - Compile with lists of host edges by mark, so that searchplans can start at a marked edge.\n"
                         "-f - Compile in fast shutdown mode.\n"
                         "-g - Compile with minimal garbage collection (requires fast shutdown).\n"
+                        "-i - Compile with an index of host nodes by label.\n"
+                        "-j - Compile rule set calls to scan the host nodes once for rules with the same first node.\n"
+                        "-k - Compile with the host graph compacted after loops that leave it sparse.\n"
                         "-m - Compile with root reflecting matches.\n"
                         "-n - Compile without graph node lists.\n"
+                        "-P - Compile with a profile of rule matching, rule application and backtracking written to gp2.profile.\n"
                         "-q - Compile program quickly without optimisations.\n"
+                        "-R - Compile rule set calls to skip rules that cannot have gained a match since they last failed.\n"
+                        "-s - Print the searchplan of each rule and its estimated cost.\n"
+                        "-t - Compile with the first searchplan operation of rules matched on several threads (requires -n).\n"
+                        "-u - Compile loops of a single rule with matching resumed from the last match.\n"
+                        "-v - Compile with lists of host nodes by degree, used to match nodes deleted by a rule.\n"
+                        "-w - Compile the program with the lib sources and link-time optimisation instead of linking the prebuilt lib.\n"
+                        "-x - Compile with an index of host edges by their endpoints.\n"
+                        "-y - Compile node scans to filter the host nodes by mark and degree with vector instructions (requires -n).\n"
+                        "-z - Compile the matching code of each searchplan into a single function that backtracks without calls.\n"
                         "-l - Specify directory of lib source files.\n"
                         "-o - Specify directory for generated code and program output.\n"
                         "-p - Validate a GP 2 program.\n"
@@ -254,10 +365,30 @@ int main(int argc, char **argv)
          if(parameter[0] != '-') break;
           switch(parameter[1])
           {
+             case 'a':
+                  adaptive_searchplans = true;
+                  break;
+
+             case 'b':
+                  batch_apply = true;
+                  break;
+
+             case 'c':
+                  compact_nodes = true;
+                  break;
+
              case 'd':
                   debug_flags = true;
                   break;
 
+             case 'e':
+                  array_adjacency = true;
+                  break;
+
+             case 'E':
+                  edge_lists = true;
+                  break;
+
              case 'f':
                   fast_shutdown = true;
                   break;
@@ -266,6 +397,18 @@ int main(int argc, char **argv)
                   minimal_gc = true;
                   break;
 
+             case 'i':
+                  label_index = true;
+                  break;
+
+             case 'j':
+                  shared_scans = true;
+                  break;
+
+             case 'k':
+                  compact_graphs = true;
+                  break;
+
              case 'm':
                   reflect_roots = true;
                   break;
@@ -274,10 +417,50 @@ int main(int argc, char **argv)
                   no_node_list = true;
                   break;
 
+             case 'P':
+                  profile_runtime = true;
+                  break;
+
              case 'q':
                   quick_compile = true;
                   break;
 
+             case 'R':
+                  applicability_tracking = true;
+                  break;
+
+             case 's':
+                  print_searchplans = true;
+                  break;
+
+             case 't':
+                  parallel_matching = true;
+                  break;
+
+             case 'u':
+                  resumable_loops = true;
+                  break;
+
+             case 'v':
+                  degree_index = true;
+                  break;
+
+             case 'w':
+                  whole_program = true;
+                  break;
+
+             case 'x':
+                  edge_index = true;
+                  break;
+
+             case 'y':
+                  node_filter = true;
+                  break;
+
+             case 'z':
+                  flat_matchers = true;
+                  break;
+
              case 'l':
                   argv_index++;
                   if(argv_index == argc)
@@ -318,6 +501,24 @@ int main(int argc, char **argv)
       exit(EXIT_FAILURE);
    }
 
+   if (compact_graphs && minimal_gc)
+   {
+      print_to_console("%s\n", "Error: graph compaction requires garbage collection.");
+      exit(EXIT_FAILURE);
+   }
+
+   if (parallel_matching && !no_node_list)
+   {
+      print_to_console("%s\n", "Error: parallel matching requires compiling without node lists.");
+      exit(EXIT_FAILURE);
+   }
+
+   if (node_filter && !no_node_list)
+   {
+      print_to_console("%s\n", "Error: node filtering requires compiling without node lists.");
+      exit(EXIT_FAILURE);
+   }
+
    /* If no output directory specified, make a directory in /tmp. */
    if(output_dir == NULL) 
    {
@@ -376,8 +577,9 @@ int main(int argc, char **argv)
          print_to_console("Generating program code...\n");
          generateRules(gp_program, output_dir);
          generateRuntimeMain(gp_program, output_dir);
-         printMakeFile(output_dir);
-         printBuildScript(output_dir, lib_dir);
+         string library = prebuiltLibrary(lib_dir);
+         printMakeFile(output_dir, library);
+         printBuildScript(output_dir, lib_dir, library);
       }
    }
    if(yyin != NULL) fclose(yyin);
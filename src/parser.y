@@ -75,7 +75,7 @@ bool syntax_error = false;
 %locations /* Generates code to process locations of symbols in the source file. */
 
 %union {  
-  int num;   /* value of NUM token. */
+  long num;   /* value of NUM token. */
   double dnum; /* value of DNUM token. */
   char *str; /* value of STRING and CHAR tokens. */
   char *id;  /* value of PROCID and ID tokens. */
@@ -487,7 +487,7 @@ ProcID: PROCID 				/* default $$ = $1 */
 RuleID: ID		         	/* default $$ = $1 */ 
 NodeID: ID				/* default $$ = $1 */
       | NUM				{ char id[64]; int write;
-					  write = snprintf(id, 64, "%d", $1);
+					  write = snprintf(id, 64, "%ld", $1);
 				          if(write < 0) {
 					    yyerror("Node ID conversion failed.");
 					    exit(1);
@@ -496,7 +496,7 @@ NodeID: ID				/* default $$ = $1 */
 					}
 EdgeID: ID				/* default $$ = $1 */ 
       | NUM				{ char id[64]; int write;
-					  write = snprintf(id, 64, "%d", $1);
+					  write = snprintf(id, 64, "%ld", $1);
 				          if(write < 0) {
 					    yyerror("Edge ID conversion failed.");
 					    exit(1);
@@ -609,7 +609,7 @@ void printASTCondition(GPCondition *const cond, FILE *dot_file)
           atom->id = next_id++;
 
           print_to_dot_file("node%d[label=\"%d\\n%d.%d-%d.%d\\n"
-                            "Number: %d\"]\n", atom->id, atom->id, 
+                            "Number: %ld\"]\n", atom->id, atom->id, 
                             LOCATION_ARGS(atom->location), atom->number);
           break;
 
@@ -319,6 +319,31 @@ bool isPredicate(Rule *rule)
    return true;
 }
 
+bool requiredPredicate(Condition *condition, Predicate *predicate, bool *negated)
+{
+   if(condition == NULL) return false;
+   switch(condition->type)
+   {
+      case 'e':
+           if(condition->predicate != predicate) return false;
+           *negated = false;
+           return true;
+
+      case 'n':
+           if(condition->neg_condition->type != 'e' ||
+              condition->neg_condition->predicate != predicate) return false;
+           *negated = true;
+           return true;
+
+      case 'a':
+           return requiredPredicate(condition->left_condition, predicate, negated) ||
+                  requiredPredicate(condition->right_condition, predicate, negated);
+
+      default:
+           return false;
+   }
+}
+
 Variable *getVariable(Rule *rule, string name)
 {
    int index;
@@ -449,6 +474,31 @@ bool hasListVariable(RuleLabel label)
    return false;
 }
 
+bool isConstantLabel(RuleLabel label)
+{
+   if(label.list == NULL) return true;
+   RuleListItem *item = label.list->first;
+   while(item != NULL)
+   {
+      if(item->atom->type != INTEGER_CONSTANT && 
+         item->atom->type != STRING_CONSTANT) return false;
+      item = item->next;
+   }
+   return true;
+}
+
+bool hasConcatenation(RuleLabel label)
+{
+   if(label.list == NULL) return false;
+   RuleListItem *item = label.list->first;
+   while(item != NULL)
+   {
+      if(item->atom->type == CONCAT) return true;
+      item = item->next;
+   }
+   return false;
+}
+
 static void printOperation(RuleAtom *left_exp, RuleAtom *right_exp, 
                            string const operation, bool nested, FILE *file);
 
@@ -457,7 +507,7 @@ static void printRuleAtom(RuleAtom *atom, bool nested, FILE *file)
     switch(atom->type) 
     {
         case INTEGER_CONSTANT: 
-             fprintf(file, "%d", atom->number);
+             fprintf(file, "%ld", atom->number);
              break;
               
         case STRING_CONSTANT:
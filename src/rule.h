@@ -88,7 +88,7 @@ typedef struct RuleList {
 typedef struct RuleAtom { 
    AtomType type;
    union {
-      int number;
+      long number;
       string string;
       struct {
          int id;
@@ -244,6 +244,11 @@ void addVariablePredicate(Variable *variable, Predicate *predicate, int size);
  * deletes nor relabels any items. */
 bool isPredicate(Rule *rule);
 
+/* Returns true if the condition can only hold if the predicate is true, or
+ * false if *negated is set: the predicate, or its negation, is a conjunct of
+ * the condition. A match for which it fails can be rejected early. */
+bool requiredPredicate(Condition *condition, Predicate *predicate, bool *negated);
+
 Variable *getVariable(Rule *rule, string name);
 int getVariableId(Rule *rule, string name);
 RuleNode *getRuleNode(RuleGraph *graph, int index);
@@ -257,6 +262,10 @@ RuleList *appendRuleAtom(RuleList *list, RuleAtom *atom);
 bool equalRuleLists(RuleLabel left_label, RuleLabel right_label);
 /* Used to determine the appropriate function call to generate label matching code. */
 bool hasListVariable(RuleLabel label);
+/* Returns true if every atom of the label is an integer or string constant. */
+bool isConstantLabel(RuleLabel label);
+/* Returns true if an atom of the label is a string concatenation. */
+bool hasConcatenation(RuleLabel label);
 
 void printRule(Rule *rule, FILE *file);
 void freeRule(Rule *rule);
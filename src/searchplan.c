@@ -15,11 +15,6 @@
 
 #include "searchplan.h"
 
-static void traverseNode(Searchplan *searchplan, RuleNode *node, char type, 
-                         bool *tagged_nodes, bool *tagged_edges);
-static void traverseEdge(Searchplan *searchplan, RuleEdge *node, char type, 
-                         bool *tagged_nodes, bool *tagged_edges);
-
 static Searchplan *makeSearchplan(void)
 {
    Searchplan *plan = malloc(sizeof(Searchplan));
@@ -30,6 +25,7 @@ static Searchplan *makeSearchplan(void)
    }   
    plan->first = NULL;
    plan->last = NULL;
+   plan->cost = 0.0;
    return plan;
 }
 
@@ -61,125 +57,448 @@ static void appendSearchOp(Searchplan *plan, char type, int index)
    }
 }  
 
-Searchplan *generateSearchplan(RuleGraph *lhs)
+/* Estimates for the cost model. The absolute values only matter relative to
+ * each other: a start operation scans a node list of about NODE_ESTIMATE
+ * nodes, and an edge operation scans an incidence list of about
+ * DEGREE_ESTIMATE edges. */
+#define NODE_ESTIMATE 1000.0
+#define DEGREE_ESTIMATE 4.0
+/* Each host edge is in the incidence lists of two nodes. */
+#define EDGE_ESTIMATE (NODE_ESTIMATE * DEGREE_ESTIMATE / 2.0)
+
+/* Returns the fraction of host items expected to match the label. Constant
+ * labels are the most selective, followed by fixed-length labels with atom
+ * variables. Labels containing a list variable match almost anything. */
+static double labelSelectivity(RuleLabel label)
 {
-   Searchplan *searchplan = makeSearchplan();
-   bool tagged_nodes[lhs->node_index]; 
-   bool tagged_edges[lhs->edge_index];  
-   int index;
-   for(index = 0; index < lhs->node_index; index++) tagged_nodes[index] = false;
-   for(index = 0; index < lhs->edge_index; index++) tagged_edges[index] = false;
+   double selectivity;
+   if(hasListVariable(label)) selectivity = 1.0;
+   else if(label.length == 0) selectivity = 0.5;
+   else if(isConstantLabel(label)) selectivity = 0.1;
+   else selectivity = 0.7;
+   /* Matching is restricted to the host lists of the given mark. */
+   if(label.mark == ANY) selectivity *= 0.8;
+   else if(label.mark != NONE) selectivity *= 0.2;
+   return selectivity;
+}
 
-   /* Perform a depth-first traversal of the graph from its root nodes. */
-   for(index = 0; index < lhs->node_index; index++)
-   {
-      RuleNode *node = getRuleNode(lhs, index);
-      if(node->root && !tagged_nodes[node->index]) 
-         traverseNode(searchplan, node, 'r', tagged_nodes, tagged_edges);
-   }
+/* Returns the fraction of host nodes expected to match the LHS node. A node
+ * with a high required degree rules out most host nodes, and a deleted node
+ * must match the degree exactly because of the dangling condition. */
+static double nodeSelectivity(RuleNode *node)
+{
+   double selectivity = labelSelectivity(node->label);
+   if(node->root) selectivity *= 0.01;
+   int degree = node->indegree + node->outdegree + node->bidegree;
+   selectivity /= 1.0 + degree;
+   if(node->interface == NULL) selectivity *= 0.5;
+   return selectivity;
+}
 
-   /* Search for undiscovered nodes, namely nodes that are not reachable 
-    * from a root node. */
-   for(index = 0; index < lhs->node_index; index++)
+/* Number of candidates for a node matched from scratch. */
+static double startBranching(RuleNode *node)
+{
+   return NODE_ESTIMATE * nodeSelectivity(node);
+}
+
+/* Number of candidates for an edge matched from one of its incident nodes,
+ * multiplied by the selectivity of the node at the other end if that node is
+ * matched by the same step. An edge whose other end is already matched only
+ * has to be checked against that node. */
+static double edgeBranching(RuleEdge *edge, RuleNode *other, bool *tagged_nodes)
+{
+   double branching = DEGREE_ESTIMATE * labelSelectivity(edge->label);
+   if(edge->bidirectional) branching *= 2.0;
+   if(edge->source == edge->target) return branching / DEGREE_ESTIMATE;
+   if(tagged_nodes[other->index]) return branching / DEGREE_ESTIMATE;
+   return branching * nodeSelectivity(other);
+}
+
+/* Number of candidates for an edge matched from scratch from the lists of
+ * host edges by mark. */
+static double edgeStartBranching(RuleEdge *edge)
+{
+   return EDGE_ESTIMATE * labelSelectivity(edge->label);
+}
+
+/* With -E, a plan can start at an edge of a mark other than NONE, whose
+ * lists are expected to be short. A bidirectional edge is not a start, as
+ * the first of its nodes matched from the host edge would be committed to
+ * one of its ends. */
+static bool startEdge(RuleEdge *edge)
+{
+   return edge_lists && edge->label.mark != NONE && !edge->bidirectional;
+}
+
+/* The required predicates of a rule's condition (see requiredPredicate), and
+ * the LHS items and variables bound by a partial searchplan. A required
+ * predicate is decided, and rejects the matches that fail it, as soon as its
+ * nodes and variables are bound. */
+typedef struct PlanConditions {
+   Rule *rule;
+   int count;
+   Predicate **predicates;
+   bool *negated;
+   bool *decided;
+   bool *bound_variables;
+} PlanConditions;
+
+static void collectRequiredPredicates(PlanConditions *conditions, Condition *condition)
+{
+   switch(condition->type)
    {
-      if(!tagged_nodes[index]) 
+      case 'e':
       {
-         RuleNode *node = getRuleNode(lhs, index);
-         traverseNode(searchplan, node, 'n', tagged_nodes, tagged_edges);
+           bool negated = false;
+           if(requiredPredicate(conditions->rule->condition, condition->predicate, &negated))
+           {
+              conditions->predicates[conditions->count] = condition->predicate;
+              conditions->negated[conditions->count] = negated;
+              conditions->decided[conditions->count] = false;
+              conditions->count++;
+           }
+           break;
       }
+      case 'n':
+           collectRequiredPredicates(conditions, condition->neg_condition);
+           break;
+
+      case 'a':
+      case 'o':
+           collectRequiredPredicates(conditions, condition->left_condition);
+           collectRequiredPredicates(conditions, condition->right_condition);
+           break;
+
+      default:
+           break;
    }
-   return searchplan;
 }
 
-static void traverseNode(Searchplan *searchplan, RuleNode *node, char type, 
-                  bool *tagged_nodes, bool *tagged_edges)
+/* Returns the fraction of matches expected to satisfy the predicate. The
+ * fraction for a negated predicate is the complement. */
+static double predicateSelectivity(Predicate *predicate, bool negated)
 {
-   tagged_nodes[node->index] = true;
-   appendSearchOp(searchplan, type, node->index);
-   /* Search the node's incident edges for an untagged edge. Outedges
-    * are arbitrarily examined first. If no such edges exist, the function
-    * exits and control passes to the caller. */
-   RuleEdges *iterator = node->outedges;
-   while(iterator != NULL)
+   double selectivity;
+   switch(predicate->type)
    {
-      RuleEdge *edge = iterator->edge;
-      if(!tagged_edges[edge->index])
-      {
-         if(edge->source == edge->target) 
-              traverseEdge(searchplan, edge, 'l', tagged_nodes, tagged_edges);
-         else traverseEdge(searchplan, edge, 's', tagged_nodes, tagged_edges);
-      }
-      iterator = iterator->next;
+      /* Two nodes chosen independently are rarely adjacent. */
+      case EDGE_PRED: selectivity = 0.05; break;
+      case EQUAL: selectivity = 0.1; break;
+      case NOT_EQUAL: selectivity = 0.9; break;
+      default: selectivity = 0.5; break;
+   }
+   return negated ? 1.0 - selectivity : selectivity;
+}
+
+/* Marks the variables occurring in the label as bound. */
+static void bindAtomVariables(RuleAtom *atom, bool *bound_variables)
+{
+   if(atom->type == VARIABLE) bound_variables[atom->variable.id] = true;
+   else if(atom->type == CONCAT)
+   {
+      bindAtomVariables(atom->bin_op.left_exp, bound_variables);
+      bindAtomVariables(atom->bin_op.right_exp, bound_variables);
    }
-   iterator = node->inedges;
-   while(iterator != NULL)
+}
+
+static void bindLabelVariables(RuleLabel label, bool *bound_variables)
+{
+   if(label.list == NULL) return;
+   for(RuleListItem *item = label.list->first; item != NULL; item = item->next)
+      bindAtomVariables(item->atom, bound_variables);
+}
+
+static bool hasPredicate(Predicate **predicates, int count, Predicate *predicate)
+{
+   for(int index = 0; index < count; index++)
+      if(predicates[index] == predicate) return true;
+   return false;
+}
+
+/* Returns the fraction of matches expected to pass the required predicates
+ * that are decided once the node and the edge, either of which may be NULL,
+ * are matched in addition to the tagged nodes. If commit is set, the node's
+ * and edge's variables are bound and the predicates are marked decided. */
+static double conditionSelectivity(PlanConditions *conditions, bool *tagged_nodes,
+                                   RuleNode *node, RuleEdge *edge, bool commit)
+{
+   if(conditions->count == 0) return 1.0;
+   Rule *rule = conditions->rule;
+   bool bound[rule->variables + 1];
+   for(int index = 0; index < rule->variables; index++)
+      bound[index] = conditions->bound_variables[index];
+   if(node != NULL) bindLabelVariables(node->label, bound);
+   if(edge != NULL) bindLabelVariables(edge->label, bound);
+
+   double selectivity = 1.0;
+   for(int p = 0; p < conditions->count; p++)
    {
-      RuleEdge *edge = iterator->edge;
-      if(!tagged_edges[edge->index])
+      if(conditions->decided[p]) continue;
+      Predicate *predicate = conditions->predicates[p];
+      bool ready = true;
+      for(int index = 0; index < rule->lhs->node_index && ready; index++)
       {
-         if(edge->source == edge->target)
-              traverseEdge(searchplan, edge, 'l', tagged_nodes, tagged_edges);
-         else traverseEdge(searchplan, edge, 't', tagged_nodes, tagged_edges);
+         RuleNode *other = getRuleNode(rule->lhs, index);
+         if(other->predicates == NULL || tagged_nodes[index] || other == node) continue;
+         if(hasPredicate(other->predicates, other->predicate_count, predicate)) ready = false;
       }
-      iterator = iterator->next;
+      for(int index = 0; index < rule->variables && ready; index++)
+      {
+         Variable *variable = &(rule->variable_list[index]);
+         if(variable->predicates == NULL || bound[index]) continue;
+         if(hasPredicate(variable->predicates, variable->predicate_count, predicate))
+            ready = false;
+      }
+      if(!ready) continue;
+      selectivity *= predicateSelectivity(predicate, conditions->negated[p]);
+      if(commit) conditions->decided[p] = true;
    }
-   iterator = node->outedges_dashed;
-   while(iterator != NULL)
+   if(commit)
+      for(int index = 0; index < rule->variables; index++)
+         conditions->bound_variables[index] = bound[index];
+   return selectivity;
+}
+
+/* The incident edges of a node are stored in four lists. */
+static RuleEdges *incidentEdges(RuleNode *node, int list)
+{
+   switch(list)
    {
-      RuleEdge *edge = iterator->edge;
-      if(!tagged_edges[edge->index])
+      case 0: return node->outedges;
+      case 1: return node->inedges;
+      case 2: return node->outedges_dashed;
+      default: return node->inedges_dashed;
+   }
+}
+
+/* Builds a searchplan that matches the given node first, or the given edge
+ * and then its source and target if start_edge is not NULL, and accumulates
+ * the estimated cost of the plan: the sum, over all operations, of the number
+ * of partial matches expected to reach that operation. The plan is built
+ * greedily. At each step, the cheapest untagged edge incident to a tagged
+ * node is appended, followed by its other incident node if that node is
+ * untagged. When no such edge exists, the cheapest untagged node starts a
+ * new component. The required predicates of the rule's condition scale the
+ * number of partial matches at the operation by which they are decided. */
+static Searchplan *buildSearchplan(Rule *rule, RuleNode *start, RuleEdge *start_edge)
+{
+   RuleGraph *lhs = rule->lhs;
+   Searchplan *plan = makeSearchplan();
+   bool tagged_nodes[lhs->node_index];
+   bool tagged_edges[lhs->edge_index];
+   int index;
+   for(index = 0; index < lhs->node_index; index++) tagged_nodes[index] = false;
+   for(index = 0; index < lhs->edge_index; index++) tagged_edges[index] = false;
+
+   Predicate *predicates[rule->predicate_count + 1];
+   bool negated[rule->predicate_count + 1], decided[rule->predicate_count + 1];
+   bool bound_variables[rule->variables + 1];
+   for(index = 0; index < rule->variables; index++) bound_variables[index] = false;
+   PlanConditions conditions = {rule, 0, predicates, negated, decided, bound_variables};
+   if(rule->condition != NULL) collectRequiredPredicates(&conditions, rule->condition);
+
+   double matches = 1.0;
+   RuleNode *next_node = start;
+   if(start_edge != NULL)
+   {
+      /* The nodes are matched from the host edge by the operations after the
+       * edge operation, the source first. */
+      tagged_edges[start_edge->index] = true;
+      matches *= edgeStartBranching(start_edge) *
+                 conditionSelectivity(&conditions, tagged_nodes, NULL, start_edge, true);
+      appendSearchOp(plan, 'e', start_edge->index);
+      plan->cost += matches;
+      RuleNode *ends[2] = {start_edge->source, start_edge->target};
+      for(int end = 0; end < 2; end++)
       {
-         if(edge->source == edge->target) 
-              traverseEdge(searchplan, edge, 'l', tagged_nodes, tagged_edges);
-         else traverseEdge(searchplan, edge, 's', tagged_nodes, tagged_edges);
+         if(tagged_nodes[ends[end]->index]) continue;
+         matches *= nodeSelectivity(ends[end]) *
+                    conditionSelectivity(&conditions, tagged_nodes, ends[end], NULL, true);
+         tagged_nodes[ends[end]->index] = true;
+         appendSearchOp(plan, end == 0 ? 'o' : 'i', ends[end]->index);
+         plan->cost += matches;
       }
-      iterator = iterator->next;
+      next_node = NULL;
    }
-   iterator = node->inedges_dashed;
-   while(iterator != NULL)
+   while(true)
    {
-      RuleEdge *edge = iterator->edge;
-      if(!tagged_edges[edge->index])
+      if(next_node != NULL)
       {
-         if(edge->source == edge->target)
-              traverseEdge(searchplan, edge, 'l', tagged_nodes, tagged_edges);
-         else traverseEdge(searchplan, edge, 't', tagged_nodes, tagged_edges);
+         matches *= startBranching(next_node) *
+                    conditionSelectivity(&conditions, tagged_nodes, next_node, NULL, true);
+         tagged_nodes[next_node->index] = true;
+         appendSearchOp(plan, next_node->root ? 'r' : 'n', next_node->index);
+         plan->cost += matches;
       }
-      iterator = iterator->next;
+
+      /* Expand from the tagged nodes until no untagged incident edge remains. */
+      while(true)
+      {
+         RuleEdge *best_edge = NULL;
+         RuleNode *best_from = NULL;
+         double best_branching = 0.0;
+         for(index = 0; index < lhs->node_index; index++)
+         {
+            if(!tagged_nodes[index]) continue;
+            RuleNode *node = getRuleNode(lhs, index);
+            int list;
+            for(list = 0; list < 4; list++)
+            {
+               RuleEdges *iterator = incidentEdges(node, list);
+               while(iterator != NULL)
+               {
+                  RuleEdge *edge = iterator->edge;
+                  if(!tagged_edges[edge->index])
+                  {
+                     RuleNode *other = edge->source == node ? edge->target : edge->source;
+                     double branching = edgeBranching(edge, other, tagged_nodes) *
+                        conditionSelectivity(&conditions, tagged_nodes,
+                                             tagged_nodes[other->index] ? NULL : other,
+                                             edge, false);
+                     if(best_edge == NULL || branching < best_branching)
+                     {
+                        best_edge = edge;
+                        best_from = node;
+                        best_branching = branching;
+                     }
+                  }
+                  iterator = iterator->next;
+               }
+            }
+         }
+         if(best_edge == NULL) break;
+
+         tagged_edges[best_edge->index] = true;
+         RuleNode *best_other = best_edge->source == best_from ? best_edge->target :
+                                                                 best_edge->source;
+         conditionSelectivity(&conditions, tagged_nodes,
+                              tagged_nodes[best_other->index] ? NULL : best_other,
+                              best_edge, true);
+         matches *= best_branching;
+         plan->cost += matches;
+         if(best_edge->source == best_edge->target)
+         {
+            appendSearchOp(plan, 'l', best_edge->index);
+            continue;
+         }
+         /* The node operation must directly follow the edge operation,
+          * because it is matched from the host edge found by that operation. */
+         if(best_edge->source == best_from)
+         {
+            appendSearchOp(plan, 's', best_edge->index);
+            RuleNode *target = best_edge->target;
+            if(!tagged_nodes[target->index])
+            {
+               tagged_nodes[target->index] = true;
+               appendSearchOp(plan, best_edge->bidirectional ? 'b' : 'i', target->index);
+            }
+         }
+         else
+         {
+            appendSearchOp(plan, 't', best_edge->index);
+            RuleNode *source = best_edge->source;
+            if(!tagged_nodes[source->index])
+            {
+               tagged_nodes[source->index] = true;
+               appendSearchOp(plan, best_edge->bidirectional ? 'b' : 'o', source->index);
+            }
+         }
+      }
+
+      /* Start a new component with the cheapest untagged node, if any. */
+      next_node = NULL;
+      double next_branching = 0.0;
+      for(index = 0; index < lhs->node_index; index++)
+      {
+         if(tagged_nodes[index]) continue;
+         RuleNode *node = getRuleNode(lhs, index);
+         double branching = startBranching(node) *
+                            conditionSelectivity(&conditions, tagged_nodes, node, NULL, false);
+         if(next_node == NULL || branching < next_branching)
+         {
+            next_node = node;
+            next_branching = branching;
+         }
+      }
+      if(next_node == NULL) break;
    }
+   return plan;
 }
 
-static void traverseEdge(Searchplan *searchplan, RuleEdge *edge, char type,
-                  bool *tagged_nodes, bool *tagged_edges)
+Searchplan *generateSearchplan(Rule *rule)
 {
-   tagged_edges[edge->index] = true;
-   appendSearchOp(searchplan, type, edge->index);
-
-   /* If the edge is a loop, its incident node has already been examined. 
-    * Backtrack by returning control to the caller. */
-   if(type == 'l') return;
-
-   /* Continue the graph traversal of any untagged nodes incident to the edge. */
-   if(type == 's')
+   RuleGraph *lhs = rule->lhs;
+   /* Every LHS node, and with -E every marked LHS edge, is tried as the first
+    * operation. Ties go to the plan found first, so plans for rules with
+    * uniform LHS items follow the order of the LHS. */
+   Searchplan *best_plan = NULL;
+   int index;
+   for(index = 0; index < lhs->node_index + lhs->edge_index; index++)
    {
-      RuleNode *target = edge->target;
-      if(!tagged_nodes[target->index])
+      Searchplan *plan;
+      if(index < lhs->node_index) plan = buildSearchplan(rule, getRuleNode(lhs, index), NULL);
+      else
+      {
+         RuleEdge *edge = getRuleEdge(lhs, index - lhs->node_index);
+         if(!startEdge(edge)) continue;
+         plan = buildSearchplan(rule, NULL, edge);
+      }
+      if(best_plan == NULL || plan->cost < best_plan->cost)
       {
-         if(edge->bidirectional) 
-              traverseNode(searchplan, target, 'b', tagged_nodes, tagged_edges);
-         else traverseNode(searchplan, target, 'i', tagged_nodes, tagged_edges);
+         freeSearchplan(best_plan);
+         best_plan = plan;
       }
-   }      
-   else /* type == 't' */ 
+      else freeSearchplan(plan);
+   }
+   if(best_plan == NULL) best_plan = makeSearchplan();
+   return best_plan;
+}
+
+int generateAlternativeSearchplans(Rule *rule, Searchplan **plans, int max_plans)
+{
+   RuleGraph *lhs = rule->lhs;
+   plans[0] = generateSearchplan(rule);
+   int count = 1;
+   /* A plan starting at a root node does not depend on the mark counts. The
+    * graph does not count its edges by mark, so neither does a plan starting
+    * at an edge. */
+   if(plans[0]->first == NULL || plans[0]->first->type == 'r' ||
+      plans[0]->first->type == 'e') return count;
+   RuleNode *start = getRuleNode(lhs, plans[0]->first->index);
+
+   /* For each other start mark, keep the cheapest plan starting at a
+    * non-root node with that mark. */
+   int mark;
+   for(mark = NONE; mark <= ANY && count < max_plans; mark++)
    {
-      RuleNode *source = edge->source;
-      if(!tagged_nodes[source->index])
+      if(mark == DASHED || mark == start->label.mark) continue;
+      Searchplan *best_plan = NULL;
+      int index;
+      for(index = 0; index < lhs->node_index; index++)
       {
-         if(edge->bidirectional) 
-              traverseNode(searchplan, source, 'b', tagged_nodes, tagged_edges);
-         else traverseNode(searchplan, source, 'o', tagged_nodes, tagged_edges);  
+         RuleNode *node = getRuleNode(lhs, index);
+         if(node->root || (int)node->label.mark != mark) continue;
+         Searchplan *plan = buildSearchplan(rule, node, NULL);
+         if(best_plan == NULL || plan->cost < best_plan->cost)
+         {
+            freeSearchplan(best_plan);
+            best_plan = plan;
+         }
+         else freeSearchplan(plan);
       }
+      if(best_plan != NULL) plans[count++] = best_plan;
    }
+   return count;
+}
+
+double searchplanWeight(Searchplan *plan, RuleGraph *lhs)
+{
+   if(plan->first == NULL) return 0.0;
+   RuleNode *start = getRuleNode(lhs, plan->first->index);
+   double mark_selectivity = 1.0;
+   if(start->label.mark == ANY) mark_selectivity = 0.8;
+   else if(start->label.mark != NONE) mark_selectivity = 0.2;
+   return plan->cost / (NODE_ESTIMATE * mark_selectivity);
 }
 
 void printSearchplan(Searchplan *plan)
@@ -195,6 +514,7 @@ void printSearchplan(Searchplan *plan)
          printf("Type: %c\nIndex: %d\n\n", iterator->type, iterator->index);
          iterator = iterator->next;  
       }
+      printf("Estimated cost: %.2f\n\n", plan->cost);
    }
 }
 
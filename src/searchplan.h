@@ -41,7 +41,8 @@
  * 'i': Node matched from its incoming edge.
  * 'o': Node matched from its outgoing edge.
  * 'b': Node matched from an incident bidirectional edge.
- * 'e': Edge.
+ * 'e': Edge matched from the lists of host edges by mark (-E), followed by
+ *      the operations matching its source and target from the host edge.
  * 's': Edge matched from its source.
  * 't': Edge matched from its target.
  * 'l': Looping edge matched from its incident node.
@@ -56,29 +57,46 @@ typedef struct SearchOp {
 } SearchOp;
 
 /* Operations are appended to the searchplan, so a pointer to the last
- * searchplan operation is maintained for efficiency. */
+ * searchplan operation is maintained for efficiency. The cost is the estimate
+ * used by generateSearchplan to choose between candidate plans. */
 typedef struct Searchplan {
    SearchOp *first;
    SearchOp *last;
+   double cost;
 } Searchplan;
 
-/* generateSearchplan traverses a graph in order to create a searchplan
- * using the following algorithm:
- * (1) Walk the graph in a depth-first manner starting at the root nodes. 
- *     Tag each item, including the initial root node, when it is encountered.
- *     If the next item in the traversal is untagged, tag it and append the
- *     appropriate operation to the searchplan. For instance, if we examine an
- *     outgoing edge of a root node, add the 's' operation to the searchplan.
- *     Once this step is complete, all connected components containing root
- *     nodes have been examined.
- * (2) Scan the node list of the graph, performing step 2 on any untagged nodes.
- *     Unnecessary if the input graph is root-connected.
- *
- * The depth-first search is performed by recursive calls to traverseNode and
- * traverseEdge. These two functions are responsible for checking if items
- * are tagged, tagging items, and adding new operations to the searchplan. */ 
+/* generateSearchplan builds one candidate searchplan for each possible first
+ * node, and with -E for each edge with a mark other than NONE that is not
+ * bidirectional, and returns the one with the lowest estimated cost.
+ * (1) The cost model estimates how many host items match each LHS item.
+ *     Root nodes are very selective, constant labels are more selective than
+ *     labels with variables, marked items are more selective than unmarked
+ *     ones, nodes with a high required degree are more selective than nodes
+ *     with a low one, and deleted nodes must match their degree exactly.
+ *     A predicate that the rule's condition requires (see requiredPredicate)
+ *     reduces the expected number of matches once all its nodes and
+ *     variables are matched, since failing matches are rejected there.
+ * (2) A candidate plan is built greedily from its first node: the cheapest
+ *     unmatched edge incident to a matched node is appended next, together
+ *     with its unmatched incident node if it has one, so that every node
+ *     after the first node of a connected component is reached via an edge.
+ *     Other components are started from their cheapest node. Both choices
+ *     count the required predicates that the new items decide.
+ * (3) The cost of a plan is the sum of the expected number of partial matches
+ *     reaching each of its operations. */
+Searchplan *generateSearchplan(Rule *rule);
+
+/* Used for runtime-adaptive matching. Stores the plan returned by
+ * generateSearchplan in plans[0], followed by the cheapest plan for each other
+ * mark a non-root first node can have, and returns the number of plans
+ * stored (at most max_plans). Only plans[0] is generated if it starts at a
+ * root node. */
+int generateAlternativeSearchplans(Rule *rule, Searchplan **plans, int max_plans);
 
-Searchplan *generateSearchplan(RuleGraph *lhs);
+/* Returns the estimated cost of the plan per host node carrying the mark of
+ * its first node. Multiplying by the number of such nodes in the host graph
+ * gives the runtime estimate compared by adaptive matchers. */
+double searchplanWeight(Searchplan *plan, RuleGraph *lhs);
 
 void printSearchplan(Searchplan *searchplan);
 void freeSearchplan(Searchplan *searchplan);